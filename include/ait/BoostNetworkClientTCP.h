@@ -14,6 +14,7 @@
 #include <memory>
 #include <boost/asio.hpp>
 #include <ait/serializable.h>
+#include <ait/NetworkMessage.h>
 
 #define FUNCTION_LINE_STRING (std::string(__FILE__) + " [" + std::string(__FUNCTION__) + ":" + std::to_string(__LINE__) + "]")
 #define ANNOTATE_EXC(type, s) type (std::string(FUNCTION_LINE_STRING).append(": ").append(s))
@@ -208,6 +209,16 @@ public:
 		//return sendDataBlocking(reinterpret_cast<const uint8_t*>(&data), sizeof(T));
 	}
 
+	//! Blocking call. Sends all buffers of the message with a single gather write. Returns the number of sent bytes.
+	size_t sendMessageBlocking(NetworkMessage& message) {
+		boost::system::error_code ec;
+		size_t sentBytes = boost::asio::write(socket_, message.getBuffers(), ec);
+		if (ec) {
+			throw ANNOTATE_EXC_BOOST(Error, std::string("Unable to send message on socket"), ec);
+		}
+		return sentBytes;
+	}
+
 	//! Shuts down and closes the socket
 	void close() {
 		if (socket_.is_open()) {
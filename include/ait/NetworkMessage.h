@@ -0,0 +1,113 @@
+//==================================================
+// NetworkMessage.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <boost/asio/buffer.hpp>
+#include <ait/serializable.h>
+
+namespace ait
+{
+
+//! A message that is described by a sequence of buffer views so that it can be sent with a single gather write.
+//!
+//! Serialized values (headers, frame infos, ...) and small buffers are copied into internal storage.
+//! Large buffers are only referenced and have to stay valid until the message is sent.
+//! Clearing the message keeps the allocated storage so that it can be reused for the next message.
+class NetworkMessage : public ait::Writer
+{
+public:
+	//! Buffers smaller than this are copied into the internal storage instead of being referenced
+	static const size_t COPY_THRESHOLD = 512;
+
+	NetworkMessage()
+		: size_(0) {
+	}
+
+	void clear() {
+		storage_.clear();
+		segments_.clear();
+		buffers_.clear();
+		size_ = 0;
+	}
+
+	//! Serializes a value into the message (same format as ait::Writer::write()).
+	template <typename T>
+	size_t addValue(const T& value) {
+		return write(value);
+	}
+
+	//! Adds a buffer view to the message. The data has to stay valid until the message is sent.
+	void addBuffer(const void* data, size_t size) {
+		if (size < COPY_THRESHOLD) {
+			_write(data, size);
+			return;
+		}
+		Segment segment;
+		segment.external_data = reinterpret_cast<const uint8_t*>(data);
+		segment.offset = 0;
+		segment.size = size;
+		segments_.push_back(segment);
+		size_ += size;
+	}
+
+	size_t _write(const void* data, size_t size) override {
+		// Extend the previous segment if it is also located in the internal storage
+		if (segments_.empty() || segments_.back().external_data != nullptr) {
+			Segment segment;
+			segment.external_data = nullptr;
+			segment.offset = storage_.size();
+			segment.size = 0;
+			segments_.push_back(segment);
+		}
+		const size_t offset = storage_.size();
+		storage_.resize(offset + size);
+		std::memcpy(storage_.data() + offset, data, size);
+		segments_.back().size += size;
+		size_ += size;
+		return size;
+	}
+
+	//! Total number of bytes of the message
+	size_t getSize() const {
+		return size_;
+	}
+
+	size_t getNumSegments() const {
+		return segments_.size();
+	}
+
+	//! Buffer sequence for Boost Asio. Only valid until the message is modified.
+	const std::vector<boost::asio::const_buffer>& getBuffers() {
+		// The storage might have been reallocated while adding values so the buffers are only created now
+		buffers_.clear();
+		for (const Segment& segment : segments_) {
+			const uint8_t* data = segment.external_data != nullptr ? segment.external_data : storage_.data() + segment.offset;
+			buffers_.push_back(boost::asio::const_buffer(data, segment.size));
+		}
+		return buffers_;
+	}
+
+private:
+	struct Segment {
+		// nullptr if the segment is located in the internal storage
+		const uint8_t* external_data;
+		size_t offset;
+		size_t size;
+	};
+
+	std::vector<uint8_t> storage_;
+	std::vector<Segment> segments_;
+	std::vector<boost::asio::const_buffer> buffers_;
+	size_t size_;
+};
+
+}
@@ -157,7 +157,7 @@ namespace ait {
     {
         static size_t read(Reader* reader, T& tuple) {
             size_t bytes_read = 0;
-            bytes_read += ValueReaderTuple<size - 1, T>::write(reader, tuple);
+            bytes_read += ValueReaderTuple<size - 1, T>::read(reader, tuple);
             bytes_read += ValueReader<typename std::tuple_element<size - 1, T>::type>::read(reader, std::get<size - 1>(tuple));
             return bytes_read;
         }
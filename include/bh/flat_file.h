@@ -0,0 +1,287 @@
+//==================================================
+// flat_file.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "common.h"
+#include "memory_mapped_file.h"
+
+namespace bh {
+
+/// 64 bit checksum of a memory block (FNV-1a style hashing of 8 byte words)
+inline std::uint64_t computeChecksum64(const void* data, const std::size_t size) {
+  const std::uint64_t prime = 0x100000001B3ull;
+  std::uint64_t checksum = 0xCBF29CE484222325ull;
+  const char* bytes = static_cast<const char*>(data);
+  std::size_t i = 0;
+  for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t)) {
+    std::uint64_t word;
+    std::memcpy(&word, bytes + i, sizeof(word));
+    checksum = (checksum ^ word) * prime;
+    checksum ^= checksum >> 29;
+  }
+  for (; i < size; ++i) {
+    checksum = (checksum ^ static_cast<unsigned char>(bytes[i])) * prime;
+  }
+  return checksum;
+}
+
+/// Contiguous array of elements that is owned by someone else (i.e. a memory mapped file)
+template <typename T>
+class ConstArrayView {
+public:
+  ConstArrayView()
+  : data_(nullptr), size_(0) {}
+
+  ConstArrayView(const T* data, const std::size_t size)
+  : data_(data), size_(size) {}
+
+  const T* data() const {
+    return data_;
+  }
+
+  std::size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  const T* begin() const {
+    return data_;
+  }
+
+  const T* end() const {
+    return data_ + size_;
+  }
+
+  const T& operator[](const std::size_t index) const {
+    return data_[index];
+  }
+
+private:
+  const T* data_;
+  std::size_t size_;
+};
+
+/// Layout of flat binary files: A header and a table of sections followed by the section data.
+///
+/// Each section is an array of trivially copyable elements that starts at an aligned offset so that it can be
+/// used in place after memory mapping the file. Every section has its own checksum.
+/// Values are stored in the byte order of the machine that wrote the file (little endian on all our platforms).
+struct FlatFileLayout {
+  static constexpr std::size_t ALIGNMENT = 64;
+
+  struct Header {
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t num_sections;
+    std::uint64_t section_table_checksum;
+  };
+
+  struct SectionEntry {
+    std::uint32_t id;
+    std::uint32_t element_size;
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint64_t checksum;
+  };
+
+  static std::size_t alignOffset(const std::size_t offset) {
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  }
+};
+
+/// Writes sections to a flat binary file.
+///
+/// Only pointers to the section data are kept so the data has to stay valid until write() is called.
+class FlatFileWriter {
+public:
+  FlatFileWriter(const std::uint64_t magic, const std::uint32_t version)
+  : magic_(magic), version_(version) {}
+
+  template <typename T>
+  void addSection(const std::uint32_t id, const T* data, const std::size_t count) {
+    static_assert(std::is_trivially_copyable<T>::value, "Section elements must be trivially copyable");
+    for (const PendingSection& section : sections_) {
+      BH_ASSERT(section.id != id);
+    }
+    PendingSection section;
+    section.id = id;
+    section.element_size = sizeof(T);
+    section.data = reinterpret_cast<const char*>(data);
+    section.size = count * sizeof(T);
+    sections_.push_back(section);
+  }
+
+  template <typename T>
+  void addSection(const std::uint32_t id, const std::vector<T>& data) {
+    addSection(id, data.data(), data.size());
+  }
+
+  void write(const std::string& filename) const {
+    std::vector<FlatFileLayout::SectionEntry> section_table(sections_.size());
+    std::size_t offset = FlatFileLayout::alignOffset(
+            sizeof(FlatFileLayout::Header) + sections_.size() * sizeof(FlatFileLayout::SectionEntry));
+    for (std::size_t i = 0; i < sections_.size(); ++i) {
+      FlatFileLayout::SectionEntry& entry = section_table[i];
+      std::memset(&entry, 0, sizeof(entry));
+      entry.id = sections_[i].id;
+      entry.element_size = static_cast<std::uint32_t>(sections_[i].element_size);
+      entry.offset = offset;
+      entry.size = sections_[i].size;
+      entry.checksum = computeChecksum64(sections_[i].data, sections_[i].size);
+      offset = FlatFileLayout::alignOffset(offset + sections_[i].size);
+    }
+    FlatFileLayout::Header header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = magic_;
+    header.version = version_;
+    header.num_sections = static_cast<std::uint32_t>(sections_.size());
+    header.section_table_checksum = computeChecksum64(
+            section_table.data(), section_table.size() * sizeof(FlatFileLayout::SectionEntry));
+
+    std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+      throw bh::Error("Unable to open file " + filename + " for writing");
+    }
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(section_table.data()),
+              section_table.size() * sizeof(FlatFileLayout::SectionEntry));
+    std::size_t position = sizeof(header) + section_table.size() * sizeof(FlatFileLayout::SectionEntry);
+    const std::vector<char> padding(FlatFileLayout::ALIGNMENT, 0);
+    for (std::size_t i = 0; i < sections_.size(); ++i) {
+      ofs.write(padding.data(), section_table[i].offset - position);
+      ofs.write(sections_[i].data, sections_[i].size);
+      position = section_table[i].offset + sections_[i].size;
+    }
+    if (!ofs) {
+      throw bh::Error("Failed to write file " + filename);
+    }
+  }
+
+private:
+  struct PendingSection {
+    std::uint32_t id;
+    std::size_t element_size;
+    const char* data;
+    std::size_t size;
+  };
+
+  std::uint64_t magic_;
+  std::uint32_t version_;
+  std::vector<PendingSection> sections_;
+};
+
+/// Memory maps a flat binary file and gives direct access to its sections (without copying).
+class FlatFileReader {
+public:
+  /// Throws a bh::Error if the file has a different magic number or version or if a checksum does not match.
+  FlatFileReader(const std::string& filename, const std::uint64_t magic, const std::uint32_t version,
+                 const bool verify_checksums = true)
+  : file_(filename), filename_(filename) {
+    if (file_.size() < sizeof(FlatFileLayout::Header)) {
+      throw bh::Error("File " + filename + " is too small for a flat file header");
+    }
+    std::memcpy(&header_, file_.data(), sizeof(header_));
+    if (header_.magic != magic) {
+      throw bh::Error("File " + filename + " has an unexpected magic number");
+    }
+    if (header_.version != version) {
+      throw bh::Error("File " + filename + " has version " + std::to_string(header_.version)
+                      + " but version " + std::to_string(version) + " is required");
+    }
+    const std::size_t section_table_size = header_.num_sections * sizeof(FlatFileLayout::SectionEntry);
+    if (file_.size() < sizeof(FlatFileLayout::Header) + section_table_size) {
+      throw bh::Error("File " + filename + " is too small for its section table");
+    }
+    section_table_.resize(header_.num_sections);
+    std::memcpy(section_table_.data(), file_.data() + sizeof(FlatFileLayout::Header), section_table_size);
+    if (computeChecksum64(section_table_.data(), section_table_size) != header_.section_table_checksum) {
+      throw bh::Error("File " + filename + " has a corrupted section table");
+    }
+    for (const FlatFileLayout::SectionEntry& entry : section_table_) {
+      // Written so that a crafted section table cannot overflow the bounds check
+      if (entry.offset % FlatFileLayout::ALIGNMENT != 0
+          || entry.offset > file_.size() || entry.size > file_.size() - entry.offset) {
+        throw bh::Error("File " + filename + " has an invalid section " + std::to_string(entry.id));
+      }
+    }
+    if (verify_checksums) {
+      verifyChecksums();
+    }
+  }
+
+  /// Whether a file starts with the given magic number (without validating the rest of the file)
+  static bool hasMagic(const std::string& filename, const std::uint64_t magic) {
+    std::ifstream ifs(filename, std::ios::binary);
+    std::uint64_t file_magic = 0;
+    ifs.read(reinterpret_cast<char*>(&file_magic), sizeof(file_magic));
+    return ifs && file_magic == magic;
+  }
+
+  void verifyChecksums() const {
+    for (const FlatFileLayout::SectionEntry& entry : section_table_) {
+      if (computeChecksum64(file_.data() + entry.offset, entry.size) != entry.checksum) {
+        throw bh::Error("File " + filename_ + " has a corrupted section " + std::to_string(entry.id));
+      }
+    }
+  }
+
+  std::uint32_t getVersion() const {
+    return header_.version;
+  }
+
+  bool hasSection(const std::uint32_t id) const {
+    return findSection(id) != nullptr;
+  }
+
+  template <typename T>
+  ConstArrayView<T> getSection(const std::uint32_t id) const {
+    static_assert(std::is_trivially_copyable<T>::value, "Section elements must be trivially copyable");
+    static_assert(FlatFileLayout::ALIGNMENT % alignof(T) == 0, "Section elements must not be over-aligned");
+    const FlatFileLayout::SectionEntry* entry = findSection(id);
+    if (entry == nullptr) {
+      throw bh::Error("File " + filename_ + " has no section " + std::to_string(id));
+    }
+    if (entry->element_size != sizeof(T) || entry->size % sizeof(T) != 0) {
+      throw bh::Error("Section " + std::to_string(id) + " of file " + filename_
+                      + " has elements of size " + std::to_string(entry->element_size)
+                      + " but " + std::to_string(sizeof(T)) + " is required");
+    }
+    return ConstArrayView<T>(reinterpret_cast<const T*>(file_.data() + entry->offset), entry->size / sizeof(T));
+  }
+
+  const MemoryMappedFile& getFile() const {
+    return file_;
+  }
+
+private:
+  const FlatFileLayout::SectionEntry* findSection(const std::uint32_t id) const {
+    for (const FlatFileLayout::SectionEntry& entry : section_table_) {
+      if (entry.id == id) {
+        return &entry;
+      }
+    }
+    return nullptr;
+  }
+
+  MemoryMappedFile file_;
+  std::string filename_;
+  FlatFileLayout::Header header_;
+  std::vector<FlatFileLayout::SectionEntry> section_table_;
+};
+
+}
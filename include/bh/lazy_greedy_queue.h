@@ -0,0 +1,420 @@
+//==================================================
+// lazy_greedy_queue.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "common.h"
+
+namespace bh {
+
+/// Max-priority queue for lazy greedy maximization of a submodular function.
+///
+/// Every entry caches its last evaluated marginal gain. Because of submodularity the cached value is an upper bound
+/// of the current gain, so only the top entry has to be re-evaluated until it is still on top after re-evaluation.
+/// Cached values become stale whenever the selection changes (see invalidateValues()).
+/// Entries can be removed permanently (i.e. after being selected or when they turned out to be invalid).
+template <typename KeyT, typename ValueT, typename KeyHashT = std::hash<KeyT>>
+class LazyGreedyQueue {
+public:
+  using KeyType = KeyT;
+  using ValueType = ValueT;
+  /// Serialized entry (key, cached value, valid flag)
+  using SerializedEntry = std::tuple<KeyType, ValueType, bool>;
+
+  struct Entry {
+    KeyType key;
+    ValueType value;
+    std::size_t epoch;
+    // Number of removals of the key when the entry was pushed. Entries of earlier generations are removed.
+    std::size_t generation;
+  };
+
+  LazyGreedyQueue()
+  : epoch_(1), has_front_(false), num_evaluations_(0), num_updates_(0) {}
+
+  void clear() {
+    heap_.clear();
+    key_generations_.clear();
+    has_front_ = false;
+    epoch_ = 1;
+    num_evaluations_ = 0;
+    num_updates_ = 0;
+  }
+
+  bool empty() const {
+    return !has_front_ && heap_.empty();
+  }
+
+  /// Number of entries (including removed entries that have not been purged yet)
+  std::size_t size() const {
+    return heap_.size() + (has_front_ ? 1 : 0);
+  }
+
+  /// Insert an entry. The value is used as an upper bound until the entry is evaluated.
+  ///
+  /// A key can be pushed again after it was removed.
+  void push(const KeyType& key, const ValueType& value) {
+    heap_.push_back(Entry { key, value, 0, getGeneration(key) });
+    std::push_heap(heap_.begin(), heap_.end(), compareEntries);
+  }
+
+  /// Mark all cached values as stale (i.e. the selection has changed).
+  void invalidateValues() {
+    restoreFront();
+    ++epoch_;
+  }
+
+  /// Permanently remove an entry.
+  ///
+  /// Entries in the heap are only marked as removed by increasing the generation of their key
+  /// and are dropped when they reach the top.
+  void remove(const KeyType& key) {
+    if (has_front_ && front_.key == key) {
+      has_front_ = false;
+    }
+    else {
+      ++key_generations_[key];
+    }
+  }
+
+  /// Current best entry. Only valid after one of the update methods was called.
+  const Entry& top() const {
+    BH_ASSERT(!empty());
+    return has_front_ ? front_ : heap_.front();
+  }
+
+  /// Lazily re-evaluate entries until the top entry is (approximately) the best one.
+  ///
+  /// With epsilon > 0 a re-evaluated entry is accepted if its gain is at least (1 - epsilon) times the largest
+  /// cached upper bound of the remaining entries (threshold greedy).
+  /// Returns the number of evaluations.
+  template <typename Evaluator>
+  std::size_t updateTop(Evaluator&& evaluate, const ValueType epsilon = 0) {
+    restoreFront();
+    ++num_updates_;
+    std::size_t num_evaluations = 0;
+    while (!heap_.empty()) {
+      std::pop_heap(heap_.begin(), heap_.end(), compareEntries);
+      Entry entry = heap_.back();
+      heap_.pop_back();
+      if (isRemoved(entry)) {
+        continue;
+      }
+      if (entry.epoch != epoch_) {
+        entry.value = evaluate(entry.key);
+        entry.epoch = epoch_;
+        ++num_evaluations;
+      }
+      if (heap_.empty() || entry.value >= (1 - epsilon) * heap_.front().value) {
+        setFront(entry);
+        break;
+      }
+      heap_.push_back(entry);
+      std::push_heap(heap_.begin(), heap_.end(), compareEntries);
+    }
+    num_evaluations_ += num_evaluations;
+    return num_evaluations;
+  }
+
+  /// Lazy greedy update that re-evaluates the batch_size stale entries with the largest upper bounds at once.
+  ///
+  /// The batch evaluator is called with the keys of a batch and has to fill in their values
+  /// (i.e. it can evaluate them in parallel). Returns the number of evaluations.
+  template <typename BatchEvaluator>
+  std::size_t updateTopBatched(BatchEvaluator&& evaluate_batch, const std::size_t batch_size,
+                               const ValueType epsilon = 0) {
+    restoreFront();
+    ++num_updates_;
+    std::size_t num_evaluations = 0;
+    std::vector<Entry> batch;
+    std::vector<KeyType> keys;
+    std::vector<ValueType> values;
+    while (!heap_.empty()) {
+      // Collect stale entries with the largest upper bounds
+      batch.clear();
+      while (!heap_.empty() && batch.size() < std::max<std::size_t>(batch_size, 1)) {
+        if (!isRemoved(heap_.front())) {
+          if (heap_.front().epoch == epoch_) {
+            break;
+          }
+          batch.push_back(heap_.front());
+        }
+        std::pop_heap(heap_.begin(), heap_.end(), compareEntries);
+        heap_.pop_back();
+      }
+      if (batch.empty()) {
+        if (!heap_.empty()) {
+          // The top entry is up-to-date
+          std::pop_heap(heap_.begin(), heap_.end(), compareEntries);
+          setFront(heap_.back());
+          heap_.pop_back();
+        }
+        break;
+      }
+      keys.resize(batch.size());
+      values.resize(batch.size());
+      for (std::size_t i = 0; i < batch.size(); ++i) {
+        keys[i] = batch[i].key;
+      }
+      evaluate_batch(keys, &values);
+      num_evaluations += batch.size();
+      std::size_t best_index = 0;
+      for (std::size_t i = 0; i < batch.size(); ++i) {
+        batch[i].value = values[i];
+        batch[i].epoch = epoch_;
+        if (batch[i].value > batch[best_index].value) {
+          best_index = i;
+        }
+      }
+      for (std::size_t i = 0; i < batch.size(); ++i) {
+        if (i != best_index) {
+          heap_.push_back(batch[i]);
+          std::push_heap(heap_.begin(), heap_.end(), compareEntries);
+        }
+      }
+      const Entry& best_entry = batch[best_index];
+      if (heap_.empty() || best_entry.value >= (1 - epsilon) * heap_.front().value) {
+        setFront(best_entry);
+        break;
+      }
+      heap_.push_back(best_entry);
+      std::push_heap(heap_.begin(), heap_.end(), compareEntries);
+    }
+    num_evaluations_ += num_evaluations;
+    return num_evaluations;
+  }
+
+  /// Stochastic lazy greedy: Select the best entry of a random subset of sample_size entries.
+  ///
+  /// Entries of the subset are evaluated lazily in order of their cached upper bounds.
+  /// The sampler has to return a uniformly distributed integer in [0, n).
+  /// Falls back to updateTop() if the subset would contain all entries.
+  /// Returns the number of evaluations.
+  template <typename Evaluator, typename Sampler>
+  std::size_t updateTopStochastic(Evaluator&& evaluate, Sampler&& sample_index, const std::size_t sample_size,
+                                  const ValueType epsilon = 0) {
+    restoreFront();
+    purgeRemoved();
+    if (sample_size == 0 || sample_size >= heap_.size()) {
+      return updateTop(std::forward<Evaluator>(evaluate), epsilon);
+    }
+    ++num_updates_;
+    // Sample distinct heap positions with Floyd's algorithm
+    std::vector<std::size_t> positions;
+    positions.reserve(sample_size);
+    std::unordered_set<std::size_t> sampled_positions;
+    for (std::size_t j = heap_.size() - sample_size; j < heap_.size(); ++j) {
+      std::size_t position = static_cast<std::size_t>(sample_index(j + 1));
+      if (!sampled_positions.insert(position).second) {
+        position = j;
+        sampled_positions.insert(position);
+      }
+      positions.push_back(position);
+    }
+    std::sort(positions.begin(), positions.end(), [&](const std::size_t a, const std::size_t b) {
+      return heap_[a].value > heap_[b].value;
+    });
+    std::size_t num_evaluations = 0;
+    std::size_t best_position = positions.front();
+    ValueType best_value = std::numeric_limits<ValueType>::lowest();
+    std::vector<std::size_t> evaluated_positions;
+    for (const std::size_t position : positions) {
+      Entry& entry = heap_[position];
+      if ((1 - epsilon) * entry.value <= best_value) {
+        // Cached values are upper bounds so none of the remaining entries can be (significantly) better
+        break;
+      }
+      if (entry.epoch != epoch_) {
+        entry.value = evaluate(entry.key);
+        entry.epoch = epoch_;
+        evaluated_positions.push_back(position);
+        ++num_evaluations;
+      }
+      if (entry.value > best_value) {
+        best_value = entry.value;
+        best_position = position;
+      }
+    }
+    // Evaluated values can only have decreased so the heap is restored by sifting them down. Going from the back of
+    // the heap only moves entries below the current position so the remaining positions stay valid.
+    std::sort(evaluated_positions.begin(), evaluated_positions.end(), std::greater<std::size_t>());
+    for (const std::size_t position : evaluated_positions) {
+      siftDown(position, &best_position);
+    }
+    setFront(heap_[best_position]);
+    removeAt(best_position);
+    num_evaluations_ += num_evaluations;
+    return num_evaluations;
+  }
+
+  /// Up to num_entries entries with the largest cached values in descending order.
+  ///
+  /// Only the top entry is guaranteed to be up-to-date, the other values are upper bounds.
+  std::vector<Entry> getTopEntries(const std::size_t num_entries) const {
+    std::vector<Entry> entries;
+    entries.reserve(size());
+    if (has_front_) {
+      entries.push_back(front_);
+    }
+    for (const Entry& entry : heap_) {
+      if (!isRemoved(entry)) {
+        entries.push_back(entry);
+      }
+    }
+    const std::size_t num_sorted = std::min(num_entries, entries.size());
+    const auto begin_it = has_front_ ? entries.begin() + 1 : entries.begin();
+    if (begin_it < entries.begin() + num_sorted) {
+      std::partial_sort(begin_it, entries.begin() + num_sorted, entries.end(),
+                        [](const Entry& a, const Entry& b) { return a.value > b.value; });
+    }
+    entries.resize(num_sorted);
+    return entries;
+  }
+
+  /// Entries in ascending order of their cached values (used for serialization)
+  std::vector<SerializedEntry> getSerializedEntries() const {
+    std::vector<Entry> entries = getTopEntries(size());
+    std::vector<SerializedEntry> serialized_entries;
+    serialized_entries.reserve(entries.size());
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+      serialized_entries.push_back(std::make_tuple(it->key, it->value, true));
+    }
+    return serialized_entries;
+  }
+
+  /// Replace entries with serialized entries. All values are treated as upper bounds.
+  void setSerializedEntries(const std::vector<SerializedEntry>& serialized_entries) {
+    clear();
+    for (const SerializedEntry& serialized_entry : serialized_entries) {
+      if (std::get<2>(serialized_entry)) {
+        heap_.push_back(Entry { std::get<0>(serialized_entry), std::get<1>(serialized_entry), 0, 0 });
+      }
+    }
+    std::make_heap(heap_.begin(), heap_.end(), compareEntries);
+  }
+
+  /// Total number of evaluations
+  std::size_t getNumEvaluations() const {
+    return num_evaluations_;
+  }
+
+  /// Total number of top entry updates (i.e. selections)
+  std::size_t getNumUpdates() const {
+    return num_updates_;
+  }
+
+private:
+  static bool compareEntries(const Entry& a, const Entry& b) {
+    return a.value < b.value;
+  }
+
+  std::size_t getGeneration(const KeyType& key) const {
+    if (key_generations_.empty()) {
+      return 0;
+    }
+    const auto it = key_generations_.find(key);
+    return it != key_generations_.end() ? it->second : 0;
+  }
+
+  bool isRemoved(const Entry& entry) const {
+    return entry.generation != getGeneration(entry.key);
+  }
+
+  void setFront(const Entry& entry) {
+    front_ = entry;
+    has_front_ = true;
+  }
+
+  void restoreFront() {
+    if (has_front_) {
+      heap_.push_back(front_);
+      std::push_heap(heap_.begin(), heap_.end(), compareEntries);
+      has_front_ = false;
+    }
+  }
+
+  /// Move the entry at position down until the heap property holds (the subtrees below it have to be heaps).
+  /// The tracked position follows the entry that it points to.
+  void siftDown(std::size_t position, std::size_t* tracked_position) {
+    while (true) {
+      const std::size_t left = 2 * position + 1;
+      if (left >= heap_.size()) {
+        break;
+      }
+      const std::size_t right = left + 1;
+      const std::size_t child = right < heap_.size() && compareEntries(heap_[left], heap_[right]) ? right : left;
+      if (!compareEntries(heap_[position], heap_[child])) {
+        break;
+      }
+      std::swap(heap_[position], heap_[child]);
+      if (*tracked_position == child) {
+        *tracked_position = position;
+      }
+      else if (*tracked_position == position) {
+        *tracked_position = child;
+      }
+      position = child;
+    }
+  }
+
+  void siftUp(std::size_t position) {
+    while (position > 0) {
+      const std::size_t parent = (position - 1) / 2;
+      if (!compareEntries(heap_[parent], heap_[position])) {
+        break;
+      }
+      std::swap(heap_[parent], heap_[position]);
+      position = parent;
+    }
+  }
+
+  /// Remove the entry at a heap position in logarithmic time
+  void removeAt(const std::size_t position) {
+    heap_[position] = heap_.back();
+    heap_.pop_back();
+    if (position < heap_.size()) {
+      std::size_t tracked_position = position;
+      siftDown(position, &tracked_position);
+      siftUp(tracked_position);
+    }
+  }
+
+  void purgeRemoved() {
+    if (key_generations_.empty()) {
+      return;
+    }
+    heap_.erase(std::remove_if(heap_.begin(), heap_.end(), [&](const Entry& entry) {
+      return isRemoved(entry);
+    }), heap_.end());
+    // Only entries of the current generations are left so the generations can start over
+    for (Entry& entry : heap_) {
+      entry.generation = 0;
+    }
+    key_generations_.clear();
+    std::make_heap(heap_.begin(), heap_.end(), compareEntries);
+  }
+
+  std::vector<Entry> heap_;
+  // Number of removals of each removed key
+  std::unordered_map<KeyType, std::size_t, KeyHashT> key_generations_;
+  std::size_t epoch_;
+  // Selected entry that was taken out of the heap
+  Entry front_;
+  bool has_front_;
+  std::size_t num_evaluations_;
+  std::size_t num_updates_;
+};
+
+}
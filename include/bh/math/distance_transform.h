@@ -0,0 +1,127 @@
+//==================================================
+// distance_transform.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "../common.h"
+
+namespace bh {
+
+#if __GNUC__ && !__CUDACC__
+  #pragma GCC push_options
+  #pragma GCC optimize ("fast-math")
+#endif
+
+/// Value used for grid cells that have no seed (i.e. an infinite distance).
+///
+/// A finite value is used so that the transform also behaves correctly when compiled with fast-math.
+template <typename FloatT>
+constexpr FloatT getDistanceTransformFarValue() {
+  return std::numeric_limits<FloatT>::max();
+}
+
+/// Exact squared Euclidean distance transform of a sampled 1D function (Felzenszwalb & Huttenlocher).
+///
+/// Computes d(q) = min_p ((q - p)^2 + f(p)) in linear time by constructing the lower envelope of the parabolas
+/// rooted at each sample. Samples with a far value do not contribute. The buffers v and z need to have at least
+/// n and n + 1 elements.
+template <typename FloatT>
+void squaredDistanceTransform1D(const FloatT* f, const std::size_t n, FloatT* d, std::size_t* v, FloatT* z) {
+  const FloatT far_value = getDistanceTransformFarValue<FloatT>();
+  const FloatT lowest = std::numeric_limits<FloatT>::lowest();
+  std::ptrdiff_t k = -1;
+  for (std::size_t q = 0; q < n; ++q) {
+    if (f[q] >= far_value) {
+      continue;
+    }
+    const FloatT fq = f[q] + FloatT(q) * FloatT(q);
+    FloatT s = lowest;
+    while (k >= 0) {
+      const FloatT fv = f[v[k]] + FloatT(v[k]) * FloatT(v[k]);
+      s = (fq - fv) / (2 * FloatT(q) - 2 * FloatT(v[k]));
+      if (s > z[k]) {
+        break;
+      }
+      --k;
+    }
+    ++k;
+    v[k] = q;
+    z[k] = k == 0 ? lowest : s;
+    z[k + 1] = far_value;
+  }
+  if (k < 0) {
+    for (std::size_t q = 0; q < n; ++q) {
+      d[q] = far_value;
+    }
+    return;
+  }
+  std::size_t j = 0;
+  for (std::size_t q = 0; q < n; ++q) {
+    while (z[j + 1] < FloatT(q)) {
+      ++j;
+    }
+    const FloatT diff = FloatT(q) - FloatT(v[j]);
+    d[q] = diff * diff + f[v[j]];
+  }
+}
+
+/// Exact squared Euclidean distance transform of a 3D grid (Saito & Toriwaki / Felzenszwalb & Huttenlocher).
+///
+/// The grid is stored with x as the fastest running index, i.e. index = x + dim_x * (y + dim_y * z).
+/// On input each cell holds the squared distance of its seed (0 for a seed cell) or the far value.
+/// On output each cell holds the squared distance in units of cells to the closest seed.
+/// The transform is separable and each pass is parallelized over grid lines with OpenMP.
+template <typename FloatT>
+void squaredDistanceTransform3D(
+    FloatT* values, const std::size_t dim_x, const std::size_t dim_y, const std::size_t dim_z) {
+  const std::size_t dims[3] = { dim_x, dim_y, dim_z };
+  const std::size_t strides[3] = { 1, dim_x, dim_x * dim_y };
+  for (std::size_t axis = 0; axis < 3; ++axis) {
+    const std::size_t n = dims[axis];
+    const std::size_t stride = strides[axis];
+    // The two remaining axes enumerate the lines along the current axis
+    const std::size_t axis1 = axis == 0 ? 1 : 0;
+    const std::size_t axis2 = axis == 2 ? 1 : 2;
+    const std::size_t num_lines = dims[axis1] * dims[axis2];
+#pragma omp parallel
+    {
+      std::vector<FloatT> f(n);
+      std::vector<FloatT> d(n);
+      std::vector<std::size_t> v(n);
+      std::vector<FloatT> z(n + 1);
+#pragma omp for schedule(static)
+      for (std::ptrdiff_t line = 0; line < static_cast<std::ptrdiff_t>(num_lines); ++line) {
+        const std::size_t i1 = static_cast<std::size_t>(line) % dims[axis1];
+        const std::size_t i2 = static_cast<std::size_t>(line) / dims[axis1];
+        FloatT* line_values = values + i1 * strides[axis1] + i2 * strides[axis2];
+        for (std::size_t q = 0; q < n; ++q) {
+          f[q] = line_values[q * stride];
+        }
+        squaredDistanceTransform1D(f.data(), n, d.data(), v.data(), z.data());
+        for (std::size_t q = 0; q < n; ++q) {
+          line_values[q * stride] = d[q];
+        }
+      }
+    }
+  }
+}
+
+template <typename FloatT>
+void squaredDistanceTransform3D(
+    std::vector<FloatT>* values, const std::size_t dim_x, const std::size_t dim_y, const std::size_t dim_z) {
+  BH_ASSERT(values->size() == dim_x * dim_y * dim_z);
+  squaredDistanceTransform3D(values->data(), dim_x, dim_y, dim_z);
+}
+
+#if __GNUC__ && !__CUDACC__
+  #pragma GCC pop_options
+#endif
+
+}
@@ -44,11 +44,11 @@ public:
   }
 
   size_t getDimY() const {
-    return dim_x_;
+    return dim_y_;
   }
 
   size_t getDimZ() const {
-    return dim_x_;
+    return dim_z_;
   }
 
   size_t getNumElements() const {
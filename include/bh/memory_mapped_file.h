@@ -0,0 +1,117 @@
+//==================================================
+// memory_mapped_file.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "common.h"
+
+namespace bh {
+
+/// Read-only memory mapping of a whole file.
+///
+/// The pages are loaded lazily by the operating system so opening even very large files is cheap.
+class MemoryMappedFile {
+public:
+  MemoryMappedFile()
+  : data_(nullptr), size_(0) {}
+
+  explicit MemoryMappedFile(const std::string& filename)
+  : data_(nullptr), size_(0) {
+    open(filename);
+  }
+
+  MemoryMappedFile(const MemoryMappedFile&) = delete;
+  MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+  MemoryMappedFile(MemoryMappedFile&& other)
+  : data_(other.data_), size_(other.size_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+
+  MemoryMappedFile& operator=(MemoryMappedFile&& other) {
+    if (this != &other) {
+      close();
+      std::swap(data_, other.data_);
+      std::swap(size_, other.size_);
+    }
+    return *this;
+  }
+
+  ~MemoryMappedFile() {
+    close();
+  }
+
+  void open(const std::string& filename) {
+    close();
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw bh::Error("Unable to open file " + filename + ": " + std::strerror(errno));
+    }
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0) {
+      const int error = errno;
+      ::close(fd);
+      throw bh::Error("Unable to determine size of file " + filename + ": " + std::strerror(error));
+    }
+    const std::size_t size = static_cast<std::size_t>(file_stat.st_size);
+    if (size > 0) {
+      void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        const int error = errno;
+        ::close(fd);
+        throw bh::Error("Unable to map file " + filename + ": " + std::strerror(error));
+      }
+      data_ = static_cast<const char*>(data);
+    }
+    // The mapping stays valid after closing the file descriptor
+    ::close(fd);
+    size_ = size;
+  }
+
+  void close() {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  bool isOpen() const {
+    return data_ != nullptr;
+  }
+
+  /// Hint that the whole file will be read soon (i.e. to prefetch the pages)
+  void adviseWillNeed() const {
+    if (data_ != nullptr) {
+      ::madvise(const_cast<char*>(data_), size_, MADV_WILLNEED);
+    }
+  }
+
+  const char* data() const {
+    return data_;
+  }
+
+  std::size_t size() const {
+    return size_;
+  }
+
+private:
+  const char* data_;
+  std::size_t size_;
+};
+
+}
@@ -0,0 +1,138 @@
+//==================================================
+// min_hash.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "common.h"
+
+namespace bh {
+
+/// MinHash signature of a set together with the exact size of the set
+struct MinHashSketch {
+  std::size_t num_elements = 0;
+  std::vector<std::uint32_t> min_hashes;
+
+  std::size_t getMemoryUsage() const {
+    return min_hashes.capacity() * sizeof(std::uint32_t);
+  }
+};
+
+/// MinHash sketches for estimating the similarity of large integer sets.
+///
+/// Uses one permutation hashing: Each element is hashed once and the hash selects one of k bins which keeps
+/// the minimum hash value. Computing a sketch is linear in the size of the set (independent of k).
+/// The fraction of equal bins (ignoring bins that are empty in both sketches) estimates the Jaccard index
+/// with a standard deviation of about sqrt(J * (1 - J) / k) for sets that are much larger than k.
+class MinHash {
+public:
+  enum Comparison {
+    BELOW_THRESHOLD,
+    ABOVE_THRESHOLD,
+    UNCERTAIN,
+  };
+
+  explicit MinHash(const std::size_t num_hashes = 128, const std::uint64_t seed = 0)
+  : num_hashes_(num_hashes), seed_(seed) {
+    BH_ASSERT(num_hashes > 0);
+  }
+
+  std::size_t getNumHashes() const {
+    return num_hashes_;
+  }
+
+  /// Compute the sketch of the set of integers in [first, last) (which must not contain duplicates).
+  template <typename Iterator>
+  MinHashSketch computeSketch(Iterator first, Iterator last) const {
+    MinHashSketch sketch;
+    sketch.min_hashes.resize(num_hashes_, std::numeric_limits<std::uint32_t>::max());
+    std::uint32_t* min_hashes = sketch.min_hashes.data();
+    for (Iterator it = first; it != last; ++it) {
+      const std::uint64_t hash = mixHash(static_cast<std::uint64_t>(*it) ^ seed_);
+      // The upper 32 bits select the bin and the lower 32 bits are the hash value
+      const std::size_t bin = static_cast<std::size_t>(((hash >> 32) * num_hashes_) >> 32);
+      min_hashes[bin] = std::min(min_hashes[bin], static_cast<std::uint32_t>(hash));
+      ++sketch.num_elements;
+    }
+    return sketch;
+  }
+
+  /// Estimated Jaccard index |A n B| / |A u B| of two sketched sets
+  static double estimateJaccard(const MinHashSketch& sketch1, const MinHashSketch& sketch2) {
+    BH_ASSERT(sketch1.min_hashes.size() == sketch2.min_hashes.size());
+    if (sketch1.num_elements == 0 || sketch2.num_elements == 0) {
+      return 0;
+    }
+    const std::uint32_t empty_bin = std::numeric_limits<std::uint32_t>::max();
+    std::size_t num_equal = 0;
+    std::size_t num_non_empty = 0;
+    for (std::size_t i = 0; i < sketch1.min_hashes.size(); ++i) {
+      const std::uint32_t min_hash1 = sketch1.min_hashes[i];
+      const std::uint32_t min_hash2 = sketch2.min_hashes[i];
+      const bool both_empty = min_hash1 == empty_bin && min_hash2 == empty_bin;
+      num_equal += min_hash1 == min_hash2 && !both_empty ? 1 : 0;
+      num_non_empty += both_empty ? 0 : 1;
+    }
+    return num_equal / static_cast<double>(num_non_empty);
+  }
+
+  /// Estimated Dice coefficient |A n B| / ((|A| + |B|) / 2) of two sketched sets
+  static double estimateDice(const MinHashSketch& sketch1, const MinHashSketch& sketch2) {
+    return jaccardToDice(estimateJaccard(sketch1, sketch2));
+  }
+
+  static double jaccardToDice(const double jaccard) {
+    return 2 * jaccard / (1 + jaccard);
+  }
+
+  static double diceToJaccard(const double dice) {
+    return dice / (2 - dice);
+  }
+
+  /// Compare the Dice coefficient of two sketched sets with a threshold.
+  ///
+  /// The result is uncertain if the estimated Jaccard index is within num_std_devs standard deviations
+  /// (of an estimate at the threshold) of the threshold. Sets whose sizes are too different to reach the
+  /// threshold are rejected exactly.
+  static Comparison compareDice(const MinHashSketch& sketch1, const MinHashSketch& sketch2,
+                                const double dice_threshold, const double num_std_devs) {
+    const std::size_t min_num_elements = std::min(sketch1.num_elements, sketch2.num_elements);
+    const std::size_t sum_num_elements = sketch1.num_elements + sketch2.num_elements;
+    if (min_num_elements == 0 || 2 * min_num_elements < dice_threshold * sum_num_elements) {
+      return BELOW_THRESHOLD;
+    }
+    const double jaccard_threshold = diceToJaccard(dice_threshold);
+    const std::size_t num_bins = std::min(sketch1.min_hashes.size(), sum_num_elements);
+    const double std_dev = std::sqrt(jaccard_threshold * (1 - jaccard_threshold) / static_cast<double>(num_bins));
+    const double jaccard = estimateJaccard(sketch1, sketch2);
+    if (jaccard + num_std_devs * std_dev < jaccard_threshold) {
+      return BELOW_THRESHOLD;
+    }
+    if (jaccard - num_std_devs * std_dev > jaccard_threshold) {
+      return ABOVE_THRESHOLD;
+    }
+    return UNCERTAIN;
+  }
+
+private:
+  static std::uint64_t mixHash(std::uint64_t value) {
+    // Finalizer of splitmix64
+    value = (value ^ (value >> 30)) * static_cast<std::uint64_t>(0xBF58476D1CE4E5B9ull);
+    value = (value ^ (value >> 27)) * static_cast<std::uint64_t>(0x94D049BB133111EBull);
+    return value ^ (value >> 31);
+  }
+
+  std::size_t num_hashes_;
+  std::uint64_t seed_;
+};
+
+}
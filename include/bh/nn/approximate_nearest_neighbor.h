@@ -72,6 +72,16 @@ public:
   template <typename Iterator>
   Result knnSearch(Iterator begin, Iterator end, std::size_t knn) const;
 
+  /// Search the nearest neighbors of many points with one FLANN query that is parallelized over the points.
+  ///
+  /// The results are stored densely with knn entries for each point (in the order of the points).
+  /// Missing neighbors have an index of -1 and the maximum distance.
+  /// A number of threads of 0 uses all cores.
+  template <typename Iterator>
+  void knnSearchBatch(Iterator begin, Iterator end, std::size_t knn,
+                      std::vector<IndexType>* indices, std::vector<DistanceType>* distances,
+                      int num_threads = 0) const;
+
   void radiusSearch(const Point& point, FloatType radius, std::size_t max_results,
       std::vector<IndexType>* indices, std::vector<DistanceType>* distances) const;
 
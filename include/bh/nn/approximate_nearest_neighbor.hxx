@@ -88,6 +88,11 @@ template<typename FloatT, std::size_t dimension, typename NormT>
 template<typename Iterator>
 void ApproximateNearestNeighbor<FloatT, dimension, NormT>::addPoints(
         Iterator begin, Iterator end, FloatType rebuild_threshold) {
+  // Building the index in one go is much faster than inserting the points one by one
+  if (!initialized_ && begin != end) {
+    initIndex(begin, end);
+    return;
+  }
   for (Iterator it = begin; it != end; ++it) {
     addPoint(*it);
   }
@@ -185,6 +190,32 @@ auto ApproximateNearestNeighbor<FloatT, dimension, NormT>::knnSearch(
   return knnSearch(points, knn);
 }
 
+template<typename FloatT, std::size_t dimension, typename NormT>
+template<typename Iterator>
+void ApproximateNearestNeighbor<FloatT, dimension, NormT>::knnSearchBatch(
+        Iterator begin, Iterator end, std::size_t knn,
+        std::vector<IndexType>* indices, std::vector<DistanceType>* distances, int num_threads) const {
+  const std::size_t num_points = end - begin;
+  indices->assign(num_points * knn, static_cast<IndexType>(-1));
+  distances->assign(num_points * knn, std::numeric_limits<DistanceType>::max());
+  if (num_points == 0 || knn == 0 || empty()) {
+    return;
+  }
+  // FLANN expects the queries as a dense row-major matrix
+  std::vector<FlannElementType> queries(num_points * dimension);
+  for (Iterator it = begin; it != end; ++it) {
+    for (std::size_t col = 0; col < dimension; ++col) {
+      queries[(it - begin) * dimension + col] = (*it)(col);
+    }
+  }
+  FlannMatrix flann_queries(queries.data(), num_points, dimension);
+  FlannIndexMatrix flann_indices(indices->data(), num_points, knn);
+  FlannDistanceMatrix flann_distances(distances->data(), num_points, knn);
+  flann::SearchParams search_params = search_params_;
+  search_params.cores = num_threads;
+  index_.knnSearch(flann_queries, flann_indices, flann_distances, knn, search_params);
+}
+
 template<typename FloatT, std::size_t dimension, typename NormT>
 void ApproximateNearestNeighbor<FloatT, dimension, NormT>::radiusSearch(
         const Point &point, FloatType radius, std::size_t max_results,
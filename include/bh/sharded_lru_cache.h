@@ -0,0 +1,232 @@
+//==================================================
+// sharded_lru_cache.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "common.h"
+
+namespace bh {
+
+struct ShardedLruCacheStatistics {
+  std::size_t num_hits = 0;
+  std::size_t num_misses = 0;
+  std::size_t num_evictions = 0;
+  std::size_t num_entries = 0;
+  std::size_t num_bytes = 0;
+};
+
+/// Thread-safe least-recently-used cache with a memory budget.
+///
+/// The keys are distributed over independently locked shards so that concurrent lookups of different keys
+/// rarely contend. Each shard evicts its least recently used entries once it exceeds its share of the budget.
+/// Values are handed out as shared pointers so they stay valid after being evicted.
+/// Pinned keys are never evicted (so a shard can exceed its budget if it holds many pinned entries).
+template <typename KeyT, typename ValueT, typename KeyHashT = std::hash<KeyT>>
+class ShardedLruCache {
+public:
+  using KeyType = KeyT;
+  using ValueType = ValueT;
+  using ValuePtr = std::shared_ptr<const ValueType>;
+  /// Returns the number of bytes occupied by a value
+  using SizeFunction = std::function<std::size_t(const ValueType&)>;
+
+  using Statistics = ShardedLruCacheStatistics;
+
+  /// A maximum of 0 bytes disables eviction.
+  explicit ShardedLruCache(const std::size_t max_bytes = 0, const std::size_t num_shards = 16,
+                           const SizeFunction& size_function = getDefaultSize) {
+    reset(max_bytes, num_shards, size_function);
+  }
+
+  /// Remove all entries and change the configuration (not thread-safe).
+  void reset(const std::size_t max_bytes, const std::size_t num_shards,
+             const SizeFunction& size_function = getDefaultSize) {
+    BH_ASSERT(num_shards > 0);
+    max_bytes_ = max_bytes;
+    size_function_ = size_function;
+    shards_.clear();
+    for (std::size_t i = 0; i < num_shards; ++i) {
+      shards_.emplace_back(new Shard());
+    }
+  }
+
+  std::size_t getMaxBytes() const {
+    return max_bytes_;
+  }
+
+  std::size_t getNumShards() const {
+    return shards_.size();
+  }
+
+  /// Cached value or nullptr. A found entry becomes the most recently used one.
+  ValuePtr find(const KeyType& key) {
+    Shard& shard = getShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+      ++shard.num_misses;
+      return nullptr;
+    }
+    ++shard.num_hits;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return it->second->value;
+  }
+
+  /// Insert a value and return the cached value (which is the existing one if the key is already cached).
+  ValuePtr insert(const KeyType& key, ValueType&& value) {
+    const std::size_t num_bytes = size_function_(value) + ENTRY_OVERHEAD_BYTES;
+    ValuePtr value_ptr = std::make_shared<const ValueType>(std::move(value));
+    Shard& shard = getShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if (it != shard.map.end()) {
+      shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+      return it->second->value;
+    }
+    shard.entries.push_front(Entry { key, value_ptr, num_bytes });
+    shard.map.emplace(key, shard.entries.begin());
+    shard.num_bytes += num_bytes;
+    // The new entry is kept even if it exceeds the budget on its own
+    const std::size_t max_shard_bytes = max_bytes_ / shards_.size();
+    auto lru_it = shard.entries.end();
+    while (max_bytes_ > 0 && shard.num_bytes > max_shard_bytes && lru_it != std::next(shard.entries.begin())) {
+      --lru_it;
+      if (shard.pin_counts.count(lru_it->key) > 0) {
+        continue;
+      }
+      shard.num_bytes -= lru_it->num_bytes;
+      shard.map.erase(lru_it->key);
+      lru_it = shard.entries.erase(lru_it);
+      ++shard.num_evictions;
+    }
+    return value_ptr;
+  }
+
+  /// Exempt a key from eviction until unpin() has been called as often as pin().
+  ///
+  /// The key does not have to be cached yet. This allows to fill the cache for a parallel pass without
+  /// the entries being evicted (and computed again) during the pass.
+  void pin(const KeyType& key) {
+    Shard& shard = getShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ++shard.pin_counts[key];
+  }
+
+  void unpin(const KeyType& key) {
+    Shard& shard = getShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.pin_counts.find(key);
+    BH_ASSERT(it != shard.pin_counts.end());
+    if (--it->second == 0) {
+      shard.pin_counts.erase(it);
+    }
+  }
+
+  /// Cached value or the value computed by compute() (which is cached).
+  ///
+  /// compute() is called without holding a lock. If multiple threads miss the same key concurrently
+  /// all of them compute the value but only the first one is cached.
+  template <typename Compute>
+  ValuePtr getOrCompute(const KeyType& key, Compute&& compute) {
+    ValuePtr value_ptr = find(key);
+    if (value_ptr) {
+      return value_ptr;
+    }
+    return insert(key, compute());
+  }
+
+  void erase(const KeyType& key) {
+    Shard& shard = getShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if (it != shard.map.end()) {
+      shard.num_bytes -= it->second->num_bytes;
+      shard.entries.erase(it->second);
+      shard.map.erase(it);
+    }
+  }
+
+  /// Remove all entries and reset the statistics (pinned keys stay pinned).
+  void clear() {
+    for (const std::unique_ptr<Shard>& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      shard->entries.clear();
+      shard->map.clear();
+      shard->num_bytes = 0;
+      shard->num_hits = 0;
+      shard->num_misses = 0;
+      shard->num_evictions = 0;
+    }
+  }
+
+  Statistics getStatistics() const {
+    Statistics statistics;
+    for (const std::unique_ptr<Shard>& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      statistics.num_hits += shard->num_hits;
+      statistics.num_misses += shard->num_misses;
+      statistics.num_evictions += shard->num_evictions;
+      statistics.num_entries += shard->entries.size();
+      statistics.num_bytes += shard->num_bytes;
+    }
+    return statistics;
+  }
+
+private:
+  // Approximate memory overhead of the list and hash map nodes of an entry
+  static constexpr std::size_t ENTRY_OVERHEAD_BYTES = 64;
+
+  struct Entry {
+    KeyType key;
+    ValuePtr value;
+    std::size_t num_bytes;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    // Entries in order of their last use (most recently used first)
+    std::list<Entry> entries;
+    std::unordered_map<KeyType, typename std::list<Entry>::iterator, KeyHashT> map;
+    // Number of pin() calls without a matching unpin() call for each pinned key
+    std::unordered_map<KeyType, std::size_t, KeyHashT> pin_counts;
+    std::size_t num_bytes = 0;
+    std::size_t num_hits = 0;
+    std::size_t num_misses = 0;
+    std::size_t num_evictions = 0;
+  };
+
+  static std::size_t getDefaultSize(const ValueType&) {
+    return sizeof(ValueType);
+  }
+
+  Shard& getShard(const KeyType& key) {
+    // Mix the hash because std::hash is the identity for integers
+    std::size_t hash = KeyHashT()(key);
+    hash ^= hash >> 17;
+    hash *= static_cast<std::size_t>(0x9E3779B97F4A7C15ull);
+    hash ^= hash >> 29;
+    return *shards_[hash % shards_.size()];
+  }
+
+  std::size_t max_bytes_;
+  SizeFunction size_function_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+template <typename KeyT, typename ValueT, typename KeyHashT>
+constexpr std::size_t ShardedLruCache<KeyT, ValueT, KeyHashT>::ENTRY_OVERHEAD_BYTES;
+
+}
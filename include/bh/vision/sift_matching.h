@@ -0,0 +1,298 @@
+//==================================================
+// sift_matching.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#if __AVX2__ || __SSE2__
+  #include <immintrin.h>
+#endif
+#include "../eigen.h"
+
+namespace bh {
+namespace vision {
+
+/// Integer dot product of two SIFT descriptors (higher is more similar).
+using SiftScore = int;
+using SiftScoreMatrix = Eigen::Matrix<SiftScore, Eigen::Dynamic, Eigen::Dynamic>;
+
+/// SIFT descriptors converted to 16 bit integers and stored contiguously for the blocked matching kernels.
+///
+/// The number of stored descriptors is padded with zero descriptors to a multiple of the kernel tile size.
+class SiftDescriptorMatrix {
+public:
+  static constexpr std::size_t kDimension = 128;
+  static constexpr std::size_t kPadding = 4;
+
+  SiftDescriptorMatrix()
+      : num_descriptors_(0) {}
+
+  /// Converts descriptors with 8 bit components. Consecutive descriptors are stride bytes apart.
+  SiftDescriptorMatrix(const uint8_t* descriptors, const std::size_t num_descriptors,
+                       const std::size_t stride = kDimension)
+      : num_descriptors_(num_descriptors),
+        data_(((num_descriptors + kPadding - 1) / kPadding) * kPadding * kDimension, 0) {
+    for (std::size_t i = 0; i < num_descriptors; ++i) {
+      const uint8_t* descriptor = descriptors + i * stride;
+      std::copy(descriptor, descriptor + kDimension, data_.begin() + i * kDimension);
+    }
+  }
+
+  std::size_t size() const {
+    return num_descriptors_;
+  }
+
+  const int16_t* descriptor(const std::size_t index) const {
+    return data_.data() + index * kDimension;
+  }
+
+private:
+  std::size_t num_descriptors_;
+  std::vector<int16_t> data_;
+};
+
+/// Best and second best score of a descriptor against a set of descriptors (i.e. for Lowe's ratio test).
+///
+/// Ties are resolved in favor of the lower index so that the result does not depend on the scan order.
+struct SiftTopTwoMatches {
+  SiftScore best_score = std::numeric_limits<SiftScore>::min();
+  SiftScore second_best_score = std::numeric_limits<SiftScore>::min();
+  std::size_t best_index = (std::size_t)-1;
+
+  void update(const SiftScore score, const std::size_t index) {
+    if (score > best_score || (score == best_score && index < best_index)) {
+      second_best_score = best_score;
+      best_score = score;
+      best_index = index;
+    }
+    else if (score > second_best_score) {
+      second_best_score = score;
+    }
+  }
+
+  void merge(const SiftTopTwoMatches& other) {
+    if (other.best_index == (std::size_t)-1) {
+      return;
+    }
+    const SiftScore second_best_score_other = other.second_best_score;
+    update(other.best_score, other.best_index);
+    second_best_score = std::max(second_best_score, second_best_score_other);
+  }
+};
+
+/// Lowe's ratio test on the angular distance of the best and second best match.
+/// SIFT descriptor vectors are normalized to length 512.
+template <typename FloatT>
+bool passesSiftRatioTest(const SiftTopTwoMatches& top_two, const FloatT ratio_threshold,
+                         const FloatT max_feature_distance) {
+  if (top_two.best_index == (std::size_t)-1) {
+    return false;
+  }
+  const FloatT kDistNorm = FloatT(1.0 / (512.0 * 512.0));
+  const FloatT best_distance_normed = std::acos(std::min(kDistNorm * top_two.best_score, FloatT(1.0)));
+  // Check for minimum distance
+  if (best_distance_normed > max_feature_distance) {
+    return false;
+  }
+  const FloatT second_best_distance_normed = std::acos(
+          std::min(kDistNorm * top_two.second_best_score, FloatT(1.0)));
+  return best_distance_normed < ratio_threshold * second_best_distance_normed;
+}
+
+namespace detail {
+
+static constexpr std::size_t kSiftTileRows = 4;
+static constexpr std::size_t kSiftTileCols = 2;
+// A block of rows stays in L1 cache while a block of columns is streamed from L2 cache.
+static constexpr std::size_t kSiftBlockRows = 64;
+static constexpr std::size_t kSiftBlockCols = 256;
+
+#if __AVX2__
+inline SiftScore horizontalSumSiftScore(const __m256i sum) {
+  __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum128);
+}
+#elif __SSE2__
+inline SiftScore horizontalSumSiftScore(__m128i sum) {
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+/// Scores of a tile of 4 rows and 2 columns. The products of 8 bit components fit into 16 bit multiply-adds
+/// with 32 bit accumulators so the scores are exact.
+inline void computeSiftScoreTile(const int16_t* const rows[kSiftTileRows], const int16_t* const cols[kSiftTileCols],
+                                 SiftScore scores[kSiftTileRows][kSiftTileCols]) {
+  const std::size_t dimension = SiftDescriptorMatrix::kDimension;
+#if __AVX2__
+  __m256i sums[kSiftTileRows][kSiftTileCols];
+  for (std::size_t i = 0; i < kSiftTileRows; ++i) {
+    for (std::size_t j = 0; j < kSiftTileCols; ++j) {
+      sums[i][j] = _mm256_setzero_si256();
+    }
+  }
+  for (std::size_t k = 0; k < dimension; k += 16) {
+    __m256i a[kSiftTileRows];
+    for (std::size_t i = 0; i < kSiftTileRows; ++i) {
+      a[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[i] + k));
+    }
+    for (std::size_t j = 0; j < kSiftTileCols; ++j) {
+      const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cols[j] + k));
+      for (std::size_t i = 0; i < kSiftTileRows; ++i) {
+        sums[i][j] = _mm256_add_epi32(sums[i][j], _mm256_madd_epi16(a[i], b));
+      }
+    }
+  }
+  for (std::size_t i = 0; i < kSiftTileRows; ++i) {
+    for (std::size_t j = 0; j < kSiftTileCols; ++j) {
+      scores[i][j] = horizontalSumSiftScore(sums[i][j]);
+    }
+  }
+#elif __SSE2__
+  __m128i sums[kSiftTileRows][kSiftTileCols];
+  for (std::size_t i = 0; i < kSiftTileRows; ++i) {
+    for (std::size_t j = 0; j < kSiftTileCols; ++j) {
+      sums[i][j] = _mm_setzero_si128();
+    }
+  }
+  for (std::size_t k = 0; k < dimension; k += 8) {
+    __m128i a[kSiftTileRows];
+    for (std::size_t i = 0; i < kSiftTileRows; ++i) {
+      a[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[i] + k));
+    }
+    for (std::size_t j = 0; j < kSiftTileCols; ++j) {
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cols[j] + k));
+      for (std::size_t i = 0; i < kSiftTileRows; ++i) {
+        sums[i][j] = _mm_add_epi32(sums[i][j], _mm_madd_epi16(a[i], b));
+      }
+    }
+  }
+  for (std::size_t i = 0; i < kSiftTileRows; ++i) {
+    for (std::size_t j = 0; j < kSiftTileCols; ++j) {
+      scores[i][j] = horizontalSumSiftScore(sums[i][j]);
+    }
+  }
+#else
+  for (std::size_t i = 0; i < kSiftTileRows; ++i) {
+    for (std::size_t j = 0; j < kSiftTileCols; ++j) {
+      SiftScore score = 0;
+      for (std::size_t k = 0; k < dimension; ++k) {
+        score += rows[i][k] * cols[j][k];
+      }
+      scores[i][j] = score;
+    }
+  }
+#endif
+}
+
+/// Computes the scores of a block of rows against all columns and calls score_functor(row, col, score)
+/// for every pair. Columns are processed in cache blocks and rows and columns in register tiles.
+template <typename ScoreFunctor>
+void computeSiftScoreRowBlock(const SiftDescriptorMatrix& descriptors1, const std::size_t row_begin,
+                              const std::size_t row_end, const SiftDescriptorMatrix& descriptors2,
+                              ScoreFunctor&& score_functor) {
+  // The descriptor matrices are padded to a multiple of the tile size
+  static_assert(SiftDescriptorMatrix::kPadding % kSiftTileRows == 0, "Rows have to be padded to the tile size");
+  static_assert(SiftDescriptorMatrix::kPadding % kSiftTileCols == 0, "Columns have to be padded to the tile size");
+  const std::size_t num_cols = descriptors2.size();
+  for (std::size_t col_block = 0; col_block < num_cols; col_block += kSiftBlockCols) {
+    const std::size_t col_block_end = std::min(col_block + kSiftBlockCols, num_cols);
+    for (std::size_t row = row_begin; row < row_end; row += kSiftTileRows) {
+      const int16_t* rows[kSiftTileRows];
+      for (std::size_t i = 0; i < kSiftTileRows; ++i) {
+        rows[i] = descriptors1.descriptor(row + i);
+      }
+      const std::size_t tile_rows = std::min(kSiftTileRows, row_end - row);
+      for (std::size_t col = col_block; col < col_block_end; col += kSiftTileCols) {
+        const int16_t* cols[kSiftTileCols];
+        for (std::size_t j = 0; j < kSiftTileCols; ++j) {
+          cols[j] = descriptors2.descriptor(col + j);
+        }
+        SiftScore scores[kSiftTileRows][kSiftTileCols];
+        computeSiftScoreTile(rows, cols, scores);
+        const std::size_t tile_cols = std::min(kSiftTileCols, col_block_end - col);
+        for (std::size_t i = 0; i < tile_rows; ++i) {
+          for (std::size_t j = 0; j < tile_cols; ++j) {
+            score_functor(row + i, col + j, scores[i][j]);
+          }
+        }
+      }
+    }
+  }
+}
+
+}
+
+/// Dense matrix of the scores of all descriptor pairs (rows correspond to descriptors1).
+inline SiftScoreMatrix computeSiftScoreMatrix(
+        const SiftDescriptorMatrix& descriptors1, const SiftDescriptorMatrix& descriptors2) {
+  SiftScoreMatrix scores(descriptors1.size(), descriptors2.size());
+  const std::size_t num_rows = descriptors1.size();
+#pragma omp parallel for schedule(dynamic)
+  for (std::ptrdiff_t row_block = 0; row_block < static_cast<std::ptrdiff_t>(num_rows); row_block += detail::kSiftBlockRows) {
+    const std::size_t row_begin = static_cast<std::size_t>(row_block);
+    const std::size_t row_end = std::min(row_begin + detail::kSiftBlockRows, num_rows);
+    detail::computeSiftScoreRowBlock(descriptors1, row_begin, row_end, descriptors2,
+                                     [&](const std::size_t row, const std::size_t col, const SiftScore score) {
+      scores(row, col) = score;
+    });
+  }
+  return scores;
+}
+
+/// Best and second best matches of each descriptor in descriptors1 (top_two1) and optionally of each descriptor
+/// in descriptors2 (top_two2) without materializing the score matrix.
+/// The results are the same as for a scan of the rows and columns of the score matrix.
+inline void computeSiftTopTwoMatches(
+        const SiftDescriptorMatrix& descriptors1, const SiftDescriptorMatrix& descriptors2,
+        std::vector<SiftTopTwoMatches>* top_two1, std::vector<SiftTopTwoMatches>* top_two2 = nullptr) {
+  const std::size_t num_rows = descriptors1.size();
+  top_two1->assign(num_rows, SiftTopTwoMatches());
+  if (top_two2 != nullptr) {
+    top_two2->assign(descriptors2.size(), SiftTopTwoMatches());
+  }
+#pragma omp parallel
+  {
+    // Column results of each thread are merged at the end
+    std::vector<SiftTopTwoMatches> thread_top_two2(top_two2 != nullptr ? descriptors2.size() : 0);
+#pragma omp for schedule(dynamic)
+    for (std::ptrdiff_t row_block = 0; row_block < static_cast<std::ptrdiff_t>(num_rows); row_block += detail::kSiftBlockRows) {
+      const std::size_t row_begin = static_cast<std::size_t>(row_block);
+      const std::size_t row_end = std::min(row_begin + detail::kSiftBlockRows, num_rows);
+      if (top_two2 != nullptr) {
+        detail::computeSiftScoreRowBlock(descriptors1, row_begin, row_end, descriptors2,
+                                         [&](const std::size_t row, const std::size_t col, const SiftScore score) {
+          (*top_two1)[row].update(score, col);
+          thread_top_two2[col].update(score, row);
+        });
+      }
+      else {
+        detail::computeSiftScoreRowBlock(descriptors1, row_begin, row_end, descriptors2,
+                                         [&](const std::size_t row, const std::size_t col, const SiftScore score) {
+          (*top_two1)[row].update(score, col);
+        });
+      }
+    }
+    if (top_two2 != nullptr) {
+#pragma omp critical
+      for (std::size_t col = 0; col < thread_top_two2.size(); ++col) {
+        (*top_two2)[col].merge(thread_top_two2[col]);
+      }
+    }
+  }
+}
+
+}
+}
@@ -0,0 +1,368 @@
+//==================================================
+// DepthCodec.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#if __SSE2__
+	#include <emmintrin.h>
+#endif
+#include <snappy/snappy.h>
+
+namespace ait
+{
+
+	namespace video
+	{
+		/// Lossless codecs for 16 bit depth images (i.e. depth in millimeters).
+		///
+		/// A frame is split into tiles of consecutive rows. Tiles are encoded and decoded independently
+		/// and in parallel (OpenMP). An encoded frame consists of an EncodedDepthFrameHeader, the encoded size
+		/// of each tile (uint32_t) and the concatenated encoded tiles.
+		enum class DepthCodecType
+		{
+			NONE = 0,
+			// Snappy compression of the raw depth values
+			SNAPPY = 1,
+			// Prediction from the neighbouring pixels and bit-plane packing of the residuals
+			DELTA_BITPLANE = 2,
+		};
+
+		inline std::string getDepthCodecName(const DepthCodecType type) {
+			switch (type) {
+			case DepthCodecType::NONE:
+				return "none";
+			case DepthCodecType::SNAPPY:
+				return "snappy";
+			case DepthCodecType::DELTA_BITPLANE:
+				return "delta-bitplane";
+			default:
+				throw std::runtime_error("Unknown depth codec type");
+			}
+		}
+
+		inline DepthCodecType getDepthCodecType(const std::string& name) {
+			for (DepthCodecType type : { DepthCodecType::NONE, DepthCodecType::SNAPPY, DepthCodecType::DELTA_BITPLANE }) {
+				if (getDepthCodecName(type) == name) {
+					return type;
+				}
+			}
+			throw std::runtime_error("Unknown depth codec: " + name);
+		}
+
+		class DepthCodec
+		{
+		public:
+			virtual ~DepthCodec() {
+			}
+
+			virtual DepthCodecType getType() const = 0;
+
+			//! Upper bound of the encoded size of a tile
+			virtual std::size_t getMaxEncodedTileSize(std::size_t width, std::size_t rows) const = 0;
+
+			//! Encodes a tile and returns the encoded size. Has to be reentrant.
+			virtual std::size_t encodeTile(const std::uint16_t* depth, std::size_t width, std::size_t rows, std::uint8_t* output) const = 0;
+
+			//! Decodes a tile. Throws std::runtime_error if the data is corrupt. Has to be reentrant.
+			virtual void decodeTile(const std::uint8_t* data, std::size_t size, std::size_t width, std::size_t rows, std::uint16_t* depth) const = 0;
+		};
+
+		class SnappyDepthCodec : public DepthCodec
+		{
+		public:
+			DepthCodecType getType() const override {
+				return DepthCodecType::SNAPPY;
+			}
+
+			std::size_t getMaxEncodedTileSize(std::size_t width, std::size_t rows) const override {
+				return snappy::MaxCompressedLength(width * rows * sizeof(std::uint16_t));
+			}
+
+			std::size_t encodeTile(const std::uint16_t* depth, std::size_t width, std::size_t rows, std::uint8_t* output) const override {
+				std::size_t encoded_size;
+				snappy::RawCompress(reinterpret_cast<const char*>(depth), width * rows * sizeof(std::uint16_t),
+					reinterpret_cast<char*>(output), &encoded_size);
+				return encoded_size;
+			}
+
+			void decodeTile(const std::uint8_t* data, std::size_t size, std::size_t width, std::size_t rows, std::uint16_t* depth) const override {
+				std::size_t decoded_size;
+				const char* compressed = reinterpret_cast<const char*>(data);
+				if (!snappy::GetUncompressedLength(compressed, size, &decoded_size)
+					|| decoded_size != width * rows * sizeof(std::uint16_t)
+					|| !snappy::RawUncompress(compressed, size, reinterpret_cast<char*>(depth))) {
+					throw std::runtime_error("Corrupt snappy depth tile");
+				}
+			}
+		};
+
+		/// Each pixel is predicted from its left, upper and upper-left neighbour (median edge detector as in LOCO-I).
+		/// The residuals are zigzag-mapped and packed in blocks of 32 values: One byte with the number of significant bits
+		/// followed by one 32 bit word per bit-plane. Smooth depth and invalid (zero) regions cost one byte per block.
+		class DeltaBitplaneDepthCodec : public DepthCodec
+		{
+		public:
+			static const std::size_t BLOCK_SIZE = 32;
+
+			DepthCodecType getType() const override {
+				return DepthCodecType::DELTA_BITPLANE;
+			}
+
+			std::size_t getMaxEncodedTileSize(std::size_t width, std::size_t rows) const override {
+				const std::size_t num_blocks = (width * rows + BLOCK_SIZE - 1) / BLOCK_SIZE;
+				return num_blocks * (1 + 16 * sizeof(std::uint32_t));
+			}
+
+			std::size_t encodeTile(const std::uint16_t* depth, std::size_t width, std::size_t rows, std::uint8_t* output) const override {
+				std::uint8_t* output_ptr = output;
+				std::uint16_t residuals[BLOCK_SIZE];
+				std::size_t num_residuals = 0;
+				for (std::size_t row = 0; row < rows; ++row) {
+					for (std::size_t col = 0; col < width; ++col) {
+						const std::uint16_t value = depth[row * width + col];
+						const std::uint16_t prediction = predict(depth, width, row, col);
+						residuals[num_residuals++] = zigzagEncode(static_cast<std::uint16_t>(value - prediction));
+						if (num_residuals == BLOCK_SIZE) {
+							output_ptr = encodeBlock(residuals, output_ptr);
+							num_residuals = 0;
+						}
+					}
+				}
+				if (num_residuals > 0) {
+					std::fill(residuals + num_residuals, residuals + BLOCK_SIZE, 0);
+					output_ptr = encodeBlock(residuals, output_ptr);
+				}
+				return output_ptr - output;
+			}
+
+			void decodeTile(const std::uint8_t* data, std::size_t size, std::size_t width, std::size_t rows, std::uint16_t* depth) const override {
+				const std::uint8_t* data_ptr = data;
+				const std::uint8_t* data_end = data + size;
+				std::uint16_t residuals[BLOCK_SIZE];
+				std::size_t residual_index = BLOCK_SIZE;
+				for (std::size_t row = 0; row < rows; ++row) {
+					for (std::size_t col = 0; col < width; ++col) {
+						if (residual_index == BLOCK_SIZE) {
+							data_ptr = decodeBlock(data_ptr, data_end, residuals);
+							residual_index = 0;
+						}
+						const std::uint16_t prediction = predict(depth, width, row, col);
+						depth[row * width + col] = static_cast<std::uint16_t>(prediction + zigzagDecode(residuals[residual_index++]));
+					}
+				}
+				if (data_ptr != data_end) {
+					throw std::runtime_error("Corrupt delta-bitplane depth tile");
+				}
+			}
+
+		private:
+			static std::uint16_t predict(const std::uint16_t* depth, const std::size_t width, const std::size_t row, const std::size_t col) {
+				if (row == 0) {
+					return col == 0 ? 0 : depth[col - 1];
+				}
+				const std::uint16_t up = depth[(row - 1) * width + col];
+				if (col == 0) {
+					return up;
+				}
+				const std::uint16_t left = depth[row * width + col - 1];
+				const std::uint16_t up_left = depth[(row - 1) * width + col - 1];
+				const std::uint16_t min_value = std::min(left, up);
+				const std::uint16_t max_value = std::max(left, up);
+				if (up_left >= max_value) {
+					return min_value;
+				}
+				else if (up_left <= min_value) {
+					return max_value;
+				}
+				return static_cast<std::uint16_t>(left + up - up_left);
+			}
+
+			// Residuals are computed modulo 2^16 so that the mapping is lossless.
+			// Computed on the unsigned value because shifting a negative value left is undefined before C++20.
+			static std::uint16_t zigzagEncode(const std::uint16_t residual) {
+				return static_cast<std::uint16_t>((residual << 1) ^ (0 - (residual >> 15)));
+			}
+
+			static std::uint16_t zigzagDecode(const std::uint16_t value) {
+				return static_cast<std::uint16_t>((value >> 1) ^ (0 - (value & 1)));
+			}
+
+			static std::uint8_t* encodeBlock(const std::uint16_t* residuals, std::uint8_t* output) {
+				std::uint16_t bits_or = 0;
+				for (std::size_t i = 0; i < BLOCK_SIZE; ++i) {
+					bits_or |= residuals[i];
+				}
+				std::uint8_t num_bits = 0;
+				while (num_bits < 16 && (bits_or >> num_bits) != 0) {
+					++num_bits;
+				}
+				*output++ = num_bits;
+#if __SSE2__
+				const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(residuals));
+				const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(residuals + 8));
+				const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(residuals + 16));
+				const __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(residuals + 24));
+				for (std::uint8_t bit = 0; bit < num_bits; ++bit) {
+					// Move the bit into the sign bit. Signed saturation keeps the sign when packing to bytes.
+					const __m128i shift = _mm_cvtsi32_si128(15 - bit);
+					const __m128i low = _mm_packs_epi16(_mm_sll_epi16(r0, shift), _mm_sll_epi16(r1, shift));
+					const __m128i high = _mm_packs_epi16(_mm_sll_epi16(r2, shift), _mm_sll_epi16(r3, shift));
+					const std::uint32_t plane = static_cast<std::uint32_t>(_mm_movemask_epi8(low))
+						| (static_cast<std::uint32_t>(_mm_movemask_epi8(high)) << 16);
+					std::memcpy(output, &plane, sizeof(plane));
+					output += sizeof(plane);
+				}
+#else
+				for (std::uint8_t bit = 0; bit < num_bits; ++bit) {
+					std::uint32_t plane = 0;
+					for (std::size_t i = 0; i < BLOCK_SIZE; ++i) {
+						plane |= static_cast<std::uint32_t>((residuals[i] >> bit) & 1) << i;
+					}
+					std::memcpy(output, &plane, sizeof(plane));
+					output += sizeof(plane);
+				}
+#endif
+				return output;
+			}
+
+			static const std::uint8_t* decodeBlock(const std::uint8_t* data, const std::uint8_t* data_end, std::uint16_t* residuals) {
+				if (data >= data_end) {
+					throw std::runtime_error("Corrupt delta-bitplane depth tile");
+				}
+				const std::uint8_t num_bits = *data++;
+				if (num_bits > 16 || data_end - data < static_cast<std::ptrdiff_t>(num_bits * sizeof(std::uint32_t))) {
+					throw std::runtime_error("Corrupt delta-bitplane depth tile");
+				}
+				std::fill(residuals, residuals + BLOCK_SIZE, 0);
+				for (std::uint8_t bit = 0; bit < num_bits; ++bit) {
+					std::uint32_t plane;
+					std::memcpy(&plane, data, sizeof(plane));
+					data += sizeof(plane);
+					for (std::size_t i = 0; i < BLOCK_SIZE; ++i) {
+						residuals[i] |= static_cast<std::uint16_t>(((plane >> i) & 1) << bit);
+					}
+				}
+				return data;
+			}
+		};
+
+		inline std::unique_ptr<DepthCodec> createDepthCodec(const DepthCodecType type) {
+			switch (type) {
+			case DepthCodecType::SNAPPY:
+				return std::unique_ptr<DepthCodec>(new SnappyDepthCodec());
+			case DepthCodecType::DELTA_BITPLANE:
+				return std::unique_ptr<DepthCodec>(new DeltaBitplaneDepthCodec());
+			default:
+				return nullptr;
+			}
+		}
+
+		struct EncodedDepthFrameHeader
+		{
+			std::uint32_t width;
+			std::uint32_t height;
+			std::uint32_t tile_rows;
+			std::uint32_t num_tiles;
+		};
+
+		//! Encodes a depth frame tile by tile (in parallel). The output vector is resized and can be reused for the next frame.
+		inline void encodeDepthFrame(const DepthCodec& codec, const std::uint16_t* depth, const std::size_t width, const std::size_t height,
+			std::vector<std::uint8_t>& output, const std::size_t tile_rows = 32) {
+			EncodedDepthFrameHeader header;
+			header.width = static_cast<std::uint32_t>(width);
+			header.height = static_cast<std::uint32_t>(height);
+			header.tile_rows = static_cast<std::uint32_t>(tile_rows);
+			header.num_tiles = static_cast<std::uint32_t>((height + tile_rows - 1) / tile_rows);
+			const std::size_t tile_sizes_offset = sizeof(header);
+			const std::size_t data_offset = tile_sizes_offset + header.num_tiles * sizeof(std::uint32_t);
+			const std::size_t max_tile_size = codec.getMaxEncodedTileSize(width, tile_rows);
+			output.resize(data_offset + header.num_tiles * max_tile_size);
+			std::memcpy(output.data(), &header, sizeof(header));
+
+			// Each tile is encoded into its own slot of maximum size and the slots are compacted afterwards
+			std::vector<std::uint32_t> tile_sizes(header.num_tiles);
+#pragma omp parallel for schedule(dynamic)
+			for (int tile = 0; tile < static_cast<int>(header.num_tiles); ++tile) {
+				const std::size_t row_begin = tile * tile_rows;
+				const std::size_t rows = std::min(tile_rows, height - row_begin);
+				tile_sizes[tile] = static_cast<std::uint32_t>(
+					codec.encodeTile(depth + row_begin * width, width, rows, output.data() + data_offset + tile * max_tile_size));
+			}
+			std::size_t offset = data_offset;
+			for (std::size_t tile = 0; tile < header.num_tiles; ++tile) {
+				std::memmove(output.data() + offset, output.data() + data_offset + tile * max_tile_size, tile_sizes[tile]);
+				offset += tile_sizes[tile];
+			}
+			std::memcpy(output.data() + tile_sizes_offset, tile_sizes.data(), tile_sizes.size() * sizeof(std::uint32_t));
+			output.resize(offset);
+		}
+
+		//! Upper bound of the encoded size of a frame for any number of rows per tile (used to validate received frames).
+		inline std::size_t getMaxEncodedDepthFrameSize(const DepthCodec& codec, const std::size_t width, const std::size_t height) {
+			return sizeof(EncodedDepthFrameHeader) + height * (sizeof(std::uint32_t) + codec.getMaxEncodedTileSize(width, 1));
+		}
+
+		//! Reads the frame size of an encoded depth frame.
+		inline EncodedDepthFrameHeader getEncodedDepthFrameHeader(const std::uint8_t* data, const std::size_t size) {
+			EncodedDepthFrameHeader header;
+			if (size < sizeof(header)) {
+				throw std::runtime_error("Corrupt depth frame: Missing header");
+			}
+			std::memcpy(&header, data, sizeof(header));
+			if (header.tile_rows == 0 || header.num_tiles != (header.height + header.tile_rows - 1) / header.tile_rows
+				|| size < sizeof(header) + header.num_tiles * sizeof(std::uint32_t)) {
+				throw std::runtime_error("Corrupt depth frame: Invalid header");
+			}
+			return header;
+		}
+
+		//! Decodes a depth frame tile by tile (in parallel). The depth buffer has to hold width * height values.
+		inline void decodeDepthFrame(const DepthCodec& codec, const std::uint8_t* data, const std::size_t size, std::uint16_t* depth) {
+			const EncodedDepthFrameHeader header = getEncodedDepthFrameHeader(data, size);
+			std::vector<std::uint32_t> tile_sizes(header.num_tiles);
+			std::memcpy(tile_sizes.data(), data + sizeof(header), tile_sizes.size() * sizeof(std::uint32_t));
+			std::vector<std::size_t> tile_offsets(header.num_tiles);
+			std::size_t offset = sizeof(header) + header.num_tiles * sizeof(std::uint32_t);
+			for (std::size_t tile = 0; tile < header.num_tiles; ++tile) {
+				tile_offsets[tile] = offset;
+				offset += tile_sizes[tile];
+			}
+			if (offset != size) {
+				throw std::runtime_error("Corrupt depth frame: Tile sizes do not match frame size");
+			}
+
+			bool corrupt = false;
+#pragma omp parallel for schedule(dynamic)
+			for (int tile = 0; tile < static_cast<int>(header.num_tiles); ++tile) {
+				const std::size_t row_begin = tile * header.tile_rows;
+				const std::size_t rows = std::min<std::size_t>(header.tile_rows, header.height - row_begin);
+				try {
+					codec.decodeTile(data + tile_offsets[tile], tile_sizes[tile], header.width, rows, depth + row_begin * header.width);
+				}
+				catch (const std::runtime_error&) {
+					// Exceptions must not leave the parallel region
+#pragma omp critical
+					corrupt = true;
+				}
+			}
+			if (corrupt) {
+				throw std::runtime_error("Corrupt depth frame: Unable to decode tile");
+			}
+		}
+
+	}
+
+}
@@ -0,0 +1,273 @@
+//==================================================
+// DepthQuantization.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <vector>
+#if __AVX__ || __SSE2__
+	#include <immintrin.h>
+#endif
+
+namespace ait
+{
+
+	namespace video
+	{
+		/// Quantization of float depth images to 8 bit values that are replicated into the four channels of an RGBA image.
+		///
+		/// Valid depth values (finite and within the truncation range) are mapped linearly (or linearly in inverse depth)
+		/// from [min_depth, max_depth] to [truncation_threshold, 255]. Invalid depth values are mapped to 0.
+		/// All functions are reentrant. Work is split into blocks that are processed in parallel (OpenMP) and
+		/// each block is vectorized (AVX or SSE2 depending on the compiler flags).
+		struct DepthQuantizationParameters
+		{
+			float trunc_depth_min = 0;
+			float trunc_depth_max = std::numeric_limits<float>::infinity();
+			std::uint8_t truncation_threshold = 5;
+			bool inverse_depth = true;
+		};
+
+		/// Range of the valid depth values of an image. Empty (min_depth > max_depth) if there are no valid values.
+		struct DepthRange
+		{
+			float min_depth = std::numeric_limits<float>::infinity();
+			float max_depth = -std::numeric_limits<float>::infinity();
+
+			bool empty() const {
+				return min_depth > max_depth;
+			}
+		};
+
+		namespace detail
+		{
+			const std::size_t DEPTH_QUANTIZATION_BLOCK_SIZE = 16 * 1024;
+
+			inline bool isValidDepth(const float depth, const DepthQuantizationParameters& parameters) {
+				return std::isfinite(depth) && depth >= parameters.trunc_depth_min && depth <= parameters.trunc_depth_max;
+			}
+
+			inline void computeDepthRangeBlock(const float* depth, const std::size_t num_pixels,
+				const DepthQuantizationParameters& parameters, float& min_depth, float& max_depth) {
+				std::size_t i = 0;
+#if __AVX__
+				const __m256 trunc_min_vec = _mm256_set1_ps(parameters.trunc_depth_min);
+				const __m256 trunc_max_vec = _mm256_set1_ps(parameters.trunc_depth_max);
+				const __m256 abs_mask_vec = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+				const __m256 inf_vec = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+				const __m256 neg_inf_vec = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+				__m256 min_vec = inf_vec;
+				__m256 max_vec = neg_inf_vec;
+				for (; i + 8 <= num_pixels; i += 8) {
+					const __m256 depth_vec = _mm256_loadu_ps(depth + i);
+					// Ordered comparisons are false for NaN
+					__m256 valid_mask = _mm256_and_ps(_mm256_cmp_ps(depth_vec, trunc_min_vec, _CMP_GE_OQ), _mm256_cmp_ps(depth_vec, trunc_max_vec, _CMP_LE_OQ));
+					valid_mask = _mm256_and_ps(valid_mask, _mm256_cmp_ps(_mm256_and_ps(depth_vec, abs_mask_vec), inf_vec, _CMP_LT_OQ));
+					min_vec = _mm256_min_ps(min_vec, _mm256_blendv_ps(inf_vec, depth_vec, valid_mask));
+					max_vec = _mm256_max_ps(max_vec, _mm256_blendv_ps(neg_inf_vec, depth_vec, valid_mask));
+				}
+				float min_values[8];
+				float max_values[8];
+				_mm256_storeu_ps(min_values, min_vec);
+				_mm256_storeu_ps(max_values, max_vec);
+				for (int j = 0; j < 8; ++j) {
+					min_depth = std::min(min_depth, min_values[j]);
+					max_depth = std::max(max_depth, max_values[j]);
+				}
+#elif __SSE2__
+				const __m128 trunc_min_vec = _mm_set1_ps(parameters.trunc_depth_min);
+				const __m128 trunc_max_vec = _mm_set1_ps(parameters.trunc_depth_max);
+				const __m128 abs_mask_vec = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+				const __m128 inf_vec = _mm_set1_ps(std::numeric_limits<float>::infinity());
+				const __m128 neg_inf_vec = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+				__m128 min_vec = inf_vec;
+				__m128 max_vec = neg_inf_vec;
+				for (; i + 4 <= num_pixels; i += 4) {
+					const __m128 depth_vec = _mm_loadu_ps(depth + i);
+					__m128 valid_mask = _mm_and_ps(_mm_cmpge_ps(depth_vec, trunc_min_vec), _mm_cmple_ps(depth_vec, trunc_max_vec));
+					valid_mask = _mm_and_ps(valid_mask, _mm_cmplt_ps(_mm_and_ps(depth_vec, abs_mask_vec), inf_vec));
+					min_vec = _mm_min_ps(min_vec, _mm_or_ps(_mm_and_ps(valid_mask, depth_vec), _mm_andnot_ps(valid_mask, inf_vec)));
+					max_vec = _mm_max_ps(max_vec, _mm_or_ps(_mm_and_ps(valid_mask, depth_vec), _mm_andnot_ps(valid_mask, neg_inf_vec)));
+				}
+				float min_values[4];
+				float max_values[4];
+				_mm_storeu_ps(min_values, min_vec);
+				_mm_storeu_ps(max_values, max_vec);
+				for (int j = 0; j < 4; ++j) {
+					min_depth = std::min(min_depth, min_values[j]);
+					max_depth = std::max(max_depth, max_values[j]);
+				}
+#endif
+				for (; i < num_pixels; ++i) {
+					if (isValidDepth(depth[i], parameters)) {
+						min_depth = std::min(min_depth, depth[i]);
+						max_depth = std::max(max_depth, depth[i]);
+					}
+				}
+			}
+
+			/// Linear mapping of (inverse) depth to the quantized range: value = trunc(x * scale + offset)
+			struct DepthQuantizationMapping
+			{
+				float scale;
+				float offset;
+				float min_value;
+				float max_value;
+
+				DepthQuantizationMapping(const DepthRange& range, const DepthQuantizationParameters& parameters) {
+					float low;
+					float high;
+					if (range.empty()) {
+						low = 0;
+						high = 0;
+					}
+					else if (parameters.inverse_depth) {
+						low = 1 / range.max_depth;
+						high = 1 / range.min_depth;
+					}
+					else {
+						low = range.min_depth;
+						high = range.max_depth;
+					}
+					const float threshold = parameters.truncation_threshold;
+					scale = high > low ? (255 - threshold) / (high - low) : 0;
+					// Adding 0.5 and truncating rounds the non-negative values to the nearest integer
+					offset = threshold - low * scale + 0.5f;
+					min_value = threshold;
+					max_value = 255.5f;
+				}
+
+				std::uint32_t quantize(const float depth, const bool inverse_depth) const {
+					const float value = (inverse_depth ? 1 / depth : depth) * scale + offset;
+					const std::uint32_t quantized_value = static_cast<std::uint32_t>(std::min(std::max(value, min_value), max_value));
+					return quantized_value * 0x01010101u;
+				}
+			};
+
+			inline void quantizeDepthBlock(const float* depth, const std::size_t num_pixels,
+				const DepthQuantizationParameters& parameters, const DepthQuantizationMapping& mapping, std::uint32_t* rgba) {
+				std::size_t i = 0;
+#if __AVX2__
+				const __m256 trunc_min_vec = _mm256_set1_ps(parameters.trunc_depth_min);
+				const __m256 trunc_max_vec = _mm256_set1_ps(parameters.trunc_depth_max);
+				const __m256 abs_mask_vec = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+				const __m256 inf_vec = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+				const __m256 one_vec = _mm256_set1_ps(1);
+				const __m256 scale_vec = _mm256_set1_ps(mapping.scale);
+				const __m256 offset_vec = _mm256_set1_ps(mapping.offset);
+				const __m256 min_value_vec = _mm256_set1_ps(mapping.min_value);
+				const __m256 max_value_vec = _mm256_set1_ps(mapping.max_value);
+				for (; i + 8 <= num_pixels; i += 8) {
+					const __m256 depth_vec = _mm256_loadu_ps(depth + i);
+					__m256 valid_mask = _mm256_and_ps(_mm256_cmp_ps(depth_vec, trunc_min_vec, _CMP_GE_OQ), _mm256_cmp_ps(depth_vec, trunc_max_vec, _CMP_LE_OQ));
+					valid_mask = _mm256_and_ps(valid_mask, _mm256_cmp_ps(_mm256_and_ps(depth_vec, abs_mask_vec), inf_vec, _CMP_LT_OQ));
+					const __m256 x_vec = parameters.inverse_depth ? _mm256_div_ps(one_vec, depth_vec) : depth_vec;
+					__m256 value_vec = _mm256_add_ps(_mm256_mul_ps(x_vec, scale_vec), offset_vec);
+					value_vec = _mm256_min_ps(_mm256_max_ps(value_vec, min_value_vec), max_value_vec);
+					__m256i quantized_vec = _mm256_and_si256(_mm256_cvttps_epi32(value_vec), _mm256_castps_si256(valid_mask));
+					// Replicate the value into all four channels
+					quantized_vec = _mm256_or_si256(quantized_vec, _mm256_slli_epi32(quantized_vec, 8));
+					quantized_vec = _mm256_or_si256(quantized_vec, _mm256_slli_epi32(quantized_vec, 16));
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + i), quantized_vec);
+				}
+#elif __SSE2__
+				const __m128 trunc_min_vec = _mm_set1_ps(parameters.trunc_depth_min);
+				const __m128 trunc_max_vec = _mm_set1_ps(parameters.trunc_depth_max);
+				const __m128 abs_mask_vec = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+				const __m128 inf_vec = _mm_set1_ps(std::numeric_limits<float>::infinity());
+				const __m128 one_vec = _mm_set1_ps(1);
+				const __m128 scale_vec = _mm_set1_ps(mapping.scale);
+				const __m128 offset_vec = _mm_set1_ps(mapping.offset);
+				const __m128 min_value_vec = _mm_set1_ps(mapping.min_value);
+				const __m128 max_value_vec = _mm_set1_ps(mapping.max_value);
+				for (; i + 4 <= num_pixels; i += 4) {
+					const __m128 depth_vec = _mm_loadu_ps(depth + i);
+					__m128 valid_mask = _mm_and_ps(_mm_cmpge_ps(depth_vec, trunc_min_vec), _mm_cmple_ps(depth_vec, trunc_max_vec));
+					valid_mask = _mm_and_ps(valid_mask, _mm_cmplt_ps(_mm_and_ps(depth_vec, abs_mask_vec), inf_vec));
+					const __m128 x_vec = parameters.inverse_depth ? _mm_div_ps(one_vec, depth_vec) : depth_vec;
+					__m128 value_vec = _mm_add_ps(_mm_mul_ps(x_vec, scale_vec), offset_vec);
+					value_vec = _mm_min_ps(_mm_max_ps(value_vec, min_value_vec), max_value_vec);
+					__m128i quantized_vec = _mm_and_si128(_mm_cvttps_epi32(value_vec), _mm_castps_si128(valid_mask));
+					quantized_vec = _mm_or_si128(quantized_vec, _mm_slli_epi32(quantized_vec, 8));
+					quantized_vec = _mm_or_si128(quantized_vec, _mm_slli_epi32(quantized_vec, 16));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i), quantized_vec);
+				}
+#endif
+				for (; i < num_pixels; ++i) {
+					if (isValidDepth(depth[i], parameters)) {
+						rgba[i] = mapping.quantize(depth[i], parameters.inverse_depth);
+					}
+					else {
+						rgba[i] = 0;
+					}
+				}
+			}
+		}
+
+		/// Compute the range of the valid depth values.
+		inline DepthRange computeDepthRange(const float* depth, const std::size_t num_pixels, const DepthQuantizationParameters& parameters) {
+			const std::size_t block_size = detail::DEPTH_QUANTIZATION_BLOCK_SIZE;
+			const int num_blocks = static_cast<int>((num_pixels + block_size - 1) / block_size);
+			// Partial ranges of each block are combined afterwards (min/max reductions need OpenMP 3.1 which MSVC lacks)
+			std::vector<float> block_min_depths(num_blocks, std::numeric_limits<float>::infinity());
+			std::vector<float> block_max_depths(num_blocks, -std::numeric_limits<float>::infinity());
+#pragma omp parallel for
+			for (int block = 0; block < num_blocks; ++block) {
+				const std::size_t begin = block * block_size;
+				const std::size_t end = std::min(begin + block_size, num_pixels);
+				detail::computeDepthRangeBlock(depth + begin, end - begin, parameters, block_min_depths[block], block_max_depths[block]);
+			}
+			DepthRange range;
+			range.min_depth = std::numeric_limits<float>::infinity();
+			range.max_depth = -std::numeric_limits<float>::infinity();
+			for (int block = 0; block < num_blocks; ++block) {
+				range.min_depth = std::min(range.min_depth, block_min_depths[block]);
+				range.max_depth = std::max(range.max_depth, block_max_depths[block]);
+			}
+			return range;
+		}
+
+		/// Quantize depth values into RGBA pixels (the caller provides num_pixels RGBA values).
+		///
+		/// The range has to be computed from the same depth values (i.e. with computeDepthRange()).
+		inline void quantizeDepthToRGBA(const float* depth, const std::size_t num_pixels, const DepthRange& range,
+			const DepthQuantizationParameters& parameters, std::uint32_t* rgba) {
+			const detail::DepthQuantizationMapping mapping(range, parameters);
+			const std::size_t block_size = detail::DEPTH_QUANTIZATION_BLOCK_SIZE;
+			const int num_blocks = static_cast<int>((num_pixels + block_size - 1) / block_size);
+#pragma omp parallel for
+			for (int block = 0; block < num_blocks; ++block) {
+				const std::size_t begin = block * block_size;
+				const std::size_t end = std::min(begin + block_size, num_pixels);
+				detail::quantizeDepthBlock(depth + begin, end - begin, parameters, mapping, rgba + begin);
+			}
+		}
+
+		/// Inverse of the quantization (for validation). Returns NaN for invalid (zero) values.
+		inline float dequantizeDepth(const std::uint8_t value, const DepthRange& range, const DepthQuantizationParameters& parameters) {
+			if (value == 0) {
+				return std::numeric_limits<float>::quiet_NaN();
+			}
+			const float threshold = parameters.truncation_threshold;
+			if (parameters.inverse_depth) {
+				const float min_inv_depth = 1 / range.max_depth;
+				const float max_inv_depth = 1 / range.min_depth;
+				return 1 / ((value - threshold) * (max_inv_depth - min_inv_depth) / (255 - threshold) + min_inv_depth);
+			}
+			else {
+				return (value - threshold) * (range.max_depth - range.min_depth) / (255 - threshold) + range.min_depth;
+			}
+		}
+
+	}
+
+}
@@ -10,6 +10,7 @@
 
 #include "GstreamerPipeline.h"
 
+#include <vector>
 #include <opencv2/core.hpp>
 
 template <typename TUserData>
@@ -85,13 +86,63 @@ public:
 			throw std::runtime_error("pushNewFrame() failed: Non-continuous images are not supported");
 		}
 
+		GstBufferWrapper buffer(allocateInputBuffer(frame.rows, frame.cols, frame.elemSize1(), buffer_size));
+		std::copy(frame.data, frame.data + buffer_size, buffer.getDataWritable());
+		buffer.unmap();
+
+		return pushInputBuffer(buffer, user_data);
+	}
+
+	//! Push frames that are concatenated horizontally (i.e. left, right and depth frame) as a single input frame.
+	//! The rows of the frames are copied directly into the Gstreamer buffer (without merging the frames first).
+	bool pushInputConcatenated(const std::vector<cv::Mat>& frames, const TUserData& user_data)
+	{
+		if (frames.empty()) {
+			throw std::runtime_error("pushInputConcatenated() failed: No frames");
+		}
+		int total_cols = 0;
+		for (const cv::Mat& frame : frames) {
+			if (frame.rows != frames.front().rows || frame.type() != frames.front().type()) {
+				throw std::runtime_error("pushInputConcatenated() failed: Frames do not have the same height and type");
+			}
+			total_cols += frame.cols;
+		}
+		const int rows = frames.front().rows;
+		if (frames.front().depth() != CV_8U && frames.front().depth() != CV_8S) {
+			throw std::runtime_error("pushInputConcatenated() failed: Unsupported image depth");
+		}
+		const size_t elem_size = frames.front().elemSize();
+		const size_t row_size = total_cols * elem_size;
+		const size_t buffer_size = rows * row_size;
+
+		GstBufferWrapper buffer(allocateInputBuffer(rows, total_cols, frames.front().elemSize1(), buffer_size));
+		guint8* data = buffer.getDataWritable();
+#pragma omp parallel for
+		for (int row = 0; row < rows; ++row) {
+			guint8* row_data = data + row * row_size;
+			for (const cv::Mat& frame : frames) {
+				const size_t frame_row_size = frame.cols * elem_size;
+				std::copy(frame.ptr(row), frame.ptr(row) + frame_row_size, row_data);
+				row_data += frame_row_size;
+			}
+		}
+		buffer.unmap();
+
+		return pushInputBuffer(buffer, user_data);
+	}
+
+protected:
+	//! Allocates a Gstreamer buffer for an input frame and negotiates the input caps with the first frame.
+	//! The returned buffer is mapped writable.
+	GstBufferWrapper allocateInputBuffer(int rows, int cols, size_t elem_size1, size_t buffer_size)
+	{
 		if (!negotiated_) {
 			GstCaps *caps = gst_caps_new_simple(
 				"video/x-raw",
-				"width", G_TYPE_INT, frame.cols,
-				"height", G_TYPE_INT, frame.rows,
+				"width", G_TYPE_INT, cols,
+				"height", G_TYPE_INT, rows,
 				"format", G_TYPE_STRING, "BGRA",
-				"bpp", G_TYPE_INT, 8 * frame.elemSize1(),
+				"bpp", G_TYPE_INT, 8 * elem_size1,
 				//"framerate", GST_TYPE_FRACTION, 10, 1,
 				nullptr);
 			gst_app_src_set_caps(GST_APP_SRC(Base::getNativeAppSrc()), caps);
@@ -109,9 +160,12 @@ public:
 		if (buffer.getSize() != buffer_size) {
 			throw std::runtime_error("pushNewFrame() failed: Buffer has wrong size");
 		}
-		std::copy(frame.data, frame.data + buffer_size, buffer.getDataWritable());
-		buffer.unmap();
+		return buffer;
+	}
 
+	//! Sets the timing information of an input buffer and pushes it into the pipeline.
+	bool pushInputBuffer(GstBufferWrapper& buffer, const TUserData& user_data)
+	{
 		// Set buffer timestamp and duration
 		//std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
 		//std::chrono::duration<double> elapsed_duration = now - start_time_;
@@ -155,7 +209,6 @@ public:
 		return Base::pushInput(buffer, user_data);
 	}
 
-protected:
 	GstPipeline* createPipeline(GstAppSrc* appsrc, GstAppSink* appsink) const override
 	{
 #if SIMULATE_ZED
@@ -15,6 +15,11 @@
 #include <mutex>
 #include <string>
 #include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
 
 #include <gst/gst.h>
 #include <gst/app/gstappsink.h>
@@ -365,6 +370,226 @@ private:
 	std::atomic<bool> discard_everything_;
 };
 
+/// Lock-free single-producer/single-consumer ring of preallocated frames.
+///
+/// All frames are allocated up-front (capacity + 2: one is being written by the producer and one
+/// is being read by the consumer) and recycled, so pushing a frame never allocates.
+/// Queued frames are passed through a ring of frame pointers and consumed frames are returned
+/// to the producer through a second ring. Only atomics are used on the producer and consumer paths;
+/// the condition variable is only used to put a waiting consumer to sleep.
+///
+/// Producer: T* frame = acquireWriteFrame(); fill *frame; commitWriteFrame();
+/// Consumer: T* frame = tryAcquireReadFrame(); read *frame; releaseReadFrame();
+template <typename T>
+class SPSCFrameRing
+{
+public:
+	enum OverflowPolicy {
+		// Replace the oldest queued frame with the new frame
+		DROP_OLDEST,
+		// Discard the new frame
+		DROP_NEWEST,
+		// Wait until the consumer has taken a frame (or until setDiscardEverything(true) is called)
+		BLOCK,
+	};
+
+	SPSCFrameRing(const size_t capacity, const OverflowPolicy overflow_policy, const T& prototype_frame = T())
+		: capacity_(capacity), overflow_policy_(overflow_policy),
+		queued_frames_(capacity), read_index_(0), write_index_(0),
+		free_frames_(capacity + 2), free_read_index_(0), free_write_index_(0),
+		write_frame_(nullptr), read_frame_(nullptr),
+		discard_everything_(false), dropped_frame_counter_(0), consumer_waiting_(false) {
+		if (capacity_ == 0) {
+			throw ANNOTATE_EXC(std::runtime_error, "Frame ring needs a capacity of at least one frame");
+		}
+		frames_.reserve(capacity_ + 2);
+		for (size_t i = 0; i < capacity_ + 2; ++i) {
+			frames_.emplace_back(new T(prototype_frame));
+			free_frames_[i].store(frames_.back().get(), std::memory_order_relaxed);
+		}
+		free_write_index_.store(capacity_ + 2, std::memory_order_release);
+	}
+
+	SPSCFrameRing(const SPSCFrameRing&) = delete;
+	void operator=(const SPSCFrameRing&) = delete;
+
+	size_t getCapacity() const {
+		return capacity_;
+	}
+
+	OverflowPolicy getOverflowPolicy() const {
+		return overflow_policy_;
+	}
+
+	/// Abort blocking pushes and discard all new frames
+	void setDiscardEverything(bool discard_everything) {
+		discard_everything_ = discard_everything;
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	/// Number of queued frames (only exact if called by the producer or consumer while the other one is idle)
+	size_t size() const {
+		const uint64_t read_index = read_index_.load(std::memory_order_acquire);
+		const uint64_t write_index = write_index_.load(std::memory_order_acquire);
+		return write_index > read_index ? static_cast<size_t>(write_index - read_index) : 0;
+	}
+
+	/// Number of frames dropped because the ring was full
+	uint64_t getDroppedFrameCount() const {
+		return dropped_frame_counter_.load(std::memory_order_relaxed);
+	}
+
+	//
+	// Producer
+	//
+
+	/// Frame to be filled by the producer (a recycled frame with its previous content). Never allocates.
+	T* acquireWriteFrame() {
+		if (write_frame_ == nullptr) {
+			const uint64_t free_read_index = free_read_index_.load(std::memory_order_relaxed);
+			// Synchronizes with the consumer releasing the frame so it must not be compiled out with the assertion
+			const uint64_t free_write_index = free_write_index_.load(std::memory_order_acquire);
+			// There is always a free frame because at most capacity + 1 frames are queued or read
+			AIT_ASSERT(free_read_index < free_write_index);
+			write_frame_ = free_frames_[free_read_index % free_frames_.size()].load(std::memory_order_relaxed);
+			free_read_index_.store(free_read_index + 1, std::memory_order_release);
+		}
+		return write_frame_;
+	}
+
+	/// Queue the acquired frame. Returns false if the frame was discarded (it can be acquired again).
+	bool commitWriteFrame() {
+		AIT_ASSERT(write_frame_ != nullptr);
+		if (discard_everything_) {
+			return false;
+		}
+		uint64_t write_index = write_index_.load(std::memory_order_relaxed);
+		T* reclaimed_frame = nullptr;
+		unsigned int block_spin_counter = 0;
+		while (write_index - read_index_.load(std::memory_order_acquire) >= capacity_) {
+			if (overflow_policy_ == DROP_NEWEST) {
+				++dropped_frame_counter_;
+				return false;
+			}
+			else if (overflow_policy_ == DROP_OLDEST) {
+				// Compete with the consumer for the oldest frame. Whoever wins owns it.
+				uint64_t read_index = read_index_.load(std::memory_order_acquire);
+				T* oldest_frame = queued_frames_[read_index % capacity_].load(std::memory_order_relaxed);
+				if (read_index_.compare_exchange_strong(read_index, read_index + 1, std::memory_order_acq_rel)) {
+					reclaimed_frame = oldest_frame;
+					++dropped_frame_counter_;
+				}
+			}
+			else {
+				if (discard_everything_) {
+					return false;
+				}
+				// Spin shortly and then back off so that a stalled consumer does not keep a core busy
+				if (block_spin_counter < MAX_BLOCK_SPIN_COUNT) {
+					++block_spin_counter;
+					std::this_thread::yield();
+				}
+				else {
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+				}
+			}
+		}
+		queued_frames_[write_index % capacity_].store(write_frame_, std::memory_order_relaxed);
+		write_index_.store(write_index + 1, std::memory_order_release);
+		write_frame_ = reclaimed_frame;
+		// Only wake up the consumer if it is sleeping (it announces this before checking for frames)
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (consumer_waiting_.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> lock(sleep_mutex_);
+			frame_queued_condition_.notify_one();
+		}
+		return true;
+	}
+
+	//
+	// Consumer
+	//
+
+	/// Oldest queued frame or nullptr if the ring is empty. The frame has to be released before acquiring the next one.
+	T* tryAcquireReadFrame() {
+		AIT_ASSERT(read_frame_ == nullptr);
+		uint64_t read_index = read_index_.load(std::memory_order_acquire);
+		while (read_index < write_index_.load(std::memory_order_acquire)) {
+			// The slot might be overwritten if the producer dropped this frame. The exchange fails in that case.
+			T* frame = queued_frames_[read_index % capacity_].load(std::memory_order_relaxed);
+			if (read_index_.compare_exchange_weak(read_index, read_index + 1, std::memory_order_acq_rel)) {
+				read_frame_ = frame;
+				return frame;
+			}
+		}
+		return nullptr;
+	}
+
+	/// Wait for a queued frame (up to the timeout). Returns nullptr if no frame was queued in time.
+	template <typename TRep, typename TPeriod>
+	T* acquireReadFrame(const std::chrono::duration<TRep, TPeriod>& timeout) {
+		T* frame = tryAcquireReadFrame();
+		if (frame == nullptr) {
+			std::unique_lock<std::mutex> lock(sleep_mutex_);
+			consumer_waiting_.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			frame_queued_condition_.wait_for(lock, timeout, [this]() { return !empty(); });
+			consumer_waiting_.store(false, std::memory_order_relaxed);
+			lock.unlock();
+			frame = tryAcquireReadFrame();
+		}
+		return frame;
+	}
+
+	/// Return the acquired frame to the producer
+	void releaseReadFrame() {
+		AIT_ASSERT(read_frame_ != nullptr);
+		const uint64_t free_write_index = free_write_index_.load(std::memory_order_relaxed);
+		free_frames_[free_write_index % free_frames_.size()].store(read_frame_, std::memory_order_relaxed);
+		free_write_index_.store(free_write_index + 1, std::memory_order_release);
+		read_frame_ = nullptr;
+	}
+
+private:
+	static const unsigned int MAX_BLOCK_SPIN_COUNT = 1000;
+	static const size_t CACHE_LINE_SIZE = 64;
+
+	const size_t capacity_;
+	const OverflowPolicy overflow_policy_;
+	std::vector<std::unique_ptr<T>> frames_;
+
+	// Queued frames (producer to consumer). The read index is also advanced by the producer when dropping the oldest frame.
+	// Indices are padded to separate cache lines so that producer and consumer do not invalidate each other's lines.
+	std::vector<std::atomic<T*>> queued_frames_;
+	char padding0_[CACHE_LINE_SIZE];
+	std::atomic<uint64_t> read_index_;
+	char padding1_[CACHE_LINE_SIZE];
+	std::atomic<uint64_t> write_index_;
+	char padding2_[CACHE_LINE_SIZE];
+
+	// Consumed frames (consumer to producer)
+	std::vector<std::atomic<T*>> free_frames_;
+	std::atomic<uint64_t> free_read_index_;
+	char padding3_[CACHE_LINE_SIZE];
+	std::atomic<uint64_t> free_write_index_;
+	char padding4_[CACHE_LINE_SIZE];
+
+	// Frames currently owned by the producer and by the consumer
+	T* write_frame_;
+	char padding5_[CACHE_LINE_SIZE];
+	T* read_frame_;
+	char padding6_[CACHE_LINE_SIZE];
+
+	std::atomic<bool> discard_everything_;
+	std::atomic<uint64_t> dropped_frame_counter_;
+	std::atomic<bool> consumer_waiting_;
+	std::mutex sleep_mutex_;
+	std::condition_variable frame_queued_condition_;
+};
+
 template <typename TUserData>
 class GstreamerPipeline;
 
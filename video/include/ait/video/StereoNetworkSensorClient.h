@@ -15,6 +15,7 @@
 #include <ait/video/GstreamerPipeline.h>
 
 #include <ait/common.h>
+#include <ait/NetworkMessage.h>
 
 //#pragma comment(lib, "zlib64.lib")
 //#if _DEBUG
@@ -51,21 +52,25 @@ public:
 		network_client_->sendDataBlocking(stereo_initialization);
 	}
 
+	//! Sends header, user data, buffer info and the encoded buffer with a single gather write.
+	//! The encoded buffer is not copied. The message storage is reused for every frame.
 	void sendGstreamerData(GstBufferWrapper& buffer, const TUserData& user_data) {
+		frame_message_.clear();
+
 		StereoPacketHeader packet_header;
 		packet_header.client_type = client_type_;
 		packet_header.packet_type = StereoPacketType::CLIENT_2_SERVER_GSTREAMER_FRAME;
 		packet_header.packet_size = (size_t)-1;
 		packet_header.packet_size_decompressed = packet_header.packet_size;
-		network_client_->sendDataBlocking(packet_header);
+		frame_message_.addValue(packet_header);
 
 #if DEBUG_IMAGE_COMPRESSION
-        network_client_->sendDataBlocking(user_data);
-        network_client_->sendDataBlocking(user_data.left_frame.data, user_data.left_frame.rows * user_data.left_frame.cols * user_data.left_frame.elemSize());
-        network_client_->sendDataBlocking(user_data.right_frame.data, user_data.right_frame.rows * user_data.right_frame.cols * user_data.right_frame.elemSize());
-        network_client_->sendDataBlocking(user_data.depth_frame.data, user_data.depth_frame.rows * user_data.depth_frame.cols * user_data.depth_frame.elemSize());
+        frame_message_.addValue(user_data);
+        frame_message_.addBuffer(user_data.left_frame.data, user_data.left_frame.rows * user_data.left_frame.cols * user_data.left_frame.elemSize());
+        frame_message_.addBuffer(user_data.right_frame.data, user_data.right_frame.rows * user_data.right_frame.cols * user_data.right_frame.elemSize());
+        frame_message_.addBuffer(user_data.depth_frame.data, user_data.depth_frame.rows * user_data.depth_frame.cols * user_data.depth_frame.elemSize());
 #else
-        network_client_->sendDataBlocking(user_data);
+        frame_message_.addValue(user_data);
 #endif
 
 		GstreamerBufferInfo buffer_info;
@@ -75,9 +80,11 @@ public:
 		buffer_info.offset = GST_BUFFER_OFFSET(buffer.get());
 		buffer_info.offset_end = GST_BUFFER_OFFSET_END(buffer.get());
 		buffer_info.size = buffer.getSize();
-		network_client_->sendDataBlocking(buffer_info);
+		frame_message_.addValue(buffer_info);
+
+		frame_message_.addBuffer(buffer.getData(), buffer.getSize());
 
-		network_client_->sendDataBlocking(buffer.getData(), buffer.getSize());
+		network_client_->sendMessageBlocking(frame_message_);
 	}
 
 	void sendGstreamerParameters(GstCapsWrapper gst_caps, const TUserParameters& user_parameters) {
@@ -93,10 +100,22 @@ public:
 		network_client_->sendDataBlocking(user_parameters);
 	}
 
+	void sendDepthCodecParameters(const StereoDepthCodecParameters& depth_codec_parameters) {
+		StereoPacketHeader packet_header;
+		packet_header.client_type = client_type_;
+		packet_header.packet_type = StereoPacketType::CLIENT_2_SERVER_DEPTH_CODEC;
+		packet_header.packet_size = (size_t)-1;
+		packet_header.packet_size_decompressed = packet_header.packet_size;
+		network_client_->sendDataBlocking(packet_header);
+
+		network_client_->sendDataBlocking(depth_codec_parameters);
+	}
+
 private:
 	size_t ack_frame_counter_;
 	std::shared_ptr<TNetworkClient> network_client_;
 	StereoClientType client_type_;
+	NetworkMessage frame_message_;
 };
 
 }
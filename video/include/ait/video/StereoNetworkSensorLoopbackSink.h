@@ -0,0 +1,298 @@
+//==================================================
+// StereoNetworkSensorLoopbackSink.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <boost/asio.hpp>
+#include <ait/serializable.h>
+#include <ait/video/StereoNetworkSensorProtocol.h>
+#include <ait/video/DepthCodec.h>
+
+namespace ait
+{
+
+namespace video
+{
+
+//! Receiving end of the stereo network protocol on the loopback interface (replacement for the BundleFusion server
+//! when benchmarking the streaming pipeline). Connections are accepted and handled one after the other on a
+//! separate thread. Lossless depth frames are decoded like on the server.
+//!
+//! GstreamerBufferInfo is sent as raw object memory, so the sink has to run in the same process as the client.
+class StereoNetworkSensorLoopbackSink
+{
+public:
+	using tcp = boost::asio::ip::tcp;
+	using clock = std::chrono::system_clock;
+
+	struct ReceivedFrame
+	{
+		const StereoFrameInfo* frame_info;
+		const StereoFrameLocationInfo* location_info;
+		const GstreamerBufferInfo* buffer_info;
+		//! Time when the frame was completely received and decoded (seconds since epoch as the frame timestamp)
+		double receive_time;
+		//! Size of the frame packet in bytes
+		size_t size;
+	};
+
+	using FrameCallback = std::function<void(const ReceivedFrame&)>;
+
+	//! Listens on the loopback interface. A port of 0 selects a free port.
+	StereoNetworkSensorLoopbackSink(unsigned int port = 0)
+		: acceptor_(io_service_, tcp::endpoint(boost::asio::ip::address_v4::loopback(), port)), socket_(io_service_) {
+		terminate_ = false;
+		connected_ = false;
+		num_received_frames_ = 0;
+	}
+
+	~StereoNetworkSensorLoopbackSink() {
+		stop();
+	}
+
+	unsigned int getPort() const {
+		return acceptor_.local_endpoint().port();
+	}
+
+	//! Called on the receiving thread for every frame
+	void setFrameCallback(const FrameCallback& frame_callback) {
+		frame_callback_ = frame_callback;
+	}
+
+	bool isConnected() const {
+		return connected_;
+	}
+
+	size_t getNumReceivedFrames() const {
+		return num_received_frames_;
+	}
+
+	StereoFrameParameters getFrameParameters() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return frame_parameters_;
+	}
+
+	DepthCodecType getDepthCodecType() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return depth_codec_type_;
+	}
+
+	std::string getCapsString() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return caps_string_;
+	}
+
+	void start() {
+		if (receive_thread_.joinable()) {
+			throw std::runtime_error("Loopback sink is already running");
+		}
+		terminate_ = false;
+		receive_thread_ = std::thread([this]() {
+			receiveLoop();
+		});
+	}
+
+	void stop() {
+		terminate_ = true;
+		if (receive_thread_.joinable()) {
+			boost::system::error_code ec;
+			// Unblock read() or accept() on the receiving thread
+			socket_.shutdown(tcp::socket::shutdown_both, ec);
+			tcp::socket wakeup_socket(io_service_);
+			wakeup_socket.connect(acceptor_.local_endpoint(), ec);
+			receive_thread_.join();
+		}
+		boost::system::error_code ec;
+		acceptor_.close(ec);
+	}
+
+private:
+	//! Reads from the socket through a buffer (serialized vectors are read element by element)
+	class SocketReader : public ait::Reader
+	{
+	public:
+		SocketReader(tcp::socket& socket)
+			: socket_(socket), buffer_(64 * 1024), begin_(0), end_(0), total_read_(0) {
+		}
+
+		size_t _read(void* data, size_t size) override {
+			uint8_t* output = reinterpret_cast<uint8_t*>(data);
+			size_t remaining = size;
+			while (remaining > 0) {
+				if (begin_ == end_) {
+					if (remaining >= buffer_.size()) {
+						// Large reads bypass the buffer
+						boost::asio::read(socket_, boost::asio::buffer(output, remaining));
+						break;
+					}
+					end_ = socket_.read_some(boost::asio::buffer(buffer_));
+					begin_ = 0;
+				}
+				const size_t count = std::min(remaining, end_ - begin_);
+				std::memcpy(output, buffer_.data() + begin_, count);
+				begin_ += count;
+				output += count;
+				remaining -= count;
+			}
+			total_read_ += size;
+			return size;
+		}
+
+		size_t getTotalRead() const {
+			return total_read_;
+		}
+
+	private:
+		tcp::socket& socket_;
+		std::vector<uint8_t> buffer_;
+		size_t begin_;
+		size_t end_;
+		size_t total_read_;
+	};
+
+	void receiveLoop() {
+		while (!terminate_) {
+			boost::system::error_code ec;
+			acceptor_.accept(socket_, ec);
+			if (terminate_) {
+				break;
+			}
+			if (ec) {
+				if (!terminate_) {
+					std::cerr << "Loopback sink: Unable to accept connection: " << ec.message() << std::endl;
+				}
+				break;
+			}
+			connected_ = true;
+			try {
+				handleConnection();
+			}
+			catch (const boost::system::system_error& err) {
+				if (!terminate_ && err.code() != boost::asio::error::eof) {
+					std::cerr << "Loopback sink: Network error: " << err.what() << std::endl;
+				}
+			}
+			catch (const std::runtime_error& err) {
+				std::cerr << "Loopback sink: Protocol error: " << err.what() << std::endl;
+			}
+			connected_ = false;
+			socket_.close(ec);
+		}
+	}
+
+	void handleConnection() {
+		SocketReader reader(socket_);
+		// Depth frame size from the calibration of the initialization packet. Bounds the untrusted sizes of received depth frames.
+		size_t depth_width = 0;
+		size_t depth_height = 0;
+		StereoFrameParameters frame_parameters;
+		DepthCodecType depth_codec_type = DepthCodecType::NONE;
+		std::unique_ptr<DepthCodec> depth_codec;
+		std::tuple<StereoFrameInfo, StereoFrameLocationInfo> user_data;
+		GstreamerBufferInfo buffer_info;
+		std::vector<uint8_t> buffer;
+		std::vector<uint16_t> depth_frame;
+		while (!terminate_) {
+			const size_t packet_start = reader.getTotalRead();
+			StereoPacketHeader header;
+			reader.read(header);
+			switch (header.packet_type) {
+			case StereoPacketType::CLIENT_2_SERVER_INITIALIZATION:
+			{
+				StereoInitializationPacket initialization;
+				reader.read(initialization);
+				depth_width = initialization.calibration.depth_image_width;
+				depth_height = initialization.calibration.depth_image_height;
+				break;
+			}
+			case StereoPacketType::CLIENT_2_SERVER_GSTREAMER_PARAMETERS:
+			{
+				std::string caps_string;
+				reader.read(caps_string);
+				reader.read(frame_parameters);
+				// A depth codec is announced in a separate packet after the parameters
+				depth_codec_type = DepthCodecType::NONE;
+				depth_codec.reset();
+				std::lock_guard<std::mutex> lock(mutex_);
+				caps_string_ = caps_string;
+				frame_parameters_ = frame_parameters;
+				depth_codec_type_ = depth_codec_type;
+				break;
+			}
+			case StereoPacketType::CLIENT_2_SERVER_DEPTH_CODEC:
+			{
+				StereoDepthCodecParameters depth_codec_parameters;
+				reader.read(depth_codec_parameters);
+				depth_codec_type = depth_codec_parameters.depth_codec;
+				depth_codec = createDepthCodec(depth_codec_type);
+				std::lock_guard<std::mutex> lock(mutex_);
+				depth_codec_type_ = depth_codec_type;
+				break;
+			}
+			case StereoPacketType::CLIENT_2_SERVER_GSTREAMER_FRAME:
+			{
+				StereoFrameInfo& frame_info = std::get<0>(user_data);
+				frame_info.depth_codec = depth_codec_type;
+				frame_info.max_encoded_depth_size = depth_codec ? getMaxEncodedDepthFrameSize(*depth_codec, depth_width, depth_height) : 0;
+				reader.read(user_data);
+				reader.read(buffer_info);
+				buffer.resize(buffer_info.size);
+				reader._read(buffer.data(), buffer.size());
+				if (depth_codec) {
+					const EncodedDepthFrameHeader depth_header = getEncodedDepthFrameHeader(frame_info.encoded_depth.data(), frame_info.encoded_depth.size());
+					if (depth_header.width > depth_width || depth_header.height > depth_height) {
+						throw std::runtime_error("Depth frame is larger than the calibrated depth image");
+					}
+					depth_frame.resize(static_cast<size_t>(depth_header.width) * depth_header.height);
+					decodeDepthFrame(*depth_codec, frame_info.encoded_depth.data(), frame_info.encoded_depth.size(), depth_frame.data());
+				}
+				++num_received_frames_;
+				if (frame_callback_) {
+					ReceivedFrame received_frame;
+					received_frame.frame_info = &frame_info;
+					received_frame.location_info = &std::get<1>(user_data);
+					received_frame.buffer_info = &buffer_info;
+					received_frame.receive_time = std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+					received_frame.size = reader.getTotalRead() - packet_start;
+					frame_callback_(received_frame);
+				}
+				break;
+			}
+			default:
+				throw std::runtime_error("Unknown packet type: " + std::to_string(static_cast<int>(header.packet_type)));
+			}
+		}
+	}
+
+	boost::asio::io_service io_service_;
+	tcp::acceptor acceptor_;
+	tcp::socket socket_;
+	std::thread receive_thread_;
+	std::atomic_bool terminate_;
+	std::atomic_bool connected_;
+	std::atomic<size_t> num_received_frames_;
+	FrameCallback frame_callback_;
+
+	mutable std::mutex mutex_;
+	StereoFrameParameters frame_parameters_;
+	DepthCodecType depth_codec_type_ = DepthCodecType::NONE;
+	std::string caps_string_;
+};
+
+}
+
+}
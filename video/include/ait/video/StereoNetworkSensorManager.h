@@ -16,6 +16,8 @@
 #include <ait/video/StereoNetworkSensorClient.h>
 #include <ait/video/StereoNetworkSensorProtocol.h>
 #include <ait/video/EncodingGstreamerPipeline.h>
+#include <ait/video/DepthQuantization.h>
+#include <ait/video/DepthCodec.h>
 
 namespace ait
 {
@@ -71,8 +73,17 @@ namespace ait
 				return pipeline_;
 			}
 
-			void setUseCompression(bool use_compression) {
-				use_compression_ = use_compression;
+			//! Sends a losslessly compressed 16 bit depth frame (millimeters) with every frame (in addition to the encoded video).
+			//! The codec is not negotiated: it is announced to the server with a separate packet after the frame parameters
+			//! and the depth frames follow without waiting for a reply. Only use a codec if the server understands the
+			//! announcement, otherwise it loses track of the stream (nothing is sent without a codec).
+			//! Has to be set before the pipeline is started.
+			void setAnnouncedDepthCodec(DepthCodecType depth_codec_type) {
+				depth_codec_ = createDepthCodec(depth_codec_type);
+			}
+
+			DepthCodecType getDepthCodecType() const {
+				return depth_codec_ ? depth_codec_->getType() : DepthCodecType::NONE;
 			}
 
 			void stateChangeCallback(GstState old_state, GstState new_state, GstState pending_state) {
@@ -125,9 +136,14 @@ namespace ait
 
                 StereoFrameInfo frame_info;
                 frame_info.timestamp = timestamp;
-                const cv::Mat& merged_frame = processFrames(left_frame, right_frame, depth_frame, frame_info);
-
-                return pipeline_.pushInput(merged_frame, std::make_tuple(frame_info, location_info));
+                processFrames(left_frame, right_frame, depth_frame, frame_info);
+
+                // The frames are copied row by row into the pipeline buffer instead of merging them first
+                input_frames_.resize(3);
+                input_frames_[0] = left_frame;
+                input_frames_[1] = right_frame;
+                input_frames_[2] = depth_frame_rgba_;
+                return pipeline_.pushInputConcatenated(input_frames_, std::make_tuple(std::move(frame_info), location_info));
             }
 
 		protected:
@@ -184,6 +200,11 @@ namespace ait
 										GstCapsWrapper output_caps = pipeline_.getOutputCaps();
 										std::cout << "Sending Gstreamer Caps: " << output_caps.getString() << std::endl;
 										stereo_sensor_client_.sendGstreamerParameters(std::move(pipeline_.getOutputCaps()), user_parameters_);
+										if (depth_codec_) {
+											StereoDepthCodecParameters depth_codec_parameters;
+											depth_codec_parameters.depth_codec = getDepthCodecType();
+											stereo_sensor_client_.sendDepthCodecParameters(depth_codec_parameters);
+										}
 										outputCapsSent = true;
 									}
 
@@ -191,7 +212,7 @@ namespace ait
 									double rate;
 									unsigned int frame_count = frame_rate_counter.getCount();
 									byte_counter += sizeof(StereoPacketHeader) + sizeof(GstreamerBufferInfo) + sizeof(StereoFrameInfo) + sizeof(StereoFrameLocationInfo)
-										+ frame_info.validation_pixel_values.size() + buffer.getSize();
+										+ frame_info.validation_pixel_values.size() + frame_info.encoded_depth.size() + buffer.getSize();
 									if (frame_rate_counter.reportRate(rate)) {
 										double bandwidth = rate * byte_counter / static_cast<double>(frame_count) / 1024.0;
 										byte_counter = 0;
@@ -226,14 +247,24 @@ namespace ait
 				std::cout << "Exiting pipeline output thread" << std::endl;
 			}
 
-            virtual const cv::Mat processFrames(
+            //! Converts the depth frame to RGBA (stored in depth_frame_rgba_) and fills in the frame info.
+            virtual void processFrames(
                     const cv::Mat& left_frame, const cv::Mat& right_frame, const cv::Mat& depth_frame,
                     StereoFrameInfo& frame_info) {
 //                std::cout << "Converting depth frame to RGBA" << std::endl;
-                const cv::Mat& depth_frame_rgba = convertDepthFrameFloatToRGBA(depth_frame, frame_info, inverse_depth_);
-//                std::cout << "Merging left, right and depth frame to single stereo frame" << std::endl;
-                const cv::Mat& merged_frame = mergeStereoDepthFrames(left_frame, right_frame, depth_frame_rgba);
-                AIT_ASSERT(merged_frame.isContinuous());
+                convertDepthFrameFloatToRGBA(depth_frame, depth_frame_rgba_, frame_info, inverse_depth_);
+                const cv::Mat& depth_frame_rgba = depth_frame_rgba_;
+                checkStereoDepthFrames(left_frame, right_frame, depth_frame_rgba);
+
+                frame_info.depth_codec = getDepthCodecType();
+                if (depth_codec_) {
+                    convertDepthFrameFloatToUint16(depth_frame, depth_frame_uint16_);
+                    // The frame info is handed to the pipeline so the encoder works on a buffer of maximum size that is
+                    // reused and only the encoded bytes are copied
+                    encodeDepthFrame(*depth_codec_, depth_frame_uint16_.ptr<uint16_t>(), depth_frame_uint16_.cols, depth_frame_uint16_.rows,
+                        encoded_depth_buffer_);
+                    frame_info.encoded_depth.assign(encoded_depth_buffer_.begin(), encoded_depth_buffer_.end());
+                }
 
 #if DEBUG_IMAGE_COMPRESSION
                 frame_info.width = left_frame.cols;
@@ -271,101 +302,57 @@ namespace ait
                     }
                     frame_info.validation_pixel_values[i] = value;
                 }
-
-                return merged_frame;
             }
 
-			const cv::Mat& convertDepthFrameFloatToUint16(const cv::Mat& depth_frame)
+			//! Convert float depth to uint16_t depth (scaled by 1000, i.e. millimeters). Invalid depth is mapped to 0.
+			//! Reentrant as long as each caller provides its own output frame.
+			void convertDepthFrameFloatToUint16(const cv::Mat& depth_frame, cv::Mat& depth_frame_uint16) const
 			{
-				// Convert float to uint16_t depth image (scaled by 1000)
-				static cv::Mat depth_frame_uint16;
-				if (depth_frame_uint16.empty()
-					|| depth_frame_uint16.rows != depth_frame.rows
-					|| depth_frame_uint16.cols != depth_frame.cols) {
-					depth_frame_uint16 = cv::Mat(depth_frame.rows, depth_frame.cols, CV_16S);
-				}
+				AIT_ASSERT(depth_frame.type() == CV_32FC1);
+				AIT_ASSERT(depth_frame.isContinuous());
+				depth_frame_uint16.create(depth_frame.rows, depth_frame.cols, CV_16UC1);
+				AIT_ASSERT(depth_frame_uint16.isContinuous());
+				const float* depth = depth_frame.ptr<float>();
+				uint16_t* depth_uint16 = depth_frame_uint16.ptr<uint16_t>();
+				const int num_pixels = static_cast<int>(depth_frame.total());
 #pragma omp parallel for
-				for (int i = 0; i < depth_frame.rows * depth_frame.cols; ++i) {
-					float depth = depth_frame.at<float>(i);
-					if (std::isfinite(depth)) {
-						depth_frame_uint16.at<uint16_t>(i) = static_cast<uint16_t>(depth * 1000);
+				for (int i = 0; i < num_pixels; ++i) {
+					if (std::isfinite(depth[i]) && depth[i] >= trunc_depth_min_ && depth[i] <= trunc_depth_max_) {
+						depth_uint16[i] = static_cast<uint16_t>(std::min(std::round(depth[i] * 1000), 65535.0f));
 					}
 					else {
-						depth_frame_uint16.at<uint16_t>(i) = 0.0;
+						depth_uint16[i] = 0;
 					}
 				}
-				return depth_frame_uint16;
 			}
 
-			const cv::Mat& convertDepthFrameFloatToRGBA(const cv::Mat& depth_frame, StereoFrameInfo& frame_info, bool inverse_depth = true)
+			//! Quantize depth to 8 bit (replicated into RGBA) and store the quantization range in the frame info.
+			//! Reentrant as long as each caller provides its own output frame.
+			void convertDepthFrameFloatToRGBA(const cv::Mat& depth_frame, cv::Mat& depth_frame_rgba, StereoFrameInfo& frame_info, bool inverse_depth = true) const
 			{
-                const uint8_t trunc_thres = DEPTH_UINT8_TRUNCATION_THRESHOLD;
-				// Convert float to uint16_t depth image (scaled by 1000)
-				static cv::Mat depth_frame_rgba;
-				if (depth_frame_rgba.empty()
-					|| depth_frame_rgba.rows != depth_frame.rows
-					|| depth_frame_rgba.cols != depth_frame.cols) {
-					depth_frame_rgba = cv::Mat(depth_frame.rows, depth_frame.cols, CV_8UC4);
-				}
-				float min_depth = std::numeric_limits<float>::infinity();
-				float max_depth = 0;
-#pragma omp parallel for
-				for (int i = 0; i < depth_frame.rows * depth_frame.cols; ++i) {
-					float depth = depth_frame.at<float>(i);
-					if (std::isfinite(depth) && depth >= trunc_depth_min_ && depth <= trunc_depth_max_) {
-						if (depth < min_depth) {
-							min_depth = depth;
-						}
-						if (depth > max_depth) {
-							max_depth = depth;
-						}
-					}
-				}
-				frame_info.min_depth = min_depth;
-				frame_info.max_depth = max_depth;
-				frame_info.truncation_threshold = trunc_thres;
+				AIT_ASSERT(depth_frame.type() == CV_32FC1);
+				AIT_ASSERT(depth_frame.isContinuous());
+				depth_frame_rgba.create(depth_frame.rows, depth_frame.cols, CV_8UC4);
+				AIT_ASSERT(depth_frame_rgba.isContinuous());
+
+				DepthQuantizationParameters parameters;
+				parameters.trunc_depth_min = trunc_depth_min_;
+				parameters.trunc_depth_max = trunc_depth_max_;
+				parameters.truncation_threshold = DEPTH_UINT8_TRUNCATION_THRESHOLD;
+				parameters.inverse_depth = inverse_depth;
+				const size_t num_pixels = depth_frame.total();
+				const float* depth = depth_frame.ptr<float>();
+				const DepthRange range = computeDepthRange(depth, num_pixels, parameters);
+				quantizeDepthToRGBA(depth, num_pixels, range, parameters, depth_frame_rgba.ptr<uint32_t>());
+
+				frame_info.min_depth = range.min_depth;
+				frame_info.max_depth = range.max_depth;
+				frame_info.truncation_threshold = parameters.truncation_threshold;
 				frame_info.inverse_depth = inverse_depth;
-				float max_inv_depth = 1 / min_depth;
-				float min_inv_depth = 1 / max_depth;
-				const auto& convertInvDepthFloatToUint8 = [&](float inv_depth) { return trunc_thres + static_cast<uint8_t>(std::round((255 - trunc_thres) * (inv_depth - min_inv_depth) / (max_inv_depth - min_inv_depth))); };
-				const auto& convertDepthFloatToUint8 = [&](float depth) { return trunc_thres + static_cast<uint8_t>(std::round((255 - trunc_thres) * (depth - min_depth) / (max_depth - min_depth))); };
-				const auto& convertUint8ToInvDepthFloat = [&](uint8_t value) { return (value - trunc_thres) * (max_inv_depth - min_inv_depth) / (255.0f - trunc_thres) + min_inv_depth; };
-				const auto& convertUint8ToDepthFloat = [&](uint8_t value) { return (value - trunc_thres) * (max_depth - min_depth) / (255.0f - trunc_thres) + min_depth; };
-
-				float max_conv_error = 0;
-#pragma omp parallel for
-				for (int i = 0; i < depth_frame.rows * depth_frame.cols; ++i) {
-					float depth = depth_frame.at<float>(i);
-					uint8_t value;
-					if (std::isfinite(depth) && depth >= trunc_depth_min_ && depth <= trunc_depth_max_) {
-						// Debugging: Compute maximum depth error due to conversion
-						float depth_conv;
-						if (inverse_depth) {
-							value = convertInvDepthFloatToUint8(1.0f / depth);
-							depth_conv = 1.0f / convertUint8ToInvDepthFloat(value);
-						}
-						else {
-							value = convertDepthFloatToUint8(depth);
-							depth_conv = convertUint8ToDepthFloat(value);
-						}
-						AIT_ASSERT(value >= trunc_thres && value <= 255);
-						float conv_error = std::abs(depth - depth_conv);
-						if (conv_error > max_conv_error) {
-							max_conv_error = conv_error;
-						}
-					}
-					else {
-						value = 0;
-					}
-					depth_frame_rgba.at<cv::Vec4b>(i) = { value, value, value, value };
-				}
-				std::cout << "Maximum conversion error: " << max_conv_error << std::endl;
-				return depth_frame_rgba;
 			}
 
-			const cv::Mat& mergeStereoDepthFrames(const cv::Mat& left_frame, const cv::Mat& right_frame, const cv::Mat& depth_frame)
+			void checkStereoDepthFrames(const cv::Mat& left_frame, const cv::Mat& right_frame, const cv::Mat& depth_frame) const
 			{
-				static cv::Mat merged_frame;
 				// Make sure all frames have the same size and type
 				if (left_frame.rows != right_frame.rows || left_frame.rows != depth_frame.rows)
 				{
@@ -379,26 +366,6 @@ namespace ait
 				{
 					throw std::runtime_error("Stereo and depth frames do not have the same type");
 				}
-				int total_rows = left_frame.rows;
-				int total_cols = left_frame.cols + right_frame.cols + depth_frame.cols;
-				if (merged_frame.empty()
-					|| merged_frame.rows != total_rows
-					|| merged_frame.cols != total_cols
-					|| merged_frame.type() != left_frame.type())
-				{
-					merged_frame = cv::Mat(total_rows, total_cols, left_frame.type());
-					AIT_ASSERT(merged_frame.isContinuous());
-				}
-#pragma omp parallel sections
-				{
-					{ left_frame.copyTo(merged_frame.colRange(cv::Range(0, left_frame.cols))); }
-#pragma omp section
-					{ right_frame.copyTo(merged_frame.colRange(cv::Range(left_frame.cols, left_frame.cols + depth_frame.cols))); }
-#pragma omp section
-					{ depth_frame.copyTo(merged_frame.colRange(cv::Range(left_frame.cols + depth_frame.cols, total_cols))); }
-				}
-
-				return merged_frame;
 			}
 
 			void initializeValidationPixelLocations() {
@@ -446,11 +413,16 @@ namespace ait
 			float trunc_depth_min_;
 			float trunc_depth_max_;
 			bool inverse_depth_;
+			// Output buffers of the frame processing (reused for every frame)
+			cv::Mat depth_frame_rgba_;
+			cv::Mat depth_frame_uint16_;
+			std::vector<uint8_t> encoded_depth_buffer_;
+			std::vector<cv::Mat> input_frames_;
 
 			std::thread pipeline_output_thread_;
 			StereoNetworkSensorClient<TNetworkClient, PipelineUserDataType, StereoFrameParameters> stereo_sensor_client_;
 
-			bool use_compression_;
+			std::unique_ptr<DepthCodec> depth_codec_;
 		};
 
 	}
@@ -2,9 +2,12 @@
 
 #include <iostream>
 #include <cstdint>
+#include <limits>
+#include <stdexcept>
 #include <vector>
 #include <Eigen/Dense>
 #include <ait/serializable.h>
+#include <ait/video/DepthCodec.h>
 
 #include <gst/gst.h>
 
@@ -26,6 +29,10 @@ enum class StereoPacketType
 
 	CLIENT_2_SERVER_GSTREAMER_PARAMETERS = 512 + 1,
 	CLIENT_2_SERVER_GSTREAMER_FRAME = 512 + 2,
+	// Only sent (after the Gstreamer parameters) if the frames carry a lossless depth frame.
+	// One-way announcement without a reply from the server, so it must only be sent to servers that know this packet.
+	// Without a depth codec the stream is the same as for servers that do not know this packet.
+	CLIENT_2_SERVER_DEPTH_CODEC = 512 + 3,
 };
 
 struct StereoPacketHeader
@@ -139,6 +146,23 @@ struct StereoFrameParameters : public Serializable<StereoFrameParameters>
 	}
 };
 
+struct StereoDepthCodecParameters : public Serializable<StereoDepthCodecParameters>
+{
+	~StereoDepthCodecParameters() override {
+	};
+
+	// Codec of the lossless depth frame that is appended to each frame info
+	ait::video::DepthCodecType depth_codec = ait::video::DepthCodecType::NONE;
+
+	size_t _write(Writer& writer) const override {
+		return writer.write(depth_codec);
+	}
+
+	size_t _read(Reader& reader) override {
+		return reader.read(depth_codec);
+	}
+};
+
 struct StereoFrameInfo : public Serializable<StereoFrameInfo>
 {
 	~StereoFrameInfo() override {
@@ -150,6 +174,12 @@ struct StereoFrameInfo : public Serializable<StereoFrameInfo>
 	float min_depth;
 	float max_depth;
 	std::vector<uint8_t> validation_pixel_values;
+	// Not serialized. Has to be set to the announced codec (StereoDepthCodecParameters) before reading or writing.
+	ait::video::DepthCodecType depth_codec = ait::video::DepthCodecType::NONE;
+	// Lossless depth frame in millimeters (see DepthCodec.h). Only serialized if a depth codec is used.
+	std::vector<uint8_t> encoded_depth;
+	// Not serialized. Larger encoded depth frames are rejected when reading (see getMaxEncodedDepthFrameSize()).
+	size_t max_encoded_depth_size = std::numeric_limits<size_t>::max();
 #if DEBUG_IMAGE_COMPRESSION
 	unsigned int width;
 	unsigned int height;
@@ -166,6 +196,11 @@ struct StereoFrameInfo : public Serializable<StereoFrameInfo>
 		written += writer.write(min_depth);
 		written += writer.write(max_depth);
 		written += writer.write(validation_pixel_values);
+		if (depth_codec != ait::video::DepthCodecType::NONE) {
+			// Same format as writing the vector but with a single write call
+			written += writer.write(encoded_depth.size());
+			written += writer._write(encoded_depth.data(), encoded_depth.size());
+		}
 #if DEBUG_IMAGE_COMPRESSION
 		written += writer.write(width);
 		written += writer.write(height);
@@ -178,13 +213,22 @@ struct StereoFrameInfo : public Serializable<StereoFrameInfo>
 
 	size_t _read(Reader& reader) override {
 		size_t bytes_read = 0;
+		bytes_read += reader.read(timestamp);
 		bytes_read += reader.read(truncation_threshold);
 		bytes_read += reader.read(inverse_depth);
 		bytes_read += reader.read(min_depth);
 		bytes_read += reader.read(max_depth);
 		bytes_read += reader.read(validation_pixel_values);
+		if (depth_codec != ait::video::DepthCodecType::NONE) {
+			size_t encoded_depth_size;
+			bytes_read += reader.read(encoded_depth_size);
+			if (encoded_depth_size > max_encoded_depth_size) {
+				throw std::runtime_error("Encoded depth frame is larger than possible for the frame size");
+			}
+			encoded_depth.resize(encoded_depth_size);
+			bytes_read += reader._read(encoded_depth.data(), encoded_depth.size());
+		}
 #if DEBUG_IMAGE_COMPRESSION
-		bytes_read += reader.read(timestamp);
 		bytes_read += reader.read(width);
 		bytes_read += reader.read(height);
 		bytes_read += reader.read(left_frame);
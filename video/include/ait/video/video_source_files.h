@@ -0,0 +1,113 @@
+//==================================================
+// video_source_files.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+#pragma once
+
+#include <chrono>
+#include <limits>
+#include <vector>
+#include <ait/video/video_source.h>
+
+namespace ait
+{
+namespace video
+{
+
+// Replays a recorded stereo and depth sequence from image files.
+//
+// The files are given as printf-style patterns with the frame index (i.e. "left_%06d.png").
+// Color frames are returned as BGRA. Depth frames can be stored as float images (i.e. EXR) or as 16 bit images
+// in millimeters. As for the ZED camera retrieveDepth() returns a normalized BGRA image for display and
+// retrieveDepthFloat() returns the depth as float in meters.
+// Frames are replayed with a target rate or as fast as possible (rate <= 0).
+class VideoSourceFiles : public VideoSource
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr size_t INVALID_FRAME_INDEX = std::numeric_limits<size_t>::max();
+
+  enum class GrabResult
+  {
+    FRAME,
+    //! The next frame is not due yet (only if grabbing does not block)
+    NOT_DUE,
+    END_OF_SEQUENCE,
+  };
+
+  VideoSourceFiles();
+  virtual ~VideoSourceFiles() override;
+
+  //! Opens a sequence starting at the first index. The sequence ends at the first missing left frame.
+  void open(const std::string &left_pattern, const std::string &right_pattern, const std::string &depth_pattern,
+    int first_index=0);
+  void close();
+
+  //! Loads all frames into memory so that disk access does not influence the replay rate.
+  void preload();
+
+  double getFPS() const;
+  //! Replay rate. A rate <= 0 replays the frames as fast as possible.
+  void setFPS(double fps);
+  //! Restart at the first frame after the last frame
+  void setLoop(bool loop);
+
+  size_t getNumFrames() const;
+  //! Index of the currently grabbed frame in the sequence (INVALID_FRAME_INDEX if no frame was grabbed yet).
+  //! When looping the index restarts at 0 after the last frame, so it is not a count of grabbed frames.
+  size_t getFrameIndex() const;
+
+  bool has_depth() const override;
+  bool has_stereo() const override;
+
+  int getWidth() const override;
+  int getHeight() const override;
+
+  //! Returns false if no new frame was grabbed. Blocks until the next frame is due (if block is true).
+  bool grab(bool block=true) override;
+  //! Same as grab() but tells apart the end of the sequence from a frame that is not due yet.
+  GrabResult tryGrab(bool block=true);
+  bool retrieveMono(cv::Mat *mat) override;
+  bool retrieveLeft(cv::Mat *mat) override;
+  bool retrieveRight(cv::Mat *mat) override;
+  bool retrieveDepth(cv::Mat *mat) override;
+  bool retrieveDepthFloat(cv::Mat *mat);
+
+private:
+  struct Frame
+  {
+    cv::Mat left;
+    cv::Mat right;
+    cv::Mat depth;
+  };
+
+  void ensureOpened() const;
+  std::string getFilename(const std::string &pattern, int index) const;
+  Frame loadFrame(size_t frame_index) const;
+
+  std::string left_pattern_;
+  std::string right_pattern_;
+  std::string depth_pattern_;
+  int first_index_;
+  size_t num_frames_;
+  int width_;
+  int height_;
+
+  double fps_;
+  bool loop_;
+  // Index of the next frame to grab
+  size_t next_frame_index_;
+  bool grabbed_;
+  clock::time_point next_frame_time_;
+
+  std::vector<Frame> preloaded_frames_;
+  Frame frame_;
+};
+
+}  // namespace video
+}  // namespace ait
@@ -0,0 +1,160 @@
+//==================================================
+// depth_codec_benchmark.cpp
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+// Compression ratio and encode/decode throughput (MB/s of raw 16 bit depth) of the lossless depth codecs.
+// Depth frames are read from image files (16 bit in millimeters or 32 bit float in meters).
+// Without any files a synthetic depth frame is used.
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include <tclap/CmdLine.h>
+#include <opencv2/opencv.hpp>
+#include <ait/video/DepthCodec.h>
+
+using namespace ait::video;
+
+namespace {
+
+using BenchmarkClock = std::chrono::steady_clock;
+
+cv::Mat loadDepthFrame(const std::string& filename) {
+	cv::Mat image = cv::imread(filename, cv::IMREAD_ANYDEPTH);
+	if (image.empty()) {
+		throw std::runtime_error("Unable to read depth frame " + filename);
+	}
+	if (image.type() == CV_16UC1) {
+		return image;
+	}
+	else if (image.type() == CV_32FC1) {
+		cv::Mat depth_frame(image.rows, image.cols, CV_16UC1);
+		for (int i = 0; i < static_cast<int>(image.total()); ++i) {
+			const float depth = image.at<float>(i);
+			depth_frame.at<uint16_t>(i) = std::isfinite(depth) ? static_cast<uint16_t>(std::min(std::round(depth * 1000), 65535.0f)) : 0;
+		}
+		return depth_frame;
+	}
+	throw std::runtime_error("Unsupported depth frame type: " + filename);
+}
+
+// Slanted planes with sensor noise and invalid regions
+cv::Mat generateDepthFrame(const int width, const int height) {
+	std::mt19937 rng(0);
+	std::normal_distribution<float> noise_dist(0, 2);
+	cv::Mat depth_frame(height, width, CV_16UC1);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			float depth = x < width / 2 ? 1500 + 2.0f * x + 0.5f * y : 4000 - 1.5f * y;
+			if ((x / 64 + y / 64) % 7 == 0) {
+				depth = 0;
+			}
+			else {
+				depth += noise_dist(rng);
+			}
+			depth_frame.at<uint16_t>(y, x) = static_cast<uint16_t>(std::max(depth, 0.0f));
+		}
+	}
+	return depth_frame;
+}
+
+void runBenchmark(const DepthCodec& codec, const std::vector<cv::Mat>& depth_frames, const size_t num_iterations,
+	const size_t tile_rows, const int num_threads) {
+	omp_set_num_threads(num_threads);
+	std::vector<std::vector<uint8_t>> encoded_frames(depth_frames.size());
+	size_t raw_size = 0;
+	size_t encoded_size = 0;
+
+	const BenchmarkClock::time_point encode_start_time = BenchmarkClock::now();
+	for (size_t iteration = 0; iteration < num_iterations; ++iteration) {
+		for (size_t i = 0; i < depth_frames.size(); ++i) {
+			const cv::Mat& depth_frame = depth_frames[i];
+			encodeDepthFrame(codec, depth_frame.ptr<uint16_t>(), depth_frame.cols, depth_frame.rows, encoded_frames[i], tile_rows);
+			raw_size += depth_frame.total() * depth_frame.elemSize();
+			encoded_size += encoded_frames[i].size();
+		}
+	}
+	const double encode_seconds = std::chrono::duration<double>(BenchmarkClock::now() - encode_start_time).count();
+
+	std::vector<cv::Mat> decoded_frames;
+	for (const cv::Mat& depth_frame : depth_frames) {
+		decoded_frames.push_back(cv::Mat(depth_frame.rows, depth_frame.cols, CV_16UC1));
+	}
+	const BenchmarkClock::time_point decode_start_time = BenchmarkClock::now();
+	for (size_t iteration = 0; iteration < num_iterations; ++iteration) {
+		for (size_t i = 0; i < depth_frames.size(); ++i) {
+			decodeDepthFrame(codec, encoded_frames[i].data(), encoded_frames[i].size(), decoded_frames[i].ptr<uint16_t>());
+		}
+	}
+	const double decode_seconds = std::chrono::duration<double>(BenchmarkClock::now() - decode_start_time).count();
+
+	bool lossless = true;
+	for (size_t i = 0; i < depth_frames.size(); ++i) {
+		if (cv::countNonZero(depth_frames[i] != decoded_frames[i]) > 0) {
+			lossless = false;
+		}
+	}
+
+	std::cout << getDepthCodecName(codec.getType()) << ", " << num_threads << " threads: ratio "
+		<< raw_size / static_cast<double>(encoded_size)
+		<< ", encode " << raw_size / encode_seconds / (1024.0 * 1024.0) << " MB/s"
+		<< ", decode " << raw_size / decode_seconds / (1024.0 * 1024.0) << " MB/s"
+		<< (lossless ? "" : " (DECODED FRAMES DIFFER)") << std::endl;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		TCLAP::CmdLine cmd("Depth codec benchmark", ' ', "0.1");
+		TCLAP::ValueArg<int> width_arg("x", "width", "Width of the synthetic depth frame", false, 1280, "pixels", cmd);
+		TCLAP::ValueArg<int> height_arg("y", "height", "Height of the synthetic depth frame", false, 720, "pixels", cmd);
+		TCLAP::ValueArg<size_t> num_iterations_arg("n", "num-iterations", "Number of times each frame is encoded and decoded", false, 20, "count", cmd);
+		TCLAP::ValueArg<size_t> tile_rows_arg("t", "tile-rows", "Number of rows per tile", false, 32, "rows", cmd);
+		TCLAP::UnlabeledMultiArg<std::string> depth_files_arg("depth-files", "Recorded depth frames (16 bit millimeters or float meters)", false, "filenames", cmd);
+
+		cmd.parse(argc, argv);
+
+		std::vector<cv::Mat> depth_frames;
+		for (const std::string& filename : depth_files_arg.getValue()) {
+			depth_frames.push_back(loadDepthFrame(filename));
+		}
+		if (depth_frames.empty()) {
+			std::cout << "No depth frames given. Using a synthetic depth frame." << std::endl;
+			depth_frames.push_back(generateDepthFrame(width_arg.getValue(), height_arg.getValue()));
+		}
+		const size_t num_iterations = std::max<size_t>(num_iterations_arg.getValue(), 1);
+		const size_t tile_rows = std::max<size_t>(tile_rows_arg.getValue(), 1);
+
+		const int num_threads = omp_get_max_threads();
+		for (DepthCodecType type : { DepthCodecType::SNAPPY, DepthCodecType::DELTA_BITPLANE }) {
+			std::unique_ptr<DepthCodec> codec = createDepthCodec(type);
+			runBenchmark(*codec, depth_frames, num_iterations, tile_rows, 1);
+			runBenchmark(*codec, depth_frames, num_iterations, tile_rows, num_threads);
+		}
+	}
+	catch (TCLAP::ArgException &err)
+	{
+		std::cerr << "Command line error: " << err.error() << " for arg " << err.argId() << std::endl;
+		return 1;
+	}
+	catch (const std::runtime_error& err)
+	{
+		std::cerr << "Error: " << err.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,170 @@
+//==================================================
+// depth_quantization_benchmark.cpp
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+// Throughput (megapixels per second) of the depth to RGBA quantization with one or several concurrent streams.
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+#include <omp.h>
+#include <tclap/CmdLine.h>
+#include <ait/video/DepthQuantization.h>
+
+using namespace ait::video;
+
+namespace {
+
+using BenchmarkClock = std::chrono::steady_clock;
+
+std::vector<float> generateDepthFrame(const size_t num_pixels, const unsigned int seed) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> depth_dist(0.3f, 25.0f);
+	std::uniform_real_distribution<float> invalid_dist(0, 1);
+	std::vector<float> depth_frame(num_pixels);
+	for (size_t i = 0; i < num_pixels; ++i) {
+		const float p = invalid_dist(rng);
+		if (p < 0.05f) {
+			depth_frame[i] = std::numeric_limits<float>::quiet_NaN();
+		}
+		else if (p < 0.1f) {
+			depth_frame[i] = std::numeric_limits<float>::infinity();
+		}
+		else {
+			depth_frame[i] = depth_dist(rng);
+		}
+	}
+	return depth_frame;
+}
+
+// Per-pixel quantization as done before (single-threaded)
+void quantizeDepthToRGBAReference(const std::vector<float>& depth_frame, const DepthQuantizationParameters& parameters, std::vector<uint32_t>& rgba) {
+	const uint8_t trunc_thres = parameters.truncation_threshold;
+	float min_depth = std::numeric_limits<float>::infinity();
+	float max_depth = 0;
+	for (size_t i = 0; i < depth_frame.size(); ++i) {
+		const float depth = depth_frame[i];
+		if (std::isfinite(depth) && depth >= parameters.trunc_depth_min && depth <= parameters.trunc_depth_max) {
+			min_depth = std::min(min_depth, depth);
+			max_depth = std::max(max_depth, depth);
+		}
+	}
+	const float max_inv_depth = 1 / min_depth;
+	const float min_inv_depth = 1 / max_depth;
+	for (size_t i = 0; i < depth_frame.size(); ++i) {
+		const float depth = depth_frame[i];
+		uint8_t value = 0;
+		if (std::isfinite(depth) && depth >= parameters.trunc_depth_min && depth <= parameters.trunc_depth_max) {
+			if (parameters.inverse_depth) {
+				value = trunc_thres + static_cast<uint8_t>(std::round((255 - trunc_thres) * (1 / depth - min_inv_depth) / (max_inv_depth - min_inv_depth)));
+			}
+			else {
+				value = trunc_thres + static_cast<uint8_t>(std::round((255 - trunc_thres) * (depth - min_depth) / (max_depth - min_depth)));
+			}
+		}
+		rgba[i] = value * 0x01010101u;
+	}
+}
+
+double runBenchmark(const std::vector<std::vector<float>>& depth_frames, const DepthQuantizationParameters& parameters,
+	const size_t num_iterations, const size_t num_streams, const int num_threads_per_stream, const bool reference) {
+	const BenchmarkClock::time_point start_time = BenchmarkClock::now();
+	std::vector<std::thread> stream_threads;
+	for (size_t stream = 0; stream < num_streams; ++stream) {
+		stream_threads.emplace_back([&, stream]() {
+			// The number of OpenMP threads is a per-thread setting
+			omp_set_num_threads(num_threads_per_stream);
+			const std::vector<float>& depth_frame = depth_frames[stream % depth_frames.size()];
+			std::vector<uint32_t> rgba(depth_frame.size());
+			for (size_t iteration = 0; iteration < num_iterations; ++iteration) {
+				if (reference) {
+					quantizeDepthToRGBAReference(depth_frame, parameters, rgba);
+				}
+				else {
+					const DepthRange range = computeDepthRange(depth_frame.data(), depth_frame.size(), parameters);
+					quantizeDepthToRGBA(depth_frame.data(), depth_frame.size(), range, parameters, rgba.data());
+				}
+			}
+		});
+	}
+	for (std::thread& thread : stream_threads) {
+		thread.join();
+	}
+	const double duration_seconds = std::chrono::duration<double>(BenchmarkClock::now() - start_time).count();
+	return num_streams * num_iterations * depth_frames.front().size() / duration_seconds / 1e6;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		TCLAP::CmdLine cmd("Depth quantization benchmark", ' ', "0.1");
+		TCLAP::ValueArg<size_t> width_arg("x", "width", "Width of the depth frames", false, 1280, "pixels", cmd);
+		TCLAP::ValueArg<size_t> height_arg("y", "height", "Height of the depth frames", false, 720, "pixels", cmd);
+		TCLAP::ValueArg<size_t> num_iterations_arg("n", "num-iterations", "Number of frames to quantize per stream", false, 200, "count", cmd);
+		TCLAP::ValueArg<size_t> num_streams_arg("s", "num-streams", "Number of concurrently quantized streams", false, 2, "count", cmd);
+		TCLAP::SwitchArg linear_depth_arg("l", "linear-depth", "Quantize depth instead of inverse depth", cmd, false);
+
+		cmd.parse(argc, argv);
+
+		const size_t num_pixels = width_arg.getValue() * height_arg.getValue();
+		const size_t num_iterations = num_iterations_arg.getValue();
+		const size_t num_streams = std::max<size_t>(num_streams_arg.getValue(), 1);
+		DepthQuantizationParameters parameters;
+		parameters.trunc_depth_min = 0.5f;
+		parameters.trunc_depth_max = 20.0f;
+		parameters.inverse_depth = !linear_depth_arg.getValue();
+
+		std::vector<std::vector<float>> depth_frames;
+		for (size_t stream = 0; stream < num_streams; ++stream) {
+			depth_frames.push_back(generateDepthFrame(num_pixels, static_cast<unsigned int>(stream)));
+		}
+
+		// Compare with the reference quantization (values can differ by one due to rounding of the scaled value)
+		std::vector<uint32_t> rgba_reference(num_pixels);
+		std::vector<uint32_t> rgba(num_pixels);
+		quantizeDepthToRGBAReference(depth_frames.front(), parameters, rgba_reference);
+		const DepthRange range = computeDepthRange(depth_frames.front().data(), num_pixels, parameters);
+		quantizeDepthToRGBA(depth_frames.front().data(), num_pixels, range, parameters, rgba.data());
+		int max_difference = 0;
+		size_t num_different_pixels = 0;
+		for (size_t i = 0; i < num_pixels; ++i) {
+			const int difference = std::abs(static_cast<int>(rgba[i] & 0xFF) - static_cast<int>(rgba_reference[i] & 0xFF));
+			max_difference = std::max(max_difference, difference);
+			if (rgba[i] != rgba_reference[i]) {
+				++num_different_pixels;
+			}
+		}
+		std::cout << "Depth range: [" << range.min_depth << ", " << range.max_depth << "]" << std::endl;
+		std::cout << "Pixels different from reference: " << num_different_pixels << " (maximum difference " << max_difference << ")" << std::endl;
+
+		const int num_threads = omp_get_max_threads();
+		const int num_threads_per_stream = std::max(num_threads / static_cast<int>(num_streams), 1);
+		std::cout << "Reference, 1 stream: " << runBenchmark(depth_frames, parameters, num_iterations, 1, 1, true) << " MP/s" << std::endl;
+		std::cout << "Quantization, 1 stream, 1 thread: "
+			<< runBenchmark(depth_frames, parameters, num_iterations, 1, 1, false) << " MP/s" << std::endl;
+		std::cout << "Quantization, 1 stream, " << num_threads << " threads: "
+			<< runBenchmark(depth_frames, parameters, num_iterations, 1, num_threads, false) << " MP/s" << std::endl;
+		std::cout << "Quantization, " << num_streams << " streams, " << num_threads_per_stream << " threads per stream: "
+			<< runBenchmark(depth_frames, parameters, num_iterations, num_streams, num_threads_per_stream, false) << " MP/s" << std::endl;
+	}
+	catch (TCLAP::ArgException &err)
+	{
+		std::cerr << "Command line error: " << err.error() << " for arg " << err.argId() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
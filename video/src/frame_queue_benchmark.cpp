@@ -0,0 +1,192 @@
+//==================================================
+// frame_queue_benchmark.cpp
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+// Latency and throughput of the mutex-protected SPSCFixedQueue (allocating a buffer for every frame)
+// compared to the lock-free SPSCFrameRing (recycling preallocated frames).
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <tclap/CmdLine.h>
+#include <ait/video/GstreamerPipeline.h>
+
+namespace {
+
+using BenchmarkClock = std::chrono::steady_clock;
+
+struct BenchmarkFrame {
+	std::vector<uint8_t> data;
+	BenchmarkClock::time_point push_time;
+	uint64_t index;
+};
+
+struct BenchmarkOptions {
+	size_t num_frames;
+	size_t frame_size;
+	size_t capacity;
+	double frame_rate;
+	bool block;
+};
+
+struct BenchmarkResult {
+	double duration_seconds;
+	size_t num_received_frames;
+	std::vector<double> latencies_us;
+};
+
+void waitForNextFrame(const BenchmarkOptions& options, const BenchmarkClock::time_point start_time, const size_t frame_index) {
+	if (options.frame_rate > 0) {
+		const auto frame_time = start_time + std::chrono::microseconds(static_cast<int64_t>(1e6 * frame_index / options.frame_rate));
+		std::this_thread::sleep_until(frame_time);
+	}
+}
+
+BenchmarkResult runFixedQueueBenchmark(const BenchmarkOptions& options, const std::vector<uint8_t>& source_data) {
+	SPSCFixedQueue<BenchmarkFrame> queue(static_cast<unsigned int>(options.capacity));
+	BenchmarkResult result;
+	std::atomic<bool> producer_done(false);
+	const BenchmarkClock::time_point start_time = BenchmarkClock::now();
+	std::thread producer_thread([&]() {
+		for (size_t i = 0; i < options.num_frames; ++i) {
+			waitForNextFrame(options, start_time, i);
+			// Every frame is a new allocation (as with copying Gstreamer buffers)
+			BenchmarkFrame frame;
+			frame.data.resize(options.frame_size);
+			std::memcpy(frame.data.data(), source_data.data(), options.frame_size);
+			frame.index = i;
+			frame.push_time = BenchmarkClock::now();
+			queue.pushBack(frame, options.block);
+		}
+		producer_done = true;
+	});
+	while (true) {
+		std::unique_lock<std::mutex> lock(queue.getMutex());
+		queue.getQueueFilledCondition().wait_for(lock, std::chrono::milliseconds(100), [&]() { return !queue.empty(); });
+		if (queue.empty()) {
+			if (producer_done) {
+				break;
+			}
+			continue;
+		}
+		BenchmarkFrame frame = queue.popFront(lock);
+		lock.unlock();
+		const BenchmarkClock::time_point pop_time = BenchmarkClock::now();
+		result.latencies_us.push_back(std::chrono::duration<double, std::micro>(pop_time - frame.push_time).count());
+	}
+	producer_thread.join();
+	result.duration_seconds = std::chrono::duration<double>(BenchmarkClock::now() - start_time).count();
+	result.num_received_frames = result.latencies_us.size();
+	return result;
+}
+
+BenchmarkResult runFrameRingBenchmark(const BenchmarkOptions& options, const std::vector<uint8_t>& source_data) {
+	BenchmarkFrame prototype_frame;
+	prototype_frame.data.resize(options.frame_size);
+	prototype_frame.index = 0;
+	const SPSCFrameRing<BenchmarkFrame>::OverflowPolicy overflow_policy = options.block
+		? SPSCFrameRing<BenchmarkFrame>::BLOCK : SPSCFrameRing<BenchmarkFrame>::DROP_OLDEST;
+	SPSCFrameRing<BenchmarkFrame> ring(options.capacity, overflow_policy, prototype_frame);
+	BenchmarkResult result;
+	std::atomic<bool> producer_done(false);
+	const BenchmarkClock::time_point start_time = BenchmarkClock::now();
+	std::thread producer_thread([&]() {
+		for (size_t i = 0; i < options.num_frames; ++i) {
+			waitForNextFrame(options, start_time, i);
+			BenchmarkFrame* frame = ring.acquireWriteFrame();
+			std::memcpy(frame->data.data(), source_data.data(), options.frame_size);
+			frame->index = i;
+			frame->push_time = BenchmarkClock::now();
+			ring.commitWriteFrame();
+		}
+		producer_done = true;
+	});
+	while (true) {
+		const BenchmarkFrame* frame = ring.acquireReadFrame(std::chrono::milliseconds(100));
+		if (frame == nullptr) {
+			if (producer_done && ring.empty()) {
+				break;
+			}
+			continue;
+		}
+		const BenchmarkClock::time_point pop_time = BenchmarkClock::now();
+		result.latencies_us.push_back(std::chrono::duration<double, std::micro>(pop_time - frame->push_time).count());
+		ring.releaseReadFrame();
+	}
+	producer_thread.join();
+	result.duration_seconds = std::chrono::duration<double>(BenchmarkClock::now() - start_time).count();
+	result.num_received_frames = result.latencies_us.size();
+	return result;
+}
+
+void printResult(const std::string& name, const BenchmarkOptions& options, BenchmarkResult result) {
+	std::sort(result.latencies_us.begin(), result.latencies_us.end());
+	double mean_latency = 0;
+	for (const double latency : result.latencies_us) {
+		mean_latency += latency;
+	}
+	auto percentile = [&](const double p) -> double {
+		if (result.latencies_us.empty()) {
+			return 0;
+		}
+		const size_t index = std::min(result.latencies_us.size() - 1, static_cast<size_t>(p * result.latencies_us.size()));
+		return result.latencies_us[index];
+	};
+	if (!result.latencies_us.empty()) {
+		mean_latency /= result.latencies_us.size();
+	}
+	const double frame_rate = result.num_received_frames / result.duration_seconds;
+	std::cout << name << ":" << std::endl;
+	std::cout << "  received " << result.num_received_frames << " of " << options.num_frames << " frames in "
+		<< result.duration_seconds << " s (" << frame_rate << " Hz, "
+		<< frame_rate * options.frame_size / (1024.0 * 1024.0) << " MB/s)" << std::endl;
+	std::cout << "  latency [us]: mean " << mean_latency << ", median " << percentile(0.5)
+		<< ", 99% " << percentile(0.99) << ", max " << percentile(1.0) << std::endl;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		TCLAP::CmdLine cmd("Frame queue benchmark", ' ', "0.1");
+		TCLAP::ValueArg<size_t> num_frames_arg("n", "num-frames", "Number of frames to push", false, 2000, "count", cmd);
+		TCLAP::ValueArg<size_t> frame_size_arg("s", "frame-size", "Size of a frame", false, 2 * 1280 * 720 * 4, "bytes", cmd);
+		TCLAP::ValueArg<size_t> capacity_arg("c", "capacity", "Maximum number of queued frames", false, 5, "count", cmd);
+		TCLAP::ValueArg<double> frame_rate_arg("r", "frame-rate", "Frame rate of the producer (0 for as fast as possible)", false, 0, "Hz", cmd);
+		TCLAP::SwitchArg block_arg("b", "block", "Block the producer if the queue is full (otherwise frames are dropped)", cmd, false);
+
+		cmd.parse(argc, argv);
+
+		BenchmarkOptions options;
+		options.num_frames = num_frames_arg.getValue();
+		options.frame_size = frame_size_arg.getValue();
+		options.capacity = capacity_arg.getValue();
+		options.frame_rate = frame_rate_arg.getValue();
+		options.block = block_arg.getValue();
+
+		std::vector<uint8_t> source_data(options.frame_size);
+		for (size_t i = 0; i < source_data.size(); ++i) {
+			source_data[i] = static_cast<uint8_t>(i);
+		}
+
+		printResult("SPSCFixedQueue", options, runFixedQueueBenchmark(options, source_data));
+		printResult("SPSCFrameRing", options, runFrameRingBenchmark(options, source_data));
+	}
+	catch (TCLAP::ArgException &err)
+	{
+		std::cerr << "Command line error: " << err.error() << " for arg " << err.argId() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
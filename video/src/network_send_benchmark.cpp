@@ -0,0 +1,220 @@
+//==================================================
+// network_send_benchmark.cpp
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+// Frames per second and latency of sending stereo frames over a loopback TCP connection.
+// Compares merging the frames and sending header, infos and payload with separate blocking calls
+// against a reused NetworkMessage that references the frames and is sent with a single gather write.
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <tclap/CmdLine.h>
+#include <ait/BoostNetworkClientTCP.h>
+#include <ait/NetworkMessage.h>
+
+namespace {
+
+using BenchmarkClock = std::chrono::steady_clock;
+using tcp = boost::asio::ip::tcp;
+
+struct BenchmarkFrameHeader {
+	uint64_t frame_index;
+	int64_t send_time_ns;
+	// Number of bytes following the header
+	uint64_t size;
+};
+
+// Stand-in for the Gstreamer buffer info and the frame info
+struct BenchmarkFrameInfo {
+	uint64_t pts;
+	uint64_t dts;
+	uint64_t duration;
+	uint64_t offset;
+	uint64_t offset_end;
+	uint64_t size;
+	double timestamp;
+	float min_depth;
+	float max_depth;
+};
+
+struct BenchmarkFrames {
+	size_t width;
+	size_t height;
+	// RGBA frames
+	std::vector<uint8_t> left;
+	std::vector<uint8_t> right;
+	std::vector<uint8_t> depth;
+	std::vector<uint8_t> validation_pixel_values;
+
+	size_t getPayloadSize() const {
+		return left.size() + right.size() + depth.size();
+	}
+};
+
+struct BenchmarkResult {
+	double frames_per_second;
+	double bandwidth_mb_per_second;
+	std::vector<double> latencies_ms;
+};
+
+BenchmarkFrames generateFrames(const size_t width, const size_t height, const size_t num_validation_pixels) {
+	std::mt19937 rng(0);
+	std::uniform_int_distribution<int> value_dist(0, 255);
+	BenchmarkFrames frames;
+	frames.width = width;
+	frames.height = height;
+	for (std::vector<uint8_t>* frame : { &frames.left, &frames.right, &frames.depth }) {
+		frame->resize(4 * width * height);
+		for (uint8_t& value : *frame) {
+			value = static_cast<uint8_t>(value_dist(rng));
+		}
+	}
+	frames.validation_pixel_values.resize(num_validation_pixels);
+	for (uint8_t& value : frames.validation_pixel_values) {
+		value = static_cast<uint8_t>(value_dist(rng));
+	}
+	return frames;
+}
+
+// Merge the frames horizontally into a single frame (as done before sending)
+void mergeFrames(const BenchmarkFrames& frames, std::vector<uint8_t>& merged) {
+	const size_t row_size = 4 * frames.width;
+	merged.resize(frames.getPayloadSize());
+#pragma omp parallel for
+	for (int row = 0; row < static_cast<int>(frames.height); ++row) {
+		uint8_t* merged_row = merged.data() + 3 * row * row_size;
+		std::copy(frames.left.data() + row * row_size, frames.left.data() + (row + 1) * row_size, merged_row);
+		std::copy(frames.right.data() + row * row_size, frames.right.data() + (row + 1) * row_size, merged_row + row_size);
+		std::copy(frames.depth.data() + row * row_size, frames.depth.data() + (row + 1) * row_size, merged_row + 2 * row_size);
+	}
+}
+
+// Accepts a single connection and records the latency of every received frame
+void receiveFrames(boost::asio::io_service& io_service, tcp::acceptor& acceptor, const size_t num_frames, std::vector<double>& latencies_ms) {
+	tcp::socket socket(io_service);
+	acceptor.accept(socket);
+	std::vector<uint8_t> data;
+	latencies_ms.resize(num_frames);
+	for (size_t i = 0; i < num_frames; ++i) {
+		BenchmarkFrameHeader header;
+		boost::asio::read(socket, boost::asio::buffer(&header, sizeof(header)));
+		data.resize(header.size);
+		boost::asio::read(socket, boost::asio::buffer(data));
+		const int64_t receive_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(BenchmarkClock::now().time_since_epoch()).count();
+		latencies_ms[header.frame_index] = (receive_time_ns - header.send_time_ns) / 1e6;
+	}
+}
+
+BenchmarkResult runBenchmark(const BenchmarkFrames& frames, const size_t num_frames, const bool gather_write) {
+	boost::asio::io_service io_service;
+	tcp::acceptor acceptor(io_service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+	const unsigned short port = acceptor.local_endpoint().port();
+
+	BenchmarkResult result;
+	std::thread receiver_thread([&]() {
+		receiveFrames(io_service, acceptor, num_frames, result.latencies_ms);
+	});
+
+	ait::BoostNetworkClientTCP client;
+	client.open("127.0.0.1", port);
+
+	BenchmarkFrameInfo frame_info;
+	std::memset(&frame_info, 0, sizeof(frame_info));
+	frame_info.size = frames.getPayloadSize();
+	std::vector<uint8_t> merged;
+	ait::NetworkMessage message;
+
+	const BenchmarkClock::time_point start_time = BenchmarkClock::now();
+	for (size_t i = 0; i < num_frames; ++i) {
+		BenchmarkFrameHeader header;
+		header.frame_index = i;
+		header.send_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(BenchmarkClock::now().time_since_epoch()).count();
+		header.size = sizeof(frame_info) + frames.validation_pixel_values.size() + frames.getPayloadSize();
+		frame_info.timestamp = static_cast<double>(i);
+		if (gather_write) {
+			message.clear();
+			message.addValue(header);
+			message.addValue(frame_info);
+			message.addBuffer(frames.validation_pixel_values.data(), frames.validation_pixel_values.size());
+			message.addBuffer(frames.left.data(), frames.left.size());
+			message.addBuffer(frames.right.data(), frames.right.size());
+			message.addBuffer(frames.depth.data(), frames.depth.size());
+			client.sendMessageBlocking(message);
+		}
+		else {
+			mergeFrames(frames, merged);
+			client.sendDataBlocking(header);
+			client.sendDataBlocking(frame_info);
+			client.sendDataBlocking(frames.validation_pixel_values.data(), frames.validation_pixel_values.size());
+			client.sendDataBlocking(merged.data(), merged.size());
+		}
+	}
+	receiver_thread.join();
+	const double duration_seconds = std::chrono::duration<double>(BenchmarkClock::now() - start_time).count();
+	client.close();
+
+	const size_t frame_size = sizeof(BenchmarkFrameHeader) + sizeof(frame_info) + frames.validation_pixel_values.size() + frames.getPayloadSize();
+	result.frames_per_second = num_frames / duration_seconds;
+	result.bandwidth_mb_per_second = num_frames * frame_size / duration_seconds / (1024.0 * 1024.0);
+	return result;
+}
+
+void printResult(const std::string& name, BenchmarkResult result) {
+	std::vector<double>& latencies = result.latencies_ms;
+	std::sort(latencies.begin(), latencies.end());
+	const auto percentile = [&](const double p) {
+		return latencies[std::min(static_cast<size_t>(p * latencies.size()), latencies.size() - 1)];
+	};
+	const double mean = std::accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size();
+	std::cout << name << ": " << result.frames_per_second << " frames/s, " << result.bandwidth_mb_per_second << " MB/s" << std::endl;
+	std::cout << "  Latency: mean " << mean << " ms, median " << percentile(0.5)
+		<< " ms, 99th percentile " << percentile(0.99) << " ms, max " << latencies.back() << " ms" << std::endl;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		TCLAP::CmdLine cmd("Network send benchmark", ' ', "0.1");
+		TCLAP::ValueArg<size_t> width_arg("x", "width", "Width of the stereo and depth frames", false, 1280, "pixels", cmd);
+		TCLAP::ValueArg<size_t> height_arg("y", "height", "Height of the stereo and depth frames", false, 720, "pixels", cmd);
+		TCLAP::ValueArg<size_t> num_frames_arg("n", "num-frames", "Number of frames to send", false, 300, "count", cmd);
+		TCLAP::ValueArg<size_t> num_validation_pixels_arg("v", "num-validation-pixels", "Number of validation pixel values per frame", false, 3000, "count", cmd);
+
+		cmd.parse(argc, argv);
+
+		const size_t num_frames = std::max<size_t>(num_frames_arg.getValue(), 1);
+		const BenchmarkFrames frames = generateFrames(width_arg.getValue(), height_arg.getValue(), num_validation_pixels_arg.getValue());
+		std::cout << "Frame payload: " << frames.getPayloadSize() / 1024.0 << " kB" << std::endl;
+
+		printResult("Merged frame, separate blocking sends", runBenchmark(frames, num_frames, false));
+		printResult("Referenced frames, single gather write", runBenchmark(frames, num_frames, true));
+	}
+	catch (TCLAP::ArgException &err)
+	{
+		std::cerr << "Command line error: " << err.error() << " for arg " << err.argId() << std::endl;
+		return 1;
+	}
+	catch (const ait::BoostNetworkClientTCP::Error& err)
+	{
+		std::cerr << "Network error: " << err.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,217 @@
+//==================================================
+// stereo_streaming_benchmark.cpp
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+// End-to-end benchmark of the stereo streaming pipeline without camera, GPU or BundleFusion server.
+// A recorded stereo and depth sequence is replayed into a StereoNetworkSensorManager (depth quantization,
+// Gstreamer encoding, network client) which streams to a loopback sink implementing the stereo network protocol.
+// Reports throughput, dropped frames and latency percentiles (from grabbing a frame until it is received and decoded).
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+#include <tclap/CmdLine.h>
+
+#include <gst/gst.h>
+
+#include <ait/BoostNetworkClientTCP.h>
+#include <ait/video/video_source_files.h>
+#include <ait/video/StereoNetworkSensorManager.h>
+#include <ait/video/StereoNetworkSensorLoopbackSink.h>
+
+namespace {
+
+using BenchmarkClock = std::chrono::system_clock;
+
+double getTimestamp() {
+	return std::chrono::duration<double>(BenchmarkClock::now().time_since_epoch()).count();
+}
+
+struct BenchmarkStatistics {
+	size_t num_grabbed_frames = 0;
+	size_t num_rejected_frames = 0;
+	size_t num_received_frames = 0;
+	size_t num_received_bytes = 0;
+	// Receive time of the last measured frame
+	double last_receive_time = 0;
+	std::vector<double> latencies_ms;
+};
+
+void printStatistics(BenchmarkStatistics statistics, const double duration_seconds) {
+	std::vector<double>& latencies = statistics.latencies_ms;
+	const size_t num_dropped_frames = statistics.num_grabbed_frames - statistics.num_received_frames;
+	std::cout << "Grabbed frames: " << statistics.num_grabbed_frames << std::endl;
+	std::cout << "Received frames: " << statistics.num_received_frames << std::endl;
+	std::cout << "Dropped frames: " << num_dropped_frames
+		<< " (" << 100.0 * num_dropped_frames / std::max<size_t>(statistics.num_grabbed_frames, 1) << " %, "
+		<< statistics.num_rejected_frames << " rejected at the pipeline input)" << std::endl;
+	std::cout << "Throughput: " << statistics.num_received_frames / duration_seconds << " frames/s, "
+		<< statistics.num_received_bytes / duration_seconds / 1024.0 << " kB/s" << std::endl;
+	if (latencies.empty()) {
+		return;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	const auto percentile = [&](const double p) {
+		return latencies[std::min(static_cast<size_t>(p * latencies.size()), latencies.size() - 1)];
+	};
+	const double mean = std::accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size();
+	std::cout << "Latency: mean " << mean << " ms, min " << latencies.front() << " ms, 50% " << percentile(0.5)
+		<< " ms, 90% " << percentile(0.9) << " ms, 99% " << percentile(0.99) << " ms, max " << latencies.back() << " ms" << std::endl;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	GError* gst_err;
+	gboolean gst_initialized = gst_init_check(&argc, &argv, &gst_err);
+	if (gst_initialized == FALSE) {
+		std::cerr << "ERROR: gst_init_check failed: " << gst_err->message << std::endl;
+		g_error_free(gst_err);
+		return 1;
+	}
+
+	try
+	{
+		TCLAP::CmdLine cmd("Stereo streaming benchmark", ' ', "0.1");
+		TCLAP::ValueArg<std::string> left_arg("l", "left", "Left frame filename pattern (i.e. left_%06d.png)", true, "", "pattern", cmd);
+		TCLAP::ValueArg<std::string> right_arg("r", "right", "Right frame filename pattern", true, "", "pattern", cmd);
+		TCLAP::ValueArg<std::string> depth_arg("d", "depth", "Depth frame filename pattern (16 bit millimeters or float meters)", true, "", "pattern", cmd);
+		TCLAP::ValueArg<int> first_index_arg("", "first-index", "Index of the first frame", false, 0, "index", cmd);
+		TCLAP::ValueArg<double> fps_arg("f", "fps", "Replay rate (0 replays as fast as possible)", false, 15, "Hz", cmd);
+		TCLAP::ValueArg<size_t> num_frames_arg("n", "num-frames", "Number of frames to measure (the sequence is looped)", false, 300, "count", cmd);
+		TCLAP::ValueArg<double> warmup_arg("w", "warmup", "Maximum time to wait for the first frame to arrive at the sink", false, 10, "seconds", cmd);
+		TCLAP::ValueArg<std::string> encoder_branch_arg("e", "encoder-branch", "Encoder branch description", false,
+			"x264enc bitrate=4096 pass=qual quantizer=20 tune=zerolatency speed-preset=ultrafast key-int-max=10", "description", cmd);
+		TCLAP::ValueArg<std::string> depth_codec_arg("c", "announced-depth-codec", "Lossless depth codec announced to the sink (none, snappy, delta-bitplane)", false, "none", "codec", cmd);
+		TCLAP::SwitchArg no_preload_arg("", "no-preload", "Read frames from disk while replaying", cmd, false);
+
+		cmd.parse(argc, argv);
+
+		ait::video::VideoSourceFiles video_source;
+		video_source.open(left_arg.getValue(), right_arg.getValue(), depth_arg.getValue(), first_index_arg.getValue());
+		if (!no_preload_arg.getValue()) {
+			video_source.preload();
+		}
+		video_source.setFPS(fps_arg.getValue());
+		video_source.setLoop(true);
+		std::cout << "Replaying " << video_source.getNumFrames() << " frames of size "
+			<< video_source.getWidth() << "x" << video_source.getHeight() << std::endl;
+
+		BenchmarkStatistics statistics;
+		std::mutex statistics_mutex;
+		double measurement_start_time = std::numeric_limits<double>::infinity();
+		ait::video::StereoNetworkSensorLoopbackSink sink;
+		sink.setFrameCallback([&](const ait::video::StereoNetworkSensorLoopbackSink::ReceivedFrame& frame) {
+			std::lock_guard<std::mutex> lock(statistics_mutex);
+			// Ignore frames from the warmup phase
+			if (frame.frame_info->timestamp >= measurement_start_time) {
+				++statistics.num_received_frames;
+				statistics.num_received_bytes += frame.size;
+				statistics.latencies_ms.push_back(1000 * (frame.receive_time - frame.frame_info->timestamp));
+				statistics.last_receive_time = std::max(statistics.last_receive_time, frame.receive_time);
+			}
+		});
+		sink.start();
+
+		StereoCalibration stereo_sensor_calibration;
+		std::memset(&stereo_sensor_calibration, 0, sizeof(stereo_sensor_calibration));
+		stereo_sensor_calibration.color_image_width_left = video_source.getWidth();
+		stereo_sensor_calibration.color_image_width_right = video_source.getWidth();
+		stereo_sensor_calibration.depth_image_width = video_source.getWidth();
+		stereo_sensor_calibration.color_image_height_left = video_source.getHeight();
+		stereo_sensor_calibration.color_image_height_right = video_source.getHeight();
+		stereo_sensor_calibration.depth_image_height = video_source.getHeight();
+
+		ait::video::StereoNetworkSensorManager<ait::BoostNetworkClientTCP> manager(
+			stereo_sensor_calibration, StereoClientType::CLIENT_ZED, "127.0.0.1", sink.getPort());
+		manager.getPipeline().setEncoderBranchStr(encoder_branch_arg.getValue());
+		manager.getPipeline().setDisplayBranchStr("fakesink");
+		manager.setDepthTruncation(0.5f, 20.0f);
+		manager.setInverseDepth(false);
+		manager.setAnnouncedDepthCodec(ait::video::getDepthCodecType(depth_codec_arg.getValue()));
+		manager.start();
+
+		cv::Mat left_frame, right_frame, depth_frame;
+		const auto push_frame = [&]() {
+			video_source.grab();
+			video_source.retrieveLeft(&left_frame);
+			video_source.retrieveRight(&right_frame);
+			video_source.retrieveDepthFloat(&depth_frame);
+			return manager.pushNewStereoFrame(getTimestamp(), left_frame, right_frame, depth_frame);
+		};
+
+		// Push frames until the pipeline is running and the first frames arrive at the sink
+		std::cout << "Warming up ..." << std::endl;
+		const double warmup_end_time = getTimestamp() + warmup_arg.getValue();
+		while (sink.getNumReceivedFrames() == 0 && getTimestamp() < warmup_end_time) {
+			push_frame();
+			if (fps_arg.getValue() <= 0) {
+				// Do not flood the pipeline before it is playing
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		}
+		if (sink.getNumReceivedFrames() == 0) {
+			std::cerr << "ERROR: No frames arrived at the sink during warmup" << std::endl;
+			return 1;
+		}
+
+		std::cout << "Measuring " << num_frames_arg.getValue() << " frames ..." << std::endl;
+		{
+			std::lock_guard<std::mutex> lock(statistics_mutex);
+			measurement_start_time = getTimestamp();
+		}
+		const double start_time = getTimestamp();
+		size_t num_grabbed_frames = 0;
+		size_t num_rejected_frames = 0;
+		for (size_t i = 0; i < num_frames_arg.getValue(); ++i) {
+			if (!push_frame()) {
+				++num_rejected_frames;
+			}
+			++num_grabbed_frames;
+		}
+		const double push_end_time = getTimestamp();
+
+		// Wait until the frames in flight have arrived
+		size_t num_received_frames = 0;
+		do {
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+			std::lock_guard<std::mutex> lock(statistics_mutex);
+			if (statistics.num_received_frames == num_received_frames) {
+				break;
+			}
+			num_received_frames = statistics.num_received_frames;
+		} while (num_received_frames < num_grabbed_frames - num_rejected_frames);
+		manager.stop();
+		sink.stop();
+
+		std::lock_guard<std::mutex> lock(statistics_mutex);
+		statistics.num_grabbed_frames = num_grabbed_frames;
+		statistics.num_rejected_frames = num_rejected_frames;
+		// Frames that arrive while draining the pipeline count towards the throughput so the drain time has to as well
+		const double end_time = statistics.num_received_frames > 0 ? statistics.last_receive_time : push_end_time;
+		printStatistics(statistics, end_time - start_time);
+	}
+	catch (TCLAP::ArgException &err)
+	{
+		std::cerr << "Command line error: " << err.error() << " for arg " << err.argId() << std::endl;
+		return 1;
+	}
+	catch (const std::runtime_error& err)
+	{
+		std::cerr << "Error: " << err.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
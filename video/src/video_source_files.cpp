@@ -0,0 +1,306 @@
+//==================================================
+// video_source_files.cpp
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+#include <ait/video/video_source_files.h>
+#include <cstdio>
+#include <limits>
+#include <fstream>
+#include <thread>
+
+namespace ait
+{
+namespace video
+{
+
+VideoSourceFiles::VideoSourceFiles()
+: first_index_(0), num_frames_(0), width_(0), height_(0),
+  fps_(0), loop_(false), next_frame_index_(0), grabbed_(false)
+{
+}
+
+VideoSourceFiles::~VideoSourceFiles()
+{
+  close();
+}
+
+void VideoSourceFiles::ensureOpened() const
+{
+  if (num_frames_ == 0)
+  {
+    throw VideoSource::Error("Video source has not been initialized");
+  }
+}
+
+std::string VideoSourceFiles::getFilename(const std::string &pattern, int index) const
+{
+  std::vector<char> filename(pattern.size() + 32);
+  std::snprintf(filename.data(), filename.size(), pattern.c_str(), index);
+  return std::string(filename.data());
+}
+
+void VideoSourceFiles::open(const std::string &left_pattern, const std::string &right_pattern, const std::string &depth_pattern,
+  int first_index)
+{
+  close();
+  left_pattern_ = left_pattern;
+  right_pattern_ = right_pattern;
+  depth_pattern_ = depth_pattern;
+  first_index_ = first_index;
+  size_t num_frames = 0;
+  while (std::ifstream(getFilename(left_pattern_, first_index_ + static_cast<int>(num_frames))).good())
+  {
+    ++num_frames;
+  }
+  if (num_frames == 0)
+  {
+    throw VideoSource::Error("No frames found for pattern " + left_pattern);
+  }
+  num_frames_ = num_frames;
+  const Frame first_frame = loadFrame(0);
+  width_ = first_frame.left.cols;
+  height_ = first_frame.left.rows;
+}
+
+void VideoSourceFiles::close()
+{
+  num_frames_ = 0;
+  next_frame_index_ = 0;
+  grabbed_ = false;
+  preloaded_frames_.clear();
+  frame_ = Frame();
+}
+
+VideoSourceFiles::Frame VideoSourceFiles::loadFrame(size_t frame_index) const
+{
+  const int index = first_index_ + static_cast<int>(frame_index);
+  Frame frame;
+  for (cv::Mat* mat : { &frame.left, &frame.right })
+  {
+    const std::string filename = getFilename(mat == &frame.left ? left_pattern_ : right_pattern_, index);
+    cv::Mat image = cv::imread(filename, cv::IMREAD_UNCHANGED);
+    if (image.empty())
+    {
+      throw VideoSource::Error("Unable to read frame " + filename);
+    }
+    if (image.channels() == 1)
+    {
+      cv::cvtColor(image, *mat, CV_GRAY2BGRA);
+    }
+    else if (image.channels() == 3)
+    {
+      cv::cvtColor(image, *mat, CV_BGR2BGRA);
+    }
+    else
+    {
+      *mat = image;
+    }
+  }
+  const std::string depth_filename = getFilename(depth_pattern_, index);
+  cv::Mat depth = cv::imread(depth_filename, cv::IMREAD_ANYDEPTH);
+  if (depth.empty())
+  {
+    throw VideoSource::Error("Unable to read depth frame " + depth_filename);
+  }
+  if (depth.type() == CV_16UC1)
+  {
+    // Millimeters to meters. Invalid depth (0) is mapped to NaN as for the ZED camera.
+    depth.convertTo(frame.depth, CV_32FC1, 1 / 1000.0);
+    frame.depth.setTo(std::numeric_limits<float>::quiet_NaN(), depth == 0);
+  }
+  else if (depth.type() == CV_32FC1)
+  {
+    frame.depth = depth;
+  }
+  else
+  {
+    throw VideoSource::Error("Unsupported depth frame type: " + depth_filename);
+  }
+  if (frame.right.size() != frame.left.size() || frame.depth.size() != frame.left.size())
+  {
+    throw VideoSource::Error("Stereo and depth frames do not have the same size");
+  }
+  return frame;
+}
+
+void VideoSourceFiles::preload()
+{
+  ensureOpened();
+  preloaded_frames_.resize(num_frames_);
+  for (size_t i = 0; i < num_frames_; ++i)
+  {
+    preloaded_frames_[i] = loadFrame(i);
+  }
+}
+
+double VideoSourceFiles::getFPS() const
+{
+  return fps_;
+}
+
+void VideoSourceFiles::setFPS(double fps)
+{
+  fps_ = fps;
+}
+
+void VideoSourceFiles::setLoop(bool loop)
+{
+  loop_ = loop;
+}
+
+size_t VideoSourceFiles::getNumFrames() const
+{
+  return num_frames_;
+}
+
+size_t VideoSourceFiles::getFrameIndex() const
+{
+  if (!grabbed_)
+  {
+    return INVALID_FRAME_INDEX;
+  }
+  return next_frame_index_ - 1;
+}
+
+bool VideoSourceFiles::has_depth() const
+{
+  return true;
+}
+
+bool VideoSourceFiles::has_stereo() const
+{
+  return true;
+}
+
+int VideoSourceFiles::getWidth() const
+{
+  ensureOpened();
+  return width_;
+}
+
+int VideoSourceFiles::getHeight() const
+{
+  ensureOpened();
+  return height_;
+}
+
+bool VideoSourceFiles::grab(bool block)
+{
+  return tryGrab(block) == GrabResult::FRAME;
+}
+
+VideoSourceFiles::GrabResult VideoSourceFiles::tryGrab(bool block)
+{
+  ensureOpened();
+  if (next_frame_index_ >= num_frames_)
+  {
+    if (!loop_)
+    {
+      return GrabResult::END_OF_SEQUENCE;
+    }
+    next_frame_index_ = 0;
+  }
+  if (fps_ > 0)
+  {
+    const clock::duration period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1 / fps_));
+    const clock::time_point now = clock::now();
+    if (!grabbed_)
+    {
+      next_frame_time_ = now;
+    }
+    else if (now < next_frame_time_)
+    {
+      if (!block)
+      {
+        return GrabResult::NOT_DUE;
+      }
+      std::this_thread::sleep_until(next_frame_time_);
+    }
+    else if (now - next_frame_time_ > period)
+    {
+      // The consumer is too slow. Do not try to catch up with a burst of frames.
+      next_frame_time_ = now;
+    }
+    next_frame_time_ += period;
+  }
+  if (preloaded_frames_.empty())
+  {
+    frame_ = loadFrame(next_frame_index_);
+  }
+  else
+  {
+    frame_ = preloaded_frames_[next_frame_index_];
+  }
+  ++next_frame_index_;
+  grabbed_ = true;
+  return GrabResult::FRAME;
+}
+
+bool VideoSourceFiles::retrieveMono(cv::Mat *mat)
+{
+  return retrieveLeft(mat);
+}
+
+bool VideoSourceFiles::retrieveLeft(cv::Mat *mat)
+{
+  if (!grabbed_)
+  {
+    return false;
+  }
+  *mat = frame_.left;
+  return true;
+}
+
+bool VideoSourceFiles::retrieveRight(cv::Mat *mat)
+{
+  if (!grabbed_)
+  {
+    return false;
+  }
+  *mat = frame_.right;
+  return true;
+}
+
+bool VideoSourceFiles::retrieveDepth(cv::Mat *mat)
+{
+  if (!grabbed_)
+  {
+    return false;
+  }
+  // Normalize the valid depth values of the frame to 8 bit. Nearer depth is brighter and invalid depth is black.
+  const cv::Mat valid_mask = (frame_.depth > 0) & (frame_.depth < std::numeric_limits<float>::infinity());
+  double min_depth = 0;
+  double max_depth = 0;
+  cv::minMaxLoc(frame_.depth, &min_depth, &max_depth, nullptr, nullptr, valid_mask);
+  cv::Mat normalized_depth(frame_.depth.size(), CV_8UC1, cv::Scalar(0));
+  if (max_depth > min_depth)
+  {
+    const double scale = 254 / (max_depth - min_depth);
+    cv::Mat scaled_depth;
+    frame_.depth.convertTo(scaled_depth, CV_8UC1, -scale, 1 + max_depth * scale);
+    scaled_depth.copyTo(normalized_depth, valid_mask);
+  }
+  else
+  {
+    normalized_depth.setTo(255, valid_mask);
+  }
+  cv::cvtColor(normalized_depth, *mat, CV_GRAY2BGRA);
+  return true;
+}
+
+bool VideoSourceFiles::retrieveDepthFloat(cv::Mat *mat)
+{
+  if (!grabbed_)
+  {
+    return false;
+  }
+  *mat = frame_.depth;
+  return true;
+}
+
+}  // namespace video
+}  // namespace ait
@@ -36,11 +36,6 @@
 #include <ait/video/StereoNetworkSensorManager.h>
 #include <ait/video/EncodingGstreamerPipeline.h>
 
-// Test direct depth compression (FastLZ, zlib, Snappy)
-//#include <fastlz/fastlz.h>
-//#include <snappy/snappy.h>
-//#include <zlib.h>
-
 volatile bool g_abort;
 
 void signalHandler(int sig)
@@ -142,7 +137,10 @@ std::pair<bool, boost::program_options::variables_map> process_commandline(int a
     network_options.add_options()
         ("remote-ip", po::value<std::string>()->default_value("127.0.0.1"), "Remote IP address")
         ("remote-port", po::value<int>()->default_value(1337), "Remote port")
-        ("compress", po::bool_switch()->default_value(false), "Use compression")
+        ("compress", po::bool_switch()->default_value(false),
+            "Send a losslessly compressed depth frame with every frame (the server has to support the codec announcement)")
+        ("announced-depth-codec", po::value<std::string>()->default_value("delta-bitplane"),
+            "Lossless depth codec that is announced to the server without negotiation (snappy, delta-bitplane)")
         ;
 
     po::options_description frame_options("Frame options");
@@ -229,6 +227,7 @@ int main(int argc, char** argv)
         bool show = vm["show"].as<bool>();
         bool rotate = vm["rotate"].as<bool>();
         bool use_compression = vm["compress"].as<bool>();
+        std::string depth_codec_name = vm["announced-depth-codec"].as<std::string>();
         std::string remote_ip = vm["remote-ip"].as<std::string>();
         int remote_port = vm["remote-port"].as<int>();
         int zed_mode = vm["mode"].as<int>();
@@ -296,7 +295,9 @@ int main(int argc, char** argv)
         if (vm.count("display-branch")) {
           manager.getPipeline().setDisplayBranchStr(vm["display-branch"].as<std::string>());
         }
-        manager.setUseCompression(use_compression);
+        if (use_compression) {
+            manager.setAnnouncedDepthCodec(ait::video::getDepthCodecType(depth_codec_name));
+        }
         manager.setDepthTruncation(trunc_depth_min, trunc_depth_max);
         manager.setInverseDepth(inverse_depth);
         manager.start();
@@ -350,26 +351,6 @@ int main(int argc, char** argv)
                 }
             }
 
-//            // Test direct depth compression (FastLZ, zlib, Snappy)
-//            using clock = std::chrono::high_resolution_clock;
-//            cv::Mat depth_frame_uint16 = convertDepthFrameFloatToUint16(depth_frame);
-//            if (!prev_depth_frame_uint16.empty()) {
-//                size_t input_size = depth_frame_uint16.rows * depth_frame_uint16.cols * depth_frame_uint16.elemSize();
-//                size_t output_size = static_cast<size_t>(input_size * 1.1);
-////                size_t output_size = snappy::MaxCompressedLength(input_size);
-//                uint8_t* output = new uint8_t[output_size];
-//                auto start_time = clock::now();
-//    //            size_t compressed_size = static_cast<int>(fastlz_compress_level(1, depth_frame_uint16.data, input_size, output));
-//                size_t compressed_size;
-////                snappy::RawCompress((const char*)dframe.data, input_size, (char*)output, &compressed_size);
-//                int level = 5;
-//                compress2((Bytef*)output, &compressed_size, (const Bytef*)depth_frame_uint16.data, input_size, level);
-//                auto stop_time = clock::now();
-//                delete[] output;
-//                auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(stop_time - start_time).count();
-//                std::cout << "Compressed " << input_size/1024. << " kB to " << compressed_size/1024. << " kB in " << dt << " ms" << std::endl;
-//            }
-
             if (manager.pushNewStereoFrame(timestamp, left_frame, right_frame, depth_frame)) {
                 frame_rate_counter.count();
                 double rate;
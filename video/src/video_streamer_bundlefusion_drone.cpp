@@ -263,7 +263,10 @@ std::pair<bool, boost::program_options::variables_map> process_commandline(int a
     network_options.add_options()
         ("remote-ip", po::value<std::string>()->default_value("127.0.0.1"), "Remote IP address")
         ("remote-port", po::value<int>()->default_value(1337), "Remote port")
-        ("compress", po::bool_switch()->default_value(false), "Use compression")
+        ("compress", po::bool_switch()->default_value(false),
+            "Send a losslessly compressed depth frame with every frame (the server has to support the codec announcement)")
+        ("announced-depth-codec", po::value<std::string>()->default_value("delta-bitplane"),
+            "Lossless depth codec that is announced to the server without negotiation (snappy, delta-bitplane)")
         ;
 
     po::options_description frame_options("Frame options");
@@ -345,6 +348,7 @@ int main(int argc, char** argv)
         bool show = vm["show"].as<bool>();
         bool rotate = vm["rotate"].as<bool>();
         bool use_compression = vm["compress"].as<bool>();
+        std::string depth_codec_name = vm["announced-depth-codec"].as<std::string>();
         std::string remote_ip = vm["remote-ip"].as<std::string>();
         int remote_port = vm["remote-port"].as<int>();
         int zed_mode = vm["mode"].as<int>();
@@ -439,7 +443,9 @@ int main(int argc, char** argv)
         if (vm.count("display-branch")) {
           manager.getPipeline().setDisplayBranchStr(vm["display-branch"].as<std::string>());
         }
-        manager.setUseCompression(use_compression);
+        if (use_compression) {
+            manager.setAnnouncedDepthCodec(ait::video::getDepthCodecType(depth_codec_name));
+        }
         manager.setDepthTruncation(trunc_depth_min, trunc_depth_max);
         manager.setInverseDepth(inverse_depth);
         manager.start();
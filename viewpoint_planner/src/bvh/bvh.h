@@ -10,12 +10,22 @@
 #include <iostream>
 #include <algorithm>
 #include <utility>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <stack>
+#include <unordered_map>
+#include <vector>
 #include <boost/serialization/access.hpp>
+#include <boost/serialization/version.hpp>
 #include <boost/iterator_adaptors.hpp>
 #include <bh/common.h>
 #include <bh/eigen.h>
+#include <bh/flat_file.h>
 #include <bh/math/geometry.h>
 #include <bh/utilities.h>
+#include "bvh_ray_packet.h"
 #if WITH_CUDA
   #include <bh/cuda_utils.h>
   #include "bvh.cuh"
@@ -49,7 +59,7 @@ public:
   using BoundingBoxType = BoundingBox3D<FloatType>;
 
   Node()
-  : left_child_(nullptr), right_child_(nullptr), object_(nullptr) {}
+  : left_child_(nullptr), right_child_(nullptr), object_(nullptr), index_(0) {}
 
   ~Node() {}
 
@@ -57,6 +67,11 @@ public:
     return bounding_box_;
   }
 
+  /// Index of the node in the linearized tree (dense and in depth-first order)
+  std::uint32_t getIndex() const {
+    return index_;
+  }
+
   bool hasLeftChild() const {
     return left_child_ != nullptr;
   }
@@ -116,6 +131,22 @@ private:
   Node* right_child_;
 
   ObjectType* object_;
+
+  std::uint32_t index_;
+};
+
+/// Node of the linearized tree (32 bytes for float).
+///
+/// Nodes are stored in depth-first order so that the left child of an inner node is always the next node.
+/// skip_index is the index of the first node after the subtree of a node (i.e. the right child of its parent
+/// if it is a left child). A leaf has skip_index == index + 1.
+/// This allows a stackless traversal: On a hit continue with the next node, otherwise jump to skip_index.
+template <typename FloatType = float>
+struct FlatNode {
+  FloatType bbox_min[3];
+  FloatType bbox_max[3];
+  std::uint32_t skip_index;
+  std::uint32_t depth;
 };
 
 /// A BVH from a list of objects that inherit the BoundingBox3DInterface
@@ -125,7 +156,10 @@ class Tree
 public:
   USE_FIXED_EIGEN_TYPES(FloatType)
   using NodeType = Node<ObjectType, FloatType>;
+  using FlatNodeType = FlatNode<FloatType>;
   using BoundingBoxType = BoundingBox3D<FloatType>;
+  using FlatNodeArrayType = bh::ConstArrayView<FlatNodeType>;
+  using ObjectVectorType = std::vector<ObjectType, Eigen::aligned_allocator<ObjectType>>;
   using RayType = bh::Ray<FloatType>;
   using RayDataType = bh::RayData<FloatType>;
 #if WITH_CUDA
@@ -134,6 +168,9 @@ public:
   using CudaRayType = CudaRay<FloatType>;
 #endif
 
+  /// Object index of nodes without an object (see getFlatObjects())
+  static constexpr std::uint32_t NO_OBJECT_INDEX = std::numeric_limits<std::uint32_t>::max();
+
   class Error : public bh::Error {
   public:
     explicit Error(const std::string& what)
@@ -154,6 +191,12 @@ public:
   };
 #endif
 
+  /// Strategy to split the objects of a node when building the tree
+  enum SplitMethod {
+    SPLIT_MEDIAN,  // Sort along alternating axes and split at the median object
+    SPLIT_BINNED_SAH,  // Binned surface area heuristic (subtrees are built in parallel)
+  };
+
   struct ObjectWithBoundingBox {
     BoundingBoxType bounding_box;
     ObjectType* object;
@@ -305,6 +348,11 @@ public:
     }
     root_ = nullptr;
     nodes_.clear();
+    object_storage_.clear();
+    flat_nodes_ = FlatNodeArrayType();
+    flat_node_storage_.clear();
+    flat_nodes_owner_.reset();
+    flat_node_pointers_.clear();
     depth_ = 0;
     num_leaf_nodes_ = 0;
     stored_as_vector_ = false;
@@ -350,6 +398,38 @@ public:
     return num_leaf_nodes_;
   }
 
+  /// Linearized nodes in depth-first order (used for traversal)
+  const FlatNodeArrayType& getFlatNodes() const {
+    return flat_nodes_;
+  }
+
+  /// Objects of the linearized nodes (i.e. to store the tree in a flat file together with getFlatNodes()).
+  ///
+  /// node_object_indices[i] is the index of the object of node i or NO_OBJECT_INDEX.
+  void getFlatObjects(std::vector<const ObjectType*>* objects, std::vector<std::uint32_t>* node_object_indices) const {
+    objects->clear();
+    node_object_indices->resize(flat_node_pointers_.size());
+    for (std::size_t i = 0; i < flat_node_pointers_.size(); ++i) {
+      const ObjectType* object = flat_node_pointers_[i]->getObject();
+      if (object != nullptr) {
+        (*node_object_indices)[i] = static_cast<std::uint32_t>(objects->size());
+        objects->push_back(object);
+      }
+      else {
+        (*node_object_indices)[i] = NO_OBJECT_INDEX;
+      }
+    }
+  }
+
+  /// Node with the given index in the linearized tree (see Node::getIndex())
+  const NodeType* getNode(const std::size_t index) const {
+    return flat_node_pointers_[index];
+  }
+
+  NodeType* getNode(const std::size_t index) {
+    return flat_node_pointers_[index];
+  }
+
   void printInfo() const {
     std::cout << "Info: Tree depth " << getDepth() << std::endl;
     std::cout << "Info: NumNodes " << getNumOfNodes() << std::endl;
@@ -358,22 +438,141 @@ public:
     std::cout << "Info: Root pointer " << getRoot() << std::endl;
   }
 
-  void build(std::vector<ObjectWithBoundingBox> objects, bool take_ownership=true) {
+  void build(std::vector<ObjectWithBoundingBox> objects, bool take_ownership=true,
+             const SplitMethod split_method = SPLIT_MEDIAN) {
     clear();
 //    nodes_.emplace_back();
     root_ = allocateNode();
-    buildRecursive(root_, objects);
+    buildRecursive(root_, objects, split_method);
     owns_objects_ = take_ownership;
 //    nodes_.shrink_to_fit();
     computeInfo();
+    computeFlatNodes();
     printInfo();
 //    for (auto it = begin(); it != end(); ++it) {
 //      BH_ASSERT(!it->isLeaf || it->getObject() == nullptr);
 //    }
   }
 
+  /// Build the tree from linearized nodes (i.e. from a memory mapped file).
+  ///
+  /// The flat nodes are used in place for all traversals and are neither copied nor rebuilt.
+  /// They have to stay valid as long as flat_nodes_owner is alive (the tree keeps a reference to it).
+  /// The tree nodes are created with a single allocation and point into the moved objects.
+  /// Throws a Tree::Error if the nodes or object indices are inconsistent.
+  void buildFromFlatNodes(const FlatNodeArrayType& flat_nodes, std::shared_ptr<const void> flat_nodes_owner,
+                          ObjectVectorType objects, const bh::ConstArrayView<std::uint32_t>& node_object_indices) {
+    clear();
+    const std::size_t num_of_nodes = flat_nodes.size();
+    if (num_of_nodes == 0) {
+      return;
+    }
+    if (node_object_indices.size() != num_of_nodes || num_of_nodes >= NO_OBJECT_INDEX || flat_nodes[0].depth != 0) {
+      throw Error("Inconsistent linearized tree");
+    }
+    nodes_.resize(num_of_nodes);
+    flat_node_pointers_.resize(num_of_nodes);
+    // Restore child pointers from the depth-first order (each node only depends on its own and its children's entries)
+    bool consistent = true;
+    std::size_t depth = 0;
+    std::size_t num_of_leaf_nodes = 0;
+#pragma omp parallel for reduction(&&:consistent) reduction(max:depth) reduction(+:num_of_leaf_nodes)
+    for (std::size_t i = 0; i < num_of_nodes; ++i) {
+      const FlatNodeType& flat_node = flat_nodes[i];
+      NodeType& node = nodes_[i];
+      node.index_ = static_cast<std::uint32_t>(i);
+      node.bounding_box_ = BoundingBoxType(
+          Vector3(flat_node.bbox_min[0], flat_node.bbox_min[1], flat_node.bbox_min[2]),
+          Vector3(flat_node.bbox_max[0], flat_node.bbox_max[1], flat_node.bbox_max[2]));
+      const std::uint32_t object_index = node_object_indices[i];
+      if (object_index != NO_OBJECT_INDEX) {
+        consistent = consistent && object_index < objects.size();
+        node.object_ = object_index < objects.size() ? &objects[object_index] : nullptr;
+      }
+      flat_node_pointers_[i] = &node;
+      depth = std::max<std::size_t>(depth, flat_node.depth);
+      consistent = consistent && flat_node.skip_index > i && flat_node.skip_index <= num_of_nodes;
+      if (flat_node.skip_index != i + 1 && consistent) {
+        const std::size_t left_child_index = i + 1;
+        node.left_child_ = &nodes_[left_child_index];
+        consistent = consistent && flat_nodes[left_child_index].depth == flat_node.depth + 1;
+        const std::size_t right_child_index = flat_nodes[left_child_index].skip_index;
+        if (right_child_index < flat_node.skip_index) {
+          node.right_child_ = &nodes_[right_child_index];
+          consistent = consistent && flat_nodes[right_child_index].depth == flat_node.depth + 1
+              && flat_nodes[right_child_index].skip_index == flat_node.skip_index;
+        }
+        else {
+          consistent = consistent && right_child_index == flat_node.skip_index;
+        }
+      }
+      else {
+        ++num_of_leaf_nodes;
+      }
+    }
+    if (!consistent || flat_nodes[0].skip_index != num_of_nodes) {
+      clear();
+      throw Error("Inconsistent linearized tree");
+    }
+
+    root_ = &nodes_.front();
+    stored_as_vector_ = true;
+    // The objects are owned by object_storage_ (and not deleted individually)
+    owns_objects_ = false;
+    object_storage_ = std::move(objects);
+    flat_nodes_ = flat_nodes;
+    flat_nodes_owner_ = std::move(flat_nodes_owner);
+    depth_ = depth;
+    num_nodes_ = num_of_nodes;
+    num_leaf_nodes_ = num_of_leaf_nodes;
+    printInfo();
+  }
+
+  /// Intersect a ray with the tree and return the closest hit leaf.
+  ///
+  /// Uses a stackless traversal of the linearized nodes.
   // Cannot be const because BBoxIntersectionResult contains a non-const pointer to a node
   std::pair<bool, IntersectionResult> intersects(const RayType& ray, FloatType min_range = 0, FloatType max_range = -1) {
+    IntersectionResult result;
+    if (max_range > 0) {
+      result.dist_sq = max_range * max_range;
+    }
+    else {
+      result.dist_sq = std::numeric_limits<FloatType>::max();
+    }
+    const Vector3 inv_direction = ray.direction.cwiseInverse();
+    bool does_intersect = false;
+    const std::size_t num_flat_nodes = flat_nodes_.size();
+    std::size_t index = 0;
+    while (index < num_flat_nodes) {
+      const FlatNodeType& flat_node = flat_nodes_[index];
+      FloatType t_near;
+      if (!intersectsFlatNode(flat_node, ray.origin, inv_direction, &t_near)
+          || t_near * t_near > result.dist_sq) {
+        index = flat_node.skip_index;
+        continue;
+      }
+      if (flat_node.skip_index == index + 1) {
+        result.intersection = ray.origin + t_near * ray.direction;
+        result.node = flat_node_pointers_[index];
+        result.depth = flat_node.depth;
+        result.dist_sq = t_near * t_near;
+        does_intersect = true;
+      }
+      ++index;
+    }
+    return std::make_pair(does_intersect, result);
+  }
+
+  /// Intersect a ray with the tree by recursively following the node pointers.
+  ///
+  /// Reference implementation for intersects() (i.e. for validation and benchmarks).
+  // Cannot be const because BBoxIntersectionResult contains a non-const pointer to a node
+  std::pair<bool, IntersectionResult> intersectsNodeTree(
+      const RayType& ray, FloatType min_range = 0, FloatType max_range = -1) {
+    if (getRoot() == nullptr) {
+      return std::make_pair(false, IntersectionResult());
+    }
     IntersectionData data;
     data.ray.origin = ray.origin;
     data.ray.direction = ray.direction;
@@ -390,6 +589,46 @@ public:
     return std::make_pair(does_intersect, result);
   }
 
+  /// Raycast a camera image on the CPU.
+  ///
+  /// Neighbouring pixels of a row are traced together as a packet of kRayPacketWidth rays
+  /// (SSE/AVX slab tests) and rows are distributed over all OpenMP threads.
+  /// Pixels without a hit have a nullptr node.
+  // Cannot be const because IntersectionResult contains a non-const pointer to a node
+  std::vector<IntersectionResult> raycastCpu(
+      const Matrix4x4& intrinsics,
+      const Matrix3x4& extrinsics,
+      const std::size_t x_start, const std::size_t x_end,
+      const std::size_t y_start, const std::size_t y_end,
+      FloatType min_range = 0, FloatType max_range = -1) {
+    const std::size_t width = x_end - x_start;
+    std::vector<IntersectionResult> results((y_end - y_start) * width);
+    raycastPacketsCpu(intrinsics, extrinsics, x_start, x_end, y_start, y_end, min_range, max_range,
+                      [&](const std::size_t x, const std::size_t y, const IntersectionResult& result) {
+      results[(y - y_start) * width + (x - x_start)] = result;
+    });
+    return results;
+  }
+
+  /// Raycast a camera image on the CPU and report the screen coordinates of each hit (see raycastCpu).
+  // Cannot be const because IntersectionResult contains a non-const pointer to a node
+  std::vector<IntersectionResultWithScreenCoordinates> raycastWithScreenCoordinatesCpu(
+      const Matrix4x4& intrinsics,
+      const Matrix3x4& extrinsics,
+      const std::size_t x_start, const std::size_t x_end,
+      const std::size_t y_start, const std::size_t y_end,
+      FloatType min_range = 0, FloatType max_range = -1) {
+    const std::size_t width = x_end - x_start;
+    std::vector<IntersectionResultWithScreenCoordinates> results((y_end - y_start) * width);
+    raycastPacketsCpu(intrinsics, extrinsics, x_start, x_end, y_start, y_end, min_range, max_range,
+                      [&](const std::size_t x, const std::size_t y, const IntersectionResult& result) {
+      IntersectionResultWithScreenCoordinates& result_with_screen_coordinates = results[(y - y_start) * width + (x - x_start)];
+      result_with_screen_coordinates.intersection_result = result;
+      result_with_screen_coordinates.screen_coordinates = Vector2(x, y);
+    });
+    return results;
+  }
+
 #if WITH_CUDA
 
   // Cannot be const because BBoxIntersectionResult contains a non-const pointer to a node
@@ -543,16 +782,36 @@ public:
 
   std::vector<BBoxIntersectionResult> intersects(const BoundingBoxType& bbox) {
     std::vector<BBoxIntersectionResult> results;
-    intersectsRecursive<BBoxIntersectionResult>(bbox, getRoot(), 0, &results);
+    intersectsFlat<BBoxIntersectionResult>(bbox, &results);
     return results;
   }
 
   std::vector<ConstBBoxIntersectionResult> intersects(const BoundingBoxType& bbox) const {
     std::vector<ConstBBoxIntersectionResult> results;
-    intersectsRecursive<ConstBBoxIntersectionResult>(bbox, getRoot(), 0, &results);
+    intersectsFlat<ConstBBoxIntersectionResult>(bbox, &results);
     return results;
   }
 
+  /// Returns whether any leaf overlaps the bounding box.
+  ///
+  /// Stops at the first overlapping leaf and does not allocate (i.e. for collision checks).
+  bool overlapsAny(const BoundingBoxType& bbox) const {
+    const std::size_t num_flat_nodes = flat_nodes_.size();
+    std::size_t index = 0;
+    while (index < num_flat_nodes) {
+      const FlatNodeType& flat_node = flat_nodes_[index];
+      if (!overlapsFlatNode(flat_node, bbox)) {
+        index = flat_node.skip_index;
+        continue;
+      }
+      if (flat_node.skip_index == index + 1) {
+        return true;
+      }
+      ++index;
+    }
+    return false;
+  }
+
 #if WITH_CUDA
   void setCudaStackSize(const size_t cuda_stack_size, const int cuda_gpu_id = 0, const bool verbose = true) const {
     bh::CudaDevice cuda_dev(cuda_gpu_id);
@@ -577,33 +836,15 @@ private:
     if (getNumOfNodes() == 0) {
       return;
     }
-    // Write out all nodes
-    std::deque<const NodeType*> node_queue;
-    node_queue.push_front(getRoot());
-    std::size_t node_counter = 0;
-    while (!node_queue.empty()) {
-      const NodeType* node = node_queue.back();
-      node_queue.pop_back();
-      // Write child indices to disk and push childs into writing list
-      if (node->hasLeftChild()) {
-        node_queue.push_front(node->getLeftChild());
-        const std::size_t left_child_index = node_counter + node_queue.size();
-        ar & left_child_index;
-      }
-      else {
-        const std::size_t left_child_index = 0;
-        ar & left_child_index;
+    // Write out all nodes in depth-first order
+    for (std::size_t i = 0; i < flat_nodes_.size(); ++i) {
+      const FlatNodeType& flat_node = flat_nodes_[i];
+      for (std::size_t j = 0; j < 3; ++j) {
+        ar & flat_node.bbox_min[j];
+        ar & flat_node.bbox_max[j];
       }
-      if (node->hasRightChild()) {
-        node_queue.push_front(node->getRightChild());
-        std::size_t right_child_index = node_counter + node_queue.size();
-        ar & right_child_index;
-      }
-      else {
-        const std::size_t right_child_index = 0;
-        ar & right_child_index;
-      }
-      ar & node->getBoundingBox();
+      ar & flat_node.skip_index;
+      const NodeType* node = flat_node_pointers_[i];
       if (node->getObject() != nullptr) {
         ar & true;
         ar & (*node->getObject());
@@ -611,12 +852,90 @@ private:
       else {
         ar & false;
       }
-      ++node_counter;
     }
   }
 
   template <typename Archive>
   void load(Archive& ar, const unsigned int version) {
+    if (version == 0) {
+      loadBreadthFirst(ar);
+      return;
+    }
+    std::size_t depth;
+    std::size_t num_of_nodes;
+    std::size_t num_of_leaf_nodes;
+    ar & depth;
+    ar & num_of_nodes;
+    ar & num_of_leaf_nodes;
+    if (num_of_nodes == 0) {
+      return;
+    }
+    std::cout << "Tree has depth " << depth << ", " << num_of_nodes << " nodes " << " and " << num_of_leaf_nodes << " leaf nodes" << std::endl;
+    // Read linearized nodes from disk
+    std::vector<FlatNodeType> flat_nodes(num_of_nodes);
+    std::vector<NodeType> nodes(num_of_nodes);
+    for (std::size_t i = 0; i < num_of_nodes; ++i) {
+      FlatNodeType& flat_node = flat_nodes[i];
+      for (std::size_t j = 0; j < 3; ++j) {
+        ar & flat_node.bbox_min[j];
+        ar & flat_node.bbox_max[j];
+      }
+      ar & flat_node.skip_index;
+      BH_ASSERT(flat_node.skip_index > i && flat_node.skip_index <= num_of_nodes);
+      NodeType& node = nodes[i];
+      node.bounding_box_ = BoundingBoxType(
+          Vector3(flat_node.bbox_min[0], flat_node.bbox_min[1], flat_node.bbox_min[2]),
+          Vector3(flat_node.bbox_max[0], flat_node.bbox_max[1], flat_node.bbox_max[2]));
+      bool has_object;
+      ar & has_object;
+      if (has_object) {
+        node.object_ = new ObjectType();
+        ar & (*node.object_);
+      }
+      else {
+        node.object_ = nullptr;
+      }
+    }
+    // Restore child pointers and depths from the depth-first order
+    flat_nodes[0].depth = 0;
+    for (std::size_t i = 0; i < num_of_nodes; ++i) {
+      const FlatNodeType& flat_node = flat_nodes[i];
+      if (flat_node.skip_index == i + 1) {
+        continue;
+      }
+      const std::size_t left_child_index = i + 1;
+      nodes[i].left_child_ = &nodes[left_child_index];
+      flat_nodes[left_child_index].depth = flat_node.depth + 1;
+      const std::size_t right_child_index = flat_nodes[left_child_index].skip_index;
+      if (right_child_index < flat_node.skip_index) {
+        nodes[i].right_child_ = &nodes[right_child_index];
+        flat_nodes[right_child_index].depth = flat_node.depth + 1;
+      }
+    }
+
+    // Update tree
+    nodes_ = std::move(nodes);
+    root_ = &nodes_.front();
+    stored_as_vector_ = true;
+    owns_objects_ = true;
+    flat_node_storage_ = std::move(flat_nodes);
+    flat_nodes_ = FlatNodeArrayType(flat_node_storage_.data(), flat_node_storage_.size());
+    flat_node_pointers_.resize(nodes_.size());
+    for (std::size_t i = 0; i < nodes_.size(); ++i) {
+      flat_node_pointers_[i] = &nodes_[i];
+      nodes_[i].index_ = static_cast<std::uint32_t>(i);
+    }
+    computeInfo();
+    printInfo();
+    BH_ASSERT_STR(getDepth() == depth
+        && getNumOfNodes() == num_of_nodes
+        && getNumOfLeafNodes() == num_of_leaf_nodes,
+        "The tree properties are not as expected");
+  }
+
+  /// Load a tree that was stored in breadth-first order (archive version 0)
+  template <typename Archive>
+  void loadBreadthFirst(Archive& ar) {
     std::size_t depth;
     std::size_t num_of_nodes;
     std::size_t num_of_leaf_nodes;
@@ -677,6 +996,7 @@ private:
     stored_as_vector_ = true;
     owns_objects_ = true;
     computeInfo();
+    computeFlatNodes();
     printInfo();
     BH_ASSERT_STR(getDepth() == depth
         && getNumOfNodes() == num_of_nodes
@@ -709,6 +1029,100 @@ private:
     }
   }
 
+  void computeFlatNodes() {
+    flat_nodes_ = FlatNodeArrayType();
+    flat_node_storage_.clear();
+    flat_nodes_owner_.reset();
+    flat_node_pointers_.clear();
+    if (getRoot() == nullptr) {
+      return;
+    }
+    BH_ASSERT(getNumOfNodes() < std::numeric_limits<std::uint32_t>::max());
+    flat_node_storage_.reserve(getNumOfNodes());
+    flat_node_pointers_.reserve(getNumOfNodes());
+    computeFlatNodesRecursive(getRoot(), 0);
+    flat_nodes_ = FlatNodeArrayType(flat_node_storage_.data(), flat_node_storage_.size());
+  }
+
+  void computeFlatNodesRecursive(NodeType* node, std::size_t cur_depth) {
+    const std::size_t index = flat_node_storage_.size();
+    flat_node_storage_.emplace_back();
+    flat_node_pointers_.push_back(node);
+    node->index_ = static_cast<std::uint32_t>(index);
+    FlatNodeType& flat_node = flat_node_storage_.back();
+    for (std::size_t i = 0; i < 3; ++i) {
+      flat_node.bbox_min[i] = node->getBoundingBox().getMinimum(i);
+      flat_node.bbox_max[i] = node->getBoundingBox().getMaximum(i);
+    }
+    flat_node.depth = static_cast<std::uint32_t>(cur_depth);
+    if (node->left_child_ != nullptr) {
+      computeFlatNodesRecursive(node->left_child_, cur_depth + 1);
+    }
+    if (node->right_child_ != nullptr) {
+      computeFlatNodesRecursive(node->right_child_, cur_depth + 1);
+    }
+    flat_node_storage_[index].skip_index = static_cast<std::uint32_t>(flat_node_storage_.size());
+  }
+
+  static bool isOutsideFlatNode(const FlatNodeType& flat_node, const Vector3& point) {
+    for (std::size_t i = 0; i < 3; ++i) {
+      if (point(i) < flat_node.bbox_min[i] || point(i) > flat_node.bbox_max[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Slab test with the same semantics as BoundingBox3D::intersects(ray).
+  /// A ray starting inside of the node intersects at its origin.
+  static bool intersectsFlatNode(const FlatNodeType& flat_node,
+                                 const Vector3& origin, const Vector3& inv_direction,
+                                 FloatType* t_near) {
+    if (!isOutsideFlatNode(flat_node, origin)) {
+      *t_near = 0;
+      return true;
+    }
+    FloatType t_min = -std::numeric_limits<FloatType>::max();
+    FloatType t_max = std::numeric_limits<FloatType>::max();
+    for (std::size_t i = 0; i < 3; ++i) {
+      const FloatType t0 = (flat_node.bbox_min[i] - origin(i)) * inv_direction(i);
+      const FloatType t1 = (flat_node.bbox_max[i] - origin(i)) * inv_direction(i);
+      t_min = std::max(t_min, std::min(t0, t1));
+      t_max = std::min(t_max, std::max(t0, t1));
+    }
+    *t_near = std::max(t_min, FloatType(0));
+    return t_max > *t_near;
+  }
+
+  static bool overlapsFlatNode(const FlatNodeType& flat_node, const BoundingBoxType& bbox) {
+    for (std::size_t i = 0; i < 3; ++i) {
+      if (flat_node.bbox_max[i] < bbox.getMinimum(i) || bbox.getMaximum(i) < flat_node.bbox_min[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <typename IntersectionResultT>
+  void intersectsFlat(const BoundingBoxType& bbox, std::vector<IntersectionResultT>* results) const {
+    const std::size_t num_flat_nodes = flat_nodes_.size();
+    std::size_t index = 0;
+    while (index < num_flat_nodes) {
+      const FlatNodeType& flat_node = flat_nodes_[index];
+      if (!overlapsFlatNode(flat_node, bbox)) {
+        index = flat_node.skip_index;
+        continue;
+      }
+      if (flat_node.skip_index == index + 1) {
+        IntersectionResultT result;
+        result.node = flat_node_pointers_[index];
+        result.depth = flat_node.depth;
+        results->push_back(result);
+      }
+      ++index;
+    }
+  }
+
   void computeVoxelIndexMap() const {
     std::cout << "BVH: Computing voxel index map" << std::endl;
     // Compute consistent ordering of BVH nodes
@@ -755,10 +1169,143 @@ private:
     deallocateNode(node);
   }
 
-  void buildRecursive(NodeType* root, std::vector<ObjectWithBoundingBox>& objects) {
+  void buildRecursive(NodeType* root, std::vector<ObjectWithBoundingBox>& objects, const SplitMethod split_method) {
     assert(objects.size() > 2);
+    if (split_method == SPLIT_BINNED_SAH) {
+#pragma omp parallel
+      {
+#pragma omp single nowait
+        splitBinnedSAH(root, objects.begin(), objects.end());
+      }
+    }
+    else {
 //    splitMidPoint(root, objects.begin(), objects.end(), 0);
-    splitMedian(root, objects.begin(), objects.end(), 0);
+      splitMedian(root, objects.begin(), objects.end(), 0);
+    }
+  }
+
+  // Number of bins per axis and minimum number of objects for building subtrees in a separate task
+  static constexpr std::size_t kSAHNumBins = 16;
+  static constexpr std::size_t kSAHMinObjectsPerTask = 4096;
+
+  struct SAHBin {
+    SAHBin()
+    : count(0),
+      min(Vector3::Constant(std::numeric_limits<FloatType>::max())),
+      max(Vector3::Constant(std::numeric_limits<FloatType>::lowest())) {}
+
+    void include(const Vector3& other_min, const Vector3& other_max) {
+      min = min.cwiseMin(other_min);
+      max = max.cwiseMax(other_max);
+    }
+
+    FloatType getSurfaceArea() const {
+      if (count == 0) {
+        return 0;
+      }
+      const Vector3 extent = max - min;
+      return 2 * (extent(0) * extent(1) + extent(1) * extent(2) + extent(2) * extent(0));
+    }
+
+    std::size_t count;
+    Vector3 min;
+    Vector3 max;
+  };
+
+  void splitBinnedSAH(NodeType* node,
+      typename std::vector<ObjectWithBoundingBox>::iterator begin, typename std::vector<ObjectWithBoundingBox>::iterator end) {
+    const std::size_t num_objects = end - begin;
+    if (num_objects == 1) {
+      node->bounding_box_ = begin->bounding_box;
+      node->object_ = begin->object;
+      BH_ASSERT(begin->object != nullptr);
+      return;
+    }
+
+    // Bins are distributed over the extent of the object centers
+    Vector3 center_min = Vector3::Constant(std::numeric_limits<FloatType>::max());
+    Vector3 center_max = Vector3::Constant(std::numeric_limits<FloatType>::lowest());
+    for (auto it = begin; it != end; ++it) {
+      const Vector3 center = it->bounding_box.getCenter();
+      center_min = center_min.cwiseMin(center);
+      center_max = center_max.cwiseMax(center);
+    }
+    const Vector3 center_extent = center_max - center_min;
+    auto computeBinIndex = [&](const Vector3& center, const std::size_t axis) -> std::size_t {
+      const FloatType relative = (center(axis) - center_min(axis)) / center_extent(axis);
+      return std::min(static_cast<std::size_t>(relative * kSAHNumBins), kSAHNumBins - 1);
+    };
+
+    // Find split with minimum cost over all axes.
+    // The cost of a split is the number of objects times the surface area summed over both sides.
+    FloatType best_cost = std::numeric_limits<FloatType>::max();
+    std::size_t best_axis = 0;
+    std::size_t best_split_bin = kSAHNumBins;
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      if (center_extent(axis) <= 0) {
+        continue;
+      }
+      SAHBin bins[kSAHNumBins];
+      for (auto it = begin; it != end; ++it) {
+        SAHBin& bin = bins[computeBinIndex(it->bounding_box.getCenter(), axis)];
+        ++bin.count;
+        bin.include(it->bounding_box.getMinimum(), it->bounding_box.getMaximum());
+      }
+      // Sweep from the right to accumulate the cost of the right sides
+      FloatType right_costs[kSAHNumBins];
+      SAHBin right_bin;
+      for (std::size_t i = kSAHNumBins - 1; i > 0; --i) {
+        if (bins[i].count > 0) {
+          right_bin.count += bins[i].count;
+          right_bin.include(bins[i].min, bins[i].max);
+        }
+        right_costs[i] = right_bin.count * right_bin.getSurfaceArea();
+      }
+      // Sweep from the left (split is between bin i and i + 1)
+      SAHBin left_bin;
+      for (std::size_t i = 0; i < kSAHNumBins - 1; ++i) {
+        if (bins[i].count > 0) {
+          left_bin.count += bins[i].count;
+          left_bin.include(bins[i].min, bins[i].max);
+        }
+        if (left_bin.count == 0 || left_bin.count == num_objects) {
+          continue;
+        }
+        const FloatType cost = left_bin.count * left_bin.getSurfaceArea() + right_costs[i + 1];
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_split_bin = i;
+        }
+      }
+    }
+
+    typename std::vector<ObjectWithBoundingBox>::iterator mid_it;
+    if (best_split_bin < kSAHNumBins) {
+      mid_it = std::partition(begin, end, [&](const ObjectWithBoundingBox& object) {
+        return computeBinIndex(object.bounding_box.getCenter(), best_axis) <= best_split_bin;
+      });
+    }
+    else {
+      // All objects have the same center
+      mid_it = begin + num_objects / 2;
+    }
+
+    node->left_child_ = allocateNode();
+    node->right_child_ = allocateNode();
+
+    if (num_objects >= kSAHMinObjectsPerTask) {
+#pragma omp task
+      splitBinnedSAH(node->left_child_, begin, mid_it);
+      splitBinnedSAH(node->right_child_, mid_it, end);
+#pragma omp taskwait
+    }
+    else {
+      splitBinnedSAH(node->left_child_, begin, mid_it);
+      splitBinnedSAH(node->right_child_, mid_it, end);
+    }
+
+    node->computeBoundingBox();
   }
 
   void splitMedian(NodeType* node,
@@ -938,6 +1485,125 @@ private:
     }
   }
 
+  /// Traces all camera rays of an image window in packets and calls result_functor(x, y, result) for each hit.
+  /// Nodes are visited in the same order as in intersects() so that results are identical for a minimum range of 0.
+  /// Nodes that lie completely within the minimum range are skipped (as in the CUDA kernels).
+  template <typename ResultFunctor>
+  void raycastPacketsCpu(
+      const Matrix4x4& intrinsics,
+      const Matrix3x4& extrinsics,
+      const std::size_t x_start, const std::size_t x_end,
+      const std::size_t y_start, const std::size_t y_end,
+      const FloatType min_range, const FloatType max_range,
+      ResultFunctor result_functor) {
+    using RayPacketType = CameraRayPacket<FloatType>;
+    using RayPacketIntersectorType = RayPacketIntersector<FloatType, RayPacketType::kNumLanes>;
+    const std::size_t kNumLanes = RayPacketType::kNumLanes;
+    const std::size_t num_flat_nodes = flat_nodes_.size();
+    const FloatType min_dist = std::max(min_range, FloatType(0));
+    const FloatType max_dist = max_range > 0 ? max_range : std::numeric_limits<FloatType>::max();
+    const Vector3 origin = extrinsics.col(3);
+    const Matrix3x3 rotation = extrinsics.template leftCols<3>();
+
+#pragma omp parallel
+    {
+      // Per-thread traversal state
+      RayPacketType packet;
+      for (std::size_t i = 0; i < 3; ++i) {
+        packet.origin[i] = origin(i);
+      }
+      FloatType best_dist[kNumLanes];
+      NodeType* best_node[kNumLanes];
+      std::size_t best_depth[kNumLanes];
+      FloatType t_near[kNumLanes];
+
+#pragma omp for schedule(dynamic)
+      for (std::size_t y = y_start; y < y_end; ++y) {
+        for (std::size_t x_packet = x_start; x_packet < x_end; x_packet += kNumLanes) {
+          // Setup ray packet
+          for (std::size_t lane = 0; lane < kNumLanes; ++lane) {
+            best_node[lane] = nullptr;
+            best_depth[lane] = 0;
+            if (x_packet + lane < x_end) {
+              Vector3 direction_camera;
+              direction_camera(0) = (FloatType(x_packet + lane) - intrinsics(0, 2)) / intrinsics(0, 0);
+              direction_camera(1) = (FloatType(y) - intrinsics(1, 2)) / intrinsics(1, 1);
+              direction_camera(2) = 1;
+              const Vector3 direction = (rotation * direction_camera).normalized();
+              for (std::size_t i = 0; i < 3; ++i) {
+                packet.direction[i][lane] = direction(i);
+                packet.inv_direction[i][lane] = 1 / direction(i);
+              }
+              best_dist[lane] = max_dist;
+            }
+            else {
+              // Invalid lanes can never hit anything
+              for (std::size_t i = 0; i < 3; ++i) {
+                packet.direction[i][lane] = 0;
+                packet.inv_direction[i][lane] = 0;
+              }
+              best_dist[lane] = -1;
+            }
+          }
+
+          // Stackless traversal of the linearized tree
+          std::size_t index = 0;
+          while (index < num_flat_nodes) {
+            const FlatNodeType& flat_node = flat_nodes_[index];
+            std::uint32_t mask = 0;
+            const bool outside = isOutsideFlatNode(flat_node, origin);
+            if (outside || min_dist > 0) {
+              // Nodes that end before the minimum range are skipped (as in the CUDA kernels)
+              mask = RayPacketIntersectorType::intersect(
+                  packet, flat_node.bbox_min, flat_node.bbox_max, min_dist, best_dist, t_near);
+              if (!outside) {
+                for (std::size_t lane = 0; lane < kNumLanes; ++lane) {
+                  t_near[lane] = 0;
+                }
+              }
+            }
+            else {
+              // If already inside the bounding box the intersection point is the start of the ray.
+              for (std::size_t lane = 0; lane < kNumLanes; ++lane) {
+                t_near[lane] = 0;
+                if (best_dist[lane] >= 0) {
+                  mask |= 1u << lane;
+                }
+              }
+            }
+            if (mask == 0) {
+              index = flat_node.skip_index;
+              continue;
+            }
+            if (flat_node.skip_index == index + 1) {
+              for (std::size_t lane = 0; lane < kNumLanes; ++lane) {
+                if (mask & (1u << lane)) {
+                  best_dist[lane] = t_near[lane];
+                  best_node[lane] = flat_node_pointers_[index];
+                  best_depth[lane] = flat_node.depth;
+                }
+              }
+            }
+            ++index;
+          }
+
+          // Report hits
+          for (std::size_t lane = 0; lane < kNumLanes; ++lane) {
+            if (best_node[lane] != nullptr) {
+              IntersectionResult result;
+              result.intersection = origin + best_dist[lane] * Vector3(
+                  packet.direction[0][lane], packet.direction[1][lane], packet.direction[2][lane]);
+              result.node = best_node[lane];
+              result.depth = best_depth[lane];
+              result.dist_sq = best_dist[lane] * best_dist[lane];
+              result_functor(x_packet + lane, y, result);
+            }
+          }
+        }
+      }
+    }
+  }
+
   NodeType* allocateNode() {
     return new NodeType;
   }
@@ -958,6 +1624,14 @@ private:
 //  std::vector<NodeType> nodes_;
   NodeType* root_;
   std::vector<NodeType> nodes_;
+  // Objects of trees that were built from linearized nodes
+  ObjectVectorType object_storage_;
+  // Linearized nodes in depth-first order and the corresponding tree nodes.
+  // The linearized nodes are either stored in flat_node_storage_ or owned by flat_nodes_owner_ (i.e. a mapped file).
+  FlatNodeArrayType flat_nodes_;
+  std::vector<FlatNodeType> flat_node_storage_;
+  std::shared_ptr<const void> flat_nodes_owner_;
+  std::vector<NodeType*> flat_node_pointers_;
   bool stored_as_vector_;
   bool owns_objects_;
   std::size_t depth_;
@@ -977,3 +1651,17 @@ private:
 #endif
 
 }  // namespace bvh
+
+namespace boost {
+namespace serialization {
+
+/// Version 1 of the tree archive stores the linearized nodes in depth-first order.
+template <typename ObjectType, typename FloatType>
+struct version<bvh::Tree<ObjectType, FloatType>> {
+  using type = mpl::int_<1>;
+  using tag = mpl::integral_c_tag;
+  BOOST_STATIC_CONSTANT(int, value = version::type::value);
+};
+
+}  // namespace serialization
+}  // namespace boost
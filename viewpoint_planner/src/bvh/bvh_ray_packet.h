@@ -0,0 +1,134 @@
+//==================================================
+// bvh_ray_packet.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#if !__CUDACC__
+  #if __AVX__ || __SSE2__
+    #include <immintrin.h>
+  #endif
+#endif
+
+namespace bvh {
+
+#if __GNUC__ && !__CUDACC__
+  #pragma GCC push_options
+  #pragma GCC optimize ("fast-math")
+#endif
+
+/// Number of rays that are traced together in a packet on the CPU
+#if !__CUDACC__ && __AVX__
+  static constexpr std::size_t kRayPacketWidth = 8;
+#else
+  static constexpr std::size_t kRayPacketWidth = 4;
+#endif
+
+/// A packet of camera rays with a common origin.
+///
+/// Directions are stored in SoA layout so that a bounding box can be tested against all rays at once.
+/// Lanes that do not correspond to a valid ray have a negative maximum distance and never report a hit.
+template <typename FloatT, std::size_t kWidth = kRayPacketWidth>
+struct CameraRayPacket {
+  static constexpr std::size_t kNumLanes = kWidth;
+
+  FloatT origin[3];
+  alignas(32) FloatT direction[3][kWidth];
+  alignas(32) FloatT inv_direction[3][kWidth];
+};
+
+/// Slab test of a bounding box against all rays of a packet.
+///
+/// Returns a bit mask of the lanes that intersect the bounding box between min_dist and max_dist.
+/// The entry distance of each lane (clamped to min_dist) is written to t_near.
+template <typename FloatT, std::size_t kWidth>
+struct RayPacketIntersector {
+  static std::uint32_t intersect(
+      const CameraRayPacket<FloatT, kWidth>& packet,
+      const FloatT* bbox_min, const FloatT* bbox_max,
+      const FloatT min_dist, const FloatT* max_dist, FloatT* t_near) {
+    std::uint32_t mask = 0;
+    for (std::size_t lane = 0; lane < kWidth; ++lane) {
+      FloatT t_lower = -std::numeric_limits<FloatT>::max();
+      FloatT t_upper = std::numeric_limits<FloatT>::max();
+      for (std::size_t i = 0; i < 3; ++i) {
+        const FloatT t0 = (bbox_min[i] - packet.origin[i]) * packet.inv_direction[i][lane];
+        const FloatT t1 = (bbox_max[i] - packet.origin[i]) * packet.inv_direction[i][lane];
+        t_lower = std::max(t_lower, std::min(t0, t1));
+        t_upper = std::min(t_upper, std::max(t0, t1));
+      }
+      t_lower = std::max(t_lower, min_dist);
+      t_near[lane] = t_lower;
+      if (t_upper > t_lower && t_lower <= max_dist[lane]) {
+        mask |= 1u << lane;
+      }
+    }
+    return mask;
+  }
+};
+
+#if !__CUDACC__ && __SSE2__
+template <>
+struct RayPacketIntersector<float, 4> {
+  static std::uint32_t intersect(
+      const CameraRayPacket<float, 4>& packet,
+      const float* bbox_min, const float* bbox_max,
+      const float min_dist, const float* max_dist, float* t_near) {
+    __m128 t_lower = _mm_set1_ps(-std::numeric_limits<float>::max());
+    __m128 t_upper = _mm_set1_ps(std::numeric_limits<float>::max());
+    for (std::size_t i = 0; i < 3; ++i) {
+      // All rays share the origin so the offsets to the slabs are scalars
+      const __m128 inv_direction = _mm_load_ps(packet.inv_direction[i]);
+      const __m128 t0 = _mm_mul_ps(_mm_set1_ps(bbox_min[i] - packet.origin[i]), inv_direction);
+      const __m128 t1 = _mm_mul_ps(_mm_set1_ps(bbox_max[i] - packet.origin[i]), inv_direction);
+      t_lower = _mm_max_ps(t_lower, _mm_min_ps(t0, t1));
+      t_upper = _mm_min_ps(t_upper, _mm_max_ps(t0, t1));
+    }
+    t_lower = _mm_max_ps(t_lower, _mm_set1_ps(min_dist));
+    _mm_storeu_ps(t_near, t_lower);
+    const __m128 hit = _mm_and_ps(
+        _mm_cmpgt_ps(t_upper, t_lower),
+        _mm_cmple_ps(t_lower, _mm_loadu_ps(max_dist)));
+    return static_cast<std::uint32_t>(_mm_movemask_ps(hit));
+  }
+};
+#endif
+
+#if !__CUDACC__ && __AVX__
+template <>
+struct RayPacketIntersector<float, 8> {
+  static std::uint32_t intersect(
+      const CameraRayPacket<float, 8>& packet,
+      const float* bbox_min, const float* bbox_max,
+      const float min_dist, const float* max_dist, float* t_near) {
+    __m256 t_lower = _mm256_set1_ps(-std::numeric_limits<float>::max());
+    __m256 t_upper = _mm256_set1_ps(std::numeric_limits<float>::max());
+    for (std::size_t i = 0; i < 3; ++i) {
+      // All rays share the origin so the offsets to the slabs are scalars
+      const __m256 inv_direction = _mm256_load_ps(packet.inv_direction[i]);
+      const __m256 t0 = _mm256_mul_ps(_mm256_set1_ps(bbox_min[i] - packet.origin[i]), inv_direction);
+      const __m256 t1 = _mm256_mul_ps(_mm256_set1_ps(bbox_max[i] - packet.origin[i]), inv_direction);
+      t_lower = _mm256_max_ps(t_lower, _mm256_min_ps(t0, t1));
+      t_upper = _mm256_min_ps(t_upper, _mm256_max_ps(t0, t1));
+    }
+    t_lower = _mm256_max_ps(t_lower, _mm256_set1_ps(min_dist));
+    _mm256_storeu_ps(t_near, t_lower);
+    const __m256 hit = _mm256_and_ps(
+        _mm256_cmp_ps(t_upper, t_lower, _CMP_GT_OQ),
+        _mm256_cmp_ps(t_lower, _mm256_loadu_ps(max_dist), _CMP_LE_OQ));
+    return static_cast<std::uint32_t>(_mm256_movemask_ps(hit));
+  }
+};
+#endif
+
+#if __GNUC__ && !__CUDACC__
+  #pragma GCC pop_options
+#endif
+
+}  // namespace bvh
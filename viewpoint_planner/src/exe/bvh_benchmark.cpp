@@ -0,0 +1,456 @@
+//==================================================
+// bvh_benchmark.cpp
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <bh/boost.h>
+#include <boost/program_options.hpp>
+
+#include <bh/common.h>
+#include <bh/eigen.h>
+#include <bh/min_hash.h>
+#include <bh/utilities.h>
+#include <bh/math/geometry.h>
+
+#include "../planner/occupied_tree.h"
+#include "../planner/occupied_tree_cache.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+using viewpoint_planner::OccupiedTreeType;
+using viewpoint_planner::FloatType;
+USE_FIXED_EIGEN_TYPES(FloatType)
+using RayType = OccupiedTreeType::RayType;
+
+struct BenchmarkCamera {
+  Matrix4x4 intrinsics;
+  std::size_t width;
+  std::size_t height;
+};
+
+/// Sample camera poses on a sphere around the tree looking roughly at its center
+std::vector<Matrix3x4> sampleCameraExtrinsics(
+    const OccupiedTreeType& bvh_tree, const std::size_t num_viewpoints, std::mt19937_64* rng) {
+  const OccupiedTreeType::BoundingBoxType& bbox = bvh_tree.getRoot()->getBoundingBox();
+  const Vector3 center = bbox.getCenter();
+  const FloatType radius = bbox.getMaxExtent();
+  std::normal_distribution<FloatType> normal_dist(0, 1);
+  std::vector<Matrix3x4> extrinsics_list;
+  for (std::size_t i = 0; i < num_viewpoints; ++i) {
+    Vector3 offset(normal_dist(*rng), normal_dist(*rng), std::abs(normal_dist(*rng)));
+    offset = radius * offset.normalized();
+    const Vector3 target = center + FloatType(0.1) * radius * Vector3(normal_dist(*rng), normal_dist(*rng), 0);
+    const Vector3 position = center + offset;
+    const Vector3 z_axis = (target - position).normalized();
+    Vector3 x_axis = z_axis.cross(Vector3::UnitZ());
+    if (x_axis.squaredNorm() < FloatType(1e-6)) {
+      x_axis = Vector3::UnitX();
+    }
+    x_axis.normalize();
+    const Vector3 y_axis = z_axis.cross(x_axis);
+    Matrix3x4 extrinsics;
+    extrinsics.col(0) = x_axis;
+    extrinsics.col(1) = y_axis;
+    extrinsics.col(2) = z_axis;
+    extrinsics.col(3) = position;
+    extrinsics_list.push_back(extrinsics);
+  }
+  return extrinsics_list;
+}
+
+RayType getCameraRay(const BenchmarkCamera& camera, const Matrix3x4& extrinsics,
+                     const std::size_t x, const std::size_t y) {
+  Vector3 direction_camera;
+  direction_camera(0) = (FloatType(x) - camera.intrinsics(0, 2)) / camera.intrinsics(0, 0);
+  direction_camera(1) = (FloatType(y) - camera.intrinsics(1, 2)) / camera.intrinsics(1, 1);
+  direction_camera(2) = 1;
+  const Vector3 direction = extrinsics.leftCols<3>() * direction_camera;
+  return RayType(extrinsics.col(3), direction);
+}
+
+/// Cast single rays through the tree and return the nodes that were hit for each pixel
+template <typename IntersectFunctor>
+std::vector<const OccupiedTreeType::NodeType*> runSingleRaycast(
+    const BenchmarkCamera& camera, const std::vector<Matrix3x4>& extrinsics_list,
+    IntersectFunctor intersect_functor, const string& name) {
+  std::vector<const OccupiedTreeType::NodeType*> hit_nodes;
+  hit_nodes.reserve(extrinsics_list.size() * camera.width * camera.height);
+  bh::Timer timer;
+  for (const Matrix3x4& extrinsics : extrinsics_list) {
+    for (std::size_t y = 0; y < camera.height; ++y) {
+      for (std::size_t x = 0; x < camera.width; ++x) {
+        const RayType ray = getCameraRay(camera, extrinsics, x, y);
+        const std::pair<bool, OccupiedTreeType::IntersectionResult> result = intersect_functor(ray);
+        hit_nodes.push_back(result.first ? result.second.node : nullptr);
+      }
+    }
+  }
+  const double elapsed_time = timer.getElapsedTime();
+  cout << name << ": " << hit_nodes.size() / elapsed_time << " rays/s (" << elapsed_time << " s)" << endl;
+  return hit_nodes;
+}
+
+std::vector<const OccupiedTreeType::NodeType*> runPacketRaycast(
+    OccupiedTreeType* bvh_tree, const BenchmarkCamera& camera, const std::vector<Matrix3x4>& extrinsics_list) {
+  std::vector<const OccupiedTreeType::NodeType*> hit_nodes;
+  hit_nodes.reserve(extrinsics_list.size() * camera.width * camera.height);
+  bh::Timer timer;
+  for (const Matrix3x4& extrinsics : extrinsics_list) {
+    const std::vector<OccupiedTreeType::IntersectionResult> results =
+        bvh_tree->raycastCpu(camera.intrinsics, extrinsics, 0, camera.width, 0, camera.height);
+    for (const OccupiedTreeType::IntersectionResult& result : results) {
+      hit_nodes.push_back(result.node);
+    }
+  }
+  const double elapsed_time = timer.getElapsedTime();
+  cout << "Packet raycast (multithreaded): " << hit_nodes.size() / elapsed_time
+       << " rays/s (" << elapsed_time << " s)" << endl;
+  return hit_nodes;
+}
+
+std::size_t countMismatches(const std::vector<const OccupiedTreeType::NodeType*>& hit_nodes_a,
+                            const std::vector<const OccupiedTreeType::NodeType*>& hit_nodes_b) {
+  BH_ASSERT(hit_nodes_a.size() == hit_nodes_b.size());
+  std::size_t num_mismatches = 0;
+  for (std::size_t i = 0; i < hit_nodes_a.size(); ++i) {
+    if (hit_nodes_a[i] != hit_nodes_b[i]) {
+      ++num_mismatches;
+    }
+  }
+  return num_mismatches;
+}
+
+void runRaycastBenchmark(OccupiedTreeType* bvh_tree, const BenchmarkCamera& camera,
+                         const std::vector<Matrix3x4>& extrinsics_list) {
+  cout << "Raycasting " << extrinsics_list.size() << " images of size "
+       << camera.width << "x" << camera.height << endl;
+  const std::vector<const OccupiedTreeType::NodeType*> node_tree_hits = runSingleRaycast(
+      camera, extrinsics_list,
+      [&](const RayType& ray) { return bvh_tree->intersectsNodeTree(ray); },
+      "Node tree raycast (recursive)");
+  const std::vector<const OccupiedTreeType::NodeType*> flat_tree_hits = runSingleRaycast(
+      camera, extrinsics_list,
+      [&](const RayType& ray) { return bvh_tree->intersects(ray); },
+      "Flat tree raycast (stackless)");
+  const std::vector<const OccupiedTreeType::NodeType*> packet_hits = runPacketRaycast(
+      bvh_tree, camera, extrinsics_list);
+  std::size_t num_hits = 0;
+  for (const OccupiedTreeType::NodeType* node : node_tree_hits) {
+    if (node != nullptr) {
+      ++num_hits;
+    }
+  }
+  cout << "Number of hits: " << num_hits << " of " << node_tree_hits.size() << " rays" << endl;
+  cout << "Mismatches flat tree vs. node tree: " << countMismatches(flat_tree_hits, node_tree_hits) << endl;
+  cout << "Mismatches packet vs. node tree: " << countMismatches(packet_hits, node_tree_hits) << endl;
+}
+
+/// Compare collision checks of random object positions with a full bounding box query and with overlapsAny()
+void runCollisionCheckBenchmark(const OccupiedTreeType& bvh_tree, const std::size_t num_collision_checks,
+                                const FloatType object_size, std::mt19937_64* rng) {
+  const OccupiedTreeType::BoundingBoxType& bbox = bvh_tree.getRoot()->getBoundingBox();
+  std::vector<OccupiedTreeType::BoundingBoxType> object_bboxes;
+  object_bboxes.reserve(num_collision_checks);
+  for (std::size_t i = 0; i < num_collision_checks; ++i) {
+    Vector3 position;
+    for (std::size_t j = 0; j < 3; ++j) {
+      std::uniform_real_distribution<FloatType> dist(bbox.getMinimum(j), bbox.getMaximum(j));
+      position(j) = dist(*rng);
+    }
+    object_bboxes.emplace_back(position, object_size);
+  }
+  cout << "Checking " << num_collision_checks << " object positions for collisions" << endl;
+
+  std::vector<bool> collisions_query(num_collision_checks);
+  bh::Timer timer;
+  for (std::size_t i = 0; i < num_collision_checks; ++i) {
+    collisions_query[i] = !bvh_tree.intersects(object_bboxes[i]).empty();
+  }
+  double elapsed_time = timer.getElapsedTime();
+  cout << "Collision check (bounding box query): " << num_collision_checks / elapsed_time
+       << " checks/s (" << elapsed_time << " s)" << endl;
+
+  std::vector<bool> collisions_any(num_collision_checks);
+  timer.reset();
+  for (std::size_t i = 0; i < num_collision_checks; ++i) {
+    collisions_any[i] = bvh_tree.overlapsAny(object_bboxes[i]);
+  }
+  elapsed_time = timer.getElapsedTime();
+  cout << "Collision check (overlapsAny): " << num_collision_checks / elapsed_time
+       << " checks/s (" << elapsed_time << " s)" << endl;
+
+  std::size_t num_collisions = 0;
+  std::size_t num_mismatches = 0;
+  for (std::size_t i = 0; i < num_collision_checks; ++i) {
+    if (collisions_query[i]) {
+      ++num_collisions;
+    }
+    if (collisions_query[i] != collisions_any[i]) {
+      ++num_mismatches;
+    }
+  }
+  cout << "Number of collisions: " << num_collisions << ", mismatches: " << num_mismatches << endl;
+}
+
+/// Rebuild the tree from its leaves with each split method and compare build time and raycast speed
+void runBuildBenchmark(OccupiedTreeType* bvh_tree, const BenchmarkCamera& camera,
+                       const std::vector<Matrix3x4>& extrinsics_list) {
+  std::vector<OccupiedTreeType::ObjectWithBoundingBox> objects;
+  for (OccupiedTreeType::NodeType& node : *bvh_tree) {
+    if (node.isLeaf()) {
+      OccupiedTreeType::ObjectWithBoundingBox object_with_bbox;
+      object_with_bbox.bounding_box = node.getBoundingBox();
+      object_with_bbox.object = node.getObject();
+      objects.push_back(object_with_bbox);
+    }
+  }
+  const std::vector<std::pair<OccupiedTreeType::SplitMethod, string>> split_methods = {
+      { OccupiedTreeType::SPLIT_MEDIAN, "median split" },
+      { OccupiedTreeType::SPLIT_BINNED_SAH, "binned SAH" },
+  };
+  for (const auto& entry : split_methods) {
+    OccupiedTreeType rebuilt_tree;
+    bh::Timer timer;
+    rebuilt_tree.build(objects, false, entry.first);
+    const double elapsed_time = timer.getElapsedTime();
+    cout << "Building tree with " << entry.second << " from " << objects.size() << " objects took "
+         << elapsed_time << " s" << endl;
+    runSingleRaycast(
+        camera, extrinsics_list,
+        [&](const RayType& ray) { return rebuilt_tree.intersects(ray); },
+        "Flat tree raycast (" + entry.second + ")");
+    runPacketRaycast(&rebuilt_tree, camera, extrinsics_list);
+  }
+}
+
+/// Size of the intersection of two sorted index arrays
+std::size_t computeIntersectionSize(const std::vector<std::uint32_t>& indices1,
+                                    const std::vector<std::uint32_t>& indices2) {
+  std::size_t intersection_size = 0;
+  auto it1 = indices1.begin();
+  auto it2 = indices2.begin();
+  while (it1 != indices1.end() && it2 != indices2.end()) {
+    if (*it1 < *it2) {
+      ++it1;
+    }
+    else if (*it2 < *it1) {
+      ++it2;
+    }
+    else {
+      ++intersection_size;
+      ++it1;
+      ++it2;
+    }
+  }
+  return intersection_size;
+}
+
+/// Same check as ViewpointPlanner::isSparseMatchable2() (intersection relative to the average set size)
+bool isOverlapAboveThreshold(const std::vector<std::uint32_t>& indices1,
+                             const std::vector<std::uint32_t>& indices2,
+                             const FloatType threshold) {
+  const std::size_t intersection_size = computeIntersectionSize(indices1, indices2);
+  if (intersection_size == 0) {
+    return false;
+  }
+  const std::size_t average_size = (indices1.size() + indices2.size()) / 2;
+  return intersection_size / FloatType(average_size) >= threshold;
+}
+
+/// Compare exact sparse matchability checks of all viewpoint pairs with checks that are pre-filtered by MinHash sketches
+/// (pairs are rejected early if the sketch estimate is clearly below the threshold)
+void runSparseMatchingBenchmark(OccupiedTreeType* bvh_tree, const BenchmarkCamera& camera,
+                                const std::vector<Matrix3x4>& extrinsics_list,
+                                const FloatType threshold, const std::size_t num_hashes, const FloatType num_std_devs) {
+  // Visible voxels of each viewpoint as sorted dense indices (as cached by the viewpoint planner)
+  std::unordered_map<const OccupiedTreeType::NodeType*, std::uint32_t> node_indices;
+  std::vector<std::vector<std::uint32_t>> visible_voxels_list;
+  for (const Matrix3x4& extrinsics : extrinsics_list) {
+    const std::vector<OccupiedTreeType::IntersectionResult> results =
+        bvh_tree->raycastCpu(camera.intrinsics, extrinsics, 0, camera.width, 0, camera.height);
+    std::vector<std::uint32_t> visible_voxels;
+    for (const OccupiedTreeType::IntersectionResult& result : results) {
+      if (result.node != nullptr) {
+        const auto it = node_indices.emplace(result.node, static_cast<std::uint32_t>(node_indices.size())).first;
+        visible_voxels.push_back(it->second);
+      }
+    }
+    std::sort(visible_voxels.begin(), visible_voxels.end());
+    visible_voxels.erase(std::unique(visible_voxels.begin(), visible_voxels.end()), visible_voxels.end());
+    visible_voxels_list.push_back(std::move(visible_voxels));
+  }
+  const std::size_t num_viewpoints = visible_voxels_list.size();
+  const std::size_t num_pairs = num_viewpoints * (num_viewpoints - 1) / 2;
+  cout << "Checking sparse matchability of " << num_pairs << " viewpoint pairs with threshold " << threshold << endl;
+
+  std::vector<bool> matchable_exact;
+  matchable_exact.reserve(num_pairs);
+  bh::Timer timer;
+  for (std::size_t i = 0; i < num_viewpoints; ++i) {
+    for (std::size_t j = i + 1; j < num_viewpoints; ++j) {
+      matchable_exact.push_back(isOverlapAboveThreshold(visible_voxels_list[i], visible_voxels_list[j], threshold));
+    }
+  }
+  double elapsed_time = timer.getElapsedTime();
+  cout << "Sparse matchability (exact): " << num_pairs / elapsed_time
+       << " pairs/s (" << elapsed_time << " s)" << endl;
+
+  const bh::MinHash min_hash(num_hashes);
+  std::vector<bh::MinHashSketch> sketches;
+  sketches.reserve(num_viewpoints);
+  timer.reset();
+  for (const std::vector<std::uint32_t>& visible_voxels : visible_voxels_list) {
+    sketches.push_back(min_hash.computeSketch(visible_voxels.begin(), visible_voxels.end()));
+  }
+  elapsed_time = timer.getElapsedTime();
+  cout << "Computing " << num_viewpoints << " sketches with " << num_hashes << " bins took "
+       << elapsed_time << " s" << endl;
+
+  std::vector<bool> matchable_sketch;
+  matchable_sketch.reserve(num_pairs);
+  std::size_t num_exact_checks = 0;
+  timer.reset();
+  for (std::size_t i = 0; i < num_viewpoints; ++i) {
+    for (std::size_t j = i + 1; j < num_viewpoints; ++j) {
+      const bh::MinHash::Comparison comparison =
+          bh::MinHash::compareDice(sketches[i], sketches[j], threshold, num_std_devs);
+      if (comparison == bh::MinHash::BELOW_THRESHOLD) {
+        matchable_sketch.push_back(false);
+      }
+      else {
+        ++num_exact_checks;
+        matchable_sketch.push_back(isOverlapAboveThreshold(visible_voxels_list[i], visible_voxels_list[j], threshold));
+      }
+    }
+  }
+  elapsed_time = timer.getElapsedTime();
+  cout << "Sparse matchability (sketch pre-filter): " << num_pairs / elapsed_time
+       << " pairs/s (" << elapsed_time << " s)" << endl;
+
+  std::size_t num_matchable = 0;
+  std::size_t num_mismatches = 0;
+  for (std::size_t i = 0; i < num_pairs; ++i) {
+    if (matchable_exact[i]) {
+      ++num_matchable;
+    }
+    if (matchable_exact[i] != matchable_sketch[i]) {
+      ++num_mismatches;
+    }
+  }
+  cout << "Number of matchable pairs: " << num_matchable << ", exact checks with sketch pre-filter: "
+       << num_exact_checks << ", mismatches: " << num_mismatches << endl;
+}
+
+std::pair<bool, boost::program_options::variables_map> processOptions(int argc, char** argv)
+{
+  namespace po = boost::program_options;
+
+  po::variables_map vm;
+  try {
+    po::options_description generic_options("Generic options");
+    generic_options.add_options()
+        ("help", "Produce help message")
+        ("bvh-file", po::value<string>()->required(), "Cached BVH tree to load (i.e. <octree>.bvh).")
+        ("num-viewpoints", po::value<std::size_t>()->default_value(20), "Number of random viewpoints to raycast.")
+        ("image-width", po::value<std::size_t>()->default_value(640), "Width of the raycast images.")
+        ("image-height", po::value<std::size_t>()->default_value(480), "Height of the raycast images.")
+        ("focal-length", po::value<FloatType>()->default_value(500), "Focal length of the camera in pixels.")
+        ("seed", po::value<std::size_t>()->default_value(0), "Seed for the random viewpoints.")
+        ("num-collision-checks", po::value<std::size_t>()->default_value(1000000),
+            "Number of random object positions to check for collisions.")
+        ("collision-object-size", po::value<FloatType>()->default_value(3), "Size of the object for collision checks.")
+        ("compare-build", po::bool_switch()->default_value(false),
+            "Rebuild the tree with median split and binned SAH and compare build time and raycast speed.")
+        ("sparse-matching", po::bool_switch()->default_value(false),
+            "Compare exact sparse matchability checks of all viewpoint pairs with MinHash sketch pre-filtering.")
+        ("sparse-matching-threshold", po::value<FloatType>()->default_value(FloatType(0.2)),
+            "Voxel overlap threshold for sparse matchability checks of viewpoint pairs.")
+        ("min-hash-num-hashes", po::value<std::size_t>()->default_value(128),
+            "Number of min-hash values (bins) of the visible voxel sketches.")
+        ("min-hash-num-std-devs", po::value<FloatType>()->default_value(3),
+            "Number of standard deviations a sketch decision has to be away from the threshold.")
+        ;
+
+    po::options_description options;
+    options.add(generic_options);
+    po::store(po::command_line_parser(argc, argv).options(options).run(), vm);
+    if (vm.count("help")) {
+      cout << options << endl;
+      return std::make_pair(false, vm);
+    }
+    po::notify(vm);
+
+    return std::make_pair(true, vm);
+  }
+  catch (const po::required_option& err) {
+    cerr << "Error parsing command line: Required option '" << err.get_option_name() << "' is missing" << endl;
+    return std::make_pair(false, vm);
+  }
+  catch (const po::error& err) {
+    cerr << "Error parsing command line: " << err.what() << endl;
+    return std::make_pair(false, vm);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  std::pair<bool, boost::program_options::variables_map> cmdline_result = processOptions(argc, argv);
+  if (!cmdline_result.first) {
+    return 1;
+  }
+  boost::program_options::variables_map vm = std::move(cmdline_result.second);
+
+  const string bvh_filename = vm["bvh-file"].as<string>();
+  OccupiedTreeType bvh_tree;
+  {
+    bh::Timer timer;
+    viewpoint_planner::readOccupiedTree(bvh_filename, &bvh_tree);
+    timer.printTiming("Loading BVH tree");
+  }
+  if (bvh_tree.getRoot() == nullptr) {
+    cerr << "BVH tree is empty" << endl;
+    return -1;
+  }
+
+  BenchmarkCamera camera;
+  camera.width = vm["image-width"].as<std::size_t>();
+  camera.height = vm["image-height"].as<std::size_t>();
+  const FloatType focal_length = vm["focal-length"].as<FloatType>();
+  camera.intrinsics = Matrix4x4::Identity();
+  camera.intrinsics(0, 0) = focal_length;
+  camera.intrinsics(1, 1) = focal_length;
+  camera.intrinsics(0, 2) = camera.width / FloatType(2);
+  camera.intrinsics(1, 2) = camera.height / FloatType(2);
+
+  std::mt19937_64 rng(vm["seed"].as<std::size_t>());
+  const std::vector<Matrix3x4> extrinsics_list = sampleCameraExtrinsics(
+      bvh_tree, vm["num-viewpoints"].as<std::size_t>(), &rng);
+
+  runRaycastBenchmark(&bvh_tree, camera, extrinsics_list);
+  runCollisionCheckBenchmark(bvh_tree, vm["num-collision-checks"].as<std::size_t>(),
+                             vm["collision-object-size"].as<FloatType>(), &rng);
+  if (vm["sparse-matching"].as<bool>()) {
+    runSparseMatchingBenchmark(&bvh_tree, camera, extrinsics_list,
+                               vm["sparse-matching-threshold"].as<FloatType>(),
+                               vm["min-hash-num-hashes"].as<std::size_t>(),
+                               vm["min-hash-num-std-devs"].as<FloatType>());
+  }
+  if (vm["compare-build"].as<bool>()) {
+    runBuildBenchmark(&bvh_tree, camera, extrinsics_list);
+  }
+
+  return 0;
+}
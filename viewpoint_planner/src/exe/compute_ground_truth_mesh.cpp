@@ -40,6 +40,7 @@
 
 #include "../octree/occupancy_map.h"
 #include "../octree/occupancy_node.h"
+#include "../planner/occupied_tree_cache.h"
 #include "../planner/viewpoint_planner.h"
 
 //#pragma GCC optimize("O0")
@@ -305,10 +306,7 @@ public:
   std::unique_ptr<BvhTreeType> generateValidPositionBVHTree(const OctreeType& octree) {
     cout << "Reading occupancy BVH tree" << endl;
     ViewpointPlanner::OccupiedTreeType occupancy_bvh_tree;
-    std::ifstream ifs(planner_data_options_.getValue<string>("bvh_filename"));
-    boost::archive::binary_iarchive ia(ifs);
-    ia >> occupancy_bvh_tree;
-    ifs.close();
+    viewpoint_planner::readOccupiedTree(planner_data_options_.getValue<string>("bvh_filename"), &occupancy_bvh_tree);
     cout << "Done" << endl;
 
     size_t invalid_free_voxels = 0;
@@ -373,10 +371,7 @@ public:
       const OctreeType& octree) {
     cout << "Reading occupancy BVH tree" << endl;
     ViewpointPlanner::OccupiedTreeType occupancy_bvh_tree;
-    std::ifstream ifs(planner_data_options_.getValue<string>("bvh_filename"));
-    boost::archive::binary_iarchive ia(ifs);
-    ia >> occupancy_bvh_tree;
-    ifs.close();
+    viewpoint_planner::readOccupiedTree(planner_data_options_.getValue<string>("bvh_filename"), &occupancy_bvh_tree);
     cout << "Done" << endl;
 
     std::unordered_set<Vector3> reachable_voxel_positions_set;
@@ -131,7 +131,9 @@ public:
       DummyVoxelMapLoader voxel_map_loader;
       voxel_map_loader.load(ar, version);
 //        voxel_set_loader_.load(&path.observed_voxel_set, ar, version);
-      ar & comp_data.sorted_new_informations;
+      std::vector<ViewpointPlanner::NewInformationQueue::SerializedEntry> sorted_new_informations;
+      ar & sorted_new_informations;
+      comp_data.new_informations.setSerializedEntries(sorted_new_informations);
     }
   }
 
@@ -39,6 +39,7 @@
 #include <bh/se3_transform.h>
 #include <bh/vision/types.h>
 #include <bh/vision/geometry.h>
+#include <bh/vision/sift_matching.h>
 #include <bh/vision/cameras.h>
 #include <bh/vision/drawing_qt.h>
 #include <bh/opencv/matrix.h>
@@ -485,18 +486,17 @@ public:
     return score;
   }
 
-#pragma GCC optimize("O3")
+  bh::vision::SiftDescriptorMatrix convertDescriptors(const SiftDescriptorVector& descriptors) const {
+    if (descriptors.empty()) {
+      return bh::vision::SiftDescriptorMatrix();
+    }
+    return bh::vision::SiftDescriptorMatrix(
+            descriptors.front().desc.data(), descriptors.size(), sizeof(SiftDescriptor));
+  }
+
   SiftMatchMatrix computeMatchScores(
           const SiftDescriptorVector& descriptors1, const SiftDescriptorVector& descriptors2) const {
-    SiftMatchMatrix match_scores(descriptors1.size(), descriptors2.size());
-#pragma omp parallel for
-    for (size_t row = 0; row < match_scores.rows(); ++row) {
-//      cout << "Descriptor " << i << endl;
-      for (size_t col = 0; col < match_scores.cols(); ++col) {
-        match_scores(row, col) = computeMatchScore(descriptors1[row], descriptors2[col]);
-      }
-    }
-    return match_scores;
+    return bh::vision::computeSiftScoreMatrix(convertDescriptors(descriptors1), convertDescriptors(descriptors2));
   }
 
 #pragma GCC optimize("O3")
@@ -535,7 +535,8 @@ public:
     const PinholeCamera camera1(
             cv_camera1.width(), cv_camera1.height(), cv_camera1.intrinsics());
     offscreen_renderer_->setCamera(camera1);
-    QImage depth_image1 = offscreen_renderer_->drawPoissonMeshDepth(pose1);
+    const bh::EigenTypes<FloatType>::MatrixDynamic depth_image1 =
+            offscreen_renderer_->computePoissonMeshDepthImage(Viewpoint(&camera1, pose1));
     const PoseType pose2 = prior_image_poses_.at(image_id2);
     const OpenCVCameraType cv_camera2 = cameras_.at(image_camera_ids_.at(image_id2));
     const OpenCVCameraType virtual_camera2 = OpenCVCameraType(
@@ -543,7 +544,8 @@ public:
     const PinholeCamera camera2(
             cv_camera2.width(), cv_camera2.height(), cv_camera2.intrinsics());
     offscreen_renderer_->setCamera(camera2);
-    QImage depth_image2 = offscreen_renderer_->drawPoissonMeshDepth(pose2);
+    const bh::EigenTypes<FloatType>::MatrixDynamic depth_image2 =
+            offscreen_renderer_->computePoissonMeshDepthImage(Viewpoint(&camera2, pose2));
     const std::vector<Keypoint>& keypoints1 = all_undist_keypoints_.at(image_id1);
     const std::vector<Keypoint>& keypoints2 = all_undist_keypoints_.at(image_id2);
 #pragma omp parallel for
@@ -556,7 +558,8 @@ public:
         match_scores.row(row).setConstant(0);
         continue;
       }
-      const FloatType depth1 = offscreen_renderer_->decodeDepthValue(depth_image1, unprojected_point1);
+      const FloatType depth1 = depth_image1(static_cast<int>(unprojected_point1(1)),
+                                            static_cast<int>(unprojected_point1(0)));
       if (depth1 > max_depth || depth1 <= min_depth) {
         match_scores.row(row).setConstant(0);
         continue;
@@ -575,7 +578,8 @@ public:
           match_scores(row, col) = 0;
           continue;
         }
-        const FloatType depth2 = offscreen_renderer_->decodeDepthValue(depth_image2, unprojected_point2);
+        const FloatType depth2 = depth_image2(static_cast<int>(unprojected_point2(1)),
+                                              static_cast<int>(unprojected_point2(0)));
         if (depth2 > max_depth || depth2 <= min_depth) {
           match_scores(row, col) = 0;
           continue;
@@ -604,45 +608,28 @@ public:
           const SiftMatchMatrix& match_scores,
           const FloatType ratio_threshold = FloatType(0.8),
           const FloatType max_feature_distance = FloatType(0.7)) {
-    std::vector<size_t> match_indices(match_scores.rows());
+    std::vector<bh::vision::SiftTopTwoMatches> top_two(match_scores.rows());
 #pragma omp parallel for
     for (size_t row = 0; row < (size_t)match_scores.rows(); ++row) {
-      size_t best_index = (size_t)-1;
-      SiftScore best_score = std::numeric_limits<SiftScore>::min();
-//      size_t second_best_index = (size_t)-1;
-      SiftScore second_best_score = std::numeric_limits<SiftScore>::min();
       for (size_t col = 0; col < (size_t)match_scores.cols(); ++col) {
-        const SiftScore score = match_scores(row, col);
-        if (score > second_best_score) {
-          if (score > best_score) {
-            second_best_score = best_score;
-//            second_best_index = best_index;
-            best_score = score;
-            best_index = col;
-          }
-          else {
-            second_best_score = score;
-//            second_best_index = col;
-          }
-        }
+        top_two[row].update(match_scores(row, col), col);
       }
+    }
+    return getMatchIndicesBasedOnLoweRatioTest(top_two, ratio_threshold, max_feature_distance);
+  };
 
-      // SIFT descriptor vectors are normalized to length 512.
-      const FloatType kDistNorm = FloatType(1.0 / (512.0 * 512.0));
-
-      const FloatType best_distance_normed = std::acos(std::min(kDistNorm * best_score, FloatType(1.0)));
-      // Check for minimum distance
-      if (best_distance_normed > max_feature_distance) {
-        best_index = (size_t)-1;
+  std::vector<size_t> getMatchIndicesBasedOnLoweRatioTest(
+          const std::vector<bh::vision::SiftTopTwoMatches>& top_two,
+          const FloatType ratio_threshold = FloatType(0.8),
+          const FloatType max_feature_distance = FloatType(0.7)) {
+    std::vector<size_t> match_indices(top_two.size());
+    for (size_t i = 0; i < top_two.size(); ++i) {
+      if (bh::vision::passesSiftRatioTest(top_two[i], ratio_threshold, max_feature_distance)) {
+        match_indices[i] = top_two[i].best_index;
       }
       else {
-        const FloatType second_best_distance_normed = std::acos(
-                std::min(kDistNorm * second_best_score, FloatType(1.0)));
-        if (best_distance_normed >= ratio_threshold * second_best_distance_normed) {
-          best_index = (size_t) -1;
-        }
+        match_indices[i] = (size_t)-1;
       }
-      match_indices[row] = best_index;
     }
     return match_indices;
   };
@@ -655,12 +642,44 @@ public:
     cout << "Selecting matches based on ratio test" << endl;
     std::vector<size_t> match_indices1 = getMatchIndicesBasedOnLoweRatioTest(
             match_scores, ratio_threshold, max_feature_distance);
+    std::vector<size_t> match_indices2;
+    if (cross_check) {
+      match_indices2 = getMatchIndicesBasedOnLoweRatioTest(
+              match_scores.transpose(), ratio_threshold, max_feature_distance);
+    }
+    return selectCrossCheckedMatches(match_indices1, match_indices2, cross_check);
+  }
+
+  /// Same as selectBestMatches() on the score matrix of the descriptors without computing the whole matrix
+  std::vector<std::pair<size_t, size_t>> selectBestMatches(
+          const SiftDescriptorVector& descriptors1,
+          const SiftDescriptorVector& descriptors2,
+          const FloatType ratio_threshold = FloatType(0.8),
+          const FloatType max_feature_distance = FloatType(0.7),
+          const bool cross_check = true) {
+    cout << "Selecting matches based on ratio test" << endl;
+    std::vector<bh::vision::SiftTopTwoMatches> top_two1;
+    std::vector<bh::vision::SiftTopTwoMatches> top_two2;
+    bh::vision::computeSiftTopTwoMatches(
+            convertDescriptors(descriptors1), convertDescriptors(descriptors2),
+            &top_two1, cross_check ? &top_two2 : nullptr);
+    std::vector<size_t> match_indices1 = getMatchIndicesBasedOnLoweRatioTest(
+            top_two1, ratio_threshold, max_feature_distance);
+    std::vector<size_t> match_indices2;
+    if (cross_check) {
+      match_indices2 = getMatchIndicesBasedOnLoweRatioTest(top_two2, ratio_threshold, max_feature_distance);
+    }
+    return selectCrossCheckedMatches(match_indices1, match_indices2, cross_check);
+  }
+
+  std::vector<std::pair<size_t, size_t>> selectCrossCheckedMatches(
+          const std::vector<size_t>& match_indices1,
+          const std::vector<size_t>& match_indices2,
+          const bool cross_check) {
     cout << "Matches #1 after ratio test: " << match_indices1.size() << endl;
     // Perform cross-check
     std::vector<std::pair<size_t, size_t>> matches;
     if (cross_check) {
-      std::vector<size_t> match_indices2 = getMatchIndicesBasedOnLoweRatioTest(
-              match_scores.transpose(), ratio_threshold, max_feature_distance);
       cout << "Matches #2 after ratio test: " << match_indices2.size() << endl;
       for (size_t i = 0; i < match_indices1.size(); ++i) {
         const size_t keypoint_index2 = match_indices1[i];
@@ -1079,8 +1098,8 @@ public:
         cout << "Matching image " << image_id1 << " with " << image_id2 << endl;
 //        BH_PRINT_VALUE(keypoints1.size());
 //        BH_PRINT_VALUE(keypoints2.size());
-        SiftMatchMatrix match_scores = computeMatchScores(
-                all_descriptors_.at(image_id1), all_descriptors_.at(image_id2));
+//        SiftMatchMatrix match_scores = computeMatchScores(
+//                all_descriptors_.at(image_id1), all_descriptors_.at(image_id2));
 
 //        cout << "Invalidating matches based on minimum feature distance" << endl;
 //        invalidateMatchesBasedOnFeatureDistance(
@@ -1098,7 +1117,8 @@ public:
 //        }
 
         std::vector<std::pair<size_t, size_t>> matches = selectBestMatches(
-                match_scores, options_.lowe_ratio_threshold, options_.max_feature_distance, options_.cross_check);
+                all_descriptors_.at(image_id1), all_descriptors_.at(image_id2),
+                options_.lowe_ratio_threshold, options_.max_feature_distance, options_.cross_check);
 
         exportMatchesToColmap(image_id1, image_id2, matches);
 
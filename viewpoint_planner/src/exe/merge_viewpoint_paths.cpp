@@ -71,12 +71,12 @@ class DummyVoxelMapSaver {
 public:
   using FloatType = ViewpointPlanner::FloatType;
   using VoxelType = ViewpointPlanner::VoxelType;
-  using VoxelMap = ViewpointPlanner::VoxelMap;
+  using DenseVoxelMap = ViewpointPlanner::DenseVoxelMap;
 
   DummyVoxelMapSaver() {}
 
   template <typename Archive>
-  void save(const VoxelMap& voxel_map, Archive& ar, const unsigned int version) const {
+  void save(const DenseVoxelMap& voxel_map, Archive& ar, const unsigned int version) const {
     const size_t voxel_map_size = 0;
     ar & voxel_map_size;
   }
@@ -178,7 +178,9 @@ public:
       DummyVoxelMapLoader voxel_map_loader;
       voxel_map_loader.load(ar, version);
 //        voxel_set_loader_.load(&path.observed_voxel_set, ar, version);
-      ar & comp_data.sorted_new_informations;
+      std::vector<ViewpointPlanner::NewInformationQueue::SerializedEntry> sorted_new_informations;
+      ar & sorted_new_informations;
+      comp_data.new_informations.setSerializedEntries(sorted_new_informations);
     }
   }
 
@@ -222,7 +224,9 @@ private:
       DummyVoxelMapSaver voxel_map_saver;
       voxel_map_saver.save(path.observed_voxel_map, ar, version);
       //        voxel_set_saver_.save(path.observed_voxel_set, ar, version);
-      ar & comp_data.sorted_new_informations;
+      const std::vector<ViewpointPlanner::NewInformationQueue::SerializedEntry> sorted_new_informations =
+          comp_data.new_informations.getSerializedEntries();
+      ar & sorted_new_informations;
     }
   }
 
@@ -0,0 +1,250 @@
+//==================================================
+// sift_matching_benchmark.cpp
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+// Compares the blocked SIFT matching kernels with the per-pair score loop of the image matcher
+// on random SIFT-like descriptor sets.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <bh/boost.h>
+#include <boost/program_options.hpp>
+
+#include <bh/common.h>
+#include <bh/eigen.h>
+#include <bh/vision/sift_matching.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+using FloatType = float;
+using bh::vision::SiftScore;
+using bh::vision::SiftScoreMatrix;
+using bh::vision::SiftTopTwoMatches;
+using SiftDescriptor = Eigen::Matrix<uint8_t, 128, 1>;
+using SiftDescriptorVector = EIGEN_ALIGNED_VECTOR(SiftDescriptor);
+using FloatDescriptor = Eigen::Matrix<FloatType, 128, 1>;
+using FloatDescriptorVector = EIGEN_ALIGNED_VECTOR(FloatDescriptor);
+using BenchmarkClock = std::chrono::steady_clock;
+
+/// Normalized, clipped and renormalized descriptors quantized to 8 bit as in SIFT implementations
+SiftDescriptor quantizeSiftDescriptor(FloatDescriptor descriptor) {
+  descriptor.normalize();
+  descriptor = descriptor.cwiseMin(FloatType(0.2));
+  descriptor.normalize();
+  return (FloatType(512) * descriptor).cwiseMin(FloatType(255)).array().round().cast<uint8_t>();
+}
+
+/// The second set contains noisy copies of part of the first set so that there are matches to find.
+std::pair<SiftDescriptorVector, SiftDescriptorVector> generateDescriptors(
+    const std::size_t num_descriptors1, const std::size_t num_descriptors2,
+    const FloatType match_fraction, std::mt19937_64* rng) {
+  std::exponential_distribution<FloatType> component_dist(1);
+  std::normal_distribution<FloatType> noise_dist(0, FloatType(0.1));
+  std::uniform_real_distribution<FloatType> unit_dist(0, 1);
+  FloatDescriptorVector float_descriptors1(num_descriptors1);
+  SiftDescriptorVector descriptors1;
+  for (auto& float_descriptor : float_descriptors1) {
+    for (int i = 0; i < float_descriptor.size(); ++i) {
+      float_descriptor(i) = component_dist(*rng);
+    }
+    descriptors1.push_back(quantizeSiftDescriptor(float_descriptor));
+  }
+  SiftDescriptorVector descriptors2;
+  for (std::size_t j = 0; j < num_descriptors2; ++j) {
+    FloatDescriptor float_descriptor;
+    if (!float_descriptors1.empty() && unit_dist(*rng) < match_fraction) {
+      const FloatDescriptor& source = float_descriptors1[(*rng)() % float_descriptors1.size()];
+      for (int i = 0; i < float_descriptor.size(); ++i) {
+        float_descriptor(i) = std::max(source(i) * (1 + noise_dist(*rng)), FloatType(0));
+      }
+    }
+    else {
+      for (int i = 0; i < float_descriptor.size(); ++i) {
+        float_descriptor(i) = component_dist(*rng);
+      }
+    }
+    descriptors2.push_back(quantizeSiftDescriptor(float_descriptor));
+  }
+  return std::make_pair(descriptors1, descriptors2);
+}
+
+/// Per-pair score loop as previously used by the image matcher
+SiftScoreMatrix computeMatchScoresPerPair(
+    const SiftDescriptorVector& descriptors1, const SiftDescriptorVector& descriptors2) {
+  SiftScoreMatrix match_scores(descriptors1.size(), descriptors2.size());
+#pragma omp parallel for
+  for (std::size_t row = 0; row < (std::size_t)match_scores.rows(); ++row) {
+    for (std::size_t col = 0; col < (std::size_t)match_scores.cols(); ++col) {
+      const Eigen::Matrix<SiftScore, 128, 1> int_descriptor1 = descriptors1[row].cast<SiftScore>();
+      const Eigen::Matrix<SiftScore, 128, 1> int_descriptor2 = descriptors2[col].cast<SiftScore>();
+      match_scores(row, col) = int_descriptor1.dot(int_descriptor2);
+    }
+  }
+  return match_scores;
+}
+
+std::vector<SiftTopTwoMatches> computeTopTwoMatchesFromScores(const SiftScoreMatrix& match_scores) {
+  std::vector<SiftTopTwoMatches> top_two(match_scores.rows());
+#pragma omp parallel for
+  for (std::size_t row = 0; row < (std::size_t)match_scores.rows(); ++row) {
+    for (std::size_t col = 0; col < (std::size_t)match_scores.cols(); ++col) {
+      top_two[row].update(match_scores(row, col), col);
+    }
+  }
+  return top_two;
+}
+
+std::vector<std::pair<std::size_t, std::size_t>> selectCrossCheckedMatches(
+    const std::vector<SiftTopTwoMatches>& top_two1, const std::vector<SiftTopTwoMatches>& top_two2,
+    const FloatType ratio_threshold, const FloatType max_feature_distance) {
+  std::vector<std::pair<std::size_t, std::size_t>> matches;
+  for (std::size_t i = 0; i < top_two1.size(); ++i) {
+    if (!bh::vision::passesSiftRatioTest(top_two1[i], ratio_threshold, max_feature_distance)) {
+      continue;
+    }
+    const std::size_t j = top_two1[i].best_index;
+    if (bh::vision::passesSiftRatioTest(top_two2[j], ratio_threshold, max_feature_distance)
+        && top_two2[j].best_index == i) {
+      matches.emplace_back(i, j);
+    }
+  }
+  return matches;
+}
+
+template <typename Function>
+double measureSeconds(const std::size_t num_iterations, Function&& function) {
+  const BenchmarkClock::time_point start_time = BenchmarkClock::now();
+  for (std::size_t i = 0; i < num_iterations; ++i) {
+    function();
+  }
+  return std::chrono::duration<double>(BenchmarkClock::now() - start_time).count() / num_iterations;
+}
+
+void printTiming(const string& name, const double seconds, const std::size_t num_pairs, const double reference_seconds) {
+  cout << name << ": " << 1000 * seconds << " ms, " << num_pairs / seconds * 1e-9 << " Gpairs/s, speedup "
+       << reference_seconds / seconds << endl;
+}
+
+std::pair<bool, boost::program_options::variables_map> processOptions(int argc, char** argv)
+{
+  namespace po = boost::program_options;
+
+  po::variables_map vm;
+  try {
+    po::options_description generic_options("Generic options");
+    generic_options.add_options()
+        ("help", "Produce help message")
+        ("num-descriptors1", po::value<std::size_t>()->default_value(8192), "Number of descriptors in the first set.")
+        ("num-descriptors2", po::value<std::size_t>()->default_value(8192), "Number of descriptors in the second set.")
+        ("match-fraction", po::value<FloatType>()->default_value(FloatType(0.3)),
+            "Fraction of the second set that are noisy copies of descriptors in the first set.")
+        ("num-iterations", po::value<std::size_t>()->default_value(3), "Number of timed runs of each method.")
+        ("lowe-ratio-threshold", po::value<FloatType>()->default_value(FloatType(0.8)), "Ratio threshold for Lowe's test.")
+        ("max-feature-distance", po::value<FloatType>()->default_value(FloatType(0.7)),
+            "Maximum angular distance of a match.")
+        ("seed", po::value<std::size_t>()->default_value(0), "Seed for the random descriptors.")
+        ;
+
+    po::options_description options;
+    options.add(generic_options);
+    po::store(po::command_line_parser(argc, argv).options(options).run(), vm);
+    if (vm.count("help")) {
+      cout << options << endl;
+      return std::make_pair(false, vm);
+    }
+    po::notify(vm);
+
+    return std::make_pair(true, vm);
+  }
+  catch (const po::required_option& err) {
+    cerr << "Error parsing command line: Required option '" << err.get_option_name() << "' is missing" << endl;
+    return std::make_pair(false, vm);
+  }
+  catch (const po::error& err) {
+    cerr << "Error parsing command line: " << err.what() << endl;
+    return std::make_pair(false, vm);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  std::pair<bool, boost::program_options::variables_map> cmdline_result = processOptions(argc, argv);
+  if (!cmdline_result.first) {
+    return 1;
+  }
+  boost::program_options::variables_map vm = std::move(cmdline_result.second);
+
+  const std::size_t num_iterations = std::max<std::size_t>(vm["num-iterations"].as<std::size_t>(), 1);
+  const FloatType ratio_threshold = vm["lowe-ratio-threshold"].as<FloatType>();
+  const FloatType max_feature_distance = vm["max-feature-distance"].as<FloatType>();
+  std::mt19937_64 rng(vm["seed"].as<std::size_t>());
+  const auto descriptors = generateDescriptors(
+      vm["num-descriptors1"].as<std::size_t>(), vm["num-descriptors2"].as<std::size_t>(),
+      vm["match-fraction"].as<FloatType>(), &rng);
+  const SiftDescriptorVector& descriptors1 = descriptors.first;
+  const SiftDescriptorVector& descriptors2 = descriptors.second;
+  if (descriptors1.empty() || descriptors2.empty()) {
+    cerr << "ERROR: The descriptor sets must not be empty" << endl;
+    return 1;
+  }
+  const std::size_t num_pairs = descriptors1.size() * descriptors2.size();
+  cout << "Matching " << descriptors1.size() << " x " << descriptors2.size() << " descriptors" << endl;
+
+  // Score matrix
+  SiftScoreMatrix reference_scores;
+  const double per_pair_seconds = measureSeconds(num_iterations, [&]() {
+    reference_scores = computeMatchScoresPerPair(descriptors1, descriptors2);
+  });
+  printTiming("Score matrix, per-pair loop", per_pair_seconds, num_pairs, per_pair_seconds);
+
+  SiftScoreMatrix blocked_scores;
+  const double blocked_seconds = measureSeconds(num_iterations, [&]() {
+    const bh::vision::SiftDescriptorMatrix descriptor_matrix1(descriptors1.front().data(), descriptors1.size());
+    const bh::vision::SiftDescriptorMatrix descriptor_matrix2(descriptors2.front().data(), descriptors2.size());
+    blocked_scores = bh::vision::computeSiftScoreMatrix(descriptor_matrix1, descriptor_matrix2);
+  });
+  printTiming("Score matrix, blocked kernel", blocked_seconds, num_pairs, per_pair_seconds);
+  if (blocked_scores != reference_scores) {
+    cerr << "ERROR: Score matrices of the blocked kernel and the per-pair loop differ" << endl;
+    return 1;
+  }
+
+  // Cross-checked matches with Lowe's ratio test
+  std::vector<std::pair<std::size_t, std::size_t>> reference_matches;
+  const double per_pair_matches_seconds = measureSeconds(num_iterations, [&]() {
+    const SiftScoreMatrix match_scores = computeMatchScoresPerPair(descriptors1, descriptors2);
+    reference_matches = selectCrossCheckedMatches(
+        computeTopTwoMatchesFromScores(match_scores), computeTopTwoMatchesFromScores(match_scores.transpose()),
+        ratio_threshold, max_feature_distance);
+  });
+  printTiming("Matches, per-pair loop and score matrix scan", per_pair_matches_seconds, num_pairs, per_pair_matches_seconds);
+
+  std::vector<std::pair<std::size_t, std::size_t>> matches;
+  const double top_two_seconds = measureSeconds(num_iterations, [&]() {
+    const bh::vision::SiftDescriptorMatrix descriptor_matrix1(descriptors1.front().data(), descriptors1.size());
+    const bh::vision::SiftDescriptorMatrix descriptor_matrix2(descriptors2.front().data(), descriptors2.size());
+    std::vector<SiftTopTwoMatches> top_two1;
+    std::vector<SiftTopTwoMatches> top_two2;
+    bh::vision::computeSiftTopTwoMatches(descriptor_matrix1, descriptor_matrix2, &top_two1, &top_two2);
+    matches = selectCrossCheckedMatches(top_two1, top_two2, ratio_threshold, max_feature_distance);
+  });
+  printTiming("Matches, blocked top-two kernel", top_two_seconds, num_pairs, per_pair_matches_seconds);
+  cout << "Found " << matches.size() << " cross-checked matches" << endl;
+  if (matches != reference_matches) {
+    cerr << "ERROR: Matches of the blocked kernel and the per-pair loop differ" << endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -79,11 +79,44 @@ public:
     return *planner_ptr_;
   }
 
+  /// Compare loading times of the current viewpoint graph saved as Boost archive and as flat file
+  void benchmarkViewpointGraphLoading(const std::size_t num_repetitions) {
+    namespace boostfs = boost::filesystem;
+    const boostfs::path temp_path = boostfs::temp_directory_path() / boostfs::unique_path();
+    const std::string boost_archive_filename = temp_path.string() + "_viewpoint_graph.bs";
+    const std::string flat_filename = temp_path.string() + "_viewpoint_graph.flat";
+    getPlanner().saveViewpointGraphAsBoostArchive(boost_archive_filename);
+    getPlanner().saveViewpointGraphAsFlatFile(flat_filename);
+    const auto time_loading = [&](const std::string& filename) -> double {
+      bh::Timer timer;
+      for (std::size_t i = 0; i < num_repetitions; ++i) {
+        getPlanner().loadViewpointGraph(filename);
+      }
+      return timer.getElapsedTime() / num_repetitions;
+    };
+    const double boost_archive_time = time_loading(boost_archive_filename);
+    const double flat_time = time_loading(flat_filename);
+    cout << "Viewpoint graph with " << getPlanner().getViewpointEntries().size() << " viewpoints and "
+         << getPlanner().getViewpointGraph().numEdges() << " motions" << endl;
+    cout << "Boost archive: " << boostfs::file_size(boost_archive_filename) << " bytes, "
+         << boost_archive_time << " s per load" << endl;
+    cout << "Flat file: " << boostfs::file_size(flat_filename) << " bytes, "
+         << flat_time << " s per load" << endl;
+    cout << "Speedup: " << boost_archive_time / flat_time << endl;
+    boostfs::remove(boost_archive_filename);
+    boostfs::remove(flat_filename);
+  }
+
   void run(const boost::program_options::variables_map& vm) {
     if (vm.count("in-viewpoint-graph-file") > 0) {
       getPlanner().loadViewpointGraph(vm["in-viewpoint-graph-file"].as<std::string>());
     }
 
+    if (vm["benchmark-viewpoint-graph-loading"].as<bool>()) {
+      benchmarkViewpointGraphLoading(vm["benchmark-repetitions"].as<std::size_t>());
+      return;
+    }
+
     if (vm.count("out-viewpoint-graph-file") > 0) {
       enableCtrlCHandler(signalIntHandler);
       const std::size_t max_num_candidates = vm["num-candidates"].as<std::size_t>();
@@ -250,6 +283,8 @@ std::pair<bool, boost::program_options::variables_map> processOptions(
         ("save-conservative-path", po::bool_switch()->default_value(true), "Whether to also save a conservative path")
         ("drone-start-viewpoint-ids", po::value<std::string>(), "Starting viewpoints for viewpoint path")
         ("drone-start-viewpoint-mvs", po::bool_switch()->default_value(false), "Whether to make starting viewpoints multi-view-stereo viewpoints")
+        ("benchmark-viewpoint-graph-loading", po::bool_switch()->default_value(false), "Compare loading times of the input viewpoint graph as Boost archive and as flat file")
+        ("benchmark-repetitions", po::value<std::size_t>()->default_value(3), "Number of loads per file format for benchmarking")
         ;
 
     po::options_description options;
@@ -308,7 +343,12 @@ int main(int argc, char** argv) {
   }
   boost::program_options::variables_map vm = std::move(cmdline_result.second);
 
-  BH_ASSERT(vm.count("out-viewpoint-graph-file") > 0 || vm.count("out-viewpoint-path-file") > 0);
+  if (vm["benchmark-viewpoint-graph-loading"].as<bool>()) {
+    BH_ASSERT(vm.count("in-viewpoint-graph-file") > 0);
+  }
+  else {
+    BH_ASSERT(vm.count("out-viewpoint-graph-file") > 0 || vm.count("out-viewpoint-path-file") > 0);
+  }
 
   ViewpointPlannerCmdline planner_cmdline(config_options);
 
@@ -0,0 +1,229 @@
+//==================================================
+// collision_map.cpp
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+#include <cmath>
+#include <fstream>
+#include <omp.h>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/array.hpp>
+#include <bh/utilities.h>
+#include <bh/math/distance_transform.h>
+#include "collision_map.h"
+
+namespace viewpoint_planner {
+
+CollisionMap::CollisionMap()
+: resolution_(0), requested_resolution_(0), requested_max_num_voxels_(0) {}
+
+void CollisionMap::build(const OccupiedTreeType& bvh_tree, const FloatType resolution,
+                         const std::size_t max_num_voxels) {
+  bh::Timer timer;
+  requested_resolution_ = resolution;
+  requested_max_num_voxels_ = max_num_voxels;
+  bbox_ = bvh_tree.getRoot()->getBoundingBox();
+
+  // Collect bounding boxes of all leaves (occupied and unknown voxels)
+  std::vector<BoundingBoxType> leaf_bboxes;
+  leaf_bboxes.reserve(bvh_tree.getNumOfLeafNodes());
+  FloatType min_leaf_extent = std::numeric_limits<FloatType>::max();
+  const OccupiedTreeType::FlatNodeArrayType& flat_nodes = bvh_tree.getFlatNodes();
+  for (std::size_t i = 0; i < flat_nodes.size(); ++i) {
+    const OccupiedTreeType::FlatNodeType& flat_node = flat_nodes[i];
+    if (flat_node.skip_index == i + 1) {
+      const BoundingBoxType leaf_bbox(
+          Vector3(flat_node.bbox_min[0], flat_node.bbox_min[1], flat_node.bbox_min[2]),
+          Vector3(flat_node.bbox_max[0], flat_node.bbox_max[1], flat_node.bbox_max[2]));
+      leaf_bboxes.push_back(leaf_bbox);
+      min_leaf_extent = std::min(min_leaf_extent, leaf_bbox.getMinExtent());
+    }
+  }
+
+  resolution_ = resolution > 0 ? resolution : min_leaf_extent;
+  if (resolution_ <= 0 || resolution_ == std::numeric_limits<FloatType>::max()) {
+    resolution_ = bbox_.getMaxExtent();
+  }
+  Vector3s dims;
+  while (true) {
+    for (int i = 0; i < 3; ++i) {
+      dims(i) = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(bbox_.getExtent(i) / resolution_)));
+    }
+    const std::size_t num_voxels = dims(0) * dims(1) * dims(2);
+    if (max_num_voxels == 0 || num_voxels <= max_num_voxels) {
+      break;
+    }
+    resolution_ *= std::max(std::cbrt(num_voxels / FloatType(max_num_voxels)), FloatType(1.01));
+  }
+  std::cout << "Collision map dimensions: " << dims.transpose() << ", resolution: " << resolution_ << std::endl;
+
+  // Rasterize obstacle voxels. Each thread owns a range of z slices so no synchronization is needed.
+  const std::size_t num_voxels = dims(0) * dims(1) * dims(2);
+  std::vector<std::uint8_t> obstacle_mask(num_voxels, 0);
+  const Vector3& origin = bbox_.getMinimum();
+#pragma omp parallel
+  {
+    const std::size_t thread_index = (std::size_t)omp_get_thread_num();
+    const std::size_t num_threads = (std::size_t)omp_get_num_threads();
+    const std::size_t z_begin = dims(2) * thread_index / num_threads;
+    const std::size_t z_end = dims(2) * (thread_index + 1) / num_threads;
+    for (const BoundingBoxType& leaf_bbox : leaf_bboxes) {
+      std::size_t index_min[3];
+      std::size_t index_max[3];
+      for (int i = 0; i < 3; ++i) {
+        const FloatType lower = std::floor((leaf_bbox.getMinimum(i) - origin(i)) / resolution_);
+        const FloatType upper = std::ceil((leaf_bbox.getMaximum(i) - origin(i)) / resolution_);
+        index_min[i] = static_cast<std::size_t>(std::max(lower, FloatType(0)));
+        index_max[i] = std::min(static_cast<std::size_t>(std::max(upper, FloatType(1))), (std::size_t)dims(i));
+      }
+      index_min[2] = std::max(index_min[2], z_begin);
+      index_max[2] = std::min(index_max[2], z_end);
+      for (std::size_t z = index_min[2]; z < index_max[2]; ++z) {
+        for (std::size_t y = index_min[1]; y < index_max[1]; ++y) {
+          std::uint8_t* row = &obstacle_mask[dims(0) * (y + dims(1) * z)];
+          std::fill(row + index_min[0], row + index_max[0], std::uint8_t(1));
+        }
+      }
+    }
+  }
+
+  // Distance transform of the free space to the obstacles and of the obstacles to the free space
+  const FloatType far_value = bh::getDistanceTransformFarValue<FloatType>();
+  std::vector<FloatType> outside_sq_distances(num_voxels);
+  std::vector<FloatType> inside_sq_distances(num_voxels);
+#pragma omp parallel for
+  for (std::size_t i = 0; i < num_voxels; ++i) {
+    outside_sq_distances[i] = obstacle_mask[i] ? 0 : far_value;
+    inside_sq_distances[i] = obstacle_mask[i] ? far_value : 0;
+  }
+  bh::squaredDistanceTransform3D(&outside_sq_distances, dims(0), dims(1), dims(2));
+  bh::squaredDistanceTransform3D(&inside_sq_distances, dims(0), dims(1), dims(2));
+
+  // Without any obstacle (or free voxel) the distance is bounded by the extent of the map
+  const FloatType max_distance = bbox_.getExtent().norm();
+  grid_ = GridType(dims(0), dims(1), dims(2));
+  std::vector<FloatType>& values = grid_.getValues();
+#pragma omp parallel for
+  for (std::size_t i = 0; i < num_voxels; ++i) {
+    const FloatType outside_distance = outside_sq_distances[i] >= far_value
+        ? max_distance : resolution_ * std::sqrt(outside_sq_distances[i]);
+    const FloatType inside_distance = inside_sq_distances[i] >= far_value
+        ? max_distance : resolution_ * std::sqrt(inside_sq_distances[i]);
+    values[i] = outside_distance - inside_distance;
+  }
+  timer.printTimingMs("Building collision map");
+}
+
+bool CollisionMap::isEmpty() const {
+  return grid_.getNumElements() == 0;
+}
+
+const BoundingBoxType& CollisionMap::getBoundingBox() const {
+  return bbox_;
+}
+
+FloatType CollisionMap::getResolution() const {
+  return resolution_;
+}
+
+FloatType CollisionMap::getRequestedResolution() const {
+  return requested_resolution_;
+}
+
+std::size_t CollisionMap::getRequestedMaxNumVoxels() const {
+  return requested_max_num_voxels_;
+}
+
+const CollisionMap::GridType& CollisionMap::getGrid() const {
+  return grid_;
+}
+
+FloatType CollisionMap::getValue(const std::size_t x, const std::size_t y, const std::size_t z) const {
+  return grid_.getValues()[x + grid_.getDimX() * (y + grid_.getDimY() * z)];
+}
+
+FloatType CollisionMap::getSignedDistance(const Vector3& position) const {
+  const Vector3s dims = grid_.getDimensions();
+  std::size_t index0[3];
+  std::size_t index1[3];
+  FloatType alpha[3];
+  for (int i = 0; i < 3; ++i) {
+    // Voxel centers are at integer coordinates
+    FloatType coord = (position(i) - bbox_.getMinimum(i)) / resolution_ - FloatType(0.5);
+    coord = std::min(std::max(coord, FloatType(0)), FloatType(dims(i) - 1));
+    index0[i] = static_cast<std::size_t>(coord);
+    index1[i] = std::min<std::size_t>(index0[i] + 1, dims(i) - 1);
+    alpha[i] = coord - FloatType(index0[i]);
+  }
+  const FloatType c00 = (1 - alpha[0]) * getValue(index0[0], index0[1], index0[2])
+                        + alpha[0] * getValue(index1[0], index0[1], index0[2]);
+  const FloatType c10 = (1 - alpha[0]) * getValue(index0[0], index1[1], index0[2])
+                        + alpha[0] * getValue(index1[0], index1[1], index0[2]);
+  const FloatType c01 = (1 - alpha[0]) * getValue(index0[0], index0[1], index1[2])
+                        + alpha[0] * getValue(index1[0], index0[1], index1[2]);
+  const FloatType c11 = (1 - alpha[0]) * getValue(index0[0], index1[1], index1[2])
+                        + alpha[0] * getValue(index1[0], index1[1], index1[2]);
+  const FloatType c0 = (1 - alpha[1]) * c00 + alpha[1] * c10;
+  const FloatType c1 = (1 - alpha[1]) * c01 + alpha[1] * c11;
+  return (1 - alpha[2]) * c0 + alpha[2] * c1;
+}
+
+FloatType CollisionMap::getClearance(const Vector3& position) const {
+  if (isEmpty() || !bbox_.isInside(position)) {
+    return 0;
+  }
+  // The distance field is 1-Lipschitz so the interpolated value deviates from the distance at the position by at most
+  // one voxel diagonal. Obstacles can extend up to half a voxel diagonal beyond the center of their voxel.
+  const FloatType margin = FloatType(1.5) * std::sqrt(FloatType(3)) * resolution_;
+  return std::max(getSignedDistance(position) - margin, FloatType(0));
+}
+
+void CollisionMap::read(const std::string& filename) {
+  std::ifstream ifs(filename, std::ios::binary);
+  if (!ifs) {
+    throw BH_EXCEPTION(std::string("Unable to open file for reading: ") + filename);
+  }
+  boost::archive::binary_iarchive ia(ifs);
+  FloatType bbox_min[3];
+  FloatType bbox_max[3];
+  ia >> boost::serialization::make_array(bbox_min, 3);
+  ia >> boost::serialization::make_array(bbox_max, 3);
+  bbox_ = BoundingBoxType(Vector3(bbox_min[0], bbox_min[1], bbox_min[2]),
+                          Vector3(bbox_max[0], bbox_max[1], bbox_max[2]));
+  ia >> resolution_;
+  ia >> requested_resolution_;
+  ia >> requested_max_num_voxels_;
+  std::size_t dim_x;
+  std::size_t dim_y;
+  std::size_t dim_z;
+  ia >> dim_x;
+  ia >> dim_y;
+  ia >> dim_z;
+  grid_ = GridType(dim_x, dim_y, dim_z);
+  ia >> boost::serialization::make_array(grid_.getValues().data(), grid_.getNumElements());
+}
+
+void CollisionMap::write(const std::string& filename) const {
+  std::ofstream ofs(filename, std::ios::binary);
+  if (!ofs) {
+    throw BH_EXCEPTION(std::string("Unable to open file for writing: ") + filename);
+  }
+  boost::archive::binary_oarchive oa(ofs);
+  const FloatType bbox_min[3] = { bbox_.getMinimum(0), bbox_.getMinimum(1), bbox_.getMinimum(2) };
+  const FloatType bbox_max[3] = { bbox_.getMaximum(0), bbox_.getMaximum(1), bbox_.getMaximum(2) };
+  oa << boost::serialization::make_array(bbox_min, 3);
+  oa << boost::serialization::make_array(bbox_max, 3);
+  oa << resolution_;
+  oa << requested_resolution_;
+  oa << requested_max_num_voxels_;
+  oa << grid_.getDimX();
+  oa << grid_.getDimY();
+  oa << grid_.getDimZ();
+  oa << boost::serialization::make_array(grid_.getValues().data(), grid_.getNumElements());
+}
+
+}
@@ -0,0 +1,73 @@
+//==================================================
+// collision_map.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <string>
+#include <bh/common.h>
+#include <bh/math/grid3d.h>
+#include "viewpoint_planner_types.h"
+#include "occupied_tree.h"
+
+namespace viewpoint_planner {
+
+/// Euclidean signed distance field (ESDF) of the occupied and unknown space.
+///
+/// The map is a regular voxel grid over the bounding box of the occupied BVH tree. Each voxel stores the signed
+/// distance (in metres) from its center to the closest obstacle voxel (negative inside of obstacles).
+/// It is used to quickly validate free space along motion segments by sphere marching.
+class CollisionMap {
+public:
+  using Vector3s = Eigen::Vector3s;
+  using GridType = bh::Grid3D<FloatType>;
+
+  CollisionMap();
+
+  /// Build the map from the leaves of the occupied BVH tree (which includes unknown voxels).
+  ///
+  /// If resolution is not positive the smallest leaf extent is used.
+  /// The resolution is increased if the grid would have more than max_num_voxels voxels.
+  void build(const OccupiedTreeType& bvh_tree, const FloatType resolution, const std::size_t max_num_voxels);
+
+  bool isEmpty() const;
+
+  /// Bounding box covered by the map (the bounding box of the BVH tree it was built from)
+  const BoundingBoxType& getBoundingBox() const;
+
+  FloatType getResolution() const;
+
+  /// Resolution and voxel limit that were requested when building the map
+  FloatType getRequestedResolution() const;
+  std::size_t getRequestedMaxNumVoxels() const;
+
+  const GridType& getGrid() const;
+
+  /// Trilinearly interpolated signed distance (in metres) at a position inside of the map
+  FloatType getSignedDistance(const Vector3& position) const;
+
+  /// Conservative lower bound of the distance from a position to the closest obstacle.
+  ///
+  /// Accounts for the discretization of the obstacles and the interpolation error.
+  /// Returns 0 outside of the map.
+  FloatType getClearance(const Vector3& position) const;
+
+  void read(const std::string& filename);
+
+  void write(const std::string& filename) const;
+
+private:
+  FloatType getValue(const std::size_t x, const std::size_t y, const std::size_t z) const;
+
+  BoundingBoxType bbox_;
+  FloatType resolution_;
+  FloatType requested_resolution_;
+  std::size_t requested_max_num_voxels_;
+  // Signed distance at the voxel centers in metres
+  GridType grid_;
+};
+
+}
@@ -301,18 +301,9 @@ public:
       if (next_it == motion.poses().end()) {
         break;
       }
-      const FloatT distance = it->getPositionDistanceTo(*next_it);
-      const Vector3 direction = (next_it->getWorldPosition() - it->getWorldPosition()).normalized();
-      FloatT accumulated_distance = 0;
-      while (accumulated_distance < distance) {
-        const Vector3 position = it->getWorldPosition() + accumulated_distance * direction;
-        if (!data_->isValidObjectPosition(position, object_bbox_, ignore_no_fly_zones)) {
-          return false;
-        }
-        accumulated_distance += step_distance;
-        if (accumulated_distance > distance) {
-          accumulated_distance = distance;
-        }
+      if (!data_->isValidObjectSegment(it->getWorldPosition(), next_it->getWorldPosition(),
+                                       object_bbox_, step_distance, ignore_no_fly_zones)) {
+        return false;
       }
     }
     return true;
@@ -320,19 +311,10 @@ public:
 
   std::pair<Motion, bool> findMotionStraight(const Pose& from, const Pose& to) const {
     const bool ignore_no_fly_zones = true;
-    const FloatT distance = from.getPositionDistanceTo(to);
     const FloatT step_distance = object_bbox_.getMinExtent() / FloatT(2.0);
-    const Vector3 direction = (to.getWorldPosition() - from.getWorldPosition()).normalized();
-    FloatT accumulated_distance = 0;
-    while (accumulated_distance < distance) {
-      const Vector3 position = from.getWorldPosition() + accumulated_distance * direction;
-      if (!data_->isValidObjectPosition(position, object_bbox_, ignore_no_fly_zones)) {
-        return std::make_pair(Motion(), false);
-      }
-      accumulated_distance += step_distance;
-      if (accumulated_distance > distance) {
-        accumulated_distance = distance;
-      }
+    if (!data_->isValidObjectSegment(from.getWorldPosition(), to.getWorldPosition(),
+                                     object_bbox_, step_distance, ignore_no_fly_zones)) {
+      return std::make_pair(Motion(), false);
     }
     Motion motion(from, to);
     BH_ASSERT(motion.se3Distance()>= motion.distance());
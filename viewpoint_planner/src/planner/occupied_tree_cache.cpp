@@ -0,0 +1,151 @@
+//==================================================
+// occupied_tree_cache.cpp
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/filesystem.hpp>
+#include <bh/common.h>
+#include <bh/flat_file.h>
+#include <bh/utilities.h>
+#include "occupied_tree_cache.h"
+
+namespace viewpoint_planner {
+
+namespace {
+
+// Flat file format of the cached BVH tree ("Q3DRBVHC" in little endian)
+const std::uint64_t BVH_CACHE_MAGIC = 0x4348564252443351ull;
+const std::uint32_t BVH_CACHE_VERSION = 1;
+
+enum BVHCacheSection : std::uint32_t {
+  BVH_CACHE_SECTION_KEY = 1,
+  // Linearized nodes in depth-first order (used in place for traversals)
+  BVH_CACHE_SECTION_FLAT_NODES,
+  BVH_CACHE_SECTION_OBJECTS,
+  // Index into the objects for each node (or NO_OBJECT_INDEX)
+  BVH_CACHE_SECTION_NODE_OBJECT_INDICES,
+};
+
+/// Trivially copyable version of NodeObjectType
+struct FlatNodeObject {
+  FloatType occupancy;
+  FloatType weight;
+  FloatType normal[3];
+  std::uint32_t observation_count;
+};
+
+}
+
+bool OccupiedTreeCacheKey::operator==(const OccupiedTreeCacheKey& other) const {
+  return std::memcmp(this, &other, sizeof(OccupiedTreeCacheKey)) == 0;
+}
+
+bool isOccupiedTreeCacheFile(const std::string& filename) {
+  return bh::FlatFileReader::hasMagic(filename, BVH_CACHE_MAGIC);
+}
+
+void writeOccupiedTreeCache(const std::string& filename, const OccupiedTreeType& tree,
+                            const OccupiedTreeCacheKey& cache_key) {
+  std::vector<const NodeObjectType*> objects;
+  std::vector<std::uint32_t> node_object_indices;
+  tree.getFlatObjects(&objects, &node_object_indices);
+  std::vector<FlatNodeObject> flat_objects(objects.size());
+  for (std::size_t i = 0; i < objects.size(); ++i) {
+    std::memset(&flat_objects[i], 0, sizeof(FlatNodeObject));
+    flat_objects[i].occupancy = objects[i]->occupancy;
+    flat_objects[i].weight = objects[i]->weight;
+    for (int j = 0; j < 3; ++j) {
+      flat_objects[i].normal[j] = objects[i]->normal(j);
+    }
+    flat_objects[i].observation_count = objects[i]->observation_count;
+  }
+  const OccupiedTreeType::FlatNodeArrayType& flat_nodes = tree.getFlatNodes();
+
+  bh::FlatFileWriter writer(BVH_CACHE_MAGIC, BVH_CACHE_VERSION);
+  writer.addSection(BVH_CACHE_SECTION_KEY, &cache_key, 1);
+  writer.addSection(BVH_CACHE_SECTION_FLAT_NODES, flat_nodes.data(), flat_nodes.size());
+  writer.addSection(BVH_CACHE_SECTION_OBJECTS, flat_objects);
+  writer.addSection(BVH_CACHE_SECTION_NODE_OBJECT_INDICES, node_object_indices);
+  // The current tree might be mapped from the same file so we replace the file instead of overwriting it
+  const std::string tmp_filename = filename + ".tmp";
+  writer.write(tmp_filename);
+  boost::filesystem::rename(tmp_filename, filename);
+}
+
+bool readOccupiedTreeCache(const std::string& filename, OccupiedTreeType* tree,
+                           const OccupiedTreeCacheKey* cache_key) {
+  bh::Timer timer;
+  try {
+    std::shared_ptr<const bh::FlatFileReader> reader = std::make_shared<const bh::FlatFileReader>(
+            filename, BVH_CACHE_MAGIC, BVH_CACHE_VERSION, false);
+    const bh::ConstArrayView<OccupiedTreeCacheKey> file_cache_key =
+            reader->getSection<OccupiedTreeCacheKey>(BVH_CACHE_SECTION_KEY);
+    if (file_cache_key.size() != 1 || (cache_key != nullptr && !(file_cache_key[0] == *cache_key))) {
+      return false;
+    }
+    reader->getFile().adviseWillNeed();
+    reader->verifyChecksums();
+    const bh::ConstArrayView<FlatNodeObject> flat_objects =
+            reader->getSection<FlatNodeObject>(BVH_CACHE_SECTION_OBJECTS);
+    OccupiedTreeType::ObjectVectorType objects(flat_objects.size());
+#pragma omp parallel for
+    for (std::size_t i = 0; i < flat_objects.size(); ++i) {
+      objects[i].occupancy = flat_objects[i].occupancy;
+      objects[i].weight = flat_objects[i].weight;
+      objects[i].normal = Vector3(flat_objects[i].normal[0], flat_objects[i].normal[1], flat_objects[i].normal[2]);
+      objects[i].observation_count = static_cast<decltype(objects[i].observation_count)>(
+              flat_objects[i].observation_count);
+    }
+    const OccupiedTreeType::FlatNodeArrayType flat_nodes =
+            reader->getSection<OccupiedTreeType::FlatNodeType>(BVH_CACHE_SECTION_FLAT_NODES);
+    const bh::ConstArrayView<std::uint32_t> node_object_indices =
+            reader->getSection<std::uint32_t>(BVH_CACHE_SECTION_NODE_OBJECT_INDICES);
+    tree->buildFromFlatNodes(flat_nodes, reader, std::move(objects), node_object_indices);
+  }
+  catch (const bh::Error& err) {
+    std::cout << "Unable to read cached BVH tree: " << err.what() << std::endl;
+    tree->clear();
+    return false;
+  }
+  if (tree->getRoot() == nullptr) {
+    return false;
+  }
+  timer.printTimingMs("Reading cached BVH tree");
+  return true;
+}
+
+void readOccupiedTreeFromBoostArchive(const std::string& filename, OccupiedTreeType* tree) {
+  std::ifstream ifs(filename, std::ios::binary);
+  if (!ifs) {
+    throw BH_EXCEPTION(std::string("Unable to open file for reading: ") + filename);
+  }
+  boost::archive::binary_iarchive ia(ifs);
+  ia >> *tree;
+}
+
+void readOccupiedTree(const std::string& filename, OccupiedTreeType* tree) {
+  if (isOccupiedTreeCacheFile(filename)) {
+    if (!readOccupiedTreeCache(filename, tree)) {
+      throw bh::Error(std::string("Unable to read cached BVH tree: ") + filename);
+    }
+  }
+  else {
+    try {
+      readOccupiedTreeFromBoostArchive(filename, tree);
+    }
+    catch (const boost::archive::archive_exception& err) {
+      throw bh::Error(std::string("Unable to read BVH tree from ") + filename + ": " + err.what());
+    }
+  }
+}
+
+}
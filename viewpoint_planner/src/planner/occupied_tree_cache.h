@@ -0,0 +1,58 @@
+//==================================================
+// occupied_tree_cache.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "viewpoint_planner_types.h"
+#include "occupied_tree.h"
+
+namespace viewpoint_planner {
+
+/// Everything a cached occupied BVH tree depends on. A cached tree is only used if its key is equal.
+///
+/// Stored as a plain block of memory (zero-initialized so that the padding is well defined).
+struct OccupiedTreeCacheKey {
+  std::uint64_t octree_file_size;
+  std::int64_t octree_write_time;
+  std::uint64_t mesh_file_size;
+  std::int64_t mesh_write_time;
+  std::uint64_t normal_mesh_knn;
+  FloatType bbox_min[3];
+  FloatType bbox_max[3];
+  FloatType obstacle_free_height;
+  FloatType normal_mesh_max_dist;
+  std::uint32_t use_sah_build;
+  std::uint32_t enable_opengl;
+
+  bool operator==(const OccupiedTreeCacheKey& other) const;
+};
+
+/// Returns true if the file is an occupied BVH tree cache in the flat file format.
+bool isOccupiedTreeCacheFile(const std::string& filename);
+
+/// Write the tree to a flat file that can be memory mapped by readOccupiedTreeCache().
+///
+/// The file is replaced (and not overwritten) because the current tree might be mapped from it.
+void writeOccupiedTreeCache(const std::string& filename, const OccupiedTreeType& tree,
+                            const OccupiedTreeCacheKey& cache_key);
+
+/// Memory map a cached tree in the flat file format.
+///
+/// Returns false if the file is invalid or if a cache key is given and the key of the file differs.
+bool readOccupiedTreeCache(const std::string& filename, OccupiedTreeType* tree,
+                           const OccupiedTreeCacheKey* cache_key = nullptr);
+
+/// Read a tree from a Boost archive (the cache format of older versions).
+void readOccupiedTreeFromBoostArchive(const std::string& filename, OccupiedTreeType* tree);
+
+/// Read a cached tree in the flat file format or as a Boost archive without checking the cache key
+/// (i.e. for tools that use the cache of the planner). Throws a bh::Error if the file cannot be read.
+void readOccupiedTree(const std::string& filename, OccupiedTreeType* tree);
+
+}
@@ -0,0 +1,157 @@
+//==================================================
+// viewpoint_motion_distance_oracle.cpp
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+#include "viewpoint_motion_distance_oracle.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <bh/common.h>
+
+namespace viewpoint_planner {
+
+ViewpointMotionDistanceOracle::ViewpointMotionDistanceOracle(
+        const Options& options, const std::size_t num_vertices, const std::vector<Edge>& edges)
+: options_(options), num_sources_(0), num_targets_(0) {
+  offsets_.assign(num_vertices + 1, 0);
+  for (const Edge& edge : edges) {
+    BH_ASSERT(edge.vertex1 < num_vertices && edge.vertex2 < num_vertices);
+    BH_ASSERT(edge.cost >= 0);
+    ++offsets_[edge.vertex1 + 1];
+    ++offsets_[edge.vertex2 + 1];
+  }
+  for (std::size_t i = 1; i < offsets_.size(); ++i) {
+    offsets_[i] += offsets_[i - 1];
+  }
+  adjacent_vertices_.resize(offsets_.back());
+  edge_costs_.resize(offsets_.back());
+  std::vector<std::size_t> insert_positions(offsets_.begin(), offsets_.end() - 1);
+  for (const Edge& edge : edges) {
+    const std::size_t position1 = insert_positions[edge.vertex1]++;
+    adjacent_vertices_[position1] = edge.vertex2;
+    edge_costs_[position1] = edge.cost;
+    const std::size_t position2 = insert_positions[edge.vertex2]++;
+    adjacent_vertices_[position2] = edge.vertex1;
+    edge_costs_[position2] = edge.cost;
+  }
+}
+
+void ViewpointMotionDistanceOracle::compute(const std::vector<Vertex>& sources, const std::vector<Vertex>& targets) {
+  compute(sources, targets, std::vector<std::size_t>(sources.size(), targets.size()));
+}
+
+void ViewpointMotionDistanceOracle::compute(const std::vector<Vertex>& sources, const std::vector<Vertex>& targets,
+                                            const std::vector<std::size_t>& num_source_targets) {
+  BH_ASSERT(num_source_targets.size() == sources.size());
+  num_sources_ = sources.size();
+  num_targets_ = targets.size();
+  distances_.assign(num_sources_ * num_targets_, std::numeric_limits<FloatType>::infinity());
+  paths_.clear();
+  if (options_.reconstruct_paths) {
+    paths_.resize(num_sources_ * num_targets_);
+  }
+  for (const Vertex target : targets) {
+    BH_ASSERT(target < getNumVertices());
+  }
+
+#pragma omp parallel
+  {
+    SearchTree tree;
+    tree.vertex_distances.resize(getNumVertices(), std::numeric_limits<FloatType>::infinity());
+    tree.predecessors.resize(getNumVertices());
+    tree.settled_flags.resize(getNumVertices(), false);
+    std::vector<Vertex> unique_targets;
+
+#pragma omp for schedule(dynamic)
+    for (std::size_t source_index = 0; source_index < num_sources_; ++source_index) {
+      const std::size_t num_targets = std::min(num_source_targets[source_index], num_targets_);
+      unique_targets.assign(targets.begin(), targets.begin() + num_targets);
+      std::sort(unique_targets.begin(), unique_targets.end());
+      unique_targets.erase(std::unique(unique_targets.begin(), unique_targets.end()), unique_targets.end());
+      computeShortestPathTree(sources[source_index], unique_targets, &tree);
+      for (std::size_t target_index = 0; target_index < num_targets; ++target_index) {
+        const Vertex target = targets[target_index];
+        if (!tree.settled_flags[target]) {
+          continue;
+        }
+        distances_[source_index * num_targets_ + target_index] = tree.vertex_distances[target];
+        if (options_.reconstruct_paths) {
+          std::vector<Vertex>& path = paths_[source_index * num_targets_ + target_index];
+          for (Vertex vertex = target;; vertex = tree.predecessors[vertex]) {
+            path.push_back(vertex);
+            if (vertex == sources[source_index]) {
+              break;
+            }
+          }
+          std::reverse(path.begin(), path.end());
+        }
+      }
+      resetShortestPathTree(&tree);
+    }
+  }
+}
+
+bool ViewpointMotionDistanceOracle::isReachable(const std::size_t source_index, const std::size_t target_index) const {
+  return getDistance(source_index, target_index) < std::numeric_limits<FloatType>::infinity();
+}
+
+const std::vector<ViewpointMotionDistanceOracle::Vertex>& ViewpointMotionDistanceOracle::getPath(
+        const std::size_t source_index, const std::size_t target_index) const {
+  BH_ASSERT(options_.reconstruct_paths);
+  return paths_[source_index * num_targets_ + target_index];
+}
+
+void ViewpointMotionDistanceOracle::computeShortestPathTree(
+        const Vertex source, const std::vector<Vertex>& unique_targets, SearchTree* tree) const {
+  BH_ASSERT(source < getNumVertices());
+  std::size_t num_unsettled_targets = unique_targets.size();
+  std::vector<Vertex>& touched_vertices = tree->touched_vertices;
+
+  // Min-heap with lazy deletion of outdated entries
+  using QueueEntry = std::pair<FloatType, Vertex>;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> priority_queue;
+  tree->vertex_distances[source] = 0;
+  tree->predecessors[source] = source;
+  touched_vertices.push_back(source);
+  priority_queue.push(QueueEntry(FloatType(0), source));
+  while (!priority_queue.empty() && num_unsettled_targets > 0) {
+    const FloatType distance = priority_queue.top().first;
+    const Vertex vertex = priority_queue.top().second;
+    priority_queue.pop();
+    if (tree->settled_flags[vertex]) {
+      continue;
+    }
+    tree->settled_flags[vertex] = true;
+    if (std::binary_search(unique_targets.begin(), unique_targets.end(), vertex)) {
+      --num_unsettled_targets;
+    }
+    for (std::size_t i = offsets_[vertex]; i < offsets_[vertex + 1]; ++i) {
+      const Vertex adjacent_vertex = adjacent_vertices_[i];
+      const FloatType new_distance = distance + edge_costs_[i];
+      if (new_distance < tree->vertex_distances[adjacent_vertex]) {
+        if (tree->vertex_distances[adjacent_vertex] == std::numeric_limits<FloatType>::infinity()) {
+          touched_vertices.push_back(adjacent_vertex);
+        }
+        tree->vertex_distances[adjacent_vertex] = new_distance;
+        tree->predecessors[adjacent_vertex] = vertex;
+        priority_queue.push(QueueEntry(new_distance, adjacent_vertex));
+      }
+    }
+  }
+}
+
+void ViewpointMotionDistanceOracle::resetShortestPathTree(SearchTree* tree) const {
+  for (const Vertex vertex : tree->touched_vertices) {
+    tree->vertex_distances[vertex] = std::numeric_limits<FloatType>::infinity();
+    tree->settled_flags[vertex] = false;
+  }
+  tree->touched_vertices.clear();
+}
+
+}
@@ -0,0 +1,111 @@
+//==================================================
+// viewpoint_motion_distance_oracle.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "viewpoint_planner_types.h"
+
+namespace viewpoint_planner {
+
+/// Shortest motion distances between a set of source and target vertices of an undirected graph.
+///
+/// The graph is stored in compressed sparse row format. One Dijkstra search is run for each source
+/// (in parallel) and stops as soon as all targets are settled. The distances are stored in a dense
+/// matrix (sources x targets) so that queries never have to search the graph.
+/// Optionally the shortest paths are extracted while the search trees are still available.
+class ViewpointMotionDistanceOracle {
+public:
+  using Vertex = std::uint32_t;
+
+  struct Edge {
+    Vertex vertex1;
+    Vertex vertex2;
+    FloatType cost;
+  };
+
+  struct Options {
+    // Store the vertices of the shortest path for each source-target pair
+    bool reconstruct_paths = false;
+  };
+
+  /// Edges are undirected and must have a non-negative cost.
+  ViewpointMotionDistanceOracle(const Options& options, const std::size_t num_vertices, const std::vector<Edge>& edges);
+
+  std::size_t getNumVertices() const {
+    return offsets_.size() - 1;
+  }
+
+  std::size_t getNumEdges() const {
+    return adjacent_vertices_.size() / 2;
+  }
+
+  /// Compute shortest distances from each source to each target.
+  void compute(const std::vector<Vertex>& sources, const std::vector<Vertex>& targets);
+
+  /// Compute shortest distances from each source to a prefix of the targets.
+  ///
+  /// Source i is only connected to the first num_source_targets[i] targets. The other targets are treated as
+  /// unreachable from source i so that neither searches nor reconstructed paths are spent on them.
+  void compute(const std::vector<Vertex>& sources, const std::vector<Vertex>& targets,
+               const std::vector<std::size_t>& num_source_targets);
+
+  std::size_t getNumSources() const {
+    return num_sources_;
+  }
+
+  std::size_t getNumTargets() const {
+    return num_targets_;
+  }
+
+  /// Distance from a source to a target (indices into the source and target vectors).
+  /// Returns infinity if the target cannot be reached.
+  FloatType getDistance(const std::size_t source_index, const std::size_t target_index) const {
+    return distances_[source_index * num_targets_ + target_index];
+  }
+
+  bool isReachable(const std::size_t source_index, const std::size_t target_index) const;
+
+  /// Distances in row-major order (sources x targets)
+  const std::vector<FloatType>& getDistanceMatrix() const {
+    return distances_;
+  }
+
+  /// Vertices of the shortest path from a source to a target (both inclusive).
+  /// Only available if paths are reconstructed. Empty if the target cannot be reached.
+  const std::vector<Vertex>& getPath(const std::size_t source_index, const std::size_t target_index) const;
+
+private:
+  /// Work memory of a single Dijkstra search (sized for the whole graph and reused between searches)
+  struct SearchTree {
+    std::vector<FloatType> vertex_distances;
+    std::vector<Vertex> predecessors;
+    std::vector<bool> settled_flags;
+    // Vertices whose distance was set (to reset the tree in time proportional to the search)
+    std::vector<Vertex> touched_vertices;
+  };
+
+  /// Dijkstra search from a source that stops when all (sorted and unique) targets are settled.
+  void computeShortestPathTree(const Vertex source, const std::vector<Vertex>& unique_targets, SearchTree* tree) const;
+
+  void resetShortestPathTree(SearchTree* tree) const;
+
+  Options options_;
+  // Compressed sparse row adjacency (each undirected edge is stored in both directions)
+  std::vector<std::size_t> offsets_;
+  std::vector<Vertex> adjacent_vertices_;
+  std::vector<FloatType> edge_costs_;
+
+  std::size_t num_sources_;
+  std::size_t num_targets_;
+  std::vector<FloatType> distances_;
+  std::vector<std::vector<Vertex>> paths_;
+};
+
+}
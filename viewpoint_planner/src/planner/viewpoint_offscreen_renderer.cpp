@@ -7,6 +7,7 @@
 //
 
 #include "viewpoint_offscreen_renderer.h"
+#include <omp.h>
 
 namespace viewpoint_planner {
 
@@ -17,6 +18,7 @@ ViewpointOffscreenRenderer::ViewpointOffscreenRenderer(const PinholeCamera& came
       poisson_mesh_drawer_(nullptr),
       antialiasing_(false),
       clear_color_(1, 1, 1, 1),
+      software_render_cache_next_(0),
       camera_(camera),
       near_plane_(0.5),
       far_plane_(1e5),
@@ -31,10 +33,21 @@ ViewpointOffscreenRenderer::ViewpointOffscreenRenderer(
       poisson_mesh_drawer_(nullptr),
       antialiasing_(false),
       clear_color_(1, 1, 1, 1),
+      software_render_cache_next_(0),
       camera_(camera),
       near_plane_(0.5),
       far_plane_(1e5),
-      poisson_mesh_(poisson_mesh) {}
+      poisson_mesh_(poisson_mesh) {
+  if (options_.use_software_renderer) {
+    ViewpointSoftwareRenderer::Options software_renderer_options;
+    software_renderer_options.software_renderer_tile_size = options_.software_renderer_tile_size;
+    software_renderer_.reset(new ViewpointSoftwareRenderer(software_renderer_options, poisson_mesh_));
+    software_renderer_->setNearFarPlane(near_plane_, far_plane_);
+    if (options_.dump_poisson_mesh_normals_image || options_.dump_poisson_mesh_depth_image) {
+      std::cout << "Warning: Dumping of poisson mesh images is not supported by the software renderer" << std::endl;
+    }
+  }
+}
 
 ViewpointOffscreenRenderer::~ViewpointOffscreenRenderer() {
   clearOpenGL();
@@ -56,6 +69,10 @@ void ViewpointOffscreenRenderer::setAntialiasing(const bool antialiasing) {
 
 void ViewpointOffscreenRenderer::setCamera(const PinholeCamera& camera) {
   camera_ = camera;
+  {
+    std::lock_guard<std::mutex> cache_lock(software_render_cache_mutex_);
+    software_render_cache_.clear();
+  }
   if (isInitialized()) {
     const bool framebuffer_update_required = camera_.width() != (size_t)opengl_fbo_->width()
                                              || camera_.height() != (size_t)opengl_fbo_->height();
@@ -76,6 +93,11 @@ qreal ViewpointOffscreenRenderer::getFarPlane() const {
 void ViewpointOffscreenRenderer::setNearFarPlane(const qreal near_plane, const qreal far_plane) {
   near_plane_ = near_plane;
   far_plane_ = far_plane;
+  if (software_renderer_) {
+    software_renderer_->setNearFarPlane(near_plane_, far_plane_);
+    std::lock_guard<std::mutex> cache_lock(software_render_cache_mutex_);
+    software_render_cache_.clear();
+  }
 }
 
 std::unique_lock<std::mutex> ViewpointOffscreenRenderer::acquireOpenGLLock() const {
@@ -359,11 +381,22 @@ QImage ViewpointOffscreenRenderer::drawPoissonMesh(const QMatrix4x4& pvm_matrix,
 }
 
 QImage ViewpointOffscreenRenderer::drawPoissonMeshNormals(const Viewpoint& viewpoint, const bool clear_viewport) const {
+  if (software_renderer_) {
+    const auto encode_normal = [](const SoftwareRenderBuffers& buffers, const std::size_t x, const std::size_t y) {
+      // Same encoding as the normals shader
+      const Vector3 color = 255 * (FloatType(0.5) * buffers.getNormal(x, y) + Vector3(0.5, 0.5, 0.5));
+      return qRgb(bh::clamp<int>(color(0), 0, 255), bh::clamp<int>(color(1), 0, 255), bh::clamp<int>(color(2), 0, 255));
+    };
+    return encodeSoftwareRenderBuffers(*getCachedSoftwareRenderBuffers(viewpoint), encode_normal);
+  }
   const QMatrix4x4 pvm_matrix = getPvmMatrixFromViewpoint(viewpoint);
   return drawPoissonMeshNormals(pvm_matrix, clear_viewport);
 }
 
 QImage ViewpointOffscreenRenderer::drawPoissonMeshNormals(const Pose& pose, const bool clear_viewport) const {
+  if (software_renderer_) {
+    return drawPoissonMeshNormals(Viewpoint(&camera_, pose), clear_viewport);
+  }
   const QMatrix4x4 pvm_matrix = getPvmMatrixFromPose(pose);
   return drawPoissonMeshNormals(pvm_matrix, clear_viewport);
 }
@@ -397,12 +430,22 @@ QImage ViewpointOffscreenRenderer::drawPoissonMeshNormals(const QMatrix4x4& pvm_
 }
 
 QImage ViewpointOffscreenRenderer::drawPoissonMeshDepth(const Viewpoint& viewpoint, const bool clear_viewport) const {
+  if (software_renderer_) {
+    const auto encode_depth = [this](const SoftwareRenderBuffers& buffers, const std::size_t x, const std::size_t y) {
+      const bh::Color4<uint8_t> color = encodeDepthValue(buffers.getDepth(x, y));
+      return qRgb(color.r(), color.g(), color.b());
+    };
+    return encodeSoftwareRenderBuffers(*getCachedSoftwareRenderBuffers(viewpoint), encode_depth);
+  }
   const QMatrix4x4 pvm_matrix = getPvmMatrixFromViewpoint(viewpoint);
   const QMatrix4x4 vm_matrix = getVmMatrixFromViewpoint(viewpoint);
   return drawPoissonMeshDepth(pvm_matrix, vm_matrix, clear_viewport);
 }
 
 QImage ViewpointOffscreenRenderer::drawPoissonMeshDepth(const Pose& pose, const bool clear_viewport) const {
+  if (software_renderer_) {
+    return drawPoissonMeshDepth(Viewpoint(&camera_, pose), clear_viewport);
+  }
   const QMatrix4x4 pvm_matrix = getPvmMatrixFromPose(pose);
   const QMatrix4x4 vm_matrix = getVmMatrixFromPose(pose);
   return drawPoissonMeshDepth(pvm_matrix, vm_matrix, clear_viewport);
@@ -446,11 +489,22 @@ QImage ViewpointOffscreenRenderer::drawPoissonMeshDepth(
 }
 
 QImage ViewpointOffscreenRenderer::drawPoissonMeshIndices(const Viewpoint& viewpoint, const bool clear_viewport) const {
+  if (software_renderer_) {
+    const auto encode_index = [](const SoftwareRenderBuffers& buffers, const std::size_t x, const std::size_t y) {
+      // Same encoding as the indices shader
+      const std::uint32_t index = buffers.getTriangleIndex(x, y);
+      return qRgb((index & 0x000000FF) >> 0, (index & 0x0000FF00) >> 8, (index & 0x00FF0000) >> 16);
+    };
+    return encodeSoftwareRenderBuffers(*getCachedSoftwareRenderBuffers(viewpoint), encode_index);
+  }
   const QMatrix4x4 pvm_matrix = getPvmMatrixFromViewpoint(viewpoint);
   return drawPoissonMeshIndices(pvm_matrix, clear_viewport);
 }
 
 QImage ViewpointOffscreenRenderer::drawPoissonMeshIndices(const Pose& pose, const bool clear_viewport) const {
+  if (software_renderer_) {
+    return drawPoissonMeshIndices(Viewpoint(&camera_, pose), clear_viewport);
+  }
   const QMatrix4x4 pvm_matrix = getPvmMatrixFromPose(pose);
   return drawPoissonMeshIndices(pvm_matrix, clear_viewport);
 }
@@ -499,6 +553,13 @@ Vector3 ViewpointOffscreenRenderer::computePoissonMeshNormalVector(
 Vector3 ViewpointOffscreenRenderer::computePoissonMeshNormalVector(
         const Viewpoint& viewpoint,
         const std::size_t x, const std::size_t y) const {
+  if (software_renderer_) {
+    const std::shared_ptr<const SoftwareRenderBuffers> buffers = getCachedSoftwareRenderBuffers(viewpoint);
+#if !BH_RELEASE
+    BH_ASSERT(x < buffers->width() && y < buffers->height());
+#endif
+    return buffers->getNormal(x, y);
+  }
   const Pose& pose = viewpoint.pose();
   std::unique_lock<std::mutex> cache_lock(poisson_mesh_cache_mutex_);
   if (!pose.isApprox(cached_poisson_mesh_normals_pose_) || cached_poisson_mesh_normals_image_.width() == 0) {
@@ -541,6 +602,13 @@ FloatType ViewpointOffscreenRenderer::computePoissonMeshDepth(
 FloatType ViewpointOffscreenRenderer::computePoissonMeshDepth(
         const Viewpoint& viewpoint,
         const std::size_t x, const std::size_t y) const {
+  if (software_renderer_) {
+    const std::shared_ptr<const SoftwareRenderBuffers> buffers = getCachedSoftwareRenderBuffers(viewpoint);
+#if !BH_RELEASE
+    BH_ASSERT(x < buffers->width() && y < buffers->height());
+#endif
+    return buffers->getDepth(x, y);
+  }
   const Pose& pose = viewpoint.pose();
   std::unique_lock<std::mutex> cache_lock(poisson_mesh_cache_mutex_);
   if (!pose.isApprox(cached_poisson_mesh_depth_pose_) || cached_poisson_mesh_depth_image_.width() == 0) {
@@ -566,6 +634,37 @@ FloatType ViewpointOffscreenRenderer::computePoissonMeshDepth(
   return decodeDepthValue(pixel);
 }
 
+bh::EigenTypes<FloatType>::MatrixDynamic ViewpointOffscreenRenderer::computePoissonMeshDepthImage(
+        const Viewpoint& viewpoint) const {
+  if (software_renderer_) {
+    const std::shared_ptr<const SoftwareRenderBuffers> buffers = getCachedSoftwareRenderBuffers(viewpoint);
+    bh::EigenTypes<FloatType>::MatrixDynamic depth_image(buffers->height(), buffers->width());
+    for (std::size_t y = 0; y < buffers->height(); ++y) {
+      for (std::size_t x = 0; x < buffers->width(); ++x) {
+        depth_image(y, x) = buffers->getDepth(x, y);
+      }
+    }
+    return depth_image;
+  }
+  const QImage encoded_image = drawPoissonMeshDepth(viewpoint);
+  // Pixels with the clear color do not show a triangle
+  const QRgb invalid_pixel = qRgb(255, 255, 255);
+  bh::EigenTypes<FloatType>::MatrixDynamic depth_image(encoded_image.height(), encoded_image.width());
+  for (int y = 0; y < encoded_image.height(); ++y) {
+    for (int x = 0; x < encoded_image.width(); ++x) {
+      const QRgb pixel = encoded_image.pixel(x, y);
+      if (qRed(pixel) == qRed(invalid_pixel) && qGreen(pixel) == qGreen(invalid_pixel)
+          && qBlue(pixel) == qBlue(invalid_pixel)) {
+        depth_image(y, x) = std::numeric_limits<FloatType>::infinity();
+      }
+      else {
+        depth_image(y, x) = decodeDepthValue(QColor(pixel));
+      }
+    }
+  }
+  return depth_image;
+}
+
 bh::Color4<uint8_t> ViewpointOffscreenRenderer::encodeDepthValue(const FloatType depth) const {
   const FloatType multiplier(256.);
   const FloatType red = std::floor(depth / multiplier);
@@ -661,4 +760,56 @@ std::unordered_set<size_t> ViewpointOffscreenRenderer::getVisibleTriangles(const
   return visible_triangles;
 }
 
-}
\ No newline at end of file
+bool ViewpointOffscreenRenderer::isUsingSoftwareRenderer() const {
+  return static_cast<bool>(software_renderer_);
+}
+
+void ViewpointOffscreenRenderer::renderPoissonMesh(const Viewpoint& viewpoint, SoftwareRenderBuffers* buffers) const {
+  BH_ASSERT_STR(static_cast<bool>(software_renderer_), "Software renderer is not enabled");
+  software_renderer_->render(viewpoint, buffers);
+}
+
+std::shared_ptr<const SoftwareRenderBuffers> ViewpointOffscreenRenderer::getCachedSoftwareRenderBuffers(
+        const Viewpoint& viewpoint) const {
+  const Pose& pose = viewpoint.pose();
+  // Buffers are only reused for the same intrinsics. The cache is cleared when the near or far plane changes.
+  const PinholeCamera& camera = viewpoint.camera();
+  std::unique_lock<std::mutex> cache_lock(software_render_cache_mutex_);
+  for (const SoftwareRenderCacheEntry& entry : software_render_cache_) {
+    if (pose.isApprox(entry.pose) && camera == entry.camera) {
+      return entry.buffers;
+    }
+  }
+  cache_lock.unlock();
+  // Render without holding the lock so that multiple viewpoints can be rendered concurrently
+  std::shared_ptr<SoftwareRenderBuffers> buffers = std::make_shared<SoftwareRenderBuffers>();
+  software_renderer_->render(viewpoint, buffers.get());
+  cache_lock.lock();
+  const std::size_t max_cache_size = static_cast<std::size_t>(omp_get_max_threads());
+  if (software_render_cache_.size() < max_cache_size) {
+    software_render_cache_.push_back({pose, camera, buffers});
+  }
+  else {
+    software_render_cache_next_ %= software_render_cache_.size();
+    software_render_cache_[software_render_cache_next_] = {pose, camera, buffers};
+    ++software_render_cache_next_;
+  }
+  return buffers;
+}
+
+QImage ViewpointOffscreenRenderer::encodeSoftwareRenderBuffers(
+        const SoftwareRenderBuffers& buffers,
+        const std::function<QRgb(const SoftwareRenderBuffers&, const std::size_t, const std::size_t)>& encode) const {
+  // Pixels without a triangle have the clear color of the OpenGL renderer
+  const QRgb invalid_pixel = qRgb(255, 255, 255);
+  QImage image(buffers.width(), buffers.height(), QImage::Format_ARGB32);
+  for (std::size_t y = 0; y < buffers.height(); ++y) {
+    QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+    for (std::size_t x = 0; x < buffers.width(); ++x) {
+      line[x] = buffers.isValid(x, y) ? encode(buffers, x, y) : invalid_pixel;
+    }
+  }
+  return image;
+}
+
+}
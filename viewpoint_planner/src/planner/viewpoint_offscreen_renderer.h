@@ -9,9 +9,12 @@
 #pragma once
 
 #include <bh/color.h>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include "viewpoint_planner_types.h"
 #include "viewpoint.h"
+#include "viewpoint_software_renderer.h"
 
 #if WITH_OPENGL_OFFSCREEN
 #include <QOpenGLContext>
@@ -36,6 +39,8 @@ public:
     Options() {
       addOption<bool>("dump_poisson_mesh_normals_image", &dump_poisson_mesh_normals_image);
       addOption<bool>("dump_poisson_mesh_depth_image", &dump_poisson_mesh_depth_image);
+      addOption<bool>("use_software_renderer", &use_software_renderer);
+      addOption<std::size_t>("software_renderer_tile_size", &software_renderer_tile_size);
     }
 
     ~Options() override {}
@@ -44,6 +49,10 @@ public:
     bool dump_poisson_mesh_normals_image = false;
     // Whether to dump the poisson mesh depth image after rendering
     bool dump_poisson_mesh_depth_image = false;
+    // Whether to render depth, normals and triangle indices with the CPU rasterizer instead of OpenGL
+    bool use_software_renderer = false;
+    // Width and height of the screen tiles of the CPU rasterizer
+    std::size_t software_renderer_tile_size = 32;
   };
 
   explicit ViewpointOffscreenRenderer(const PinholeCamera& camera, const MeshType* poisson_mesh);
@@ -137,6 +146,11 @@ public:
           const Viewpoint& viewpoint,
           const std::size_t x, const std::size_t y) const;
 
+  /// Depth along the optical axis for all pixels (indexed by (y, x), infinity if no triangle is visible).
+  ///
+  /// With the software renderer the depth is copied from the rendered buffers without encoding it into an image.
+  bh::EigenTypes<FloatType>::MatrixDynamic computePoissonMeshDepthImage(const Viewpoint& viewpoint) const;
+
   bh::Color4<uint8_t> encodeDepthValue(const FloatType depth) const;
 
   FloatType decodeDepthValue(const QImage& depth_image, const Vector2& image_point) const;
@@ -153,9 +167,29 @@ public:
 
   std::unordered_set<size_t> getVisibleTriangles(const QImage& mesh_indices_image) const;
 
+  /// Whether depth, normals and triangle indices are rendered with the CPU rasterizer
+  bool isUsingSoftwareRenderer() const;
+
+  /// Render depth, normals and triangle indices of the poisson mesh into caller-owned buffers.
+  ///
+  /// Only available when the software renderer is used. Can be called concurrently for different viewpoints.
+  void renderPoissonMesh(const Viewpoint& viewpoint, SoftwareRenderBuffers* buffers) const;
+
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
 private:
+  struct SoftwareRenderCacheEntry {
+    Pose pose;
+    PinholeCamera camera;
+    std::shared_ptr<const SoftwareRenderBuffers> buffers;
+  };
+
+  std::shared_ptr<const SoftwareRenderBuffers> getCachedSoftwareRenderBuffers(const Viewpoint& viewpoint) const;
+
+  QImage encodeSoftwareRenderBuffers(
+          const SoftwareRenderBuffers& buffers,
+          const std::function<QRgb(const SoftwareRenderBuffers&, const std::size_t, const std::size_t)>& encode) const;
+
   Options options_;
 
   mutable std::mutex opengl_mutex_;
@@ -174,6 +208,13 @@ private:
   mutable Pose cached_poisson_mesh_depth_pose_;
   mutable QImage cached_poisson_mesh_depth_image_;
 
+  std::unique_ptr<ViewpointSoftwareRenderer> software_renderer_;
+  // Recently rendered buffers of the software renderer (one per thread so that concurrent queries do not evict
+  // each other)
+  mutable std::mutex software_render_cache_mutex_;
+  mutable std::vector<SoftwareRenderCacheEntry> software_render_cache_;
+  mutable std::size_t software_render_cache_next_;
+
   PinholeCamera camera_;
   qreal near_plane_;
   qreal far_plane_;
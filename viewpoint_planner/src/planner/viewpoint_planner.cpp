@@ -32,6 +32,24 @@ ViewpointPlanner::ViewpointPlanner(
 #if WITH_CUDA
   raycaster_.setEnableCuda(options_.enable_cuda);
 #endif
+  raycaster_.setEnableCpuPacketRaycast(options_.enable_cpu_packet_raycast);
+  const std::size_t bytes_per_megabyte = 1024 * 1024;
+  cached_visible_voxels_.reset(
+          options_.visible_voxels_cache_max_megabytes * bytes_per_megabyte, options_.visibility_cache_num_shards,
+          [](const VisibleVoxelIndices& visible_voxels) {
+            return visible_voxels.capacity() * sizeof(VisibleVoxelIndices::value_type);
+          });
+  cached_visible_sparse_points_.reset(
+          options_.visible_sparse_points_cache_max_megabytes * bytes_per_megabyte, options_.visibility_cache_num_shards,
+          [](const VisibleSparsePoints& visible_sparse_points) {
+            return visible_sparse_points.getMemoryUsage();
+          });
+  visible_voxels_min_hash_ = bh::MinHash(options_.sparse_matching_voxels_sketch_num_hashes);
+  cached_visible_voxels_sketches_.reset(
+          0, options_.visibility_cache_num_shards,
+          [](const bh::MinHashSketch& sketch) {
+            return sketch.getMemoryUsage();
+          });
   size_t random_seed = options_.rng_seed;
   if (random_seed == 0) {
     random_seed = std::chrono::system_clock::now().time_since_epoch().count();
@@ -134,6 +152,7 @@ void ViewpointPlanner::reset() {
   std::fill(grid_cell_probabilities_.begin(), grid_cell_probabilities_.end(), 1 / FloatType(grid_cell_probabilities_.size()));
   cached_visible_sparse_points_.clear();
   cached_visible_voxels_.clear();
+  cached_visible_voxels_sketches_.clear();
   viewpoint_paths_initialized_ = false;
   viewpoint_paths_.clear();
   viewpoint_paths_.resize(options_.viewpoint_path_branches);
@@ -258,6 +277,25 @@ auto ViewpointPlanner::findViewpointEntryWithPose(const Pose& pose) const -> std
   return std::make_pair(found, matching_viewpoint_index);
 }
 
+auto ViewpointPlanner::getVoxelWithInformationSet(const VoxelIndexWithInformationSet& voxel_set) const
+    -> VoxelWithInformationSet {
+  VoxelWithInformationSet voxel_pointer_set;
+  voxel_pointer_set.reserve(voxel_set.size());
+  for (const VoxelIndexWithInformation& vi : voxel_set) {
+    voxel_pointer_set.emplace(getVoxel(vi.index), vi.information);
+  }
+  return voxel_pointer_set;
+}
+
+auto ViewpointPlanner::getVoxelMap(const DenseVoxelMap& voxel_map) const -> VoxelMap {
+  VoxelMap voxel_pointer_map;
+  voxel_pointer_map.reserve(voxel_map.size());
+  for (const VoxelIndex voxel_index : voxel_map.getIndices()) {
+    voxel_pointer_map.emplace(getVoxel(voxel_index), voxel_map.at(voxel_index));
+  }
+  return voxel_pointer_map;
+}
+
 const ViewpointPlanner::Options& ViewpointPlanner::getOptions() const {
   return options_;
 }
@@ -24,6 +24,9 @@
 #include <bh/random.h>
 #include <bh/eigen_utils.h>
 #include <bh/graph_boost.h>
+#include <bh/lazy_greedy_queue.h>
+#include <bh/min_hash.h>
+#include <bh/sharded_lru_cache.h>
 #include <bh/math/continuous_grid3d.h>
 #include <bh/nn/approximate_nearest_neighbor.h>
 #include <bh/opengl/offscreen_opengl.h>
@@ -37,6 +40,8 @@
 #include "viewpoint_raycast.h"
 #include "viewpoint_score.h"
 #include "viewpoint_offscreen_renderer.h"
+#include "viewpoint_motion_distance_oracle.h"
+#include "voxel_index_set.h"
 #include "motion_planner.h"
 
 using reconstruction::CameraId;
@@ -69,9 +74,12 @@ public:
 #if WITH_CUDA
       addOption<bool>("enable_cuda", &enable_cuda);
 #endif
+      addOption<bool>("enable_cpu_packet_raycast", &enable_cpu_packet_raycast);
       addOption<bool>("enable_opengl", &enable_opengl);
       addOption<bool>("dump_poisson_mesh_normals_image", &dump_poisson_mesh_normals_image);
       addOption<bool>("dump_poisson_mesh_depth_image", &dump_poisson_mesh_depth_image);
+      addOption<bool>("use_software_renderer", &use_software_renderer);
+      addOption<size_t>("software_renderer_tile_size", &software_renderer_tile_size);
       addOption<bool>("dump_stereo_matching_images", &dump_stereo_matching_images);
       addOption<size_t>("rng_seed", &rng_seed);
       addOption<FloatType>("virtual_camera_scale", &virtual_camera_scale);
@@ -136,6 +144,9 @@ public:
       addOption<bool>("viewpoint_path_compute_tour_incremental", &viewpoint_path_compute_tour_incremental);
       addOption<bool>("viewpoint_path_conservative_sparse_matching_incremental", &viewpoint_path_conservative_sparse_matching_incremental);
       addOption<FloatType>("viewpoint_path_time_constraint", &viewpoint_path_time_constraint);
+      addOption<FloatType>("viewpoint_path_lazy_greedy_epsilon", &viewpoint_path_lazy_greedy_epsilon);
+      addOption<size_t>("viewpoint_path_stochastic_greedy_sample_size", &viewpoint_path_stochastic_greedy_sample_size);
+      addOption<size_t>("viewpoint_path_information_batch_size", &viewpoint_path_information_batch_size);
       addOption<FloatType>("objective_parameter_alpha", &objective_parameter_alpha);
       addOption<FloatType>("objective_parameter_beta", &objective_parameter_beta);
       addOption<FloatType>("voxel_sensor_size_ratio_threshold", &voxel_sensor_size_ratio_threshold);
@@ -162,10 +173,19 @@ public:
       addOption<size_t>("sparse_matching_observation_count_threshold", &sparse_matching_observation_count_threshold);
       addOption<size_t>("sparse_matching_render_tree_depth", &sparse_matching_render_tree_depth);
       addOption<bool>("sparse_matching_dump_voxel_images", &sparse_matching_dump_voxel_images);
+      addOption<bool>("sparse_matching_voxels_sketch_enable", &sparse_matching_voxels_sketch_enable);
+      addOption<size_t>("sparse_matching_voxels_sketch_num_hashes", &sparse_matching_voxels_sketch_num_hashes);
+      addOption<FloatType>("sparse_matching_voxels_sketch_num_std_devs", &sparse_matching_voxels_sketch_num_std_devs);
+      addOption<size_t>("visible_voxels_cache_max_megabytes", &visible_voxels_cache_max_megabytes);
+      addOption<size_t>("visible_sparse_points_cache_max_megabytes", &visible_sparse_points_cache_max_megabytes);
+      addOption<size_t>("visibility_cache_num_shards", &visibility_cache_num_shards);
       addOption<bool>("viewpoint_path_2opt_enable", &viewpoint_path_2opt_enable);
       addOption<size_t>("viewpoint_path_2opt_max_k_length", &viewpoint_path_2opt_max_k_length);
+      addOption<size_t>("viewpoint_path_2opt_num_neighbors", &viewpoint_path_2opt_num_neighbors);
+      addOption<size_t>("viewpoint_path_or_opt_max_segment_length", &viewpoint_path_or_opt_max_segment_length);
       addOption<bool>("viewpoint_path_2opt_check_sparse_matching", &viewpoint_path_2opt_check_sparse_matching);
       addOption<std::string>("viewpoint_graph_filename", &viewpoint_graph_filename);
+      addOption<bool>("viewpoint_graph_save_flat_file", &viewpoint_graph_save_flat_file);
       // TODO:
       addOption<size_t>("num_sampled_poses", &num_sampled_poses);
       addOption<size_t>("num_planned_viewpoints", &num_planned_viewpoints);
@@ -178,12 +198,18 @@ public:
     // Whether to enable CUDA
     bool enable_cuda = true;
 #endif
+    // Whether to trace ray packets on multiple threads when raycasting on the CPU
+    bool enable_cpu_packet_raycast = true;
     // Whether to enable OpenGL
     bool enable_opengl = true;
     // Whether to dump the poisson mesh normals image after rendering
     bool dump_poisson_mesh_normals_image = false;
     // Whether to dump the poisson mesh depth image after rendering
     bool dump_poisson_mesh_depth_image = false;
+    // Whether to render poisson mesh depth and normals with the CPU rasterizer instead of OpenGL
+    bool use_software_renderer = false;
+    // Width and height of the screen tiles of the CPU rasterizer
+    size_t software_renderer_tile_size = 32;
     // Whether to write out stereo matching image pairs when generating viewpoint path
     bool dump_stereo_matching_images = false;
 
@@ -312,6 +338,13 @@ public:
     bool viewpoint_path_conservative_sparse_matching_incremental = false;
     // Maximum time constraint for viewpoint path
     FloatType viewpoint_path_time_constraint = std::numeric_limits<FloatType>::max();
+    // Accept a lazily re-evaluated viewpoint if its information is within this ratio of the best upper bound
+    // (0 gives exact lazy greedy selection)
+    FloatType viewpoint_path_lazy_greedy_epsilon = 0;
+    // Number of randomly sampled candidates for stochastic greedy selection (0 considers all viewpoints)
+    size_t viewpoint_path_stochastic_greedy_sample_size = 0;
+    // Number of stale candidates whose information is re-evaluated in parallel (0 evaluates one by one)
+    size_t viewpoint_path_information_batch_size = 0;
 
     // Objective factor for reconstruction image
     FloatType objective_parameter_alpha = 0;
@@ -362,16 +395,36 @@ public:
     size_t sparse_matching_observation_count_threshold = 0;
     size_t sparse_matching_render_tree_depth = 14;
     bool sparse_matching_dump_voxel_images = false;
+    // Whether to reject sparse matchability early from MinHash sketches of the visible voxels when the estimated IOU
+    // is clearly below the threshold (the exact IOU is still computed for all other pairs)
+    bool sparse_matching_voxels_sketch_enable = true;
+    // Number of min-hash values (bins) of the visible voxel sketches
+    size_t sparse_matching_voxels_sketch_num_hashes = 128;
+    // Number of standard deviations of the estimated IOU that a sketch decision has to be away from the threshold
+    FloatType sparse_matching_voxels_sketch_num_std_devs = 3;
+    // Memory budget of the cached visible voxels of viewpoints (0 means unlimited)
+    size_t visible_voxels_cache_max_megabytes = 0;
+    // Memory budget of the cached visible sparse points of viewpoints (0 means unlimited)
+    size_t visible_sparse_points_cache_max_megabytes = 0;
+    // Number of independently locked shards of the visibility caches
+    size_t visibility_cache_num_shards = 16;
 
     // Whether to enable 2 Opt
     bool viewpoint_path_2opt_enable = true;
-    // Maximum segment length that is reversed by 2 Opt
-    size_t viewpoint_path_2opt_max_k_length = 15;
+    // Maximum segment length that is reversed by 2 Opt (0 means unlimited)
+    size_t viewpoint_path_2opt_max_k_length = 0;
+    // Number of nearest neighbors of each viewpoint that are considered for new tour edges by 2 Opt and Or Opt
+    size_t viewpoint_path_2opt_num_neighbors = 10;
+    // Maximum number of consecutive viewpoints that are moved by Or Opt (0 disables Or Opt)
+    size_t viewpoint_path_or_opt_max_segment_length = 3;
     // Whether sparse matchability is checked for 2 Opt
     bool viewpoint_path_2opt_check_sparse_matching = true;
 
     // Filename of serialized viewpoint graph
     std::string viewpoint_graph_filename = "";
+    // Whether viewpoint graphs are saved as memory mapped flat files instead of Boost archives
+    // (both formats can be loaded)
+    bool viewpoint_graph_save_flat_file = true;
 
     // TODO: Needed?
     size_t num_sampled_poses = 100;
@@ -411,6 +464,10 @@ public:
   using VoxelWithInformation = viewpoint_planner::VoxelWithInformation;
   using VoxelWithInformationSet = viewpoint_planner::VoxelWithInformationSet;
   using VoxelMap = viewpoint_planner::VoxelMap;
+  using VoxelIndex = viewpoint_planner::VoxelIndex;
+  using VoxelIndexWithInformation = viewpoint_planner::VoxelIndexWithInformation;
+  using VoxelIndexWithInformationSet = viewpoint_planner::VoxelIndexWithInformationSet;
+  using DenseVoxelMap = viewpoint_planner::DenseVoxelMap;
 
   /// Describes a viewpoint, the set of voxels observed by it and the corresponding information
   struct ViewpointEntry {
@@ -422,7 +479,7 @@ public:
     : viewpoint(viewpoint), total_information(total_information), voxel_set(voxel_set) {}
 
     ViewpointEntry(const Viewpoint& viewpoint, const FloatType total_information,
-        VoxelWithInformationSet&& voxel_set)
+        VoxelIndexWithInformationSet&& voxel_set)
     : viewpoint(viewpoint), total_information(total_information), voxel_set(std::move(voxel_set)) {}
 
     ViewpointEntry(const ViewpointEntry& other)
@@ -454,7 +511,8 @@ public:
     // TODO: Only store pose and not viewpoint.
     Viewpoint viewpoint;
     FloatType total_information;
-    VoxelWithInformationSet voxel_set;
+    // Observed voxels sorted by their index
+    VoxelIndexWithInformationSet voxel_set;
 
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   };
@@ -462,6 +520,26 @@ public:
   using ViewpointEntryVector = std::vector<ViewpointEntry>;
   using ViewpointEntryIndex = ViewpointEntryVector::size_type;
 
+  /// Sorted indices of the voxels that are visible from a viewpoint
+  using VisibleVoxelIndices = std::vector<std::uint32_t>;
+
+  /// Sparse points that are visible from a viewpoint and their normal vectors (sorted by point id)
+  struct VisibleSparsePoints {
+    VisibleSparsePoints() {}
+
+    explicit VisibleSparsePoints(const std::unordered_map<Point3DId, Vector3>& point_normals);
+
+    std::size_t size() const {
+      return point3d_ids.size();
+    }
+
+    /// Number of bytes occupied by the arrays
+    std::size_t getMemoryUsage() const;
+
+    std::vector<Point3DId> point3d_ids;
+    std::vector<Vector3> normals;
+  };
+
   // Pair of indices to index viewpoint motions
   struct ViewpointIndexPair {
     ViewpointIndexPair()
@@ -702,8 +780,8 @@ public:
     std::vector<size_t> order;
 //    // Set of voxels that are observed on the whole path
 //    VoxelWithInformationSet observed_voxel_set;
-    // Map with voxels and partial information on the whole path
-    VoxelMap observed_voxel_map;
+    // Map with voxels and partial information on the whole path (indexed by voxel index)
+    DenseVoxelMap observed_voxel_map;
     // Accumulated information over the whole path
     FloatType acc_information;
     // Accumulated motion distance over the whole path
@@ -725,9 +803,11 @@ public:
     }
   };
 
+  using NewInformationQueue = bh::LazyGreedyQueue<ViewpointEntryIndex, FloatType>;
+
   struct ViewpointPathComputationData {
-    // Viewpoint entries sorted by ascending order of their novel information for the corresponding viewpoint
-    std::vector<std::tuple<ViewpointEntryIndex, FloatType, bool>> sorted_new_informations;
+    // Viewpoint entries with their lazily updated novel information for the corresponding viewpoint
+    NewInformationQueue new_informations;
     // Number of viewpoints in the entries array that have been connected to each other
     size_t num_connected_entries = 0;
     struct VoxelTriangulation {
@@ -812,8 +892,15 @@ public:
 
   void setViewpointPathTimeConstraint(const FloatType time_constraint);
 
+  /// Save the viewpoint graph in the format selected by the options
   void saveViewpointGraph(const std::string& filename) const;
 
+  void saveViewpointGraphAsBoostArchive(const std::string& filename) const;
+
+  /// Save the viewpoint graph as a versioned flat file with checksums that is memory mapped when loading
+  void saveViewpointGraphAsFlatFile(const std::string& filename) const;
+
+  /// Load a viewpoint graph (the file format is detected automatically)
   void loadViewpointGraph(const std::string& filename);
 
   void saveViewpointPath(const std::string& filename) const;
@@ -889,9 +976,30 @@ public:
   std::unordered_map<Point3DId, ViewpointPlanner::Vector3> computeVisibleSparsePoints(const Viewpoint& viewpoint) const;
 
   // Return visible sparse points for a specific viewpoint entry (computes them if not already cached)
-  const std::unordered_map<Point3DId, ViewpointPlanner::Vector3>& getCachedVisibleSparsePoints(const ViewpointEntryIndex viewpoint_index) const;
+  std::shared_ptr<const VisibleSparsePoints> getCachedVisibleSparsePoints(const ViewpointEntryIndex viewpoint_index) const;
+
+  // Return visible voxels for a specific viewpoint entry (computes them if not already cached)
+  std::shared_ptr<const VisibleVoxelIndices> getCachedVisibleVoxels(const ViewpointEntryIndex viewpoint_index) const;
+
+  // Return MinHash sketch of the visible voxels for a specific viewpoint entry (computes it if not already cached)
+  std::shared_ptr<const bh::MinHashSketch> getCachedVisibleVoxelsSketch(const ViewpointEntryIndex viewpoint_index) const;
+
+  // Compute the visible voxels (and sketches) of the viewpoint entries in the calling thread and pin them in the cache.
+  // Used before parallel passes so that the entries are neither rendered in the worker threads nor evicted during the pass.
+  void pinCachedVisibleVoxels(const std::vector<ViewpointEntryIndex>& viewpoint_indices) const;
 
-  const std::unordered_set<size_t>& getCachedVisibleVoxels(const ViewpointEntryIndex viewpoint_index) const;
+  // Undo pinCachedVisibleVoxels() after a parallel pass
+  void unpinCachedVisibleVoxels(const std::vector<ViewpointEntryIndex>& viewpoint_indices) const;
+
+  bh::MinHashSketch computeVisibleVoxelsSketch(const VisibleVoxelIndices& visible_voxels) const;
+
+  /// Compare the estimated IOU of two visible voxel sketches with a threshold.
+  /// Returns bh::MinHash::UNCERTAIN if sketches are disabled or the estimate is too close to the threshold.
+  bh::MinHash::Comparison compareVisibleVoxelsSketches(
+          const bh::MinHashSketch& sketch1, const bh::MinHashSketch& sketch2, const FloatType iou_threshold) const;
+
+  /// Print hit, miss and eviction counts and memory usage of the visible voxels and sparse points caches
+  void printVisibilityCacheStatistics() const;
 
 //  FloatType computeSparseMatchingScore(
 //          const Viewpoint& ref_viewpoint, const Viewpoint& other_viewpoint,
@@ -903,6 +1011,11 @@ public:
       const std::unordered_map<Point3DId, Vector3>& ref_visible_points,
       const std::unordered_map<Point3DId, Vector3>& other_visible_points) const;
 
+  FloatType computeSparseMatchingScore(
+      const Viewpoint& ref_viewpoint, const Viewpoint& other_viewpoint,
+      const VisibleSparsePoints& ref_visible_points,
+      const VisibleSparsePoints& other_visible_points) const;
+
   FloatType computeSparseMatchingScore(
       const Viewpoint& ref_viewpoint, const Viewpoint& other_viewpoint) const;
 
@@ -941,8 +1054,8 @@ public:
   bool isSparseMatchable2(
           const Viewpoint& viewpoint1,
           const Viewpoint& viewpoint2,
-          const std::unordered_set<size_t>& visible_voxels1,
-          const std::unordered_set<size_t>& visible_voxels2) const;
+          const VisibleVoxelIndices& visible_voxels1,
+          const VisibleVoxelIndices& visible_voxels2) const;
 
   bool isSparseMatchable2(
           const Viewpoint& viewpoint1, const Viewpoint& viewpoint2,
@@ -961,19 +1074,19 @@ public:
   bool isSparseMatchable2(
           const Viewpoint& viewpoint1,
           const Viewpoint& viewpoint2,
-          const std::unordered_set<size_t>& visible_voxels1,
-          const std::unordered_set<size_t>& visible_voxels2,
+          const VisibleVoxelIndices& visible_voxels1,
+          const VisibleVoxelIndices& visible_voxels2,
           const FloatType iou_threshold) const;
 
   bool isSparseMatchable2(
           const ViewpointEntryIndex viewpoint_index1,
           const Viewpoint& viewpoint2,
-          const std::unordered_set<size_t>& visible_voxels2) const;
+          const VisibleVoxelIndices& visible_voxels2) const;
 
   bool isSparseMatchable2(
           const ViewpointEntryIndex viewpoint_index1,
           const Viewpoint& viewpoint2,
-          const std::unordered_set<size_t>& visible_voxels2,
+          const VisibleVoxelIndices& visible_voxels2,
           const FloatType iou_threshold) const;
 
   void augmentViewpointPathWithSparseMatchingViewpoints(ViewpointPath* viewpoint_path);
@@ -1025,6 +1138,16 @@ public:
     return data_->occupied_bvh_;
   }
 
+  /// Voxel with the given index (see VoxelIndexWithInformationSet)
+  const VoxelType* getVoxel(const VoxelIndex voxel_index) const {
+    return data_->occupied_bvh_.getNode(voxel_index);
+  }
+
+  /// Convert voxel indices back to voxel pointers (i.e. for visualization)
+  VoxelWithInformationSet getVoxelWithInformationSet(const VoxelIndexWithInformationSet& voxel_set) const;
+
+  VoxelMap getVoxelMap(const DenseVoxelMap& voxel_map) const;
+
   bool hasReconstruction() const {
       return static_cast<bool>(data_->reconstruction_);
   }
@@ -1361,7 +1484,7 @@ public:
 
   // Visible voxel computation
 
-  std::unordered_set<size_t> getVisibleVoxels(const Viewpoint& viewpoint) const;
+  VisibleVoxelIndices getVisibleVoxels(const Viewpoint& viewpoint) const;
 
   // Raycasting and information computation
 
@@ -1544,6 +1667,13 @@ private:
   WeightType computeIncidenceInformationFactor(
       const Viewpoint& viewpoint, const VoxelType* node, const Vector2& screen_coordinates) const;
 
+  void loadViewpointGraphFromBoostArchive(const std::string& filename);
+
+  void loadViewpointGraphFromFlatFile(const std::string& filename);
+
+  /// Rebuild the approximate nearest neighbor index and the density field after loading viewpoint entries
+  void rebuildViewpointEntryIndices();
+
   /// Add a viewpoint entry without acquiring a lock. Returns the index of the new viewpoint entry.
   ViewpointEntryIndex addViewpointEntryWithoutLock(
           ViewpointEntry&& viewpoint_entry, const bool ignore_viewpoint_count_grid = false);
@@ -1566,7 +1696,7 @@ private:
   /// Updates observed voxel set of a viewpoint path. Returns the novel information.
   FloatType addObservedVoxelsToViewpointPath(ViewpointPath* viewpoint_path,
                                                                ViewpointPathComputationData* comp_data,
-                                                               const VoxelWithInformationSet& voxel_set);
+                                                               const VoxelIndexWithInformationSet& voxel_set);
 
   /// Add stereo viewpoint to a viewpoint path
   std::pair<size_t, size_t> addStereoViewpointPathEntryWithoutLock(ViewpointPath *viewpoint_path, ViewpointPathComputationData *comp_data,
@@ -1604,6 +1734,12 @@ private:
   std::vector<std::pair<ViewpointEntryIndex, SE3Motion>> findSE3Motions(
           const Pose& from_pose);
 
+  /// Find a motion path between two viewpoints. Returns false if no valid motion exists.
+  ///
+  /// Can be called concurrently (i.e. the visible voxels of both viewpoints should already be cached).
+  bool findViewpointMotion(const ViewpointEntryIndex from_index, const ViewpointEntryIndex to_index,
+                           ViewpointMotion* motion, const bool verbose = false);
+
   /// Find motion paths from provided viewpoint to neighbors in the viewpoint graph.
   std::vector<ViewpointMotion> findViewpointMotions(
           const ViewpointEntryIndex from_index, const bool verbose = false);
@@ -1654,12 +1790,25 @@ private:
   /// Reorders the viewpoint path to an approx. shortest cycle covering all viewpoints (i.e. TSP solution)
   bool solveApproximateTSP(ViewpointPath* viewpoint_path, ViewpointPathComputationData* comp_data);
 
-  /// Uses 2 Opt to improve the viewpoint tour
+  /// Uses 2 Opt and Or Opt local search to improve the viewpoint tour
   void improveViewpointTourWith2Opt(ViewpointPath* viewpoint_path, ViewpointPathComputationData* comp_data);
 
   /// Find shortest motion between two viewpoints using A-Star on the viewpoint graph.
   ViewpointMotion findShortestMotionAStar(const ViewpointEntryIndex from_index, const ViewpointEntryIndex to_index) const;
 
+  /// Cost of a viewpoint graph edge for shortest motion searches
+  FloatType getViewpointMotionSearchCost(const FloatType edge_weight) const;
+
+  /// Admissible A-Star heuristic for the search cost of a motion between two viewpoints (based on their Euclidean distance)
+  FloatType computeViewpointMotionSearchCostLowerBound(
+          const ViewpointEntryIndex from_index, const ViewpointEntryIndex to_index) const;
+
+  /// Concatenate the motions along a path of viewpoints in the graph
+  ViewpointMotion getViewpointMotionAlongPath(const std::vector<ViewpointEntryIndex>& viewpoint_indices) const;
+
+  /// Create a distance oracle on the viewpoint graph with the same edge costs as the shortest motion search
+  viewpoint_planner::ViewpointMotionDistanceOracle createViewpointMotionDistanceOracle(const bool reconstruct_paths) const;
+
   /// Optimize viewpoint motion by reducing redundant in-between viewpoints
   ViewpointMotion optimizeViewpointMotion(const ViewpointMotion& motion) const;
 
@@ -1673,11 +1822,6 @@ private:
   /// Computes the length of a viewpoint tour (cycle)
   FloatType computeTourLength(const ViewpointPath& viewpoint_path, const std::vector<size_t>& order) const;
 
-  /// Returns a new tour order where the path from k_start to k_end is reversed
-  std::vector<size_t> swap2Opt(
-      ViewpointPath* viewpoint_path, ViewpointPathComputationData* comp_data,
-      const size_t k_start, const size_t k_end) const;
-
   /// Create a subgraph with the nodes from a viewpoint path
   ViewpointPathGraphWrapper createViewpointPathGraph(const ViewpointPath& viewpoint_path, const ViewpointPathComputationData& comp_data);
 
@@ -1705,6 +1849,8 @@ private:
 
   mutable std::unique_ptr<bh::opengl::OffscreenOpenGL<FloatType>> offscreen_opengl_;
   mutable std::unique_ptr<rendering::OcTreeDrawer> octree_drawer_;
+  // Serializes rendering with the offscreen OpenGL context (there is only one context for all threads)
+  mutable std::mutex offscreen_opengl_mutex_;
 
   std::mutex mutex_;
 
@@ -1719,13 +1865,13 @@ private:
   // Flags indicating whether stereo viewpoint has been computed
   std::vector<bool> stereo_viewpoint_computed_flags_;
   // Cached visible sparse points and normals
-  mutable std::unordered_map<ViewpointEntryIndex, std::unordered_map<reconstruction::Point3DId, Vector3>> cached_visible_sparse_points_;
-  // Mutex for cached visible sparse points
-  mutable std::mutex cached_visible_sparse_points_mutex_;
+  mutable bh::ShardedLruCache<ViewpointEntryIndex, VisibleSparsePoints> cached_visible_sparse_points_;
   // Cached visible voxels
-  mutable std::unordered_map<ViewpointEntryIndex, std::unordered_set<size_t>> cached_visible_voxels_;
-  // Mutex for cached visible sparse points
-  mutable std::mutex cached_visible_voxels_mutex_;
+  mutable bh::ShardedLruCache<ViewpointEntryIndex, VisibleVoxelIndices> cached_visible_voxels_;
+  // MinHash for sketches of visible voxels
+  bh::MinHash visible_voxels_min_hash_;
+  // Cached sketches of visible voxels (these are small and stay cached if the visible voxels are evicted)
+  mutable bh::ShardedLruCache<ViewpointEntryIndex, bh::MinHashSketch> cached_visible_voxels_sketches_;
   // Number of real viewpoints at the beginning of the viewpoint_entries_ vector
   // These need to be distinguished because they could be in non-free space of the map
   size_t num_real_viewpoints_;
@@ -52,7 +52,7 @@ std::pair<bool, ViewpointPlanner::ViewpointEntryIndex> ViewpointPlanner::canVoxe
 template <typename Iterator>
 ViewpointPlanner::FloatType ViewpointPlanner::computeInformationScore(const Viewpoint& viewpoint, Iterator first, Iterator last) const {
   FloatType total_information = std::accumulate(first, last,
-      FloatType { 0 }, [](const FloatType& value, const VoxelWithInformation& vi) {
+      FloatType { 0 }, [](const FloatType& value, const typename std::iterator_traits<Iterator>::value_type& vi) {
         return value + vi.information;
   });
   return total_information;
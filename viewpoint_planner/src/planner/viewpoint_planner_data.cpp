@@ -5,6 +5,10 @@
  *      Author: bhepp
  */
 
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include <omp.h>
 #include <boost/filesystem.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
@@ -14,6 +18,7 @@
 #include <bh/eigen.h>
 #include <bh/gps.h>
 #include <bh/math/geometry.h>
+#include <bh/math/distance_transform.h>
 #include <bh/nn/approximate_nearest_neighbor.h>
 #include <bh/vision/cameras.h>
 #include "viewpoint_planner_data.h"
@@ -22,6 +27,31 @@
 #include "viewpoint_score.h"
 #include "viewpoint_offscreen_renderer.h"
 
+namespace {
+
+/// Largest index i in [begin, end) with lower_bounds[i] <= max_value and upper_bounds[i] >= min_value.
+///
+/// Both bounds have to be non-decreasing. Returns -1 if there is no such index.
+template <typename T, typename ValueT>
+std::ptrdiff_t findLastOverlappingInterval(
+        const std::vector<T>& lower_bounds, const std::vector<T>& upper_bounds,
+        const ValueT min_value, const ValueT max_value, const std::size_t begin, const std::size_t end) {
+  if (begin >= end) {
+    return -1;
+  }
+  const auto it = std::upper_bound(lower_bounds.begin() + begin, lower_bounds.begin() + end, max_value);
+  if (it == lower_bounds.begin() + begin) {
+    return -1;
+  }
+  const std::size_t index = static_cast<std::size_t>(it - lower_bounds.begin()) - 1;
+  if (upper_bounds[index] < min_value) {
+    return -1;
+  }
+  return static_cast<std::ptrdiff_t>(index);
+}
+
+}
+
 ViewpointPlannerData::ViewpointPlannerData(const Options* options)
 : options_(*options) {
   bvh_bbox_ = BoundingBoxType(
@@ -117,6 +147,10 @@ ViewpointPlannerData::ViewpointPlannerData(const Options* options)
   if (bvh_filename.empty()) {
     bvh_filename = octree_filename + ".bvh";
   }
+  std::string collision_map_filename = options->getValue<std::string>("collision_map_filename");
+  if (collision_map_filename.empty()) {
+    collision_map_filename = bvh_filename + ".esdf";
+  }
   std::string df_filename = options->getValue<std::string>("distance_field_filename");
   if (df_filename.empty()) {
     df_filename = mesh_filename + ".df.bs";
@@ -127,7 +161,10 @@ ViewpointPlannerData::ViewpointPlannerData(const Options* options)
   }
   readPoissonMesh(mesh_filename);
   bool augmented_octree_generated = readAndAugmentOctree(octree_filename, raw_octree_filename);
-  bool bvh_generated = readBVHTree(bvh_filename, octree_filename);
+  bool bvh_generated = readBVHTree(bvh_filename, octree_filename, mesh_filename);
+  if (options_.use_collision_map) {
+    readCollisionMap(collision_map_filename, octree_filename, bvh_generated);
+  }
   generateWeightGrid();
   bool df_generated = false;
   if (options_.use_distance_field) {
@@ -152,7 +189,8 @@ ViewpointPlannerData::ViewpointPlannerData(const Options* options)
     std::cout << "Writing updated augmented octree" << std::endl;
     octree_->write(octree_filename);
     std::cout << "Writing updated BVH tree" << std::endl;
-    writeBVHTree(bvh_filename);
+    viewpoint_planner::writeOccupiedTreeCache(
+            bvh_filename, occupied_bvh_, computeBVHCacheKey(octree_filename, mesh_filename));
   }
 }
 
@@ -225,15 +263,51 @@ bool ViewpointPlannerData::isValidObjectPosition(const Vector3& position, const
       cropped_maximum(2) = options_.obstacle_free_height;
       centered_object_bbox = BoundingBoxType(centered_object_bbox.getMinimum(), cropped_maximum);
     }
-    std::vector<ViewpointPlannerData::OccupiedTreeType::ConstBBoxIntersectionResult> results =
-            occupied_bvh_.intersects(centered_object_bbox);
-    return results.empty();
+    return !occupied_bvh_.overlapsAny(centered_object_bbox);
   }
   else {
     return false;
   }
 }
 
+bool ViewpointPlannerData::isValidObjectSegment(const Vector3& from, const Vector3& to,
+                                                const BoundingBoxType& object_bbox, const FloatType step_distance,
+                                                const bool ignore_no_fly_zones) const {
+  const FloatType distance = (to - from).norm();
+  const Vector3 direction = (to - from).normalized();
+  // No-fly zones are not part of the collision map so free space can only be skipped if they are ignored
+  const bool use_collision_map = ignore_no_fly_zones && options_.use_collision_map && !collision_map_.isEmpty();
+  // Radius of a sphere enclosing the object
+  const FloatType object_radius = object_bbox.getMinimum().cwiseAbs().cwiseMax(object_bbox.getMaximum().cwiseAbs()).norm();
+  FloatType accumulated_distance = 0;
+  while (accumulated_distance < distance) {
+    const Vector3 position = from + accumulated_distance * direction;
+    if (use_collision_map && position(2) < options_.obstacle_free_height) {
+      // Any position within the free distance is valid as long as it is inside of the map
+      const FloatType free_distance = collision_map_.getClearance(position) - object_radius;
+      if (free_distance > step_distance) {
+        const FloatType next_distance = std::min(accumulated_distance + free_distance, distance);
+        if (collision_map_.getBoundingBox().isInside(from + next_distance * direction)) {
+          accumulated_distance = next_distance;
+          continue;
+        }
+      }
+    }
+    if (!isValidObjectPosition(position, object_bbox, ignore_no_fly_zones)) {
+      return false;
+    }
+    accumulated_distance += step_distance;
+    if (accumulated_distance > distance) {
+      accumulated_distance = distance;
+    }
+  }
+  return true;
+}
+
+const viewpoint_planner::CollisionMap& ViewpointPlannerData::getCollisionMap() const {
+  return collision_map_;
+}
+
 const reconstruction::DenseReconstruction& ViewpointPlannerData::getReconstruction() const {
   return *reconstruction_;
 }
@@ -323,7 +397,8 @@ void ViewpointPlannerData::readPoissonMesh(const std::string& mesh_filename) {
   std::cout << "Number of normals in mesh: " << poisson_mesh_->m_Normals.size() << std::endl;
 }
 
-bool ViewpointPlannerData::readBVHTree(std::string bvh_filename, const std::string& octree_filename) {
+bool ViewpointPlannerData::readBVHTree(std::string bvh_filename, const std::string& octree_filename,
+                                       const std::string& mesh_filename) {
 #if WITH_CUDA
   if (options_.enable_cuda) {
     std::cout << "Selecting CUDA device " << options_.cuda_gpu_id << std::endl;
@@ -335,13 +410,24 @@ bool ViewpointPlannerData::readBVHTree(std::string bvh_filename, const std::stri
   }
 #endif
 
-  // Read cached BVH tree (if up-to-date) or generate it
+  // Read cached BVH tree (if it was built from the same octree with the same settings) or generate it
+  const BVHCacheKey cache_key = computeBVHCacheKey(octree_filename, mesh_filename);
   bool read_cached_tree = false;
   if (!options_.regenerate_bvh_tree && boost::filesystem::exists(bvh_filename)) {
-    if (boost::filesystem::last_write_time(bvh_filename) > boost::filesystem::last_write_time(octree_filename)) {
-      std::cout << "Loading up-to-date cached BVH tree." << std::endl;
-      readCachedBVHTree(bvh_filename);
+    if (viewpoint_planner::isOccupiedTreeCacheFile(bvh_filename)) {
+      std::cout << "Loading cached BVH tree." << std::endl;
+      read_cached_tree = viewpoint_planner::readOccupiedTreeCache(bvh_filename, &occupied_bvh_, &cache_key);
+      if (!read_cached_tree) {
+        std::cout << "Cached BVH tree is invalid or was built from a different octree or with different settings."
+                  << " Ignoring it." << std::endl;
+      }
+    }
+    else if (boost::filesystem::last_write_time(bvh_filename) > boost::filesystem::last_write_time(octree_filename)) {
+      std::cout << "Loading up-to-date cached BVH tree from Boost archive." << std::endl;
+      viewpoint_planner::readOccupiedTreeFromBoostArchive(bvh_filename, &occupied_bvh_);
       read_cached_tree = true;
+      std::cout << "Converting cached BVH tree to flat file." << std::endl;
+      viewpoint_planner::writeOccupiedTreeCache(bvh_filename, occupied_bvh_, cache_key);
     }
     else {
       std::cout << "Found cached BVH tree to be old. Ignoring it." << std::endl;
@@ -350,12 +436,39 @@ bool ViewpointPlannerData::readBVHTree(std::string bvh_filename, const std::stri
   if (!read_cached_tree) {
     std::cout << "Generating BVH tree." << std::endl;
     generateBVHTree(octree_.get());
-    writeBVHTree(bvh_filename);
+    viewpoint_planner::writeOccupiedTreeCache(bvh_filename, occupied_bvh_, cache_key);
   }
   std::cout << "BVH tree bounding box: " << occupied_bvh_.getRoot()->getBoundingBox() << std::endl;
   return !read_cached_tree;
 }
 
+bool ViewpointPlannerData::readCollisionMap(const std::string& collision_map_filename,
+                                            const std::string& octree_filename, const bool bvh_generated) {
+  // Read cached collision map (if up-to-date and built with the same settings) or generate it
+  bool read_cached_map = false;
+  if (!options_.regenerate_collision_map && !bvh_generated && boost::filesystem::exists(collision_map_filename)) {
+    if (boost::filesystem::last_write_time(collision_map_filename) > boost::filesystem::last_write_time(octree_filename)) {
+      std::cout << "Loading up-to-date cached collision map." << std::endl;
+      collision_map_.read(collision_map_filename);
+      read_cached_map = collision_map_.getRequestedResolution() == options_.collision_map_resolution
+          && collision_map_.getRequestedMaxNumVoxels() == options_.collision_map_max_num_voxels
+          && collision_map_.getBoundingBox() == occupied_bvh_.getRoot()->getBoundingBox();
+      if (!read_cached_map) {
+        std::cout << "Cached collision map was built with different settings. Ignoring it." << std::endl;
+      }
+    }
+    else {
+      std::cout << "Found cached collision map to be old. Ignoring it." << std::endl;
+    }
+  }
+  if (!read_cached_map) {
+    std::cout << "Generating collision map." << std::endl;
+    collision_map_.build(occupied_bvh_, options_.collision_map_resolution, options_.collision_map_max_num_voxels);
+    collision_map_.write(collision_map_filename);
+  }
+  return !read_cached_map;
+}
+
 bool ViewpointPlannerData::readMeshDistanceField(std::string df_filename, const std::string& mesh_filename) {
   // Read cached distance field (if up-to-date) or generate it.
   bool read_cached_df = false;
@@ -415,6 +528,7 @@ void ViewpointPlannerData::_writeMeshDistanceField(const std::string& filename,
 }
 
 void ViewpointPlannerData::updateWeights() {
+  bh::Timer timer;
   for (auto it = octree_->begin_tree(); it != octree_->end_tree(); ++it) {
     it->setWeight(0);
   }
@@ -432,67 +546,131 @@ void ViewpointPlannerData::updateWeights() {
   }
 //  std::cout << "min_distance: " << min_distance << std::endl;
 //  std::cout << "max_distance: " << max_distance << std::endl;
-//  FloatType max_weight = std::numeric_limits<FloatType>::lowest();
-//  FloatType min_weight = std::numeric_limits<FloatType>::max();
-//  const BoundingBoxType roi_bbox = roi_.getBoundingBox();
-  for (int ix = 0; ix < grid_dim_(0); ++ix) {
-    for (int iy = 0; iy < grid_dim_(1); ++iy) {
-      for (int iz = 0; iz < grid_dim_(2); ++iz) {
-        const BoundingBoxType::Vector3 xyz = getGridPosition(ix, iy, iz);
-//        std::cout << "roi_distance=" << roi_distance << ", roi_weight=" << roi_weight << std::endl;
-        FloatType roi_weight = 1;
-//        if (roi_.isPointOutside(xyz) != roi_bbox.isOutside(xyz)) {
-//          BH_PRINT_VAR(roi_.isPointOutside(xyz));
-//          BH_PRINT_VAR(roi_bbox.isOutside(xyz));
-//          BH_PRINT_VAR(xyz);
-//        }
-        if (roi_.isPointOutside(xyz)) {
-//        if (roi_bbox.isOutside(xyz)) {
-          FloatType roi_distance = roi_.distanceToPoint(xyz);
-//          FloatType roi_distance = roi_bbox.distanceTo(xyz);
-          roi_distance = std::min(roi_distance, options_.roi_falloff_distance);
-          roi_weight = (options_.roi_falloff_distance - roi_distance) / options_.roi_falloff_distance;
-        }
-        WeightType weight;
-        if (options_.use_distance_field) {
-          const FloatType distance = distance_field_(ix, iy, iz);
-          if (distance <= options_.weight_falloff_distance_start) {
-            weight = roi_weight;
-          }
-          else {
-            const FloatType inv_distance = (max_distance - distance) / (max_distance - options_.weight_falloff_distance_start);
-            if (options_.weight_falloff_quadratic) {
-              weight = roi_weight * inv_distance * inv_distance;
-            }
-            else {
-              weight = roi_weight * inv_distance;
-            }
-          }
-        }
-        else {
-          weight = roi_weight;
-        }
-        const BoundingBoxType bbox(xyz, grid_increment_);
-        const std::vector<OccupiedTreeType::BBoxIntersectionResult> results =
-            occupied_bvh_.intersects(bbox);
-        for (const OccupiedTreeType::BBoxIntersectionResult& result : results) {
-          WeightType observation_count_factor = computeObservationCountFactor(result.node->getObject()->observation_count);
-          BH_ASSERT(observation_count_factor <= 1);
-          result.node->getObject()->weight = weight * observation_count_factor;
-        }
-        const octomap::point3d oct_min(bbox.getMinimum(0), bbox.getMinimum(1), bbox.getMinimum(2));
-        const octomap::point3d oct_max(bbox.getMaximum(0), bbox.getMaximum(1), bbox.getMaximum(2));
-        for (auto it = octree_->begin_leafs_bbx(oct_min, oct_max); it != octree_->end_leafs_bbx(); ++it) {
-          WeightType observation_count_factor = computeObservationCountFactor(it->getObservationCount());
-          BH_ASSERT(observation_count_factor <= 1);
-          it->setWeight(weight * observation_count_factor);
-        }
+
+  // Each grid cell assigns its weight to all voxels overlapping the cell's bounding box and cells are
+  // visited in lexicographic order, i.e. a voxel gets the weight of the lexicographically largest cell it overlaps.
+  // Overlap is separable so this cell is found independently for each axis. This allows binning each voxel once
+  // (and in parallel) instead of querying the BVH tree and the octree for every cell.
+  const std::size_t num_cells = static_cast<std::size_t>(grid_dim_(0)) * grid_dim_(1) * grid_dim_(2);
+  std::vector<WeightType> cell_weights(num_cells);
+#pragma omp parallel for
+  for (std::size_t i = 0; i < num_cells; ++i) {
+    const int iz = static_cast<int>(i % grid_dim_(2));
+    const int iy = static_cast<int>((i / grid_dim_(2)) % grid_dim_(1));
+    const int ix = static_cast<int>(i / grid_dim_(2) / grid_dim_(1));
+    cell_weights[i] = computeGridCellWeight(Vector3i(ix, iy, iz), max_distance);
+  }
+  // Extent of the cells (as used by the bounding box queries) and their octree keys along each axis
+  std::vector<FloatType> cell_min[3];
+  std::vector<FloatType> cell_max[3];
+  std::vector<int> cell_min_key[3];
+  std::vector<int> cell_max_key[3];
+  // Cells with invalid octree keys are ignored for the octree
+  std::size_t valid_key_begin[3];
+  std::size_t valid_key_end[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    valid_key_begin[axis] = grid_dim_(axis);
+    valid_key_end[axis] = 0;
+    for (int i = 0; i < grid_dim_(axis); ++i) {
+      const BoundingBoxType bbox(getGridPosition(Vector3i::Constant(i)), grid_increment_);
+      cell_min[axis].push_back(bbox.getMinimum(axis));
+      cell_max[axis].push_back(bbox.getMaximum(axis));
+      octomap::key_type min_key;
+      octomap::key_type max_key;
+      const bool valid_keys = octree_->coordToKeyChecked(bbox.getMinimum(axis), min_key)
+          && octree_->coordToKeyChecked(bbox.getMaximum(axis), max_key);
+      cell_min_key[axis].push_back(valid_keys ? min_key : 0);
+      cell_max_key[axis].push_back(valid_keys ? max_key : 0);
+      if (valid_keys) {
+        valid_key_begin[axis] = std::min<std::size_t>(valid_key_begin[axis], i);
+        valid_key_end[axis] = i + 1;
       }
     }
   }
-//  std::cout << "min_weight: " << min_weight<< std::endl;
-//  std::cout << "max_weight: " << max_weight<< std::endl;
+
+  const OccupiedTreeType::FlatNodeArrayType& flat_nodes = occupied_bvh_.getFlatNodes();
+#pragma omp parallel for schedule(static, 1024)
+  for (std::size_t i = 0; i < flat_nodes.size(); ++i) {
+    const OccupiedTreeType::FlatNodeType& flat_node = flat_nodes[i];
+    if (flat_node.skip_index != i + 1) {
+      continue;
+    }
+    std::size_t cell_index = 0;
+    bool overlaps_grid = true;
+    for (int axis = 0; axis < 3 && overlaps_grid; ++axis) {
+      const std::ptrdiff_t axis_index = findLastOverlappingInterval(
+              cell_min[axis], cell_max[axis], flat_node.bbox_min[axis], flat_node.bbox_max[axis],
+              0, cell_min[axis].size());
+      overlaps_grid = axis_index >= 0;
+      cell_index = cell_index * grid_dim_(axis) + axis_index;
+    }
+    if (overlaps_grid) {
+      NodeObjectType* object = occupied_bvh_.getNode(i)->getObject();
+      const WeightType observation_count_factor = computeObservationCountFactor(object->observation_count);
+      BH_ASSERT(observation_count_factor <= 1);
+      object->weight = cell_weights[cell_index] * observation_count_factor;
+    }
+  }
+
+  // Same key test as the octree's bounding box leaf iterator (a node's key is its center)
+  std::vector<std::tuple<OccupancyMapType::NodeType*, octomap::OcTreeKey, int>> octree_leaves;
+  for (auto it = octree_->begin_leafs(); it != octree_->end_leafs(); ++it) {
+    octree_leaves.emplace_back(&(*it), it.getKey(), static_cast<int>(it.getDepth()));
+  }
+  const int tree_max_key_value = 1 << (octree_->getTreeDepth() - 1);
+#pragma omp parallel for schedule(static, 1024)
+  for (std::size_t i = 0; i < octree_leaves.size(); ++i) {
+    const octomap::OcTreeKey& key = std::get<1>(octree_leaves[i]);
+    const int center_offset_key = tree_max_key_value >> std::get<2>(octree_leaves[i]);
+    std::size_t cell_index = 0;
+    bool overlaps_grid = true;
+    for (int axis = 0; axis < 3 && overlaps_grid; ++axis) {
+      const std::ptrdiff_t axis_index = findLastOverlappingInterval(
+              cell_min_key[axis], cell_max_key[axis], key[axis] - center_offset_key, key[axis] + center_offset_key,
+              valid_key_begin[axis], valid_key_end[axis]);
+      overlaps_grid = axis_index >= 0;
+      cell_index = cell_index * grid_dim_(axis) + axis_index;
+    }
+    if (overlaps_grid) {
+      OccupancyMapType::NodeType* node = std::get<0>(octree_leaves[i]);
+      const WeightType observation_count_factor = computeObservationCountFactor(node->getObservationCount());
+      BH_ASSERT(observation_count_factor <= 1);
+      node->setWeight(cell_weights[cell_index] * observation_count_factor);
+    }
+  }
   octree_->updateInnerOccupancy();
+  timer.printTimingMs("Updating weights");
+}
+
+ViewpointPlannerData::WeightType ViewpointPlannerData::computeGridCellWeight(
+        const Vector3i& indices, const FloatType max_distance) const {
+  const Vector3 xyz = getGridPosition(indices);
+  FloatType roi_weight = 1;
+  if (roi_.isPointOutside(xyz)) {
+    FloatType roi_distance = roi_.distanceToPoint(xyz);
+    roi_distance = std::min(roi_distance, options_.roi_falloff_distance);
+    roi_weight = (options_.roi_falloff_distance - roi_distance) / options_.roi_falloff_distance;
+  }
+  WeightType weight;
+  if (options_.use_distance_field) {
+    const FloatType distance = distance_field_(indices(0), indices(1), indices(2));
+    if (distance <= options_.weight_falloff_distance_start) {
+      weight = roi_weight;
+    }
+    else {
+      const FloatType inv_distance = (max_distance - distance) / (max_distance - options_.weight_falloff_distance_start);
+      if (options_.weight_falloff_quadratic) {
+        weight = roi_weight * inv_distance * inv_distance;
+      }
+      else {
+        weight = roi_weight * inv_distance;
+      }
+    }
+  }
+  else {
+    weight = roi_weight;
+  }
+  return weight;
 }
 
 void ViewpointPlannerData::updateWeightsWithRealViewpoints() {
@@ -544,6 +722,7 @@ void ViewpointPlannerData::updateWeightsWithRealViewpoints() {
 #if WITH_CUDA
       raycaster.setEnableCuda(options_.enable_cuda);
 #endif
+      raycaster.setEnableCpuPacketRaycast(options_.enable_cpu_packet_raycast);
       // TODO: Add minimum range to raycast query. Otherwise unknown voxels are captured instead of the interesting ones.
       std::vector<OccupiedTreeType::IntersectionResultWithScreenCoordinates> raycast_results =
               raycaster.getRaycastHitVoxelsWithScreenCoordinates(viewpoint, remove_duplicates);
@@ -782,12 +961,13 @@ bool ViewpointPlannerData::isTreeConsistent(const TreeT& tree) {
 }
 
 void ViewpointPlannerData::generateBVHTree(const OccupancyMapType* octree) {
+  bh::Timer timer;
   // Initialize nearest neighbor index for mesh faces
   using MeshAnn = bh::ApproximateNearestNeighbor<FloatType, 3>;
   MeshAnn mesh_ann;
   std::vector<Vector3> triangle_centers;
   triangle_centers.resize(poisson_mesh_->m_FaceIndicesVertices.size());
-//#pragma omp parallel for
+#pragma omp parallel for
   for (size_t i = 0; i < poisson_mesh_->m_FaceIndicesVertices.size(); ++i) {
     const MeshType::Indices::Face& face = poisson_mesh_->m_FaceIndicesVertices[i];
     BH_ASSERT_STR(face.size() == 3, "Mesh faces need to have a valence of 3");
@@ -803,128 +983,147 @@ void ViewpointPlannerData::generateBVHTree(const OccupancyMapType* octree) {
   const std::size_t mesh_knn = options_.bvh_normal_mesh_knn;
   const FloatType max_dist_square = options_.bvh_normal_mesh_max_dist * options_.bvh_normal_mesh_max_dist;
 
-  std::vector<std::vector<typename OccupiedTreeType::ObjectWithBoundingBox>> objects_vector;
-//#pragma omp parallel
-  {
-    const std::size_t thread_index = (std::size_t)omp_get_thread_num();
-    const std::size_t num_threads = (std::size_t)omp_get_num_threads();
-//#pragma omp single
-    {
-      objects_vector.resize(num_threads);
+  // Collect the occupied and unknown leaves in iteration order (the octree can only be traversed sequentially).
+  // Everything else is done in parallel and the objects keep this order so that the tree is deterministic.
+  struct OctreeLeaf {
+    const OccupancyMapType::NodeType* node;
+    Vector3 center;
+    FloatType size;
+  };
+  std::vector<OctreeLeaf> leaves;
+  for (auto it = octree->begin_tree(); it != octree->end_tree(); ++it) {
+    if (!it.isLeaf()) {
+      continue;
+    }
+//      if (octree->isNodeFree(&(*it)) || octree->isNodeUnknown(&(*it))) {
+    if (octree->isNodeFree(&(*it)) && octree->isNodeKnown(&(*it))) {
+      continue;
+    }
+    const octomap::point3d center_octomap = it.getCoordinate();
+    OctreeLeaf leaf;
+    leaf.node = &(*it);
+    leaf.center = Vector3(center_octomap.x(), center_octomap.y(), center_octomap.z());
+    leaf.size = it.getSize();
+    leaves.push_back(leaf);
+  }
+  std::cout << "Collected " << leaves.size() << " occupied and unknown octree leaves" << std::endl;
+
+  // Objects of leaves that are outside of the BVH bounding box stay empty
+  std::vector<typename OccupiedTreeType::ObjectWithBoundingBox> leaf_objects(leaves.size());
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (std::size_t i = 0; i < leaves.size(); ++i) {
+    typename OccupiedTreeType::ObjectWithBoundingBox& object_with_bbox = leaf_objects[i];
+    object_with_bbox.object = nullptr;
+    object_with_bbox.bounding_box = typename OccupiedTreeType::BoundingBoxType(leaves[i].center, leaves[i].size);
+//    BH_ASSERT(object_with_bbox.bounding_box.isValid());
+    object_with_bbox.bounding_box.constrainTo(bvh_bbox_);
+    if (object_with_bbox.bounding_box.isEmpty()) {
+      continue;
     }
+    if (object_with_bbox.bounding_box.getMaximum(2) >= options_.obstacle_free_height) {
+      Vector3 min = object_with_bbox.bounding_box.getMinimum();
+      min(2) = std::min(options_.obstacle_free_height, min(2));
+      Vector3 max = object_with_bbox.bounding_box.getMaximum();
+      max(2) = options_.obstacle_free_height;
+      object_with_bbox.bounding_box = typename OccupiedTreeType::BoundingBoxType(min, max);
+//      BH_ASSERT(object_with_bbox.bounding_box.isValid());
+    }
+    if (object_with_bbox.bounding_box.isEmpty()) {
+      continue;
+    }
+//    BH_ASSERT(object_with_bbox.bounding_box.isValid());
+    object_with_bbox.object = new NodeObjectType();
+    object_with_bbox.object->occupancy = leaves[i].node->getOccupancy();
+    object_with_bbox.object->observation_count = leaves[i].node->getObservationCount();
+    object_with_bbox.object->weight = leaves[i].node->getWeight();
+    object_with_bbox.object->normal.setZero();
+  }
+
+  // Find nearest neighbor faces to compute normal of voxel/node
+  if (!options_.enable_opengl && mesh_knn > 0) {
+    // If normals are not computed with OpenGL we average nearest neighbors.
+    // The queries are batched to bound the memory of the results.
+    const std::size_t batch_size = 64 * 1024;
+    std::vector<Vector3> batch_centers;
+    std::vector<std::size_t> batch_leaf_indices;
     std::vector<MeshAnn::IndexType> knn_indices;
     std::vector<MeshAnn::DistanceType> knn_distances;
-    std::vector<typename OccupiedTreeType::ObjectWithBoundingBox>& local_objects = objects_vector[thread_index];
-    const size_t report_leaf_interval = (size_t)octree->size() / 50.0;
-    std::size_t i = 0;
-    for (auto it = octree->begin_tree(); it != octree->end_tree(); ++it, ++i) {
-      if (thread_index == 0 && i % report_leaf_interval == 0) {
-        const FloatType percentage = FloatType(100) * i / FloatType(octree->size());
-        std::cout << "  processed " << percentage << " % of octree nodes" << std::endl;
-      }
-      if (i % num_threads != thread_index) {
-        continue;
-      }
-      if (it.isLeaf()) {
-  //      if (octree->isNodeFree(&(*it)) || octree->isNodeUnknown(&(*it))) {
-        if (octree->isNodeFree(&(*it)) && octree->isNodeKnown(&(*it))) {
-          continue;
-        }
-        typename OccupiedTreeType::ObjectWithBoundingBox object_with_bbox;
-        octomap::point3d center_octomap = it.getCoordinate();
-        Eigen::Vector3f center;
-        center << center_octomap.x(), center_octomap.y(), center_octomap.z();
-        const float size = it.getSize();
-        object_with_bbox.bounding_box = typename OccupiedTreeType::BoundingBoxType(center, size);
-//        BH_ASSERT(object_with_bbox.bounding_box.isValid());
-        const BoundingBoxType old_bbox = object_with_bbox.bounding_box;
-        object_with_bbox.bounding_box.constrainTo(bvh_bbox_);
-        if (object_with_bbox.bounding_box.isEmpty()) {
-          continue;
+    for (std::size_t batch_begin = 0; batch_begin < leaves.size(); batch_begin += batch_size) {
+      const std::size_t batch_end = std::min(batch_begin + batch_size, leaves.size());
+      batch_centers.clear();
+      batch_leaf_indices.clear();
+      for (std::size_t i = batch_begin; i < batch_end; ++i) {
+        if (leaf_objects[i].object != nullptr) {
+          batch_centers.push_back(leaves[i].center);
+          batch_leaf_indices.push_back(i);
         }
-
-        const BoundingBoxType old_bbox2 = object_with_bbox.bounding_box;
-        if (object_with_bbox.bounding_box.getMaximum(2) >= options_.obstacle_free_height) {
-          const BoundingBoxType old_bbox = object_with_bbox.bounding_box;
-          Vector3 min = object_with_bbox.bounding_box.getMinimum();
-          min(2) = std::min(options_.obstacle_free_height, min(2));
-          Vector3 max = object_with_bbox.bounding_box.getMaximum();
-          max(2) = options_.obstacle_free_height;
-          object_with_bbox.bounding_box = typename OccupiedTreeType::BoundingBoxType(min, max);
-//          BH_ASSERT(object_with_bbox.bounding_box.isValid());
-        }
-        if (object_with_bbox.bounding_box.isEmpty()) {
-          continue;
-        }
-
-//        BH_ASSERT(object_with_bbox.bounding_box.isValid());
-        object_with_bbox.object = new NodeObjectType();
-        object_with_bbox.object->occupancy = it->getOccupancy();
-        object_with_bbox.object->observation_count = it->getObservationCount();
-        object_with_bbox.object->weight = it->getWeight();
-        object_with_bbox.object->normal.setZero();
-        // Find nearest neighbor faces to compute normal of voxel/node
-        if (!options_.enable_opengl) {
-          // If normals are not computed with OpenGL we average nearest neighbors
-          knn_indices.resize(mesh_knn);
-          knn_distances.resize(mesh_knn);
-          mesh_ann.knnSearch(center, mesh_knn, &knn_indices, &knn_distances);
-          for (std::size_t i = 0; i < knn_distances.size(); ++i) {
-            const MeshAnn::DistanceType dist_square = knn_distances[i];
-            const MeshAnn::IndexType index = knn_indices[i];
-            if (dist_square <= max_dist_square) {
-              const MeshType::Indices::Face &face = poisson_mesh_->m_FaceIndicesVertices[index];
-              const ml::vec3f &ml_v1 = poisson_mesh_->m_Vertices[face[0]];
-              const ml::vec3f &ml_v2 = poisson_mesh_->m_Vertices[face[1]];
-              const ml::vec3f &ml_v3 = poisson_mesh_->m_Vertices[face[2]];
-              const Vector3 v1(ml_v1.x, ml_v1.y, ml_v1.z);
-              const Vector3 v2(ml_v2.x, ml_v2.y, ml_v2.z);
-              const Vector3 v3(ml_v3.x, ml_v3.y, ml_v3.z);
-              //          Vector3 triangle_center(v1.x + v2.x + v3.x, v1.y + v2.y + v3.y, v1.z + v2.z + v3.z);
-              //          triangle_center /= 3;
-              const Vector3 normal = (v1 - v2).cross(v2 - v3).normalized();
-              const FloatType normal_weight = 1 / dist_square;
-              object_with_bbox.object->normal += normal_weight * normal;
-            }
-          }
-          if (object_with_bbox.object->normal != Vector3::Zero()) {
-            object_with_bbox.object->normal.normalize();
+      }
+      mesh_ann.knnSearchBatch(batch_centers.begin(), batch_centers.end(), mesh_knn,
+                              &knn_indices, &knn_distances, omp_get_max_threads());
+#pragma omp parallel for schedule(dynamic, 256)
+      for (std::size_t j = 0; j < batch_leaf_indices.size(); ++j) {
+        NodeObjectType* object = leaf_objects[batch_leaf_indices[j]].object;
+        for (std::size_t k = j * mesh_knn; k < (j + 1) * mesh_knn; ++k) {
+          const MeshAnn::DistanceType dist_square = knn_distances[k];
+          const MeshAnn::IndexType index = knn_indices[k];
+          if (index != static_cast<MeshAnn::IndexType>(-1) && dist_square <= max_dist_square) {
+            const MeshType::Indices::Face &face = poisson_mesh_->m_FaceIndicesVertices[index];
+            const ml::vec3f &ml_v1 = poisson_mesh_->m_Vertices[face[0]];
+            const ml::vec3f &ml_v2 = poisson_mesh_->m_Vertices[face[1]];
+            const ml::vec3f &ml_v3 = poisson_mesh_->m_Vertices[face[2]];
+            const Vector3 v1(ml_v1.x, ml_v1.y, ml_v1.z);
+            const Vector3 v2(ml_v2.x, ml_v2.y, ml_v2.z);
+            const Vector3 v3(ml_v3.x, ml_v3.y, ml_v3.z);
+            const Vector3 normal = (v1 - v2).cross(v2 - v3).normalized();
+            const FloatType normal_weight = 1 / dist_square;
+            object->normal += normal_weight * normal;
           }
         }
-
-//        objects.push_back(object_with_bbox);
-        local_objects.push_back(object_with_bbox);
+        if (object->normal != Vector3::Zero()) {
+          object->normal.normalize();
+        }
       }
+      const FloatType percentage = FloatType(100) * batch_end / FloatType(leaves.size());
+      std::cout << "  computed normals for " << percentage << " % of octree leaves" << std::endl;
     }
   }
-  std::cout << "Merging local object vectors" << std::endl;
+
   std::vector<typename OccupiedTreeType::ObjectWithBoundingBox> objects;
-  for (auto& local_objects : objects_vector) {
-    objects.insert(std::end(objects), std::begin(local_objects), std::end(local_objects));
-    local_objects.clear();
+  objects.reserve(leaf_objects.size());
+  for (const typename OccupiedTreeType::ObjectWithBoundingBox& object_with_bbox : leaf_objects) {
+    if (object_with_bbox.object != nullptr) {
+      objects.push_back(object_with_bbox);
+    }
   }
+  leaf_objects.clear();
+  timer.printTimingMs("Generating BVH tree objects");
   std::cout << "Building BVH tree with " << objects.size() << " objects" << std::endl;
-  bh::Timer timer;
-  occupied_bvh_.build(std::move(objects));
+  timer = bh::Timer();
+  const OccupiedTreeType::SplitMethod split_method = options_.bvh_use_sah_build
+      ? OccupiedTreeType::SPLIT_BINNED_SAH : OccupiedTreeType::SPLIT_MEDIAN;
+  occupied_bvh_.build(std::move(objects), true, split_method);
   timer.printTimingMs("Building BVH tree");
 }
 
-void ViewpointPlannerData::writeBVHTree(const std::string& filename) const {
-  std::ofstream ofs(filename, std::ios::binary);
-  if (!ofs) {
-    throw BH_EXCEPTION(std::string("Unable to open file for writing: ") + filename);
+ViewpointPlannerData::BVHCacheKey ViewpointPlannerData::computeBVHCacheKey(
+        const std::string& octree_filename, const std::string& mesh_filename) const {
+  BVHCacheKey cache_key;
+  std::memset(&cache_key, 0, sizeof(cache_key));
+  cache_key.octree_file_size = boost::filesystem::file_size(octree_filename);
+  cache_key.octree_write_time = getLastWriteTime(octree_filename);
+  // Normals of the voxels are computed from the mesh
+  cache_key.mesh_file_size = boost::filesystem::file_size(mesh_filename);
+  cache_key.mesh_write_time = getLastWriteTime(mesh_filename);
+  cache_key.normal_mesh_knn = options_.bvh_normal_mesh_knn;
+  for (int i = 0; i < 3; ++i) {
+    cache_key.bbox_min[i] = bvh_bbox_.getMinimum(i);
+    cache_key.bbox_max[i] = bvh_bbox_.getMaximum(i);
   }
-  boost::archive::binary_oarchive oa(ofs);
-  oa << occupied_bvh_;
-}
-
-void ViewpointPlannerData::readCachedBVHTree(const std::string& filename) {
-  std::ifstream ifs(filename, std::ios::binary);
-  if (!ifs) {
-    throw BH_EXCEPTION(std::string("Unable to open file for reading: ") + filename);
-  }
-  boost::archive::binary_iarchive ia(ifs);
-  ia >> occupied_bvh_;
+  cache_key.obstacle_free_height = options_.obstacle_free_height;
+  cache_key.normal_mesh_max_dist = options_.bvh_normal_mesh_max_dist;
+  cache_key.use_sah_build = options_.bvh_use_sah_build ? 1 : 0;
+  cache_key.enable_opengl = options_.enable_opengl ? 1 : 0;
+  return cache_key;
 }
 
 void ViewpointPlannerData::generateWeightGrid() {
@@ -944,8 +1143,13 @@ void ViewpointPlannerData::generateWeightGrid() {
 }
 
 void ViewpointPlannerData::generateDistanceField() {
-  ml::Grid3f seed_grid(options_.grid_dimension, options_.grid_dimension, options_.grid_dimension);
-  seed_grid.setValues(std::numeric_limits<float>::max());
+  bh::Timer timer;
+  const std::size_t dim_x = grid_dim_(0);
+  const std::size_t dim_y = grid_dim_(1);
+  const std::size_t dim_z = grid_dim_(2);
+  // Seed grid with squared distances (in grid units) of the voxel centers to the closest triangle center
+  const FloatType far_value = bh::getDistanceTransformFarValue<FloatType>();
+  std::vector<FloatType> sq_distances(dim_x * dim_y * dim_z, far_value);
   for (size_t i = 0; i < poisson_mesh_->m_FaceIndicesVertices.size(); ++i) {
     const MeshType::Indices::Face& face = poisson_mesh_->m_FaceIndicesVertices[i];
     BH_ASSERT_STR(face.size() == 3, "Mesh faces need to have a valence of 3");
@@ -956,63 +1160,32 @@ void ViewpointPlannerData::generateDistanceField() {
     const Vector3 tri_xyz(ml_tri_xyz.x, ml_tri_xyz.y, ml_tri_xyz.z);
     if (isInsideGrid(tri_xyz)) {
       const Vector3i indices = getGridIndices(tri_xyz);
-      const Vector3 xyz = getGridPosition(indices);
-      const float cur_dist = seed_grid(indices(0), indices(1), indices(2));
-      const float new_dist = (xyz - tri_xyz).norm() / grid_increment_;
-      if (new_dist < cur_dist) {
-        seed_grid(indices(0), indices(1), indices(2)) = new_dist;
-      }
-    }
-  }
-  distance_field_ = DistanceFieldType(seed_grid);
-  for (int ix = 0; ix < grid_dim_(0); ++ix) {
-    for (int iy = 0; iy < grid_dim_(1); ++iy) {
-      for (int iz = 0; iz < grid_dim_(2); ++iz) {
-        if (distance_field_(ix, iy, iz) > options_.distance_field_cutoff) {
-          distance_field_(ix, iy, iz) = options_.distance_field_cutoff;
-        }
-      }
-    }
-  }
-  // So far only sparse voxels have been updated. Adjust distance field until all distances are approximately correct.
-  FloatType distance_kernel[3][3][3];
-  for (int k = -1; k <= 1; k++) {
-    for (int j = -1; j <= 1; j++) {
-      for (int i = -1; i <= 1; i++) {
-        FloatType distance = grid_increment_ * Vector3((FloatType)k, (FloatType)j, (FloatType)i).norm();
-        distance_kernel[k + 1][j + 1][i + 1] = distance;
+      if ((indices.array() < 0).any() || (indices.array() >= grid_dim_.array()).any()) {
+        continue;
       }
+      const Vector3 xyz = getGridPosition(indices);
+      const std::size_t index = indices(0) + dim_x * (indices(1) + dim_y * indices(2));
+      const FloatType new_dist = (xyz - tri_xyz).norm() / grid_increment_;
+      sq_distances[index] = std::min(sq_distances[index], new_dist * new_dist);
     }
   }
-  bool distance_changed = true;
-  while (distance_changed) {
-    distance_changed = false;
-    for (std::size_t z = 0; z < distance_field_.getDimZ(); z++) {
-      for (std::size_t y = 0; y < distance_field_.getDimY(); y++) {
-        for (std::size_t x = 0; x < distance_field_.getDimX(); x++) {
-          FloatType d_min = distance_field_(x, y, z);
-          // Iterate over all neighbors
-          for (int k = -1; k <= 1; k++) {
-            for (int j = -1; j <= 1; j++) {
-              for (int i = -1; i <= 1; i++) {
-                const Eigen::Matrix<unsigned long, 3, 1> n(x + i, y + j, z + k);
-                if (distance_field_.isValidCoordinate(n(0), n(1), n(2))) {
-                  FloatType d_curr = distance_field_(n(0), n(1), n(2)) + distance_kernel[i + 1][j + 1][k + 1];
-                  if (d_curr < d_min && d_curr <= options_.distance_field_cutoff) {
-                    d_min = d_curr;
-                    distance_changed = true;
-                  }
-                }
-              }
-            }
-          }
-          if (distance_changed) {
-            distance_field_(x, y, z) = d_min;
-          }
+  // Exact Euclidean distance transform (linear time and parallel over grid lines)
+  bh::squaredDistanceTransform3D(&sq_distances, dim_x, dim_y, dim_z);
+  distance_field_ = DistanceFieldType(dim_x, dim_y, dim_z);
+#pragma omp parallel for
+  for (std::size_t z = 0; z < dim_z; ++z) {
+    for (std::size_t y = 0; y < dim_y; ++y) {
+      for (std::size_t x = 0; x < dim_x; ++x) {
+        const FloatType sq_distance = sq_distances[x + dim_x * (y + dim_y * z)];
+        FloatType distance = options_.distance_field_cutoff;
+        if (sq_distance < far_value) {
+          distance = std::min(grid_increment_ * std::sqrt(sq_distance), options_.distance_field_cutoff);
         }
+        distance_field_(x, y, z) = distance;
       }
     }
   }
+  timer.printTimingMs("Computing distance field");
 }
 
 bool ViewpointPlannerData::isInsideGrid(const Vector3& xyz) const {
@@ -20,6 +20,8 @@
 #include <bh/eigen_options.h>
 #include <bh/math/geometry.h>
 #include "occupied_tree.h"
+#include "occupied_tree_cache.h"
+#include "collision_map.h"
 #include "../octree/occupancy_map.h"
 #include "../reconstruction/dense_reconstruction.h"
 #include "../bvh/bvh.h"
@@ -48,11 +50,17 @@ public:
       addOption<std::string>("octree_filename", "");
       addOption<std::string>("bvh_filename", "");
       addOption<std::string>("distance_field_filename", "");
+      addOption<std::string>("collision_map_filename", "");
       addOption<bool>("use_distance_field", &use_distance_field);
       addOption<bool>("force_weights_update", &force_weights_update);
       addOption<bool>("regenerate_augmented_octree", &regenerate_augmented_octree);
       addOption<bool>("regenerate_bvh_tree", &regenerate_bvh_tree);
+      addOption<bool>("bvh_use_sah_build", &bvh_use_sah_build);
       addOption<bool>("regenerate_distance_field", &regenerate_distance_field);
+      addOption<bool>("use_collision_map", &use_collision_map);
+      addOption<bool>("regenerate_collision_map", &regenerate_collision_map);
+      addOption<FloatType>("collision_map_resolution", &collision_map_resolution);
+      addOption<size_t>("collision_map_max_num_voxels", &collision_map_max_num_voxels);
       addOption<std::string>("regions_json_filename", &regions_json_filename);
       addOption<FloatType>("obstacle_free_height", &obstacle_free_height);
       addOption<FloatType>("bvh_bbox_min_x", -1000);
@@ -86,6 +94,7 @@ public:
       addOption<FloatType>("real_observed_voxels_raycast_min_range", &real_observed_voxels_raycast_min_range);
       addOption<FloatType>("real_observed_voxels_raycast_max_range", &real_observed_voxels_raycast_max_range);
       addOption<bool>("enable_opengl", &enable_opengl);
+      addOption<bool>("enable_cpu_packet_raycast", &enable_cpu_packet_raycast);
 #if WITH_CUDA
       addOption<bool>("enable_cuda", &enable_cuda);
       addOption<size_t>("cuda_stack_size", &cuda_stack_size);
@@ -99,7 +108,16 @@ public:
     bool force_weights_update = false;
     bool regenerate_augmented_octree = false;
     bool regenerate_bvh_tree = false;
+    // Whether to build the BVH tree with the (parallel) binned surface area heuristic instead of median splits
+    bool bvh_use_sah_build = false;
     bool regenerate_distance_field = false;
+    // Whether to validate motion segments by sphere marching on a signed distance field of the occupied space
+    bool use_collision_map = true;
+    bool regenerate_collision_map = false;
+    // Voxel size of the collision map (if not positive the smallest BVH leaf size is used)
+    FloatType collision_map_resolution = 0;
+    // Upper bound on the number of collision map voxels (the resolution is reduced if necessary)
+    size_t collision_map_max_num_voxels = 256 * 256 * 256;
     std::string regions_json_filename = "";
     FloatType obstacle_free_height = std::numeric_limits<FloatType>::max();
     size_t bvh_normal_mesh_knn = 10;
@@ -116,6 +134,8 @@ public:
     FloatType real_observed_voxels_raycast_min_range = FloatType(5);
     FloatType real_observed_voxels_raycast_max_range = std::numeric_limits<FloatType>::max();
     bool enable_opengl = true;
+    // Whether to trace ray packets on multiple threads when raycasting on the CPU
+    bool enable_cpu_packet_raycast = true;
 #if WITH_CUDA
     bool enable_cuda = true;
     size_t cuda_stack_size = 32 * 1024;
@@ -174,6 +194,16 @@ public:
   bool isValidObjectPosition(
           const Vector3& position, const BoundingBoxType& object_bbox, const bool ignore_no_fly_zones = false) const;
 
+  /// Check if an object can be moved along a straight line segment.
+  ///
+  /// Positions are checked every step_distance (the end position is not checked).
+  /// If no-fly zones are ignored, free space is skipped by sphere marching on the collision map.
+  bool isValidObjectSegment(
+          const Vector3& from, const Vector3& to, const BoundingBoxType& object_bbox,
+          const FloatType step_distance, const bool ignore_no_fly_zones = false) const;
+
+  const viewpoint_planner::CollisionMap& getCollisionMap() const;
+
   const reconstruction::DenseReconstruction& getReconstruction() const;
 
   const DistanceFieldType& getDistanceField() const;
@@ -193,6 +223,8 @@ private:
     return boost::filesystem::last_write_time(filename);
   }
 
+  using BVHCacheKey = viewpoint_planner::OccupiedTreeCacheKey;
+
   RegionType convertGpsRegionToEnuRegion(const boost::property_tree::ptree& pt) const;
 
   void readDenseReconstruction(const std::string& path);
@@ -200,14 +232,21 @@ private:
       std::string octree_filename, const std::string& raw_octree_filename, bool binary=false);
   void readDensePoints(const std::string& dense_points_filename);
   void readPoissonMesh(const std::string& mesh_filename);
-  bool readBVHTree(std::string bvh_filename, const std::string& octree_filename);
+  bool readBVHTree(std::string bvh_filename, const std::string& octree_filename, const std::string& mesh_filename);
+  /// Signed distance field of the occupied BVH tree for collision checking
+  bool readCollisionMap(const std::string& collision_map_filename, const std::string& octree_filename,
+                        const bool bvh_generated);
   /// Distance field to poisson mesh based on overall bounding box volume
   bool readMeshDistanceField(std::string df_filename, const std::string& mesh_filename);
 
   void _readMeshDistanceField(const std::string& df_filename, DistanceFieldType* distance_field);
   void _writeMeshDistanceField(const std::string& df_filename, const DistanceFieldType& distance_field);
 
+  /// Weight of voxels based on the region of interest and the distance field (parallel over voxels)
   void updateWeights();
+
+  /// Weight of a grid cell (before accounting for the observation count of voxels)
+  WeightType computeGridCellWeight(const Vector3i& indices, const FloatType max_distance) const;
   void updateWeightsWithRealViewpoints();
 
   WeightType computeObservationCountFactor(CounterType observation_count) const;
@@ -220,9 +259,7 @@ private:
 
   void generateBVHTree(const OccupancyMapType* octree);
 
-  void readCachedBVHTree(const std::string& filename);
-
-  void writeBVHTree(const std::string& filename) const;
+  BVHCacheKey computeBVHCacheKey(const std::string& octree_filename, const std::string& mesh_filename) const;
 
   void generateWeightGrid();
 
@@ -255,4 +292,5 @@ private:
 
   DistanceFieldType distance_field_;
   OccupiedTreeType occupied_bvh_;
+  viewpoint_planner::CollisionMap collision_map_;
 };
@@ -7,6 +7,7 @@
 //==================================================
 
 #include "viewpoint_planner.h"
+#include <algorithm>
 
 QImage ViewpointPlanner::drawSparsePoints(
     const Viewpoint& viewpoint,
@@ -34,15 +35,14 @@ QImage ViewpointPlanner::drawSparsePoints(
     const ViewpointEntryIndex viewpoint_index,
     const FloatType sparse_point_size /*= FloatType(2)*/) const {
   const Viewpoint& viewpoint = viewpoint_entries_[viewpoint_index].viewpoint;
-  const std::unordered_map<Point3DId, Vector3>& sparse_points_visible = getCachedVisibleSparsePoints(viewpoint_index);
+  const std::shared_ptr<const VisibleSparsePoints> sparse_points_visible = getCachedVisibleSparsePoints(viewpoint_index);
   QImage img = drawPoissonMesh(viewpoint_index);
   QPainter painter(&img);
   QPen pen;
   pen.setColor(Qt::red);
   pen.setWidth(0.2);
   painter.setPen(pen);
-  for (const auto& entry : sparse_points_visible) {
-    const Point3DId& point3d_id = entry.first;
+  for (const Point3DId point3d_id : sparse_points_visible->point3d_ids) {
     const Point3D& point3d = data_->reconstruction_->getPoints3D().at(point3d_id);
     if (viewpoint.isWorldPointVisible(point3d.getPosition())) {
       const Vector2 point_image = viewpoint.projectWorldPointIntoImage(point3d.getPosition());
@@ -129,8 +129,8 @@ QImage ViewpointPlanner::drawSparseMatching(
     const ViewpointEntryIndex viewpoint_index1, const ViewpointEntryIndex viewpoint_index2,
     const bool draw_lines /*= true*/,
     const FloatType sparse_point_size /*= FloatType(2)*/, const FloatType match_line_width /*= FloatType(0.5)*/) const {
-  const std::unordered_map<Point3DId, Vector3>& sparse_points_visible1 = getCachedVisibleSparsePoints(viewpoint_index1);
-  const std::unordered_map<Point3DId, Vector3>& sparse_points_visible2 = getCachedVisibleSparsePoints(viewpoint_index2);
+  const std::shared_ptr<const VisibleSparsePoints> sparse_points_visible1 = getCachedVisibleSparsePoints(viewpoint_index1);
+  const std::shared_ptr<const VisibleSparsePoints> sparse_points_visible2 = getCachedVisibleSparsePoints(viewpoint_index2);
   const Viewpoint& viewpoint1 = viewpoint_entries_[viewpoint_index1].viewpoint;
   const Viewpoint& viewpoint2 = viewpoint_entries_[viewpoint_index2].viewpoint;
   const QImage img1 = drawSparsePoints(viewpoint_index1, sparse_point_size);
@@ -148,12 +148,14 @@ QImage ViewpointPlanner::drawSparseMatching(
   pen_not_matchable.setWidth(match_line_width);
   pen_not_matchable.setColor(Qt::yellow);
   if (draw_lines) {
-    for (const auto& entry : sparse_points_visible1) {
-      const Point3DId& point3d_id = entry.first;
-      const Vector3& normal1 = entry.second;
-      if (sparse_points_visible2.count(point3d_id) > 0) {
+    const std::vector<Point3DId>& point3d_ids2 = sparse_points_visible2->point3d_ids;
+    for (std::size_t i = 0; i < sparse_points_visible1->size(); ++i) {
+      const Point3DId point3d_id = sparse_points_visible1->point3d_ids[i];
+      const Vector3& normal1 = sparse_points_visible1->normals[i];
+      const auto it2 = std::lower_bound(point3d_ids2.begin(), point3d_ids2.end(), point3d_id);
+      if (it2 != point3d_ids2.end() && *it2 == point3d_id) {
         const Point3D& point3d = data_->reconstruction_->getPoints3D().at(point3d_id);
-        const Vector3& normal2 = sparse_points_visible2.at(point3d_id);
+        const Vector3& normal2 = sparse_points_visible2->normals[it2 - point3d_ids2.begin()];
         const bool matchable = isSparsePointMatchable(viewpoint1, viewpoint2, point3d, normal1, normal2);
         if (matchable) {
           painter.setPen(pen_matchable);
@@ -7,6 +7,8 @@
 //==================================================
 
 #include "viewpoint_planner.h"
+#include <atomic>
+#include <omp.h>
 #include <boost/heap/binomial_heap.hpp>
 #include <boost/heap/fibonacci_heap.hpp>
 
@@ -97,20 +99,117 @@ void ViewpointPlanner::removeViewpointMotions(const ViewpointEntryIndex index) {
 
 void ViewpointPlanner::computeViewpointMotions() {
   std::cout << "Computing motions on viewpoint graph" << std::endl;
+  const bool ignore_no_fly_zones = true;
+  const std::size_t dist_knn = options_.viewpoint_motion_max_neighbors;
+  const FloatType max_dist_square = options_.viewpoint_motion_max_dist_square;
+  bh::Timer timer;
+
+  std::vector<ViewpointEntryIndex> from_indices;
   for (auto it = viewpoint_graph_.begin(); it != viewpoint_graph_.end(); ++it) {
     const ViewpointEntryIndex from_index = it.node();
-//    if (from_index < num_real_viewpoints_) {
-//      continue;
-//    }
-    std::vector<ViewpointPlanner::ViewpointMotion> motions = findViewpointMotions(from_index);
-    std::cout << "Found " << motions.size() << " connections from viewpoint " << from_index << std::endl;
+    if (isValidObjectPosition(viewpoint_entries_[from_index].viewpoint.pose().getWorldPosition(),
+                              drone_bbox_, ignore_no_fly_zones)) {
+      from_indices.push_back(from_index);
+    }
+  }
 
-    std::unique_lock<std::mutex> lock(mutex_);
+  // Collect all candidate pairs of neighboring viewpoints.
+  // Motions are symmetric so each pair only has to be planned once.
+  std::vector<ViewpointIndexPair> candidate_pairs;
+#pragma omp parallel
+  {
+    std::vector<ViewpointANN::IndexType> knn_indices;
+    std::vector<ViewpointANN::DistanceType> knn_distances;
+    std::vector<ViewpointIndexPair> local_candidate_pairs;
+#pragma omp for schedule(dynamic, 64) nowait
+    for (std::ptrdiff_t i = 0; i < static_cast<std::ptrdiff_t>(from_indices.size()); ++i) {
+      const ViewpointEntryIndex from_index = from_indices[i];
+      knn_indices.resize(dist_knn);
+      knn_distances.resize(dist_knn);
+      viewpoint_ann_.knnSearch(viewpoint_entries_[from_index].viewpoint.pose().getWorldPosition(), dist_knn,
+                               &knn_indices, &knn_distances);
+      for (std::size_t j = 0; j < knn_indices.size(); ++j) {
+        const ViewpointEntryIndex to_index = knn_indices[j];
+        // Both endpoints have to be valid because the pair might be reordered
+        if (to_index != from_index && knn_distances[j] <= max_dist_square
+            && isValidObjectPosition(viewpoint_entries_[to_index].viewpoint.pose().getWorldPosition(),
+                                     drone_bbox_, ignore_no_fly_zones)) {
+          local_candidate_pairs.emplace_back(from_index, to_index);
+        }
+      }
+    }
+#pragma omp critical
+    {
+      candidate_pairs.insert(candidate_pairs.end(), local_candidate_pairs.begin(), local_candidate_pairs.end());
+    }
+  }
+  std::sort(candidate_pairs.begin(), candidate_pairs.end(),
+            [](const ViewpointIndexPair& a, const ViewpointIndexPair& b) {
+    return std::make_pair(a.index1, a.index2) < std::make_pair(b.index1, b.index2);
+  });
+  candidate_pairs.erase(std::unique(candidate_pairs.begin(), candidate_pairs.end()), candidate_pairs.end());
+  std::cout << "Planning motions for " << candidate_pairs.size() << " viewpoint pairs" << std::endl;
+
+  // Motion planning time varies a lot between pairs so the pairs are dynamically scheduled in small chunks.
+  // Each thread accumulates its motions separately and the motion planner hands out its own OMPL instance
+  // to each concurrent query.
+  std::vector<std::vector<ViewpointMotion>> thread_motions(omp_get_max_threads());
+  std::atomic<std::size_t> num_processed_pairs(0);
+  std::atomic<std::size_t> num_found_motions(0);
+  const double progress_interval = 5;
+  bh::Timer progress_timer;
+  // Visible voxels are rendered with OpenGL so make sure they are cached (and stay cached) before running
+  // in multiple threads. Only the endpoints of one batch of pairs are pinned at a time so that the cache can still
+  // evict entries to stay within its budget. The pairs are sorted by the first index so the endpoints of a batch
+  // are mostly neighbors of a few viewpoints.
+  const std::size_t pin_batch_size = 1024;
+  std::vector<ViewpointEntryIndex> pair_indices;
+  for (std::size_t batch_begin = 0; batch_begin < candidate_pairs.size(); batch_begin += pin_batch_size) {
+    const std::size_t batch_end = std::min(batch_begin + pin_batch_size, candidate_pairs.size());
+    // Either endpoint can be a neighbor that is not in from_indices
+    pair_indices.clear();
+    for (std::size_t i = batch_begin; i < batch_end; ++i) {
+      pair_indices.push_back(candidate_pairs[i].index1);
+      pair_indices.push_back(candidate_pairs[i].index2);
+    }
+    std::sort(pair_indices.begin(), pair_indices.end());
+    pair_indices.erase(std::unique(pair_indices.begin(), pair_indices.end()), pair_indices.end());
+    pinCachedVisibleVoxels(pair_indices);
+
+#pragma omp parallel
+    {
+      std::vector<ViewpointMotion>& local_motions = thread_motions[omp_get_thread_num()];
+#pragma omp for schedule(dynamic, 4)
+      for (std::ptrdiff_t i = static_cast<std::ptrdiff_t>(batch_begin); i < static_cast<std::ptrdiff_t>(batch_end); ++i) {
+        const ViewpointIndexPair& index_pair = candidate_pairs[i];
+        ViewpointMotion motion;
+        if (findViewpointMotion(index_pair.index1, index_pair.index2, &motion)) {
+          local_motions.push_back(std::move(motion));
+          ++num_found_motions;
+        }
+        const std::size_t num_processed = ++num_processed_pairs;
+        if (omp_get_thread_num() == 0 && progress_timer.getElapsedTime() >= progress_interval) {
+          const double elapsed_time = timer.getElapsedTime();
+          std::cout << "Processed " << num_processed << " of " << candidate_pairs.size() << " viewpoint pairs, found "
+                    << num_found_motions << " motions (" << num_processed / elapsed_time << " pairs/s)" << std::endl;
+          progress_timer.reset();
+        }
+      }
+    }
+    unpinCachedVisibleVoxels(pair_indices);
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (std::vector<ViewpointMotion>& motions : thread_motions) {
     for (ViewpointMotion& motion : motions) {
       addViewpointMotion(std::move(motion));
     }
-    lock.unlock();
   }
+  lock.unlock();
+  std::cout << "Found " << num_found_motions << " motions for " << candidate_pairs.size() << " viewpoint pairs in "
+            << timer.getElapsedTime() << " s (" << candidate_pairs.size() / timer.getElapsedTime() << " pairs/s)"
+            << std::endl;
+  printVisibilityCacheStatistics();
 
 //  // Print info on connection graph
 //  for (auto it = viewpoint_graph_.begin(); it != viewpoint_graph_.end(); ++it) {
@@ -189,10 +288,8 @@ ViewpointPlanner::findSE3Motions(const Pose& from_pose) {
   // Find motion to other viewpoints in the graph
   const std::size_t dist_knn = options_.viewpoint_motion_max_neighbors;
   const FloatType max_dist_square = options_.viewpoint_motion_max_dist_square;
-  static std::vector<ViewpointANN::IndexType> knn_indices;
-  static std::vector<ViewpointANN::DistanceType> knn_distances;
-  knn_indices.resize(dist_knn);
-  knn_distances.resize(dist_knn);
+  std::vector<ViewpointANN::IndexType> knn_indices(dist_knn);
+  std::vector<ViewpointANN::DistanceType> knn_distances(dist_knn);
   viewpoint_ann_.knnSearch(from_pose.getWorldPosition(), dist_knn, &knn_indices, &knn_distances);
   std::size_t num_connections = 0;
   std::vector<std::pair<ViewpointEntryIndex, SE3Motion>> se3_motions;
@@ -201,12 +298,13 @@ ViewpointPlanner::findSE3Motions(const Pose& from_pose) {
   // Otherwise the OpenGL context and poisson mesh has to be initialized again and again in each thread.
 //  getCachedVisibleSparsePoints(from_index);
   const Viewpoint from_viewpoint = getVirtualViewpoint(from_pose);
-  const std::unordered_set<size_t> from_visible_voxels = getVisibleVoxels(from_viewpoint);
-  for (std::size_t i = 0; i < knn_indices.size(); ++i) {
-    const ViewpointANN::IndexType to_index = knn_indices[i];
-//    getCachedVisibleSparsePoints(to_index);
-    getCachedVisibleVoxels(to_index);
+  const VisibleVoxelIndices from_visible_voxels = getVisibleVoxels(from_viewpoint);
+  bh::MinHashSketch from_visible_voxels_sketch;
+  if (options_.sparse_matching_voxels_sketch_enable) {
+    from_visible_voxels_sketch = computeVisibleVoxelsSketch(from_visible_voxels);
   }
+  const std::vector<ViewpointEntryIndex> to_indices(knn_indices.begin(), knn_indices.end());
+  pinCachedVisibleVoxels(to_indices);
 #pragma omp parallel for
 #endif
   for (std::size_t i = 0; i < knn_indices.size(); ++i) {
@@ -221,7 +319,15 @@ ViewpointPlanner::findSE3Motions(const Pose& from_pose) {
 //      continue;
 //    }
 //    const bool matchable = isSparseMatchable(from_index, to_index);
-    const bool matchable = isSparseMatchable2(to_index, from_viewpoint, from_visible_voxels);
+    bh::MinHash::Comparison sketch_comparison = bh::MinHash::UNCERTAIN;
+    if (options_.sparse_matching_voxels_sketch_enable) {
+      sketch_comparison = compareVisibleVoxelsSketches(
+              *getCachedVisibleVoxelsSketch(to_index), from_visible_voxels_sketch,
+              options_.sparse_matching_voxels_iou_threshold);
+    }
+    // The sketch only rejects pairs early. Accepted pairs are always confirmed with the exact overlap.
+    const bool matchable = sketch_comparison != bh::MinHash::BELOW_THRESHOLD
+                           && isSparseMatchable2(to_index, from_viewpoint, from_visible_voxels);
     if (!matchable) {
       continue;
     }
@@ -274,10 +380,78 @@ ViewpointPlanner::findSE3Motions(const Pose& from_pose) {
       }
     }
   }
+#if !BH_DEBUG
+  unpinCachedVisibleVoxels(to_indices);
+#endif
 //  timer.printTimingMs("ViewpointPlanner::findMotion()");
   return se3_motions;
 }
 
+bool ViewpointPlanner::findViewpointMotion(const ViewpointEntryIndex from_index, const ViewpointEntryIndex to_index,
+                                           ViewpointMotion* motion, const bool verbose /*= false*/) {
+  const bool ignore_no_fly_zones = true;
+  const ViewpointEntry& from_viewpoint = viewpoint_entries_[from_index];
+  const ViewpointEntry& to_viewpoint = viewpoint_entries_[to_index];
+  if (!isValidObjectPosition(from_viewpoint.viewpoint.pose().getWorldPosition(), drone_bbox_, ignore_no_fly_zones)) {
+    if (verbose) {
+      std::cout << "No motion from viewpoint " << from_index << " due invalid object position" << std::endl;
+    }
+    return false;
+  }
+  if (!isValidObjectPosition(to_viewpoint.viewpoint.pose().getWorldPosition(), drone_bbox_, ignore_no_fly_zones)) {
+    if (verbose) {
+      std::cout << "No motion to viewpoint " << to_index << " due invalid object position" << std::endl;
+    }
+    return false;
+  }
+//  const bool matchable = isSparseMatchable(from_index, to_index);
+  const bool matchable = isSparseMatchable2(from_index, to_index);
+  if (!matchable) {
+    if (verbose) {
+      std::cout << "No motion to viewpoint " << to_index << " due to sparse matching" << std::endl;
+    }
+    return false;
+  }
+  SE3Motion se3_motion;
+  bool found_motion;
+  std::tie(se3_motion, found_motion) = motion_planner_.findMotion(from_viewpoint.viewpoint.pose(), to_viewpoint.viewpoint.pose());
+  if (!found_motion) {
+    if (verbose) {
+      std::cout << "No motion to viewpoint " << to_index << " could be found" << std::endl;
+    }
+    return false;
+  }
+#if !BH_RELEASE
+  // Additional sanity check
+  const FloatType dist_square = (to_viewpoint.viewpoint.pose().getWorldPosition()
+                                 - from_viewpoint.viewpoint.pose().getWorldPosition()).squaredNorm();
+  if (bh::isApproxSmaller<FloatType>(se3_motion.cost() * se3_motion.cost(), dist_square, FloatType(1e-2))) {
+    std::cout << "WARNING: se3_motion.cost * se3_motion.cost < dist_square" << std::endl;
+    BH_PRINT_VALUE(se3_motion.cost() * se3_motion.cost());
+    BH_PRINT_VALUE(se3_motion.cost());
+    BH_PRINT_VALUE(dist_square);
+    BH_DEBUG_BREAK;
+  }
+  FloatType motion_distance = 0;
+  if (se3_motion.poses().size() >= 2) {
+    for (auto it = se3_motion.poses().begin() + 1; it != se3_motion.poses().end(); ++it) {
+      motion_distance += (it->getWorldPosition() - (it - 1)->getWorldPosition()).norm();
+    }
+  }
+  if (!bh::isApproxEqual(se3_motion.distance(), motion_distance, FloatType(1e-2))) {
+    std::cout << "WARNING: se3_motion.distance != * motion_distance" << std::endl;
+    BH_PRINT_VALUE(se3_motion.distance());
+    BH_PRINT_VALUE(motion_distance);
+    BH_DEBUG_BREAK;
+  }
+#endif
+  *motion = ViewpointMotion({ from_index, to_index }, { se3_motion });
+  if (verbose) {
+    std::cout << "Found motion to viewpoint " << to_index << std::endl;
+  }
+  return true;
+}
+
 std::vector<ViewpointPlanner::ViewpointMotion>
 ViewpointPlanner::findViewpointMotions(const ViewpointEntryIndex from_index,const bool verbose /*= false*/) {
   const bool ignore_no_fly_zones = true;
@@ -289,10 +463,8 @@ ViewpointPlanner::findViewpointMotions(const ViewpointEntryIndex from_index,cons
   // Find motion to other viewpoints in the graph
   const std::size_t dist_knn = options_.viewpoint_motion_max_neighbors;
   const FloatType max_dist_square = options_.viewpoint_motion_max_dist_square;
-  static std::vector<ViewpointANN::IndexType> knn_indices;
-  static std::vector<ViewpointANN::DistanceType> knn_distances;
-  knn_indices.resize(dist_knn);
-  knn_distances.resize(dist_knn);
+  std::vector<ViewpointANN::IndexType> knn_indices(dist_knn);
+  std::vector<ViewpointANN::DistanceType> knn_distances(dist_knn);
   viewpoint_ann_.knnSearch(from_viewpoint.viewpoint.pose().getWorldPosition(), dist_knn, &knn_indices, &knn_distances);
   std::size_t num_connections = 0;
   std::vector<ViewpointMotion> motions;
@@ -301,12 +473,9 @@ ViewpointPlanner::findViewpointMotions(const ViewpointEntryIndex from_index,cons
   // Otherwise the OpenGL context and poisson mesh has to be initialized again and again in each thread.
 //  getCachedVisibleSparsePoints(from_index);
   bh::Timer timer;
-  getCachedVisibleVoxels(from_index);
-  for (std::size_t i = 0; i < knn_indices.size(); ++i) {
-    const ViewpointANN::IndexType to_index = knn_indices[i];
-//    getCachedVisibleSparsePoints(to_index);
-    getCachedVisibleVoxels(to_index);
-  }
+  std::vector<ViewpointEntryIndex> pinned_indices(knn_indices.begin(), knn_indices.end());
+  pinned_indices.push_back(from_index);
+  pinCachedVisibleVoxels(pinned_indices);
   const FloatType visible_voxels_time = timer.getElapsedTimeMs();
   timer.reset();
 #pragma omp parallel for
@@ -314,13 +483,6 @@ ViewpointPlanner::findViewpointMotions(const ViewpointEntryIndex from_index,cons
   for (std::size_t i = 0; i < knn_indices.size(); ++i) {
     const ViewpointANN::IndexType to_index = knn_indices[i];
     const ViewpointANN::DistanceType dist_square = knn_distances[i];
-    const ViewpointEntry& to_viewpoint = viewpoint_entries_[to_index];
-    if (!isValidObjectPosition(to_viewpoint.viewpoint.pose().getWorldPosition(), drone_bbox_, ignore_no_fly_zones)) {
-      if (verbose) {
-        std::cout << "No motion to viewpoint " << to_index << " due invalid object position" << std::endl;
-      }
-      continue;
-    }
     if (dist_square > max_dist_square) {
       if (verbose) {
         std::cout << "No motion to viewpoint " << to_index << " due to maximum distance: "
@@ -328,73 +490,23 @@ ViewpointPlanner::findViewpointMotions(const ViewpointEntryIndex from_index,cons
       }
       continue;
     }
-//    // Do not consider real point for finding motion paths
-//    if (to_index < num_real_viewpoints_) {
-//      continue;
-//    }
     if (from_index == to_index) {
       continue;
     }
-//    const bool matchable = isSparseMatchable(from_index, to_index);
-    const bool matchable = isSparseMatchable2(from_index, to_index);
-    if (!matchable) {
-      if (verbose) {
-        std::cout << "No motion to viewpoint " << to_index << " due to sparse matching" << std::endl;
-      }
-      continue;
-    }
-    SE3Motion se3_motion;
-    bool found_motion;
-    std::tie(se3_motion, found_motion) = motion_planner_.findMotion(from_viewpoint.viewpoint.pose(), to_viewpoint.viewpoint.pose());
-    // TODO
-    if (found_motion) {
+    ViewpointMotion motion;
+    if (findViewpointMotion(from_index, to_index, &motion, verbose)) {
 #if !BH_DEBUG
 #pragma omp critical
 #endif
       {
         ++num_connections;
-        // Additional sanity check
-//        FloatType motion_cost = motion.cost;
-//        if (!bh::isApproxGreaterEqual(motion_cost * motion_cost, dist_square, 1e-2f)) {
-//          FloatType dist_square2 = (from_viewpoint.viewpoint.pose().getWorldPosition() - to_viewpoint.viewpoint.pose().getWorldPosition()).squaredNorm();
-//          std::cout << "motion_cost=" << motion_cost << std::endl;
-//          std::cout << "motion_cost*motion_cost=" << motion_cost * motion_cost << std::endl;
-//          std::cout << "dist_square=" << dist_square << std::endl;
-//          std::cout << "dist_square2=" << dist_square2 << std::endl;
-//          std::cout << "motion_cost * motion_cost - dist_square=" << motion_cost * motion_cost - dist_square << std::endl;
-//        }
-#if !BH_RELEASE
-        if (bh::isApproxSmaller<FloatType>(se3_motion.cost() * se3_motion.cost(), dist_square, FloatType(1e-2))) {
-          std::cout << "WARNING: se3_motion.cost * se3_motion.cost < dist_square" << std::endl;
-          BH_PRINT_VALUE(se3_motion.cost() * se3_motion.cost());
-          BH_PRINT_VALUE(se3_motion.cost());
-          BH_PRINT_VALUE(dist_square);
-          BH_DEBUG_BREAK;
-        }
-        FloatType motion_distance = 0;
-        if (se3_motion.poses().size() >= 2) {
-          for (auto it = se3_motion.poses().begin() + 1; it != se3_motion.poses().end(); ++it) {
-            motion_distance += (it->getWorldPosition() - (it - 1)->getWorldPosition()).norm();
-          }
-        }
-        if (!bh::isApproxEqual(se3_motion.distance(), motion_distance, FloatType(1e-2))) {
-          std::cout << "WARNING: se3_motion.distance != * motion_distance" << std::endl;
-          BH_PRINT_VALUE(se3_motion.distance());
-          BH_PRINT_VALUE(motion_distance);
-          BH_DEBUG_BREAK;
-        }
-#endif
-        ViewpointMotion motion({ from_index, to_index }, { se3_motion });
-        motions.emplace_back(motion);
-        if (verbose) {
-          std::cout << "Found motion to viewpoint " << to_index << std::endl;
-        }
+        motions.push_back(std::move(motion));
       }
     }
-    else if (verbose) {
-      std::cout << "No motion to viewpoint " << to_index << " could be found" << std::endl;
-    }
   }
+#if !BH_DEBUG
+  unpinCachedVisibleVoxels(pinned_indices);
+#endif
   const FloatType motion_computation_time = timer.getElapsedTimeMs();
   if (verbose) {
     std::cout << "Time for visible voxels: " << visible_voxels_time << " ms"
@@ -425,11 +537,8 @@ ViewpointPlanner::ViewpointMotion ViewpointPlanner::findShortestMotionAStar(
   BH_ASSERT(goal == to_index);
 #endif
 
-  const typename ViewpointPlanner::ViewpointEntry& goal_viewpoint_entry = viewpoint_entries_[goal];
   const auto astar_heuristic = [&] (const ViewpointGraph::Vertex vertex) -> FloatType {
-    const typename ViewpointPlanner::ViewpointEntry& viewpoint_entry = viewpoint_entries_[vertex];
-    return (viewpoint_entry.viewpoint.pose().getWorldPosition()
-            - goal_viewpoint_entry.viewpoint.pose().getWorldPosition()).squaredNorm();
+    return computeViewpointMotionSearchCostLowerBound(vertex, goal);
   };
 
   // Use greater comparison to get a resulting min-heap (boost uses max-heaps by default)
@@ -470,8 +579,7 @@ ViewpointPlanner::ViewpointMotion ViewpointPlanner::findShortestMotionAStar(
       if (processed_flags[new_vertex]) {
         continue;
       }
-      const FloatType weight = it.weight() * it.weight();
-      const FloatType new_distance = current_distance + weight + options_.viewpoint_motion_penalty_per_graph_vertex;
+      const FloatType new_distance = current_distance + getViewpointMotionSearchCost(it.weight());
       if (new_distance < distances[new_vertex]) {
         distances[new_vertex] = new_distance;
         const FloatType new_heuristic_distance = new_distance + astar_heuristic(new_vertex);
@@ -519,11 +627,7 @@ ViewpointPlanner::ViewpointMotion ViewpointPlanner::findShortestMotionAStar(
     std::vector<ViewpointEntryIndex> viewpoint_indices;
     viewpoint_indices.reserve(reverse_viewpoint_indices.size());
     std::copy(reverse_viewpoint_indices.rbegin(), reverse_viewpoint_indices.rend(), std::back_inserter(viewpoint_indices));
-    ViewpointMotion motion;
-    for (auto it = viewpoint_indices.begin() + 1; it != viewpoint_indices.end(); ++it) {
-      const ViewpointMotion sub_motion = getViewpointMotion(*(it - 1), *it);
-      motion.append(sub_motion);
-    }
+    const ViewpointMotion motion = getViewpointMotionAlongPath(viewpoint_indices);
 
 //    // Densify viewpoint graph motions (add all shortest paths that were found to the graph)
 //    for (auto from_it = viewpoint_indices.begin(); from_it != viewpoint_indices.end(); ++from_it) {
@@ -773,6 +877,66 @@ ViewpointPlanner::ViewpointMotion ViewpointPlanner::optimizeViewpointMotion(cons
   return optimized_motion;
 }
 
+ViewpointPlanner::FloatType ViewpointPlanner::getViewpointMotionSearchCost(const FloatType edge_weight) const {
+  return edge_weight * edge_weight + options_.viewpoint_motion_penalty_per_graph_vertex;
+}
+
+ViewpointPlanner::FloatType ViewpointPlanner::computeViewpointMotionSearchCostLowerBound(
+        const ViewpointEntryIndex from_index, const ViewpointEntryIndex to_index) const {
+  // A motion covering the straight line distance d with k >= 1 edges costs at least d^2 / k + k * penalty
+  // (the squared edge lengths are minimal for equally long edges). The minimum over k is 2 * d * sqrt(penalty)
+  // for d >= sqrt(penalty) and d^2 + penalty otherwise. Without a penalty only the trivial bound 0 is admissible
+  // because a motion can have arbitrarily many short edges.
+  if (from_index == to_index) {
+    return 0;
+  }
+  const FloatType penalty = options_.viewpoint_motion_penalty_per_graph_vertex;
+  if (penalty <= 0) {
+    return 0;
+  }
+  const FloatType distance = (viewpoint_entries_[from_index].viewpoint.pose().getWorldPosition()
+                              - viewpoint_entries_[to_index].viewpoint.pose().getWorldPosition()).norm();
+  const FloatType sqrt_penalty = std::sqrt(penalty);
+  if (distance >= sqrt_penalty) {
+    return 2 * distance * sqrt_penalty;
+  }
+  return distance * distance + penalty;
+}
+
+ViewpointPlanner::ViewpointMotion ViewpointPlanner::getViewpointMotionAlongPath(
+        const std::vector<ViewpointEntryIndex>& viewpoint_indices) const {
+  BH_ASSERT(viewpoint_indices.size() >= 2);
+  ViewpointMotion motion;
+  for (auto it = viewpoint_indices.begin() + 1; it != viewpoint_indices.end(); ++it) {
+    const ViewpointMotion sub_motion = getViewpointMotion(*(it - 1), *it);
+    motion.append(sub_motion);
+  }
+  return motion;
+}
+
+viewpoint_planner::ViewpointMotionDistanceOracle ViewpointPlanner::createViewpointMotionDistanceOracle(
+        const bool reconstruct_paths) const {
+  using Oracle = viewpoint_planner::ViewpointMotionDistanceOracle;
+  // Currently the code assumes the same indices for the viewpoint graph and the viewpoint entries
+  std::vector<Oracle::Edge> edges;
+  edges.reserve(viewpoint_graph_motions_.size());
+  for (const auto& entry : viewpoint_graph_motions_) {
+    const ViewpointIndexPair& vip = entry.first;
+    if (vip.index1 == vip.index2) {
+      continue;
+    }
+    const FloatType weight = viewpoint_graph_.getWeightByNode(vip.index1, vip.index2);
+    Oracle::Edge edge;
+    edge.vertex1 = static_cast<Oracle::Vertex>(vip.index1);
+    edge.vertex2 = static_cast<Oracle::Vertex>(vip.index2);
+    edge.cost = getViewpointMotionSearchCost(weight);
+    edges.push_back(edge);
+  }
+  Oracle::Options oracle_options;
+  oracle_options.reconstruct_paths = reconstruct_paths;
+  return Oracle(oracle_options, viewpoint_graph_.size(), edges);
+}
+
 // AStar
 bool ViewpointPlanner::findAndAddShortestMotion(const ViewpointEntryIndex from_index, const ViewpointEntryIndex to_index) {
   const bool verbose = false;
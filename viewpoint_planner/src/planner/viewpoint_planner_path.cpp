@@ -202,25 +202,26 @@ bool ViewpointPlanner::addViewpointPathEntryWithStereoPair(const size_t viewpoin
 
 auto ViewpointPlanner::addObservedVoxelsToViewpointPath(ViewpointPath* viewpoint_path,
                                                         ViewpointPathComputationData* comp_data,
-                                                        const VoxelWithInformationSet& voxel_set) -> FloatType {
+                                                        const VoxelIndexWithInformationSet& voxel_set) -> FloatType {
   FloatType new_information = 0;
   new_information = 0;
-  for (const VoxelWithInformation& vi : voxel_set) {
-    const FloatType observation_information = options_.viewpoint_information_factor * vi.information;
+  for (std::size_t i = 0; i < voxel_set.size(); ++i) {
+    const VoxelIndex voxel_index = voxel_set.getIndex(i);
+    const FloatType observation_information = options_.viewpoint_information_factor * voxel_set.getInformation(i);
     FloatType novel_observation_information;
-    auto it = viewpoint_path->observed_voxel_map.find(vi.voxel);
-    if (it == viewpoint_path->observed_voxel_map.end()) {
-      viewpoint_path->observed_voxel_map.emplace(vi.voxel, observation_information);
+    FloatType* observed_information = viewpoint_path->observed_voxel_map.find(voxel_index);
+    if (observed_information == nullptr) {
+      viewpoint_path->observed_voxel_map.emplace(voxel_index, observation_information);
       novel_observation_information = observation_information;
     }
     else {
-      const WeightType voxel_weight = vi.voxel->getObject()->weight;
-      novel_observation_information = std::min(observation_information, voxel_weight - it->second);
-      BH_ASSERT(it->second <= voxel_weight);
-      if (it->second <= voxel_weight) {
-        it->second += observation_information;
-        if (it->second > voxel_weight) {
-          it->second = voxel_weight;
+      const WeightType voxel_weight = getVoxel(voxel_index)->getObject()->weight;
+      novel_observation_information = std::min(observation_information, voxel_weight - *observed_information);
+      BH_ASSERT(*observed_information <= voxel_weight);
+      if (*observed_information <= voxel_weight) {
+        *observed_information += observation_information;
+        if (*observed_information > voxel_weight) {
+          *observed_information = voxel_weight;
         }
       }
     }
@@ -453,9 +454,9 @@ void ViewpointPlanner::findInitialViewpointPathEntries(const FloatType alpha, co
     it->acc_objective = best_path_entry.acc_objective;
     it->entries.emplace_back(std::move(best_path_entry));
     BH_ASSERT(it->observed_voxel_map.empty());
-    for (const VoxelWithInformation& voxel_with_information : best_viewpoint_entry.voxel_set) {
+    for (const VoxelIndexWithInformation& voxel_with_information : best_viewpoint_entry.voxel_set) {
       it->observed_voxel_map.emplace(
-          voxel_with_information.voxel,
+          voxel_with_information.index,
           options_.viewpoint_information_factor * voxel_with_information.information);
     }
 //    it->observed_voxel_set.insert(best_viewpoint_entry.voxel_set.cbegin(), best_viewpoint_entry.voxel_set.cend());
@@ -478,7 +479,7 @@ void ViewpointPlanner::initializeViewpointPathInformations(ViewpointPath* viewpo
   const size_t largest_component_idx = max_it - component_counts.begin();
   std::cout << "Initializing viewpoint path information for largest connected component in viewpoint graph "
           << "(" << *max_it << " viewpoints)" << std::endl;
-  comp_data->sorted_new_informations.clear();
+  comp_data->new_informations.clear();
   for (auto it = viewpoint_graph_.begin(); it != viewpoint_graph_.end(); ++it) {
     const ViewpointEntryIndex viewpoint_index = it.node();
     if (component_indices[viewpoint_index] != largest_component_idx) {
@@ -490,16 +491,12 @@ void ViewpointPlanner::initializeViewpointPathInformations(ViewpointPath* viewpo
     }
     const ViewpointEntry& viewpoint_entry = viewpoint_entries_[viewpoint_index];
     const FloatType viewpoint_total_information = viewpoint_entry.total_information;
-    comp_data->sorted_new_informations.push_back(std::make_tuple(viewpoint_index, viewpoint_total_information, true));
+    comp_data->new_informations.push(viewpoint_index, viewpoint_total_information);
   }
-  std::sort(comp_data->sorted_new_informations.begin(), comp_data->sorted_new_informations.end(),
-      [](const std::tuple<ViewpointEntryIndex, FloatType, bool>& a, const std::tuple<ViewpointEntryIndex, FloatType, bool>& b) {
-        return std::get<1>(a) < std::get<1>(b);
-  });
 }
 
 void ViewpointPlanner::updateViewpointPathInformations(ViewpointPath* viewpoint_path, ViewpointPathComputationData* comp_data) {
-  if (comp_data->sorted_new_informations.empty()) {
+  if (comp_data->new_informations.empty()) {
     return;
   }
 //  // Test code for checking the lazy update scheme
@@ -514,35 +511,40 @@ void ViewpointPlanner::updateViewpointPathInformations(ViewpointPath* viewpoint_
 //  // End of test code
 
   // Updating information without considering triangulation
-  // TODO: This would be better to do with a binary heap
   // Our function is sub-modular so we can lazily update the best entries
-  std::size_t recompute_count = 0;
-  bool change_occured;
-  do {
-    change_occured = false;
-    auto best_it = comp_data->sorted_new_informations.rbegin();
-    FloatType new_information;
-    if (std::get<2>(*best_it)) {
-//      new_information = computeNewInformation(*viewpoint_path, *comp_data, std::get<0>(*best_it));
-      new_information = evaluateNovelViewpointInformation(*viewpoint_path, *comp_data, std::get<0>(*best_it));
-    }
-    else {
-      new_information = 0;
-    }
-    std::get<1>(*best_it) = new_information;
-    ++recompute_count;
-    for (auto it = comp_data->sorted_new_informations.rbegin() + 1; it != comp_data->sorted_new_informations.rend(); ++it) {
-      if (std::get<1>(*it) > std::get<1>(*(it-1))) {
-        change_occured = true;
-        // Swap with higher entry if update gives better information score
-        swap(*it, *(it - 1));
-      }
-      else {
-        break;
+  const auto evaluate = [&](const ViewpointEntryIndex viewpoint_index) {
+//    return computeNewInformation(*viewpoint_path, *comp_data, viewpoint_index);
+    return evaluateNovelViewpointInformation(*viewpoint_path, *comp_data, viewpoint_index);
+  };
+  // The path might have changed since the last update
+  comp_data->new_informations.invalidateValues();
+  std::size_t recompute_count;
+  if (options_.viewpoint_path_stochastic_greedy_sample_size > 0) {
+    const auto sample_index = [&](const std::size_t n) {
+      return static_cast<std::size_t>(random_.sampleUniformIntExclusive(n));
+    };
+    recompute_count = comp_data->new_informations.updateTopStochastic(
+        evaluate, sample_index, options_.viewpoint_path_stochastic_greedy_sample_size,
+        options_.viewpoint_path_lazy_greedy_epsilon);
+  }
+  else if (options_.viewpoint_path_information_batch_size > 0) {
+    // The observed voxels of the path are not modified while re-evaluating so the candidates can be scored concurrently
+    const auto evaluate_batch = [&](const std::vector<ViewpointEntryIndex>& viewpoint_indices,
+                                    std::vector<FloatType>* new_informations) {
+#pragma omp parallel for schedule(dynamic)
+      for (std::size_t i = 0; i < viewpoint_indices.size(); ++i) {
+        (*new_informations)[i] = evaluate(viewpoint_indices[i]);
       }
-    }
-  } while (change_occured);
-  std::cout << "Recomputed " << recompute_count << " of " << comp_data->sorted_new_informations.size() << " viewpoints" << std::endl;
+    };
+    recompute_count = comp_data->new_informations.updateTopBatched(
+        evaluate_batch, options_.viewpoint_path_information_batch_size, options_.viewpoint_path_lazy_greedy_epsilon);
+  }
+  else {
+    recompute_count = comp_data->new_informations.updateTop(evaluate, options_.viewpoint_path_lazy_greedy_epsilon);
+  }
+  std::cout << "Recomputed " << recompute_count << " of " << comp_data->new_informations.size() << " viewpoints"
+            << " (" << comp_data->new_informations.getNumEvaluations() / FloatType(comp_data->new_informations.getNumUpdates())
+            << " re-evaluations per selected viewpoint)" << std::endl;
 }
 
 void ViewpointPlanner::addNextViewpointPathEntryResult(ViewpointPath* viewpoint_path,
@@ -671,27 +673,29 @@ ViewpointPlanner::NextViewpointPathEntryStatus ViewpointPlanner::findNextViewpoi
 
 std::pair<ViewpointPlanner::ViewpointEntryIndex, ViewpointPlanner::FloatType> ViewpointPlanner::getBestNextViewpoint(
       const ViewpointPath& viewpoint_path, const ViewpointPathComputationData& comp_data, const bool randomize) const {
-  if (comp_data.sorted_new_informations.empty()) {
+  if (comp_data.new_informations.empty()) {
     return std::make_pair((ViewpointEntryIndex)-1, 0);
   }
   if (randomize) {
     // TODO: Make as parameters
     const std::size_t num_of_good_viewpoints_to_sample_from = 100;
+    const std::vector<NewInformationQueue::Entry> good_entries =
+        comp_data.new_informations.getTopEntries(num_of_good_viewpoints_to_sample_from);
     auto it = random_.sampleDiscreteWeighted(
-        comp_data.sorted_new_informations.cend() - num_of_good_viewpoints_to_sample_from,
-        comp_data.sorted_new_informations.cend(),
-        [](const std::tuple<ViewpointEntryIndex, FloatType, bool>& entry) {
-      const FloatType information = std::get<1>(entry);
+        good_entries.cbegin(),
+        good_entries.cend(),
+        [](const NewInformationQueue::Entry& entry) {
+      const FloatType information = entry.value;
       return information;
     });
-    if (it == comp_data.sorted_new_informations.cend()) {
-      it = comp_data.sorted_new_informations.cend() - 1;
+    if (it == good_entries.cend()) {
+      it = good_entries.cbegin();
     }
-    return std::make_pair(std::get<0>(*it), std::get<1>(*it));
+    return std::make_pair(it->key, it->value);
   }
   else {
-    return std::make_pair(std::get<0>(comp_data.sorted_new_informations.back()),
-                          std::get<1>(comp_data.sorted_new_informations.back()));
+    return std::make_pair(comp_data.new_informations.top().key,
+                          comp_data.new_informations.top().value);
   }
 }
 
@@ -726,11 +730,11 @@ ViewpointPlanner::FloatType ViewpointPlanner::computeViewpointPathInformationUpp
     }
     std::cout << "WARNING: Accumulated viewpoint path information does not match individual path entries" << std::endl;
   }
-  const std::size_t num_viewpoints = std::min(max_num_viewpoints, comp_data.sorted_new_informations.size());
-  for (auto it = comp_data.sorted_new_informations.rbegin(); it != comp_data.sorted_new_informations.rbegin() + num_viewpoints; ++it) {
-    const FloatType information = std::get<1>(*it);
+  const std::vector<NewInformationQueue::Entry> top_entries = comp_data.new_informations.getTopEntries(max_num_viewpoints);
+  for (auto it = top_entries.begin(); it != top_entries.end(); ++it) {
+    const FloatType information = it->value;
     information_upper_bound += information;
-//    std::cout << "sorted new information " << (it - comp_data.sorted_new_informations.rbegin()) << ": " << information << std::endl;
+//    std::cout << "sorted new information " << (it - top_entries.begin()) << ": " << information << std::endl;
   }
   return information_upper_bound;
 }
@@ -835,15 +839,12 @@ std::pair<bool, ViewpointPlanner::ViewpointEntryIndex> ViewpointPlanner::findMat
       }
     };
 
-    const auto compute_overlap_information_lambda = [&](const VoxelWithInformationSet& voxel_set1,
-                                                        const VoxelWithInformationSet& voxel_set2) -> FloatType {
+    const auto compute_overlap_information_lambda = [&](const VoxelIndexWithInformationSet& voxel_set1,
+                                                        const VoxelIndexWithInformationSet& voxel_set2) -> FloatType {
       FloatType overlap_information = 0;
-      for (const VoxelWithInformation& vi : voxel_set1) {
-        const auto it = voxel_set2.find(vi);
-        if (it != voxel_set2.end()) {
-          overlap_information += std::min(it->information, vi.information);
-        }
-      }
+      voxel_set1.forEachIntersection(voxel_set2, [&](const std::size_t i, const std::size_t j) {
+        overlap_information += std::min(voxel_set2.getInformation(j), voxel_set1.getInformation(i));
+      });
       return overlap_information;
     };
 
@@ -851,7 +852,7 @@ std::pair<bool, ViewpointPlanner::ViewpointEntryIndex> ViewpointPlanner::findMat
 
     ViewpointEntryIndex best_index = (ViewpointEntryIndex)-1;
     Viewpoint best_viewpoint;
-    VoxelWithInformationSet best_voxel_set;
+    VoxelIndexWithInformationSet best_voxel_set;
     FloatType best_total_information = std::numeric_limits<FloatType>::lowest();
     FloatType best_overlap_information = std::numeric_limits<FloatType>::lowest();
 
@@ -882,14 +883,14 @@ std::pair<bool, ViewpointPlanner::ViewpointEntryIndex> ViewpointPlanner::findMat
         const Viewpoint new_viewpoint = getVirtualViewpoint(new_pose);
         // Check if sparse matchable
 //        const bool sparse_matchable = ignore_sparse_matching || isSparseMatchable(viewpoint_entry.viewpoint, new_viewpoint);
-        const bool sparse_matchable = ignore_sparse_matching || isSparseMatchable2(viewpoint_entry.viewpoint, new_viewpoint);
+        const bool sparse_matchable = ignore_sparse_matching || isSparseMatchable2(viewpoint_index, new_viewpoint);
         if (!sparse_matchable) {
           continue;
         }
         // Compute overlap information by raycasting from new viewpoint
         std::pair<VoxelWithInformationSet, FloatType> raycast_result =
                 getRaycastHitVoxelsWithInformationScore(new_viewpoint);
-        VoxelWithInformationSet& new_voxel_set = raycast_result.first;
+        VoxelIndexWithInformationSet new_voxel_set(raycast_result.first);
         const FloatType overlap_information = compute_overlap_information_lambda(new_voxel_set, viewpoint_entry.voxel_set);
         if (overlap_information > best_overlap_information) {
           best_index = other_index;
@@ -929,7 +930,7 @@ std::pair<bool, ViewpointPlanner::ViewpointEntryIndex> ViewpointPlanner::findMat
         // Check if sparse matchable
         const Viewpoint new_viewpoint = getVirtualViewpoint(new_pose);
 //        const bool sparse_matchable = ignore_sparse_matching || isSparseMatchable(viewpoint_entry.viewpoint, new_viewpoint);
-        const bool sparse_matchable = ignore_sparse_matching || isSparseMatchable2(viewpoint_entry.viewpoint, new_viewpoint);
+        const bool sparse_matchable = ignore_sparse_matching || isSparseMatchable2(viewpoint_index, new_viewpoint);
         if (!sparse_matchable) {
           continue;
         }
@@ -957,7 +958,7 @@ std::pair<bool, ViewpointPlanner::ViewpointEntryIndex> ViewpointPlanner::findMat
         // Compute overlap information by raycasting from new viewpoint
         std::pair<VoxelWithInformationSet, FloatType> raycast_result =
                 getRaycastHitVoxelsWithInformationScore(new_viewpoint);
-        VoxelWithInformationSet& new_voxel_set = raycast_result.first;
+        VoxelIndexWithInformationSet new_voxel_set(raycast_result.first);
         ++num_raycast_samples;
         const FloatType overlap_information = compute_overlap_information_lambda(new_voxel_set, viewpoint_entry.voxel_set);
         if (overlap_information > best_overlap_information) {
@@ -980,7 +981,7 @@ std::pair<bool, ViewpointPlanner::ViewpointEntryIndex> ViewpointPlanner::findMat
     const FloatType best_overlap_ratio = best_overlap_information / viewpoint_entry.total_information;
     BH_PRINT_VALUE(best_overlap_ratio);
     // Add viewpoint candidate with same translation as best found stereo viewpoint and looking at the voxel center of the reference viewpoint
-    const VoxelWithInformationSet overlap_set = bh::computeSetIntersection(viewpoint_entry.voxel_set, best_voxel_set);
+    const VoxelIndexWithInformationSet overlap_set = viewpoint_entry.voxel_set.computeIntersection(best_voxel_set);
     const FloatType voxel_overlap_ratio = overlap_set.size() / (FloatType)viewpoint_entry.voxel_set.size();
     const FloatType first_total_information = computeInformationScore(viewpoint_entry.viewpoint, viewpoint_entry.voxel_set.begin(), viewpoint_entry.voxel_set.end());
     const FloatType second_total_information = computeInformationScore(best_viewpoint, best_voxel_set.begin(), best_voxel_set.end());
@@ -1130,7 +1131,7 @@ std::pair<bool, ViewpointPlanner::ViewpointEntryIndex> ViewpointPlanner::findMat
       const bool ignore_angular_deviation = false;
       if (is_stereo_pair_lambda(other_viewpoint_entry.viewpoint.pose(), ignore_angular_deviation)) {
         // Compute overlap information
-        const VoxelWithInformationSet overlap_set = bh::computeSetIntersection(viewpoint_entry.voxel_set, other_viewpoint_entry.voxel_set);
+        const VoxelIndexWithInformationSet overlap_set = viewpoint_entry.voxel_set.computeIntersection(other_viewpoint_entry.voxel_set);
         const FloatType voxel_overlap_ratio = overlap_set.size() / (FloatType)viewpoint_entry.voxel_set.size();
         const FloatType overlap_information = computeInformationScore(other_viewpoint_entry.viewpoint, overlap_set.begin(), overlap_set.end());
         const FloatType information_overlap_ratio = overlap_information / viewpoint_entry.total_information;
@@ -1199,7 +1200,7 @@ auto ViewpointPlanner::updateAndGetBestNextViewpoint(
         }
       }
       if (viewpoint_is_too_far) {
-        std::get<2>(*comp_data->sorted_new_informations.rbegin()) = false;
+        comp_data->new_informations.remove(new_viewpoint_index);
         new_viewpoint_index = (ViewpointEntryIndex)-1;
       }
     }
@@ -1299,7 +1300,7 @@ auto ViewpointPlanner::findNextViewpointPathEntry(
     if (verbose) {
       std::cout << "Selected viewpoint is not a valid path entry. Invalidating: " << best_path_entry.viewpoint_index << std::endl;
     }
-    std::get<2>(*comp_data->sorted_new_informations.rbegin()) = false;
+    comp_data->new_informations.remove(best_path_entry.viewpoint_index);
     result.status = NO_VALID_PATH_ENTRY;
     return result;
   }
@@ -1318,7 +1319,7 @@ auto ViewpointPlanner::findNextViewpointPathEntry(
         std::cout << "No stereo viewpoint for viewpoint " << best_path_entry.viewpoint_index << std::endl;
       }
       // Mark viewpoint as invalid to prevent use in the future
-      std::get<2>(*comp_data->sorted_new_informations.rbegin()) = false;
+      comp_data->new_informations.remove(best_path_entry.viewpoint_index);
       result.status = NO_STEREO_VIEWPOINT;
       return result;
     }
@@ -1337,7 +1338,7 @@ auto ViewpointPlanner::findNextViewpointPathEntry(
 //        std::cout << "Could not find any usable stereo viewpoint for viewpoint " << best_path_entry.viewpoint_index << std::endl;
 //      }
 //      // Mark viewpoint as invalid to prevent use in the future
-//      std::get<2>(*comp_data->sorted_new_informations.rbegin()) = false;
+//      comp_data->new_informations.remove(best_path_entry.viewpoint_index);
 //      return false;
 //    }
     const bool ignore_if_already_on_path = true;
@@ -1348,14 +1349,14 @@ auto ViewpointPlanner::findNextViewpointPathEntry(
       if (verbose) {
         std::cout << "Matched stereo viewpoint is not a valid path entry. Invalidating: " << best_path_entry.viewpoint_index << std::endl;
       }
-      std::get<2>(*comp_data->sorted_new_informations.rbegin()) = false;
+      comp_data->new_informations.remove(best_path_entry.viewpoint_index);
       result.status = NO_VALID_PATH_ENTRY;
       return result;
     }
   }
 
   // Mark viewpoint as invalid to prevent use in the future
-  std::get<2>(*comp_data->sorted_new_informations.rbegin()) = false;
+  comp_data->new_informations.remove(best_path_entry.viewpoint_index);
 
   if (options_.viewpoint_generate_stereo_pairs) {
     if (options_.dump_stereo_matching_images) {
@@ -7,6 +7,7 @@
 //==================================================
 
 #include "viewpoint_planner.h"
+#include <numeric>
 #include <tuple>
 #include <boost/graph/graph_traits.hpp>
 #include <boost/graph/adjacency_list.hpp>
@@ -16,8 +17,11 @@
 #include <boost/heap/binomial_heap.hpp>
 #include <boost/heap/fibonacci_heap.hpp>
 #include <bh/algorithm.h>
+#include "viewpoint_tour_local_search.h"
 
 using std::swap;
+using viewpoint_planner::ViewpointMotionDistanceOracle;
+using viewpoint_planner::ViewpointTourLocalSearch;
 
 void ViewpointPlanner::computeViewpointTour(ViewpointPath* viewpoint_path,
                                             ViewpointPathComputationData* comp_data,
@@ -369,14 +373,58 @@ bool ViewpointPlanner::ensureFullyConnectedViewpointPath(
   if (recompute_all) {
     comp_data->num_connected_entries = 0;
   }
+  const std::size_t first_new_entry = comp_data->num_connected_entries;
+  if (first_new_entry >= viewpoint_path->entries.size()) {
+    return true;
+  }
 
-  for (std::size_t i = comp_data->num_connected_entries; i < viewpoint_path->entries.size(); ++i) {
+  // Search shortest motions from all new path entries to all lower path entries at once (in parallel) instead of
+  // running one A-Star search for each pair of path entries.
+  // Each new entry only needs paths to the lower entries so the targets are restricted to those.
+  bh::Timer timer;
+  std::vector<ViewpointMotionDistanceOracle::Vertex> sources;
+  std::vector<ViewpointMotionDistanceOracle::Vertex> targets;
+  std::vector<std::size_t> num_source_targets;
+  for (std::size_t i = 0; i < viewpoint_path->entries.size(); ++i) {
+    const auto vertex = static_cast<ViewpointMotionDistanceOracle::Vertex>(viewpoint_path->entries[i].viewpoint_index);
+    if (i >= first_new_entry) {
+      sources.push_back(vertex);
+      num_source_targets.push_back(i);
+    }
+    targets.push_back(vertex);
+  }
+  const bool reconstruct_paths = true;
+  ViewpointMotionDistanceOracle oracle = createViewpointMotionDistanceOracle(reconstruct_paths);
+  oracle.compute(sources, targets, num_source_targets);
+  if (verbose) {
+    std::cout << "Computed motion distances from " << sources.size() << " to " << targets.size()
+              << " path entries in " << timer.getElapsedTime() << " s" << std::endl;
+  }
+
+  for (std::size_t i = first_new_entry; i < viewpoint_path->entries.size(); ++i) {
     if (verbose) {
       std::cout << "Searching motions for path entry " << i << std::endl;
     }
-    const bool ignore_existing_viewpoints = false;
-    const size_t num_connections_found = connectViewpointPathEntryToLowerEntries(
-            i, viewpoint_path, ignore_existing_viewpoints);
+    const ViewpointEntryIndex from_viewpoint_index = viewpoint_path->entries[i].viewpoint_index;
+    size_t num_connections_found = 0;
+    for (std::size_t j = 0; j < i; ++j) {
+      const ViewpointEntryIndex to_viewpoint_index = viewpoint_path->entries[j].viewpoint_index;
+      if (from_viewpoint_index == to_viewpoint_index) {
+        continue;
+      }
+      if (hasViewpointMotion(from_viewpoint_index, to_viewpoint_index)) {
+        ++num_connections_found;
+        continue;
+      }
+      const std::vector<ViewpointMotionDistanceOracle::Vertex>& path = oracle.getPath(i - first_new_entry, j);
+      if (path.empty()) {
+        continue;
+      }
+      const std::vector<ViewpointEntryIndex> viewpoint_indices(path.begin(), path.end());
+      const ViewpointMotion motion = getViewpointMotionAlongPath(viewpoint_indices);
+      addViewpointMotion(optimizeViewpointMotion(motion));
+      ++num_connections_found;
+    }
     const size_t num_lower_entries = i;
     if (num_connections_found < num_lower_entries) {
       if (verbose) {
@@ -514,22 +562,6 @@ bool ViewpointPlanner::solveApproximateTSP(
   return true;
 }
 
-std::vector<std::size_t> ViewpointPlanner::swap2Opt(
-    ViewpointPath* viewpoint_path, ViewpointPathComputationData* comp_data,
-    const std::size_t k_start, const std::size_t k_end) const {
-  std::vector<std::size_t> new_order(viewpoint_path->order.size());
-  for (std::size_t i = 0; i < k_start; ++i) {
-    new_order[i] = viewpoint_path->order[i];
-  }
-  for (std::size_t i = 0; i <= k_end - k_start; ++i) {
-    new_order[k_start + i] = viewpoint_path->order[k_end - i];
-  }
-  for (std::size_t i = k_end + 1; i < new_order.size(); ++i) {
-    new_order[i] = viewpoint_path->order[i];
-  }
-  return new_order;
-}
-
 ViewpointPlanner::FloatType ViewpointPlanner::computeTourLength(const ViewpointPath& viewpoint_path, const std::vector<std::size_t>& order) const {
   if (order.size() <= 1) {
     return 0;
@@ -563,54 +595,62 @@ ViewpointPlanner::FloatType ViewpointPlanner::computeTourLength(const ViewpointP
 void ViewpointPlanner::improveViewpointTourWith2Opt(
     ViewpointPath* viewpoint_path, ViewpointPathComputationData* comp_data) {
   const bool verbose = true;
-  const std::size_t max_k_length = options_.viewpoint_path_2opt_max_k_length;
 
-  const FloatType initial_tour_length = computeTourLength(*viewpoint_path, viewpoint_path->order);
-  if (verbose) {
-    std::cout << "Improving tour with 2 Opt. Initial tour length: " << initial_tour_length << std::endl;
+  // The local search works on the positions of the initial tour as nodes
+  const std::vector<std::size_t> initial_order = viewpoint_path->order;
+  const std::size_t num_nodes = initial_order.size();
+  std::unordered_map<ViewpointEntryIndex, std::size_t> viewpoint_index_to_node;
+  for (std::size_t node = 0; node < num_nodes; ++node) {
+    viewpoint_index_to_node.emplace(viewpoint_path->entries[initial_order[node]].viewpoint_index, node);
   }
-
-  FloatType shortest_tour_length = initial_tour_length;
-  bool improvement_made;
-  do {
-    improvement_made = false;
-    for (std::size_t k_start = 1; k_start < viewpoint_path->order.size(); ++k_start) {
-      const std::size_t max_k_end = std::min(k_start + max_k_length, viewpoint_path->order.size());
-      for (std::size_t k_end = k_start + 1; k_end < max_k_end; ++k_end) {
-        std::vector<std::size_t> new_order = swap2Opt(viewpoint_path, comp_data, k_start, k_end);
-        const FloatType new_tour_length = computeTourLength(*viewpoint_path, new_order);
-        if (new_tour_length < shortest_tour_length) {
-          // Check if new tour is matchable
-          bool matchable = true;
-          if (options_.viewpoint_path_2opt_check_sparse_matching) {
-            for (size_t i = k_start - 1; i < k_end + 1; ++i) {
-              const size_t from_index = i;
-              size_t to_index = i + 1;
-              if (to_index == new_order.size()) {
-                to_index = 0;
-              }
-              if (!isSparseMatchable2(from_index, to_index)) {
-                matchable = false;
-                break;
-              }
-            }
-          }
-          if (matchable) {
-            viewpoint_path->order = std::move(new_order);
-            shortest_tour_length = new_tour_length;
-            improvement_made = true;
-          }
-        }
+  std::vector<FloatType> distances(num_nodes * num_nodes, std::numeric_limits<FloatType>::infinity());
+  for (std::size_t node = 0; node < num_nodes; ++node) {
+    const ViewpointEntryIndex viewpoint_index = viewpoint_path->entries[initial_order[node]].viewpoint_index;
+    auto edges = viewpoint_graph_.getEdgesByNode(viewpoint_index);
+    for (auto it = edges.begin(); it != edges.end(); ++it) {
+      const auto node_it = viewpoint_index_to_node.find(it.targetNode());
+      if (node_it != viewpoint_index_to_node.end() && node_it->second != node) {
+        distances[node * num_nodes + node_it->second] = it.weight();
       }
     }
-  } while (improvement_made);
+  }
+
+  ViewpointTourLocalSearch::Options local_search_options;
+  local_search_options.num_neighbors = options_.viewpoint_path_2opt_num_neighbors;
+  local_search_options.max_or_opt_segment_length = options_.viewpoint_path_or_opt_max_segment_length;
+  local_search_options.max_2opt_segment_length = options_.viewpoint_path_2opt_max_k_length;
+  ViewpointTourLocalSearch local_search(local_search_options, num_nodes, std::move(distances));
+  if (options_.viewpoint_path_2opt_check_sparse_matching) {
+    local_search.setEdgeCheckFunction([&](const std::size_t node1, const std::size_t node2) {
+      const ViewpointEntryIndex viewpoint_index1 = viewpoint_path->entries[initial_order[node1]].viewpoint_index;
+      const ViewpointEntryIndex viewpoint_index2 = viewpoint_path->entries[initial_order[node2]].viewpoint_index;
+      return isSparseMatchable2(viewpoint_index1, viewpoint_index2);
+    });
+  }
+
+  std::vector<std::size_t> tour(num_nodes);
+  std::iota(tour.begin(), tour.end(), 0);
+  const FloatType initial_tour_length = local_search.computeTourLength(tour);
+  if (verbose) {
+    std::cout << "Improving tour with 2 Opt and Or Opt. Initial tour length: " << initial_tour_length << std::endl;
+  }
+
+  bh::Timer timer;
+  const ViewpointTourLocalSearch::Statistics statistics = local_search.improveTour(&tour);
+  const FloatType tour_length = local_search.computeTourLength(tour);
+  for (std::size_t i = 0; i < num_nodes; ++i) {
+    viewpoint_path->order[i] = initial_order[tour[i]];
+  }
   if (verbose) {
-    if (shortest_tour_length < initial_tour_length) {
+    std::cout << "Local search applied " << statistics.num_2opt_moves << " 2 Opt and "
+              << statistics.num_or_opt_moves << " Or Opt moves (" << statistics.num_evaluated_moves
+              << " moves evaluated) in " << timer.getElapsedTime() << " s" << std::endl;
+    if (tour_length < initial_tour_length) {
       std::cout << "After 2 Opt" << std::endl;
       for (const std::size_t i : viewpoint_path->order) {
         std::cout << "  i=" << i << " entry=" << viewpoint_path->entries[i].viewpoint_index << std::endl;
       }
-      std::cout << "Improved tour length from " << initial_tour_length << " to " << shortest_tour_length << std::endl;
+      std::cout << "Improved tour length from " << initial_tour_length << " to " << tour_length << std::endl;
     }
     else {
       std::cout << "Unable to improve tour with 2 Opt" << std::endl;
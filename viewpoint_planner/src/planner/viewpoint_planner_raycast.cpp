@@ -7,17 +7,22 @@
 //==================================================
 
 #include "viewpoint_planner.h"
+#include <algorithm>
 #include <bh/opengl/utils.h>
 
-std::unordered_set<size_t> ViewpointPlanner::getVisibleVoxels(const Viewpoint& viewpoint) const {
+ViewpointPlanner::VisibleVoxelIndices ViewpointPlanner::getVisibleVoxels(const Viewpoint& viewpoint) const {
+  std::unique_lock<std::mutex> lock(offscreen_opengl_mutex_);
   ensureOctreeDrawerIsInitialized();
   auto drawing_handle = offscreen_opengl_->beginDrawing();
   const QMatrix4x4 pvm_matrix = offscreen_opengl_->getPvmMatrixFromPose(viewpoint.pose());
   const QMatrix4x4 vm_matrix = offscreen_opengl_->getVmMatrixFromPose(viewpoint.pose());
   octree_drawer_->draw(pvm_matrix, vm_matrix);
   const QImage image_qt = drawing_handle.getImageQt();
-  std::unordered_set<size_t> visible_voxels = bh::opengl::getIndicesSetFromImage(image_qt);
+  const std::unordered_set<size_t> visible_voxels_set = bh::opengl::getIndicesSetFromImage(image_qt);
   drawing_handle.finish();
+  lock.unlock();
+  VisibleVoxelIndices visible_voxels(visible_voxels_set.begin(), visible_voxels_set.end());
+  std::sort(visible_voxels.begin(), visible_voxels.end());
   return visible_voxels;
 }
 
@@ -125,19 +125,22 @@ ViewpointPlanner::FloatType ViewpointPlanner::computeNewInformation(
     const ViewpointPath& viewpoint_path, const ViewpointPathComputationData& comp_data,
     const ViewpointEntryIndex new_viewpoint_index) const {
   const ViewpointEntry& new_viewpoint = viewpoint_entries_[new_viewpoint_index];
-  FloatType new_information = std::accumulate(new_viewpoint.voxel_set.cbegin(), new_viewpoint.voxel_set.cend(),
-    FloatType { 0 }, [&](const FloatType& value, const VoxelWithInformation& vi) {
-      const FloatType observation_information = options_.viewpoint_information_factor * vi.information;
-      FloatType novel_information = observation_information;
-      auto it = viewpoint_path.observed_voxel_map.find(vi.voxel);
-      if (it != viewpoint_path.observed_voxel_map.end()) {
-        const WeightType voxel_weight = vi.voxel->getObject()->weight;
-//        BH_ASSERT(it->second <= voxel_weight);
-        novel_information = std::min(observation_information, voxel_weight - it->second);
-      }
-//      BH_ASSERT(novel_information >= 0);
-      return value + novel_information;
-    });
+  // Linear pass over the sorted voxel indices with a single array lookup into the observed voxels per voxel
+  const std::vector<VoxelIndex>& voxel_indices = new_viewpoint.voxel_set.getIndices();
+  const std::vector<FloatType>& voxel_informations = new_viewpoint.voxel_set.getInformations();
+  FloatType new_information = 0;
+  for (std::size_t i = 0; i < voxel_indices.size(); ++i) {
+    const FloatType observation_information = options_.viewpoint_information_factor * voxel_informations[i];
+    FloatType novel_information = observation_information;
+    const FloatType* observed_information = viewpoint_path.observed_voxel_map.find(voxel_indices[i]);
+    if (observed_information != nullptr) {
+      const WeightType voxel_weight = getVoxel(voxel_indices[i])->getObject()->weight;
+//      BH_ASSERT(*observed_information <= voxel_weight);
+      novel_information = std::min(observation_information, voxel_weight - *observed_information);
+    }
+//    BH_ASSERT(novel_information >= 0);
+    new_information += novel_information;
+  }
   //    VoxelWithInformationSet difference_set = bh::computeSetDifference(new_viewpoint.voxel_set, viewpoint_path.observed_voxel_set);
   //    FloatType new_information = std::accumulate(difference_set.cbegin(), difference_set.cend(),
   //        FloatType { 0 }, [](const FloatType& value, const VoxelWithInformation& voxel) {
@@ -156,9 +159,9 @@ ViewpointPlanner::FloatType ViewpointPlanner::computeNewInformation(
 ViewpointPlanner::Vector3 ViewpointPlanner::computeInformationVoxelCenter(const ViewpointEntry& viewpoint_entry) const {
   Vector3 voxel_center = Vector3::Zero();
   FloatType total_weight = 0;
-  for (const VoxelWithInformation& vi : viewpoint_entry.voxel_set) {
+  for (const VoxelIndexWithInformation& vi : viewpoint_entry.voxel_set) {
     const FloatType information = vi.information;
-    voxel_center += information * vi.voxel->getBoundingBox().getCenter();
+    voxel_center += information * getVoxel(vi.index)->getBoundingBox().getCenter();
     total_weight += information;
   }
   voxel_center /= total_weight;
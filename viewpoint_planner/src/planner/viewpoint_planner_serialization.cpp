@@ -8,9 +8,87 @@
 
 #include "viewpoint_planner.h"
 #include "viewpoint_planner_serialization.h"
+#include <cstdint>
 #include <boost/serialization/deque.hpp>
+#include <bh/flat_file.h>
+
+namespace {
+
+// "Q3DRVPGF" in little endian byte order
+const std::uint64_t VIEWPOINT_GRAPH_FILE_MAGIC = 0x4647505652443351ull;
+const std::uint32_t VIEWPOINT_GRAPH_FILE_VERSION = 1;
+
+enum ViewpointGraphFileSection : std::uint32_t {
+  // Number of real viewpoints and number of BVH nodes (uint64)
+  VIEWPOINT_GRAPH_SECTION_INFO = 1,
+  // Position and rotation quaternion (x, y, z, w) of each viewpoint (7 FloatType)
+  VIEWPOINT_GRAPH_SECTION_POSES,
+  VIEWPOINT_GRAPH_SECTION_TOTAL_INFORMATIONS,
+  // Range of each viewpoint in the voxel arrays (uint64, number of viewpoints + 1)
+  VIEWPOINT_GRAPH_SECTION_VOXEL_OFFSETS,
+  // Observed voxels as positions in the BVH node traversal order (uint32)
+  VIEWPOINT_GRAPH_SECTION_VOXEL_INDICES,
+  VIEWPOINT_GRAPH_SECTION_VOXEL_INFORMATIONS,
+  VIEWPOINT_GRAPH_SECTION_STEREO_VIEWPOINT_INDICES,
+  VIEWPOINT_GRAPH_SECTION_STEREO_VIEWPOINT_COMPUTED_FLAGS,
+  VIEWPOINT_GRAPH_SECTION_EXPLORATION_FRONT,
+  // Viewpoint index pairs of the graph edges (uint64, index1 < index2)
+  VIEWPOINT_GRAPH_SECTION_EDGES,
+  VIEWPOINT_GRAPH_SECTION_EDGE_WEIGHTS,
+  // Range of each edge's motion in the motion viewpoint indices (uint64, number of edges + 1).
+  // A motion with n viewpoints consists of n - 1 SE3 motions that are stored consecutively.
+  VIEWPOINT_GRAPH_SECTION_MOTION_OFFSETS,
+  VIEWPOINT_GRAPH_SECTION_MOTION_VIEWPOINT_INDICES,
+  // Range of each SE3 motion in the SE3 motion poses (uint64, number of SE3 motions + 1)
+  VIEWPOINT_GRAPH_SECTION_SE3_MOTION_POSE_OFFSETS,
+  // Position and rotation quaternion (x, y, z, w) of each SE3 motion pose (7 FloatType)
+  VIEWPOINT_GRAPH_SECTION_SE3_MOTION_POSES,
+};
+
+const std::size_t POSE_NUM_VALUES = 7;
+
+template <typename PoseT>
+void appendPoseValues(const PoseT& pose, std::vector<ViewpointPlanner::FloatType>* values) {
+  const auto& position = pose.getWorldPosition();
+  const auto& quaternion = pose.quaternion();
+  values->insert(values->end(), { position(0), position(1), position(2),
+                                  quaternion.x(), quaternion.y(), quaternion.z(), quaternion.w() });
+}
+
+ViewpointPlanner::Pose getPoseFromValues(const ViewpointPlanner::FloatType* values) {
+  using Vector3 = ViewpointPlanner::Vector3;
+  using Quaternion = ViewpointPlanner::Quaternion;
+  const Vector3 position(values[0], values[1], values[2]);
+  const Quaternion quaternion(values[6], values[3], values[4], values[5]);
+  return ViewpointPlanner::Pose::createFromImageToWorldTransformation(position, quaternion);
+}
+
+// Offsets of consecutive ranges have to start at zero, be non-decreasing and end at the size of the ranged array
+bool isValidOffsetArray(const bh::ConstArrayView<std::uint64_t>& offsets,
+                        const std::size_t num_ranges, const std::size_t array_size) {
+  if (offsets.size() != num_ranges + 1 || offsets[0] != 0 || offsets[num_ranges] != array_size) {
+    return false;
+  }
+  for (std::size_t i = 0; i < num_ranges; ++i) {
+    if (offsets[i] > offsets[i + 1]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}
 
 void ViewpointPlanner::saveViewpointGraph(const std::string& filename) const {
+  if (options_.viewpoint_graph_save_flat_file) {
+    saveViewpointGraphAsFlatFile(filename);
+  }
+  else {
+    saveViewpointGraphAsBoostArchive(filename);
+  }
+}
+
+void ViewpointPlanner::saveViewpointGraphAsBoostArchive(const std::string& filename) const {
   std::cout << "Writing viewpoint graph to " << filename << std::endl;
   std::cout << "Graph has " << viewpoint_graph_.numVertices() << " viewpoints"
       << " and " << viewpoint_graph_.numEdges() << " motions" << std::endl;
@@ -27,7 +105,122 @@ void ViewpointPlanner::saveViewpointGraph(const std::string& filename) const {
   std::cout << "Done" << std::endl;
 }
 
+void ViewpointPlanner::saveViewpointGraphAsFlatFile(const std::string& filename) const {
+  std::cout << "Writing viewpoint graph flat file to " << filename << std::endl;
+  std::cout << "Graph has " << viewpoint_graph_.numVertices() << " viewpoints"
+      << " and " << viewpoint_graph_.numEdges() << " motions" << std::endl;
+  const ViewpointPlannerData::OccupiedTreeType& bvh_tree = data_->occupied_bvh_;
+
+  const std::vector<std::uint64_t> info = { num_real_viewpoints_, bvh_tree.getNumOfNodes() };
+
+  // Voxels are stored by their position in the traversal order of the BVH (like in the Boost archive)
+  std::vector<std::uint32_t> serialized_voxel_indices(bvh_tree.getNumOfNodes());
+  std::uint32_t serialized_voxel_index = 0;
+  for (const ViewpointPlannerData::OccupiedTreeType::NodeType& node : bvh_tree) {
+    serialized_voxel_indices[node.getIndex()] = serialized_voxel_index;
+    ++serialized_voxel_index;
+  }
+
+  std::vector<FloatType> poses;
+  std::vector<FloatType> total_informations;
+  std::vector<std::uint64_t> voxel_offsets;
+  std::vector<std::uint32_t> voxel_indices;
+  std::vector<FloatType> voxel_informations;
+  poses.reserve(viewpoint_entries_.size() * POSE_NUM_VALUES);
+  total_informations.reserve(viewpoint_entries_.size());
+  voxel_offsets.reserve(viewpoint_entries_.size() + 1);
+  voxel_offsets.push_back(0);
+  for (const ViewpointEntry& entry : viewpoint_entries_) {
+    appendPoseValues(entry.viewpoint.pose(), &poses);
+    total_informations.push_back(entry.total_information);
+    for (std::size_t i = 0; i < entry.voxel_set.size(); ++i) {
+      voxel_indices.push_back(serialized_voxel_indices[entry.voxel_set.getIndex(i)]);
+      voxel_informations.push_back(entry.voxel_set.getInformation(i));
+    }
+    voxel_offsets.push_back(voxel_indices.size());
+  }
+
+  const std::vector<std::uint64_t> stereo_viewpoint_indices(
+          stereo_viewpoint_indices_.begin(), stereo_viewpoint_indices_.end());
+  const std::vector<std::uint8_t> stereo_viewpoint_computed_flags(
+          stereo_viewpoint_computed_flags_.begin(), stereo_viewpoint_computed_flags_.end());
+  const std::vector<std::uint64_t> exploration_front(
+          viewpoint_exploration_front_.begin(), viewpoint_exploration_front_.end());
+
+  // Sort edges so that files are reproducible
+  std::vector<ViewpointIndexPair> index_pairs;
+  index_pairs.reserve(viewpoint_graph_motions_.size());
+  for (const auto& entry : viewpoint_graph_motions_) {
+    index_pairs.push_back(entry.first);
+  }
+  std::sort(index_pairs.begin(), index_pairs.end(), [](const ViewpointIndexPair& a, const ViewpointIndexPair& b) {
+    return std::make_pair(a.index1, a.index2) < std::make_pair(b.index1, b.index2);
+  });
+  std::vector<std::uint64_t> edges;
+  std::vector<FloatType> edge_weights;
+  std::vector<std::uint64_t> motion_offsets;
+  std::vector<std::uint64_t> motion_viewpoint_indices;
+  std::vector<std::uint64_t> se3_motion_pose_offsets;
+  std::vector<FloatType> se3_motion_poses;
+  edges.reserve(2 * index_pairs.size());
+  edge_weights.reserve(index_pairs.size());
+  motion_offsets.reserve(index_pairs.size() + 1);
+  motion_offsets.push_back(0);
+  se3_motion_pose_offsets.push_back(0);
+  for (const ViewpointIndexPair& vip : index_pairs) {
+    edges.push_back(vip.index1);
+    edges.push_back(vip.index2);
+    edge_weights.push_back(viewpoint_graph_.getWeightByNode(vip.index1, vip.index2));
+    const ViewpointMotion& motion = viewpoint_graph_motions_.at(vip);
+    BH_ASSERT(motion.fromIndex() == vip.index1);
+    BH_ASSERT(motion.se3Motions().size() + 1 == motion.viewpointIndices().size());
+    motion_viewpoint_indices.insert(motion_viewpoint_indices.end(),
+                                    motion.viewpointIndices().begin(), motion.viewpointIndices().end());
+    motion_offsets.push_back(motion_viewpoint_indices.size());
+    for (const SE3Motion& se3_motion : motion.se3Motions()) {
+      for (const Pose& pose : se3_motion.poses()) {
+        appendPoseValues(pose, &se3_motion_poses);
+      }
+      se3_motion_pose_offsets.push_back(se3_motion_poses.size() / POSE_NUM_VALUES);
+    }
+  }
+
+  bh::FlatFileWriter writer(VIEWPOINT_GRAPH_FILE_MAGIC, VIEWPOINT_GRAPH_FILE_VERSION);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_INFO, info);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_POSES, poses);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_TOTAL_INFORMATIONS, total_informations);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_VOXEL_OFFSETS, voxel_offsets);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_VOXEL_INDICES, voxel_indices);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_VOXEL_INFORMATIONS, voxel_informations);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_STEREO_VIEWPOINT_INDICES, stereo_viewpoint_indices);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_STEREO_VIEWPOINT_COMPUTED_FLAGS, stereo_viewpoint_computed_flags);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_EXPLORATION_FRONT, exploration_front);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_EDGES, edges);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_EDGE_WEIGHTS, edge_weights);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_MOTION_OFFSETS, motion_offsets);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_MOTION_VIEWPOINT_INDICES, motion_viewpoint_indices);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_SE3_MOTION_POSE_OFFSETS, se3_motion_pose_offsets);
+  writer.addSection(VIEWPOINT_GRAPH_SECTION_SE3_MOTION_POSES, se3_motion_poses);
+  writer.write(filename);
+  std::cout << "Done" << std::endl;
+}
+
 void ViewpointPlanner::loadViewpointGraph(const std::string& filename) {
+  if (bh::FlatFileReader::hasMagic(filename, VIEWPOINT_GRAPH_FILE_MAGIC)) {
+    loadViewpointGraphFromFlatFile(filename);
+  }
+  else {
+    loadViewpointGraphFromBoostArchive(filename);
+  }
+
+  std::cout << "Clearing observed voxels for previous camera viewpoints" << std::endl;
+  for (std::size_t i = 0; i < num_real_viewpoints_; ++i) {
+    ViewpointEntry& viewpoint_entry = viewpoint_entries_[i];
+    viewpoint_entry.voxel_set.clear();
+  }
+}
+
+void ViewpointPlanner::loadViewpointGraphFromBoostArchive(const std::string& filename) {
   reset();
   std::cout << "Loading viewpoint graph from " << filename << std::endl;
   std::ifstream ifs(filename);
@@ -43,24 +236,7 @@ void ViewpointPlanner::loadViewpointGraph(const std::string& filename) {
   viewpoint_graph_.clear();
   ia >> viewpoint_graph_;
   viewpoint_graph_components_valid_ = false;
-  std::cout << "Regenerating approximate nearest neighbor index" << std::endl;
-  viewpoint_ann_.clear();
-  for (const ViewpointEntry& viewpoint_entry : viewpoint_entries_) {
-    viewpoint_ann_.addPoint(viewpoint_entry.viewpoint.pose().getWorldPosition());
-  }
-  if (options_.viewpoint_count_grid_enable) {
-    std::cout << "Regenerating density field" << std::endl;
-    viewpoint_count_grid_.setAllValues(0);
-    for (const ViewpointEntry &viewpoint_entry : viewpoint_entries_) {
-      const Vector3 &viewpoint_position = viewpoint_entry.viewpoint.pose().getWorldPosition();
-      if (viewpoint_count_grid_.isInsideGrid(viewpoint_position)) {
-        viewpoint_count_grid_(viewpoint_position) += 1;
-      }
-      else {
-        std::cout << "WARNING: Loaded viewpoint outside of density grid" << std::endl;
-      }
-    }
-  }
+  rebuildViewpointEntryIndices();
   std::cout << "Loading motions" << std::endl;
   ia >> viewpoint_graph_motions_;
   std::cout << "Loaded viewpoint graph with " << viewpoint_entries_.size() << " viewpoints "
@@ -83,11 +259,212 @@ void ViewpointPlanner::loadViewpointGraph(const std::string& filename) {
       BH_ASSERT(it.target() == it.targetNode());
     }
   }
+}
 
-  std::cout << "Clearing observed voxels for previous camera viewpoints" << std::endl;
-  for (std::size_t i = 0; i < num_real_viewpoints_; ++i) {
-    ViewpointEntry& viewpoint_entry = viewpoint_entries_[i];
-    viewpoint_entry.voxel_set.clear();
+void ViewpointPlanner::loadViewpointGraphFromFlatFile(const std::string& filename) {
+  reset();
+  std::cout << "Loading viewpoint graph flat file from " << filename << std::endl;
+  bh::Timer timer;
+  const bh::FlatFileReader reader(filename, VIEWPOINT_GRAPH_FILE_MAGIC, VIEWPOINT_GRAPH_FILE_VERSION);
+  const ViewpointPlannerData::OccupiedTreeType& bvh_tree = data_->occupied_bvh_;
+
+  const bh::ConstArrayView<std::uint64_t> info = reader.getSection<std::uint64_t>(VIEWPOINT_GRAPH_SECTION_INFO);
+  if (info.size() != 2) {
+    throw bh::Error("Viewpoint graph file " + filename + " has an invalid info section");
+  }
+  if (info[0] != num_real_viewpoints_ || info[1] != bvh_tree.getNumOfNodes()) {
+    throw bh::Error("Viewpoint graph file " + filename + " does not match the current reconstruction and BVH");
+  }
+
+  const auto poses = reader.getSection<FloatType>(VIEWPOINT_GRAPH_SECTION_POSES);
+  const auto total_informations = reader.getSection<FloatType>(VIEWPOINT_GRAPH_SECTION_TOTAL_INFORMATIONS);
+  const auto voxel_offsets = reader.getSection<std::uint64_t>(VIEWPOINT_GRAPH_SECTION_VOXEL_OFFSETS);
+  const auto voxel_indices = reader.getSection<std::uint32_t>(VIEWPOINT_GRAPH_SECTION_VOXEL_INDICES);
+  const auto voxel_informations = reader.getSection<FloatType>(VIEWPOINT_GRAPH_SECTION_VOXEL_INFORMATIONS);
+  const auto stereo_viewpoint_indices = reader.getSection<std::uint64_t>(
+          VIEWPOINT_GRAPH_SECTION_STEREO_VIEWPOINT_INDICES);
+  const auto stereo_viewpoint_computed_flags = reader.getSection<std::uint8_t>(
+          VIEWPOINT_GRAPH_SECTION_STEREO_VIEWPOINT_COMPUTED_FLAGS);
+  const auto exploration_front = reader.getSection<std::uint64_t>(VIEWPOINT_GRAPH_SECTION_EXPLORATION_FRONT);
+  const auto edges = reader.getSection<std::uint64_t>(VIEWPOINT_GRAPH_SECTION_EDGES);
+  const auto edge_weights = reader.getSection<FloatType>(VIEWPOINT_GRAPH_SECTION_EDGE_WEIGHTS);
+  const auto motion_offsets = reader.getSection<std::uint64_t>(VIEWPOINT_GRAPH_SECTION_MOTION_OFFSETS);
+  const auto motion_viewpoint_indices = reader.getSection<std::uint64_t>(
+          VIEWPOINT_GRAPH_SECTION_MOTION_VIEWPOINT_INDICES);
+  const auto se3_motion_pose_offsets = reader.getSection<std::uint64_t>(
+          VIEWPOINT_GRAPH_SECTION_SE3_MOTION_POSE_OFFSETS);
+  const auto se3_motion_poses = reader.getSection<FloatType>(VIEWPOINT_GRAPH_SECTION_SE3_MOTION_POSES);
+
+  // The checksums only detect corruption so the structure is validated before anything is built from it
+  const auto throw_invalid = [&filename](const std::string& what) {
+    throw bh::Error("Viewpoint graph file " + filename + " has " + what);
+  };
+  const std::size_t num_entries = total_informations.size();
+  if (poses.size() != num_entries * POSE_NUM_VALUES) {
+    throw_invalid("an invalid number of poses");
+  }
+  if (voxel_informations.size() != voxel_indices.size()
+      || !isValidOffsetArray(voxel_offsets, num_entries, voxel_indices.size())) {
+    throw_invalid("invalid voxel offsets");
+  }
+  if (stereo_viewpoint_indices.size() != num_entries || stereo_viewpoint_computed_flags.size() != num_entries) {
+    throw_invalid("an invalid number of stereo viewpoints");
+  }
+  for (const std::uint64_t stereo_viewpoint_index : stereo_viewpoint_indices) {
+    // Viewpoints without a stereo viewpoint have an invalid index
+    if (stereo_viewpoint_index >= num_entries && stereo_viewpoint_index != (ViewpointEntryIndex)-1) {
+      throw_invalid("an invalid stereo viewpoint index");
+    }
+  }
+  for (const std::uint64_t viewpoint_index : exploration_front) {
+    if (viewpoint_index >= num_entries) {
+      throw_invalid("an invalid exploration front viewpoint index");
+    }
+  }
+  const std::size_t num_edges = edge_weights.size();
+  if (edges.size() != 2 * num_edges) {
+    throw_invalid("an invalid number of edge weights");
+  }
+  for (std::size_t k = 0; k < num_edges; ++k) {
+    if (edges[2 * k] >= edges[2 * k + 1] || edges[2 * k + 1] >= num_entries) {
+      throw_invalid("an invalid edge");
+    }
+  }
+  if (!isValidOffsetArray(motion_offsets, num_edges, motion_viewpoint_indices.size())) {
+    throw_invalid("invalid motion offsets");
+  }
+  // Each motion consists of at least one SE3 motion
+  for (std::size_t k = 0; k < num_edges; ++k) {
+    if (motion_offsets[k + 1] - motion_offsets[k] < 2) {
+      throw_invalid("a motion with less than two viewpoints");
+    }
+  }
+  for (const std::uint64_t viewpoint_index : motion_viewpoint_indices) {
+    if (viewpoint_index >= num_entries) {
+      throw_invalid("an invalid motion viewpoint index");
+    }
+  }
+  const std::size_t num_se3_motions = motion_viewpoint_indices.size() - num_edges;
+  if (se3_motion_poses.size() % POSE_NUM_VALUES != 0
+      || !isValidOffsetArray(se3_motion_pose_offsets, num_se3_motions, se3_motion_poses.size() / POSE_NUM_VALUES)) {
+    throw_invalid("invalid SE3 motion pose offsets");
+  }
+
+  // Map positions in the BVH traversal order to voxel indices. Usually this is the identity so that the
+  // voxel arrays can be copied in bulk.
+  std::vector<VoxelIndex> bvh_voxel_indices;
+  bvh_voxel_indices.reserve(bvh_tree.getNumOfNodes());
+  bool identity_voxel_mapping = true;
+  for (const ViewpointPlannerData::OccupiedTreeType::NodeType& node : bvh_tree) {
+    identity_voxel_mapping = identity_voxel_mapping && node.getIndex() == bvh_voxel_indices.size();
+    bvh_voxel_indices.push_back(node.getIndex());
+  }
+  for (const std::uint32_t voxel_index : voxel_indices) {
+    if (voxel_index >= bvh_voxel_indices.size()) {
+      throw bh::Error("Viewpoint graph file " + filename + " has an invalid voxel index");
+    }
+  }
+
+  viewpoint_entries_.clear();
+  viewpoint_entries_.reserve((size_t)std::ceil(1.25 * num_entries));
+  viewpoint_entries_.resize(num_entries);
+#pragma omp parallel for schedule(dynamic, 64)
+  for (std::size_t i = 0; i < num_entries; ++i) {
+    ViewpointEntry& entry = viewpoint_entries_[i];
+    entry.viewpoint = Viewpoint(&virtual_camera_, getPoseFromValues(&poses[i * POSE_NUM_VALUES]));
+    entry.total_information = total_informations[i];
+    const std::size_t voxel_begin = voxel_offsets[i];
+    const std::size_t voxel_end = voxel_offsets[i + 1];
+    std::vector<VoxelIndex> indices;
+    std::vector<FloatType> informations(voxel_informations.begin() + voxel_begin,
+                                        voxel_informations.begin() + voxel_end);
+    if (identity_voxel_mapping) {
+      indices.assign(voxel_indices.begin() + voxel_begin, voxel_indices.begin() + voxel_end);
+    }
+    else {
+      std::vector<std::pair<VoxelIndex, FloatType>> voxel_entries;
+      voxel_entries.reserve(voxel_end - voxel_begin);
+      for (std::size_t j = voxel_begin; j < voxel_end; ++j) {
+        voxel_entries.emplace_back(bvh_voxel_indices[voxel_indices[j]], voxel_informations[j]);
+      }
+      std::sort(voxel_entries.begin(), voxel_entries.end(),
+                [](const std::pair<VoxelIndex, FloatType>& a, const std::pair<VoxelIndex, FloatType>& b) {
+        return a.first < b.first;
+      });
+      indices.resize(voxel_entries.size());
+      for (std::size_t j = 0; j < voxel_entries.size(); ++j) {
+        indices[j] = voxel_entries[j].first;
+        informations[j] = voxel_entries[j].second;
+      }
+    }
+    entry.voxel_set = VoxelIndexWithInformationSet(std::move(indices), std::move(informations));
+  }
+
+  stereo_viewpoint_indices_.assign(stereo_viewpoint_indices.begin(), stereo_viewpoint_indices.end());
+  stereo_viewpoint_computed_flags_.assign(stereo_viewpoint_computed_flags.begin(), stereo_viewpoint_computed_flags.end());
+  viewpoint_exploration_front_.assign(exploration_front.begin(), exploration_front.end());
+
+  viewpoint_graph_.clear();
+  for (ViewpointEntryIndex viewpoint_index = 0; viewpoint_index < num_entries; ++viewpoint_index) {
+    viewpoint_graph_.addNode(viewpoint_index);
+  }
+  viewpoint_graph_motions_.clear();
+  viewpoint_graph_motions_.reserve(num_edges);
+  for (std::size_t k = 0; k < num_edges; ++k) {
+    const ViewpointEntryIndex index1 = edges[2 * k];
+    const ViewpointEntryIndex index2 = edges[2 * k + 1];
+    viewpoint_graph_.addEdgeByNode(index1, index2, edge_weights[k]);
+    std::vector<ViewpointEntryIndex> viewpoint_indices(motion_viewpoint_indices.begin() + motion_offsets[k],
+                                                       motion_viewpoint_indices.begin() + motion_offsets[k + 1]);
+    // Motion k is preceded by (motion_offsets[k] - k) SE3 motions
+    ViewpointMotion::SE3MotionVector se3_motions;
+    se3_motions.reserve(viewpoint_indices.size() - 1);
+    for (std::size_t l = motion_offsets[k] - k; l < motion_offsets[k + 1] - k - 1; ++l) {
+      SE3Motion::PoseVector se3_poses;
+      for (std::size_t p = se3_motion_pose_offsets[l]; p < se3_motion_pose_offsets[l + 1]; ++p) {
+        se3_poses.push_back(getPoseFromValues(&se3_motion_poses[p * POSE_NUM_VALUES]));
+      }
+      se3_motions.emplace_back(se3_poses);
+    }
+    viewpoint_graph_motions_.emplace(ViewpointIndexPair(index1, index2),
+                                     ViewpointMotion(std::move(viewpoint_indices), std::move(se3_motions)));
+  }
+  viewpoint_graph_components_valid_ = false;
+  rebuildViewpointEntryIndices();
+  std::cout << "Loaded viewpoint graph with " << viewpoint_entries_.size() << " viewpoints "
+      << " and " << viewpoint_graph_.numEdges() << " motions in " << timer.getElapsedTime() << " s" << std::endl;
+  BH_ASSERT(viewpoint_graph_.numEdges() == viewpoint_graph_motions_.size());
+
+#if !BH_RELEASE
+  // Consistency check that viewpoint motion distances and graph edge weights are equal
+  // (the checksums already guarantee that the file was read as it was written).
+  for (const auto& entry : viewpoint_graph_motions_) {
+    const FloatType weight = viewpoint_graph_.getWeightByNode(entry.first.index1, entry.first.index2);
+    BH_ASSERT(bh::isApproxEqual(weight, entry.second.distance(), FloatType(1e-2)));
+  }
+#endif
+}
+
+void ViewpointPlanner::rebuildViewpointEntryIndices() {
+  std::cout << "Regenerating approximate nearest neighbor index" << std::endl;
+  std::vector<Vector3> viewpoint_positions;
+  viewpoint_positions.reserve(viewpoint_entries_.size());
+  for (const ViewpointEntry& viewpoint_entry : viewpoint_entries_) {
+    viewpoint_positions.push_back(viewpoint_entry.viewpoint.pose().getWorldPosition());
+  }
+  viewpoint_ann_.clear();
+  viewpoint_ann_.addPoints(viewpoint_positions.begin(), viewpoint_positions.end());
+  if (options_.viewpoint_count_grid_enable) {
+    std::cout << "Regenerating density field" << std::endl;
+    viewpoint_count_grid_.setAllValues(0);
+    for (const Vector3& viewpoint_position : viewpoint_positions) {
+      if (viewpoint_count_grid_.isInsideGrid(viewpoint_position)) {
+        viewpoint_count_grid_(viewpoint_position) += 1;
+      }
+      else {
+        std::cout << "WARNING: Loaded viewpoint outside of density grid" << std::endl;
+      }
+    }
   }
 }
 
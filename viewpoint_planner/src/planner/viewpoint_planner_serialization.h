@@ -13,51 +13,50 @@
 class VoxelMapSaver {
 public:
   using FloatType = ViewpointPlanner::FloatType;
-  using VoxelType = ViewpointPlanner::VoxelType;
-  using VoxelMap = ViewpointPlanner::VoxelMap;
+  using VoxelIndex = ViewpointPlanner::VoxelIndex;
+  using DenseVoxelMap = ViewpointPlanner::DenseVoxelMap;
 
   VoxelMapSaver(const ViewpointPlannerData::OccupiedTreeType& bvh_tree) {
     // Compute consistent ordering of BVH nodes
-    std::size_t voxel_index = 0;
+    serialized_indices_.resize(bvh_tree.getNumOfNodes());
+    std::size_t serialized_index = 0;
     for (const ViewpointPlannerData::OccupiedTreeType::NodeType& node : bvh_tree) {
-      voxel_index_map_.emplace(&node, voxel_index);
-      ++voxel_index;
+      serialized_indices_[node.getIndex()] = serialized_index;
+      ++serialized_index;
     }
   }
 
   template <typename Archive>
-  void save(const VoxelMap& voxel_map, Archive& ar, const unsigned int version) const {
+  void save(const DenseVoxelMap& voxel_map, Archive& ar, const unsigned int version) const {
     ar & voxel_map.size();
-    for (const auto& entry : voxel_map) {
-      const VoxelType* voxel_ptr = entry.first.voxel;
-      const FloatType information = entry.second;
-      std::size_t voxel_index = voxel_index_map_.at(voxel_ptr);
+    for (const VoxelIndex index : voxel_map.getIndices()) {
+      const FloatType information = voxel_map.at(index);
+      std::size_t voxel_index = serialized_indices_[index];
       ar & voxel_index;
       ar & information;
     }
   }
 
 private:
-  std::unordered_map<const VoxelType*, std::size_t> voxel_index_map_;
+  std::vector<std::size_t> serialized_indices_;
 };
 
 class VoxelMapLoader {
 public:
   using FloatType = ViewpointPlanner::FloatType;
-  using VoxelType = ViewpointPlanner::VoxelType;
-  using VoxelMap = ViewpointPlanner::VoxelMap;
+  using VoxelIndex = ViewpointPlanner::VoxelIndex;
+  using DenseVoxelMap = ViewpointPlanner::DenseVoxelMap;
 
   VoxelMapLoader(ViewpointPlannerData::OccupiedTreeType* bvh_tree) {
     // Compute consistent ordering of BVH nodes
-    std::size_t voxel_index = 0;
-    for (ViewpointPlannerData::OccupiedTreeType::NodeType& node : *bvh_tree) {
-      index_voxel_map_.emplace(voxel_index, &node);
-      ++voxel_index;
+    voxel_indices_.reserve(bvh_tree->getNumOfNodes());
+    for (const ViewpointPlannerData::OccupiedTreeType::NodeType& node : *bvh_tree) {
+      voxel_indices_.push_back(node.getIndex());
     }
   }
 
   template <typename Archive>
-  void load(VoxelMap* voxel_map, Archive& ar, const unsigned int version) const {
+  void load(DenseVoxelMap* voxel_map, Archive& ar, const unsigned int version) const {
     std::size_t num_voxels;
     ar & num_voxels;
     for (std::size_t i = 0; i < num_voxels; ++i) {
@@ -65,82 +64,89 @@ public:
       ar & voxel_index;
       FloatType information;
       ar & information;
-//        VoxelWithInformation voxel_with_information(voxel, information);
-//        voxel_map->emplace(std::move(voxel_with_information));
       if (voxel_map != nullptr) {
-        VoxelType* voxel = index_voxel_map_.at(voxel_index);
-        voxel_map->emplace(voxel, information);
+        voxel_map->emplace(voxel_indices_.at(voxel_index), information);
       }
     }
   }
 
 private:
-  std::unordered_map<std::size_t, VoxelType*> index_voxel_map_;
+  std::vector<VoxelIndex> voxel_indices_;
 };
 
 class VoxelWithInformationSetSaver {
 public:
   using FloatType = ViewpointPlanner::FloatType;
-  using VoxelType = ViewpointPlanner::VoxelType;
-  using VoxelWithInformation = ViewpointPlanner::VoxelWithInformation;
-  using VoxelWithInformationSet = ViewpointPlanner::VoxelWithInformationSet;
+  using VoxelIndexWithInformation = ViewpointPlanner::VoxelIndexWithInformation;
+  using VoxelIndexWithInformationSet = ViewpointPlanner::VoxelIndexWithInformationSet;
 
   VoxelWithInformationSetSaver(const ViewpointPlannerData::OccupiedTreeType& bvh_tree) {
     // Compute consistent ordering of BVH nodes
-    std::size_t voxel_index = 0;
+    serialized_indices_.resize(bvh_tree.getNumOfNodes());
+    std::size_t serialized_index = 0;
     for (const ViewpointPlannerData::OccupiedTreeType::NodeType& node : bvh_tree) {
-      voxel_index_map_.emplace(&node, voxel_index);
-      ++voxel_index;
+      serialized_indices_[node.getIndex()] = serialized_index;
+      ++serialized_index;
     }
   }
 
   template <typename Archive>
-  void save(const VoxelWithInformationSet& voxel_set, Archive& ar, const unsigned int version) const {
+  void save(const VoxelIndexWithInformationSet& voxel_set, Archive& ar, const unsigned int version) const {
     ar & voxel_set.size();
-    for (const VoxelWithInformation& voxel_with_information : voxel_set) {
-      std::size_t voxel_index = voxel_index_map_.at(voxel_with_information.voxel);
+    for (const VoxelIndexWithInformation& voxel_with_information : voxel_set) {
+      std::size_t voxel_index = serialized_indices_[voxel_with_information.index];
       ar & voxel_index;
       ar & voxel_with_information.information;
     }
   }
 
 private:
-  std::unordered_map<const VoxelType*, std::size_t> voxel_index_map_;
+  std::vector<std::size_t> serialized_indices_;
 };
 
 class VoxelWithInformationSetLoader {
 public:
   using FloatType = ViewpointPlanner::FloatType;
-  using VoxelType = ViewpointPlanner::VoxelType;
-  using VoxelWithInformation = ViewpointPlanner::VoxelWithInformation;
-  using VoxelWithInformationSet = ViewpointPlanner::VoxelWithInformationSet;
+  using VoxelIndex = ViewpointPlanner::VoxelIndex;
+  using VoxelIndexWithInformationSet = ViewpointPlanner::VoxelIndexWithInformationSet;
 
   VoxelWithInformationSetLoader(ViewpointPlannerData::OccupiedTreeType* bvh_tree) {
     // Compute consistent ordering of BVH nodes
-    std::size_t voxel_index = 0;
-    for (ViewpointPlannerData::OccupiedTreeType::NodeType& node : *bvh_tree) {
-      index_voxel_map_.emplace(voxel_index, &node);
-      ++voxel_index;
+    voxel_indices_.reserve(bvh_tree->getNumOfNodes());
+    for (const ViewpointPlannerData::OccupiedTreeType::NodeType& node : *bvh_tree) {
+      voxel_indices_.push_back(node.getIndex());
     }
   }
 
   template <typename Archive>
-  void load(VoxelWithInformationSet* voxel_set, Archive& ar, const unsigned int version) const {
+  void load(VoxelIndexWithInformationSet* voxel_set, Archive& ar, const unsigned int version) const {
     std::size_t num_voxels;
     ar & num_voxels;
+    std::vector<std::pair<VoxelIndex, FloatType>> entries;
+    entries.reserve(num_voxels);
     for (std::size_t i = 0; i < num_voxels; ++i) {
       std::size_t voxel_index;
       ar & voxel_index;
-      VoxelType* voxel = index_voxel_map_.at(voxel_index);
       FloatType information;
       ar & information;
-      VoxelWithInformation voxel_with_information(voxel, information);
-      voxel_set->emplace(std::move(voxel_with_information));
+      entries.emplace_back(voxel_indices_.at(voxel_index), information);
     }
+    // The serialized order differs from the voxel index order
+    std::sort(entries.begin(), entries.end(),
+              [](const std::pair<VoxelIndex, FloatType>& a, const std::pair<VoxelIndex, FloatType>& b) {
+      return a.first < b.first;
+    });
+    std::vector<VoxelIndex> indices(entries.size());
+    std::vector<FloatType> informations(entries.size());
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+      indices[i] = entries[i].first;
+      informations[i] = entries[i].second;
+    }
+    *voxel_set = VoxelIndexWithInformationSet(std::move(indices), std::move(informations));
   }
 
 private:
-  std::unordered_map<std::size_t, VoxelType*> index_voxel_map_;
+  std::vector<VoxelIndex> voxel_indices_;
 };
 
 class ViewpointEntrySaver {
@@ -266,7 +272,9 @@ private:
       ar & path.acc_objective;
       voxel_map_saver_.save(path.observed_voxel_map, ar, version);
       //        voxel_set_saver_.save(path.observed_voxel_set, ar, version);
-      ar & comp_data.sorted_new_informations;
+      const std::vector<ViewpointPlanner::NewInformationQueue::SerializedEntry> sorted_new_informations =
+          comp_data.new_informations.getSerializedEntries();
+      ar & sorted_new_informations;
     }
   }
 
@@ -350,10 +358,12 @@ public:
       ar & path.acc_motion_distance;
       ar & path.acc_objective;
       //      voxel_map_loader_.load(&path.observed_voxel_map, ar, version);
-      ViewpointPlanner::VoxelMap* no_voxel_map = nullptr;
+      ViewpointPlanner::DenseVoxelMap* no_voxel_map = nullptr;
       voxel_map_loader_.load(no_voxel_map, ar, version);
 //        voxel_set_loader_.load(&path.observed_voxel_set, ar, version);
-      ar & comp_data.sorted_new_informations;
+      std::vector<ViewpointPlanner::NewInformationQueue::SerializedEntry> sorted_new_informations;
+      ar & sorted_new_informations;
+      comp_data.new_informations.setSerializedEntries(sorted_new_informations);
     }
   }
 
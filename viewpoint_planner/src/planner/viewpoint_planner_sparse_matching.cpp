@@ -7,6 +7,7 @@
 //==================================================
 
 #include "viewpoint_planner.h"
+#include <algorithm>
 #include <bh/algorithm.h>
 #include <bh/opengl/utils.h>
 
@@ -30,37 +31,47 @@ bool ViewpointPlanner::isWithinSparseMatchingLimits(const Viewpoint& viewpoint1,
 bool ViewpointPlanner::isSparseMatchable2(
         const Viewpoint& viewpoint1,
         const Viewpoint& viewpoint2,
-        const std::unordered_set<size_t>& visible_voxels1,
-        const std::unordered_set<size_t>& visible_voxels2,
+        const VisibleVoxelIndices& visible_voxels1,
+        const VisibleVoxelIndices& visible_voxels2,
         const FloatType iou_threshold) const {
   const bool verbose = false;
 
-  const std::unordered_set<size_t> intersection_set
-          = bh::computeSetIntersection(visible_voxels1, visible_voxels2);
-//  const std::unordered_set<size_t> union_set
-//          = bh::computeSetUnion(visible_voxels1, visible_voxels2);
-  if (intersection_set.size() == 0) {
+  // Both index arrays are sorted so the intersection is a linear merge
+  size_t intersection_size = 0;
+  auto it1 = visible_voxels1.begin();
+  auto it2 = visible_voxels2.begin();
+  while (it1 != visible_voxels1.end() && it2 != visible_voxels2.end()) {
+    if (*it1 < *it2) {
+      ++it1;
+    }
+    else if (*it2 < *it1) {
+      ++it2;
+    }
+    else {
+      ++intersection_size;
+      ++it1;
+      ++it2;
+    }
+  }
+  if (intersection_size == 0) {
     return false;
   }
-//  const FloatType iou = intersection_set.size() / (FloatType)union_set.size();
   const size_t average_set_size = (visible_voxels1.size() + visible_voxels2.size()) / 2;
-  const FloatType iou = intersection_set.size() / (FloatType)average_set_size;
+  const FloatType iou = intersection_size / (FloatType)average_set_size;
 
   if (verbose) {
     BH_PRINT_VALUE(visible_voxels1.size());
     BH_PRINT_VALUE(visible_voxels2.size());
-//    BH_PRINT_VALUE(union_set.size());
     BH_PRINT_VALUE(average_set_size);
-    BH_PRINT_VALUE(intersection_set.size());
+    BH_PRINT_VALUE(intersection_size);
     BH_PRINT_VALUE(iou);
-//    BH_ASSERT(union_set.size() >= visible_voxels1.size());
-//    BH_ASSERT(union_set.size() >= visible_voxels2.size());
-    BH_ASSERT(intersection_set.size() <= visible_voxels1.size());
-    BH_ASSERT(intersection_set.size() <= visible_voxels2.size());
+    BH_ASSERT(intersection_size <= visible_voxels1.size());
+    BH_ASSERT(intersection_size <= visible_voxels2.size());
   }
 
 
   if (options_.sparse_matching_dump_voxel_images) {
+    std::unique_lock<std::mutex> lock(offscreen_opengl_mutex_);
     ensureOctreeDrawerIsInitialized();
 
     auto drawing_handle = offscreen_opengl_->beginDrawing();
@@ -76,6 +87,7 @@ bool ViewpointPlanner::isSparseMatchable2(
     const QImage image_qt2 = drawing_handle.getImageQt();
     image_qt2.save("dump/octree_dump_2.png");
     drawing_handle.finish();
+    lock.unlock();
 
     QImage intersection_image1 = image_qt1.copy();
     for (int y = 0; y < intersection_image1.height(); ++y) {
@@ -83,7 +95,7 @@ bool ViewpointPlanner::isSparseMatchable2(
         const QColor color_qt(intersection_image1.pixel(x, y));
         const bh::Color4<float> color = bh::qt::colorFromQt<float>(color_qt);
         const size_t index = bh::opengl::colorToIndex(color);
-        if (visible_voxels2.count(index) == 0) {
+        if (!std::binary_search(visible_voxels2.begin(), visible_voxels2.end(), index)) {
           intersection_image1.setPixel(x, y, Qt::white);
         }
       }
@@ -95,7 +107,7 @@ bool ViewpointPlanner::isSparseMatchable2(
         const QColor color_qt(intersection_image2.pixel(x, y));
         const bh::Color4<float> color = bh::qt::colorFromQt<float>(color_qt);
         const size_t index = bh::opengl::colorToIndex(color);
-        if (visible_voxels1.count(index) == 0) {
+        if (!std::binary_search(visible_voxels1.begin(), visible_voxels1.end(), index)) {
           intersection_image2.setPixel(x, y, Qt::white);
         }
       }
@@ -138,11 +150,19 @@ bool ViewpointPlanner::isSparseMatchable2(
         const ViewpointEntryIndex viewpoint_index1,
         const ViewpointEntryIndex viewpoint_index2,
         const FloatType iou_threshold) const {
+  if (options_.sparse_matching_voxels_sketch_enable && !options_.sparse_matching_dump_voxel_images) {
+    const bh::MinHash::Comparison comparison = compareVisibleVoxelsSketches(
+            *getCachedVisibleVoxelsSketch(viewpoint_index1), *getCachedVisibleVoxelsSketch(viewpoint_index2), iou_threshold);
+    // The sketch only rejects pairs early. Accepted pairs are always confirmed with the exact overlap.
+    if (comparison == bh::MinHash::BELOW_THRESHOLD) {
+      return false;
+    }
+  }
   const Viewpoint& viewpoint1 = viewpoint_entries_[viewpoint_index1].viewpoint;
   const Viewpoint& viewpoint2 = viewpoint_entries_[viewpoint_index2].viewpoint;
-  const std::unordered_set<size_t>& visible_voxels1 = getCachedVisibleVoxels(viewpoint_index1);
-  const std::unordered_set<size_t>& visible_voxels2 = getCachedVisibleVoxels(viewpoint_index2);
-  return isSparseMatchable2(viewpoint1, viewpoint2, visible_voxels1, visible_voxels2, iou_threshold);
+  const std::shared_ptr<const VisibleVoxelIndices> visible_voxels1 = getCachedVisibleVoxels(viewpoint_index1);
+  const std::shared_ptr<const VisibleVoxelIndices> visible_voxels2 = getCachedVisibleVoxels(viewpoint_index2);
+  return isSparseMatchable2(viewpoint1, viewpoint2, *visible_voxels1, *visible_voxels2, iou_threshold);
 }
 
 bool ViewpointPlanner::isSparseMatchable2(
@@ -150,19 +170,19 @@ bool ViewpointPlanner::isSparseMatchable2(
         const Viewpoint& viewpoint2,
         const FloatType iou_threshold) const {
   const Viewpoint& viewpoint1 = viewpoint_entries_[viewpoint_index1].viewpoint;
-  const std::unordered_set<size_t>& visible_voxels1 = getCachedVisibleVoxels(viewpoint_index1);
-  const std::unordered_set<size_t> visible_voxels2 = getVisibleVoxels(viewpoint2);
-  return isSparseMatchable2(viewpoint1, viewpoint2, visible_voxels1, visible_voxels2, iou_threshold);
+  const std::shared_ptr<const VisibleVoxelIndices> visible_voxels1 = getCachedVisibleVoxels(viewpoint_index1);
+  const VisibleVoxelIndices visible_voxels2 = getVisibleVoxels(viewpoint2);
+  return isSparseMatchable2(viewpoint1, viewpoint2, *visible_voxels1, visible_voxels2, iou_threshold);
 }
 
 bool ViewpointPlanner::isSparseMatchable2(
         const ViewpointEntryIndex viewpoint_index1,
         const Viewpoint& viewpoint2,
-        const std::unordered_set<size_t>& visible_voxels2,
+        const VisibleVoxelIndices& visible_voxels2,
         const FloatType iou_threshold) const {
   const Viewpoint& viewpoint1 = viewpoint_entries_[viewpoint_index1].viewpoint;
-  const std::unordered_set<size_t>& visible_voxels1 = getCachedVisibleVoxels(viewpoint_index1);
-  return isSparseMatchable2(viewpoint1, viewpoint2, visible_voxels1, visible_voxels2, iou_threshold);
+  const std::shared_ptr<const VisibleVoxelIndices> visible_voxels1 = getCachedVisibleVoxels(viewpoint_index1);
+  return isSparseMatchable2(viewpoint1, viewpoint2, *visible_voxels1, visible_voxels2, iou_threshold);
 }
 
 bool ViewpointPlanner::isSparseMatchable2(
@@ -170,16 +190,16 @@ bool ViewpointPlanner::isSparseMatchable2(
         const FloatType iou_threshold) const {
 //  const std::unordered_set<const VoxelType*> raycast_voxels1 = getRaycastHitVoxelsSet(viewpoint1);
 //  const std::unordered_set<const VoxelType*> raycast_voxels2 = getRaycastHitVoxelsSet(viewpoint2);
-  const std::unordered_set<size_t> visible_voxels1 = getVisibleVoxels(viewpoint1);
-  const std::unordered_set<size_t> visible_voxels2 = getVisibleVoxels(viewpoint2);
+  const VisibleVoxelIndices visible_voxels1 = getVisibleVoxels(viewpoint1);
+  const VisibleVoxelIndices visible_voxels2 = getVisibleVoxels(viewpoint2);
   return isSparseMatchable2(viewpoint1, viewpoint2, visible_voxels1, visible_voxels2, iou_threshold);
 }
 
 bool ViewpointPlanner::isSparseMatchable2(
         const Viewpoint& viewpoint1,
         const Viewpoint& viewpoint2,
-        const std::unordered_set<size_t>& visible_voxels1,
-        const std::unordered_set<size_t>& visible_voxels2) const {
+        const VisibleVoxelIndices& visible_voxels1,
+        const VisibleVoxelIndices& visible_voxels2) const {
   return isSparseMatchable2(viewpoint1, viewpoint2,
                             visible_voxels1, visible_voxels2,
                             options_.sparse_matching_voxels_iou_threshold);
@@ -200,7 +220,7 @@ bool ViewpointPlanner::isSparseMatchable2(
 bool ViewpointPlanner::isSparseMatchable2(
         const ViewpointEntryIndex viewpoint_index1,
         const Viewpoint& viewpoint2,
-        const std::unordered_set<size_t>& visible_voxels2) const {
+        const VisibleVoxelIndices& visible_voxels2) const {
   return isSparseMatchable2(viewpoint_index1, viewpoint2, visible_voxels2, options_.sparse_matching_voxels_iou_threshold);
 }
 
@@ -295,27 +315,93 @@ std::unordered_map<Point3DId, ViewpointPlanner::Vector3> ViewpointPlanner::compu
   return computeVisibleSparsePoints(viewpoint, first, last);
 }
 
-const std::unordered_map<Point3DId, ViewpointPlanner::Vector3>& ViewpointPlanner::getCachedVisibleSparsePoints(
+ViewpointPlanner::VisibleSparsePoints::VisibleSparsePoints(
+        const std::unordered_map<Point3DId, Vector3>& point_normals) {
+  point3d_ids.reserve(point_normals.size());
+  for (const auto& entry : point_normals) {
+    point3d_ids.push_back(entry.first);
+  }
+  std::sort(point3d_ids.begin(), point3d_ids.end());
+  normals.reserve(point3d_ids.size());
+  for (const Point3DId point3d_id : point3d_ids) {
+    normals.push_back(point_normals.at(point3d_id));
+  }
+}
+
+std::size_t ViewpointPlanner::VisibleSparsePoints::getMemoryUsage() const {
+  return point3d_ids.capacity() * sizeof(Point3DId) + normals.capacity() * sizeof(Vector3);
+}
+
+std::shared_ptr<const ViewpointPlanner::VisibleSparsePoints> ViewpointPlanner::getCachedVisibleSparsePoints(
         const ViewpointEntryIndex viewpoint_index) const {
-  std::lock_guard<std::mutex> lock(cached_visible_sparse_points_mutex_);
-  auto it = cached_visible_sparse_points_.find(viewpoint_index);
-  if (it == cached_visible_sparse_points_.end()) {
+  return cached_visible_sparse_points_.getOrCompute(viewpoint_index, [&]() {
     const Viewpoint& viewpoint = viewpoint_entries_[viewpoint_index].viewpoint;
-    std::tie(it, std::ignore) = cached_visible_sparse_points_.emplace(viewpoint_index, computeVisibleSparsePoints(viewpoint));
-  }
-  return it->second;
+    return VisibleSparsePoints(computeVisibleSparsePoints(viewpoint));
+  });
 }
 
-const std::unordered_set<size_t>& ViewpointPlanner::getCachedVisibleVoxels(
+std::shared_ptr<const ViewpointPlanner::VisibleVoxelIndices> ViewpointPlanner::getCachedVisibleVoxels(
         const ViewpointEntryIndex viewpoint_index) const {
-  std::lock_guard<std::mutex> lock(cached_visible_voxels_mutex_);
-  auto it = cached_visible_voxels_.find(viewpoint_index);
-  if (it == cached_visible_voxels_.end()) {
+  return cached_visible_voxels_.getOrCompute(viewpoint_index, [&]() {
     const Viewpoint& viewpoint = viewpoint_entries_[viewpoint_index].viewpoint;
-//    std::tie(it, std::ignore) = cached_visible_voxels_.emplace(viewpoint_index, getRaycastHitVoxelsSet(viewpoint));
-    std::tie(it, std::ignore) = cached_visible_voxels_.emplace(viewpoint_index, getVisibleVoxels(viewpoint));
+    return getVisibleVoxels(viewpoint);
+  });
+}
+
+std::shared_ptr<const bh::MinHashSketch> ViewpointPlanner::getCachedVisibleVoxelsSketch(
+        const ViewpointEntryIndex viewpoint_index) const {
+  return cached_visible_voxels_sketches_.getOrCompute(viewpoint_index, [&]() {
+    return computeVisibleVoxelsSketch(*getCachedVisibleVoxels(viewpoint_index));
+  });
+}
+
+void ViewpointPlanner::pinCachedVisibleVoxels(const std::vector<ViewpointEntryIndex>& viewpoint_indices) const {
+  // Pin all entries first so that computing the later ones does not evict the earlier ones
+  for (const ViewpointEntryIndex viewpoint_index : viewpoint_indices) {
+    cached_visible_voxels_.pin(viewpoint_index);
   }
-  return it->second;
+  for (const ViewpointEntryIndex viewpoint_index : viewpoint_indices) {
+    getCachedVisibleVoxels(viewpoint_index);
+    if (options_.sparse_matching_voxels_sketch_enable) {
+      getCachedVisibleVoxelsSketch(viewpoint_index);
+    }
+  }
+}
+
+void ViewpointPlanner::unpinCachedVisibleVoxels(const std::vector<ViewpointEntryIndex>& viewpoint_indices) const {
+  for (const ViewpointEntryIndex viewpoint_index : viewpoint_indices) {
+    cached_visible_voxels_.unpin(viewpoint_index);
+  }
+}
+
+bh::MinHashSketch ViewpointPlanner::computeVisibleVoxelsSketch(const VisibleVoxelIndices& visible_voxels) const {
+  return visible_voxels_min_hash_.computeSketch(visible_voxels.begin(), visible_voxels.end());
+}
+
+bh::MinHash::Comparison ViewpointPlanner::compareVisibleVoxelsSketches(
+        const bh::MinHashSketch& sketch1, const bh::MinHashSketch& sketch2, const FloatType iou_threshold) const {
+  if (!options_.sparse_matching_voxels_sketch_enable || options_.sparse_matching_dump_voxel_images) {
+    return bh::MinHash::UNCERTAIN;
+  }
+  // The IOU of isSparseMatchable2() is relative to the average set size (i.e. it is the Dice coefficient)
+  return bh::MinHash::compareDice(sketch1, sketch2, iou_threshold, options_.sparse_matching_voxels_sketch_num_std_devs);
+}
+
+void ViewpointPlanner::printVisibilityCacheStatistics() const {
+  const auto print_statistics = [](const std::string& name, const std::size_t max_bytes,
+                                   const bh::ShardedLruCacheStatistics& statistics) {
+    const std::size_t bytes_per_megabyte = 1024 * 1024;
+    std::cout << "Cached " << name << ": " << statistics.num_entries << " entries, "
+              << statistics.num_bytes / bytes_per_megabyte << " MB";
+    if (max_bytes > 0) {
+      std::cout << " of " << max_bytes / bytes_per_megabyte << " MB";
+    }
+    std::cout << ", " << statistics.num_hits << " hits, " << statistics.num_misses << " misses, "
+              << statistics.num_evictions << " evictions" << std::endl;
+  };
+  print_statistics("visible voxels", cached_visible_voxels_.getMaxBytes(), cached_visible_voxels_.getStatistics());
+  print_statistics("visible sparse points", cached_visible_sparse_points_.getMaxBytes(),
+                   cached_visible_sparse_points_.getStatistics());
 }
 
 //ViewpointPlanner::FloatType ViewpointPlanner::computeSparseMatchingScore(
@@ -380,6 +466,14 @@ ViewpointPlanner::FloatType ViewpointPlanner::computeSparseMatchingScore(
         const Viewpoint& ref_viewpoint, const Viewpoint& other_viewpoint,
         const std::unordered_map<Point3DId, Vector3>& ref_visible_points,
         const std::unordered_map<Point3DId, Vector3>& other_visible_points) const {
+  return computeSparseMatchingScore(ref_viewpoint, other_viewpoint,
+                                    VisibleSparsePoints(ref_visible_points), VisibleSparsePoints(other_visible_points));
+}
+
+ViewpointPlanner::FloatType ViewpointPlanner::computeSparseMatchingScore(
+        const Viewpoint& ref_viewpoint, const Viewpoint& other_viewpoint,
+        const VisibleSparsePoints& ref_visible_points,
+        const VisibleSparsePoints& other_visible_points) const {
   const std::size_t num_x_slices = 3;
   const std::size_t num_y_slices = 3;
   Eigen::Matrix<std::size_t, num_y_slices, num_x_slices> ref_sector_shared_counts;
@@ -387,11 +481,22 @@ ViewpointPlanner::FloatType ViewpointPlanner::computeSparseMatchingScore(
   Eigen::Matrix<std::size_t, num_y_slices, num_x_slices> other_sector_shared_counts;
   other_sector_shared_counts.setZero();
   std::size_t num_shared_points = 0;
-  for (const auto& entry: ref_visible_points) {
-    const Point3DId& point3d_id = entry.first;
-    const Vector3& ref_normal = entry.second;
-    if (other_visible_points.count(point3d_id) > 0) {
-      const Vector3& other_normal = other_visible_points.at(point3d_id);
+  // Both point arrays are sorted by id so the shared points are found by a linear merge
+  std::size_t ref_pos = 0;
+  std::size_t other_pos = 0;
+  while (ref_pos < ref_visible_points.size() && other_pos < other_visible_points.size()) {
+    const Point3DId point3d_id = ref_visible_points.point3d_ids[ref_pos];
+    if (point3d_id < other_visible_points.point3d_ids[other_pos]) {
+      ++ref_pos;
+    }
+    else if (other_visible_points.point3d_ids[other_pos] < point3d_id) {
+      ++other_pos;
+    }
+    else {
+      const Vector3& ref_normal = ref_visible_points.normals[ref_pos];
+      const Vector3& other_normal = other_visible_points.normals[other_pos];
+      ++ref_pos;
+      ++other_pos;
       const Point3D& point3d = data_->reconstruction_->getPoints3D().at(point3d_id);
       const bool matchable = isSparsePointMatchable(
               ref_viewpoint, other_viewpoint,
@@ -450,10 +555,10 @@ ViewpointPlanner::FloatType ViewpointPlanner::computeSparseMatchingScore(
     const ViewpointEntryIndex viewpoint_index1, const ViewpointEntryIndex viewpoint_index2) const {
   const Viewpoint& viewpoint1 = viewpoint_entries_[viewpoint_index1].viewpoint;
   const Viewpoint& viewpoint2 = viewpoint_entries_[viewpoint_index2].viewpoint;
-  const std::unordered_map<Point3DId, Vector3>& sparse_points_visible1 = getCachedVisibleSparsePoints(viewpoint_index1);
-  const std::unordered_map<Point3DId, Vector3>& sparse_points_visible2 = getCachedVisibleSparsePoints(viewpoint_index2);
+  const std::shared_ptr<const VisibleSparsePoints> sparse_points_visible1 = getCachedVisibleSparsePoints(viewpoint_index1);
+  const std::shared_ptr<const VisibleSparsePoints> sparse_points_visible2 = getCachedVisibleSparsePoints(viewpoint_index2);
   return computeSparseMatchingScore(viewpoint1, viewpoint2,
-                                    sparse_points_visible1, sparse_points_visible2);
+                                    *sparse_points_visible1, *sparse_points_visible2);
 }
 
 //bool ViewpointPlanner::isSparseMatchable(
@@ -15,15 +15,22 @@ ViewpointRaycast::ViewpointRaycast(
         OccupiedTreeType *bvh_tree,
         const FloatType min_range,
         const FloatType max_range)
-    : bvh_tree_(bvh_tree), min_range_(min_range), max_range_(max_range) {
+    : bvh_tree_(bvh_tree), min_range_(min_range), max_range_(max_range),
+      enable_cpu_packet_raycast_(false) {
 #if WITH_CUDA
   enable_cuda_ = false;
 #endif
 }
 
+#if WITH_CUDA
 void ViewpointRaycast::setEnableCuda(const bool enable_cuda) {
   enable_cuda_ = enable_cuda;
 }
+#endif
+
+void ViewpointRaycast::setEnableCpuPacketRaycast(const bool enable_cpu_packet_raycast) {
+  enable_cpu_packet_raycast_ = enable_cpu_packet_raycast;
+}
 
 std::vector<OccupiedTreeType::IntersectionResult>
 ViewpointRaycast::getRaycastHitVoxels(
@@ -121,33 +128,43 @@ std::vector<OccupiedTreeType::IntersectionResult> ViewpointRaycast::getRaycastHi
   const std::size_t width = x_end - x_start;
   const std::size_t height = y_end - y_start;
   std::vector<OccupiedTreeType::IntersectionResult> raycast_results;
-  raycast_results.resize(width * height);
   ait::Timer timer;
-  for (size_t y = y_start; y < y_end; ++y) {
-//  for (size_t y = viewpoint.camera().height()/2-10; y < viewpoint.camera().height()/2+10; ++y) {
-//  size_t y = viewpoint.camera().height() / 2; {
-//  size_t y = 85; {
+  if (enable_cpu_packet_raycast_) {
+    raycast_results = bvh_tree_->raycastCpu(
+            viewpoint.camera().intrinsics(),
+            viewpoint.pose().getTransformationImageToWorld(),
+            x_start, x_end,
+            y_start, y_end,
+            min_range_, max_range_);
+  }
+  else {
+    raycast_results.resize(width * height);
+    for (size_t y = y_start; y < y_end; ++y) {
+//    for (size_t y = viewpoint.camera().height()/2-10; y < viewpoint.camera().height()/2+10; ++y) {
+//    size_t y = viewpoint.camera().height() / 2; {
+//    size_t y = 85; {
 //#if !AIT_DEBUG
 //#pragma omp parallel for
 //#endif
-    for (size_t x = x_start; x < x_end; ++x) {
-//    for (size_t x = viewpoint.camera().width()/2-10; x < viewpoint.camera().width()/2+10; ++x) {
-//    size_t x = viewpoint.camera().width() / 2; {
-//      size_t x = 101; {
-      const RayType ray = viewpoint.getCameraRay(x, y);
-      std::pair<bool, OccupiedTreeType::IntersectionResult> result =
-              bvh_tree_->intersects(ray, min_range_, max_range_);
-      if (result.first) {
-//        if (result.second.depth < octree_->getTreeDepth()) {
-//          continue;
-//        }
+      for (size_t x = x_start; x < x_end; ++x) {
+//      for (size_t x = viewpoint.camera().width()/2-10; x < viewpoint.camera().width()/2+10; ++x) {
+//      size_t x = viewpoint.camera().width() / 2; {
+//        size_t x = 101; {
+        const RayType ray = viewpoint.getCameraRay(x, y);
+        std::pair<bool, OccupiedTreeType::IntersectionResult> result =
+                bvh_tree_->intersects(ray, min_range_, max_range_);
+        if (result.first) {
+//          if (result.second.depth < octree_->getTreeDepth()) {
+//            continue;
+//          }
 //#if !AIT_DEBUG
 //#pragma omp critical
 //#endif
-        {
-//          if (octree_->isNodeUnknown(result.second.node->getObject()->observation_count)) {
-          raycast_results[(y - y_start) * width + (x - x_start)] = result.second;
-//          }
+          {
+//            if (octree_->isNodeUnknown(result.second.node->getObject()->observation_count)) {
+            raycast_results[(y - y_start) * width + (x - x_start)] = result.second;
+//            }
+          }
         }
       }
     }
@@ -173,36 +190,46 @@ ViewpointRaycast::getRaycastHitVoxelsWithScreenCoordinatesCpu(
   const std::size_t width = x_end - x_start;
   const std::size_t height = y_end - y_start;
   std::vector<OccupiedTreeType::IntersectionResultWithScreenCoordinates> raycast_results;
-  raycast_results.resize(width * height);
   ait::Timer timer;
-  for (size_t y = y_start; y < y_end; ++y) {
-//  for (size_t y = viewpoint.camera().height()/2-10; y < viewpoint.camera().height()/2+10; ++y) {
-//  size_t y = viewpoint.camera().height() / 2; {
-//  size_t y = 85; {
+  if (enable_cpu_packet_raycast_) {
+    raycast_results = bvh_tree_->raycastWithScreenCoordinatesCpu(
+            viewpoint.camera().intrinsics(),
+            viewpoint.pose().getTransformationImageToWorld(),
+            x_start, x_end,
+            y_start, y_end,
+            min_range_, max_range_);
+  }
+  else {
+    raycast_results.resize(width * height);
+    for (size_t y = y_start; y < y_end; ++y) {
+//    for (size_t y = viewpoint.camera().height()/2-10; y < viewpoint.camera().height()/2+10; ++y) {
+//    size_t y = viewpoint.camera().height() / 2; {
+//    size_t y = 85; {
 //#if !AIT_DEBUG
 //#pragma omp parallel for
 //#endif
-    for (size_t x = x_start; x < x_end; ++x) {
-//    for (size_t x = viewpoint.camera().width()/2-10; x < viewpoint.camera().width()/2+10; ++x) {
-//    size_t x = viewpoint.camera().width() / 2; {
-//      size_t x = 101; {
-      const RayType ray = viewpoint.getCameraRay(x, y);
-      std::pair<bool, OccupiedTreeType::IntersectionResult> result =
-              bvh_tree_->intersects(ray, min_range_, max_range_);
-      if (result.first) {
-//        if (result.second.depth < octree_->getTreeDepth()) {
-//          continue;
-//        }
+      for (size_t x = x_start; x < x_end; ++x) {
+//      for (size_t x = viewpoint.camera().width()/2-10; x < viewpoint.camera().width()/2+10; ++x) {
+//      size_t x = viewpoint.camera().width() / 2; {
+//        size_t x = 101; {
+        const RayType ray = viewpoint.getCameraRay(x, y);
+        std::pair<bool, OccupiedTreeType::IntersectionResult> result =
+                bvh_tree_->intersects(ray, min_range_, max_range_);
+        if (result.first) {
+//          if (result.second.depth < octree_->getTreeDepth()) {
+//            continue;
+//          }
 //#if !AIT_DEBUG
 //#pragma omp critical
 //#endif
-        {
-//          if (octree_->isNodeUnknown(result.second.node->getObject()->observation_count)) {
-          OccupiedTreeType::IntersectionResultWithScreenCoordinates result_with_screen_coordinates;
-          result_with_screen_coordinates.intersection_result = result.second;
-          result_with_screen_coordinates.screen_coordinates = Vector2(x, y);
-          raycast_results[(y - y_start) * width + (x - x_start)] = result_with_screen_coordinates;
-//          }
+          {
+//            if (octree_->isNodeUnknown(result.second.node->getObject()->observation_count)) {
+            OccupiedTreeType::IntersectionResultWithScreenCoordinates result_with_screen_coordinates;
+            result_with_screen_coordinates.intersection_result = result.second;
+            result_with_screen_coordinates.screen_coordinates = Vector2(x, y);
+            raycast_results[(y - y_start) * width + (x - x_start)] = result_with_screen_coordinates;
+//            }
+          }
         }
       }
     }
@@ -290,7 +317,8 @@ void ViewpointRaycast::removeInvalidRaycastHitVoxels(
   raycast_results->erase(std::remove_if(
           raycast_results->begin(),
           raycast_results->end(),
-          [](const RaycastResult& ir) { return ir.node == nullptr; }));
+          [](const RaycastResult& ir) { return ir.node == nullptr; }),
+          raycast_results->end());
 }
 
 void ViewpointRaycast::removeInvalidRaycastHitVoxels(
@@ -299,7 +327,8 @@ void ViewpointRaycast::removeInvalidRaycastHitVoxels(
   raycast_results->erase(std::remove_if(
           raycast_results->begin(),
           raycast_results->end(),
-          [](const RaycastResult& ir) { return ir.intersection_result.node == nullptr; }));
+          [](const RaycastResult& ir) { return ir.intersection_result.node == nullptr; }),
+          raycast_results->end());
 }
 
 void ViewpointRaycast::removeDuplicateRaycastHitVoxels(
@@ -27,6 +27,9 @@ public:
   void setEnableCuda(const bool enable_cuda);
 #endif
 
+  /// Enable multithreaded raycasting of ray packets on the CPU (otherwise rays are cast one by one).
+  void setEnableCpuPacketRaycast(const bool enable_cpu_packet_raycast);
+
   /// Perform raycast on the BVH tree.
   /// Returns a vector of hit voxels with additional info.
   std::vector<OccupiedTreeType::IntersectionResult> getRaycastHitVoxels(
@@ -140,6 +143,7 @@ private:
 #if WITH_CUDA
   bool enable_cuda_;
 #endif
+  bool enable_cpu_packet_raycast_;
 };
 
 }
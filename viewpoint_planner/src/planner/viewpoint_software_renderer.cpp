@@ -0,0 +1,346 @@
+//==================================================
+// viewpoint_software_renderer.cpp
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+#include "viewpoint_software_renderer.h"
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+namespace viewpoint_planner {
+
+constexpr std::uint32_t SoftwareRenderBuffers::INVALID_TRIANGLE_INDEX;
+
+void SoftwareRenderBuffers::resize(const std::size_t width, const std::size_t height) {
+  width_ = width;
+  height_ = height;
+  depth.resize(width * height);
+  normals.resize(width * height);
+  triangle_indices.resize(width * height);
+}
+
+ViewpointSoftwareRenderer::ViewpointSoftwareRenderer(const MeshType* mesh)
+    : ViewpointSoftwareRenderer(Options(), mesh) {}
+
+ViewpointSoftwareRenderer::ViewpointSoftwareRenderer(const Options& options, const MeshType* mesh)
+    : options_(options),
+      near_plane_(0.5),
+      far_plane_(1e5) {
+  BH_ASSERT(options_.software_renderer_tile_size > 0);
+  vertices_.reserve(mesh->m_Vertices.size());
+  for (const ml::vec3f& v : mesh->m_Vertices) {
+    vertices_.emplace_back(v.x, v.y, v.z);
+  }
+  const bool has_normals = mesh->hasNormalIndices() && mesh->hasNormals();
+  triangle_vertex_indices_.reserve(3 * mesh->m_FaceIndicesVertices.size());
+  corner_normals_.reserve(3 * mesh->m_FaceIndicesVertices.size());
+  for (std::size_t i = 0; i < mesh->m_FaceIndicesVertices.size(); ++i) {
+    const MeshType::Indices::Face& vertex_indices = mesh->m_FaceIndicesVertices[i];
+    BH_ASSERT_STR(vertex_indices.size() == 3, "Mesh face vertex indices need to have a valence of 3");
+    for (std::size_t j = 0; j < 3; ++j) {
+      triangle_vertex_indices_.push_back(static_cast<std::uint32_t>(vertex_indices[j]));
+    }
+    // Same normals as the ones uploaded by the OpenGL offscreen renderer
+    if (has_normals) {
+      const MeshType::Indices::Face& normal_indices = mesh->m_FaceIndicesNormals[i];
+      BH_ASSERT_STR(normal_indices.size() == 3, "Mesh face normal indices need to have a valence of 3");
+      for (std::size_t j = 0; j < 3; ++j) {
+        const ml::vec3f n = ml::vec3f::normalize(mesh->m_Normals[normal_indices[j]]);
+        corner_normals_.emplace_back(n.x, n.y, n.z);
+      }
+    }
+    else {
+      const Vector3& v1 = vertices_[vertex_indices[0]];
+      const Vector3& v2 = vertices_[vertex_indices[1]];
+      const Vector3& v3 = vertices_[vertex_indices[2]];
+      const Vector3 n = (v2 - v1).cross(v3 - v2).normalized();
+      for (std::size_t j = 0; j < 3; ++j) {
+        corner_normals_.push_back(n);
+      }
+    }
+  }
+}
+
+std::size_t ViewpointSoftwareRenderer::getNumTriangles() const {
+  return triangle_vertex_indices_.size() / 3;
+}
+
+FloatType ViewpointSoftwareRenderer::getNearPlane() const {
+  return near_plane_;
+}
+
+FloatType ViewpointSoftwareRenderer::getFarPlane() const {
+  return far_plane_;
+}
+
+void ViewpointSoftwareRenderer::setNearFarPlane(const FloatType near_plane, const FloatType far_plane) {
+  BH_ASSERT(near_plane > 0 && near_plane < far_plane);
+  near_plane_ = near_plane;
+  far_plane_ = far_plane;
+}
+
+void ViewpointSoftwareRenderer::render(const Viewpoint& viewpoint, SoftwareRenderBuffers* buffers) const {
+  const int width = static_cast<int>(viewpoint.camera().width());
+  const int height = static_cast<int>(viewpoint.camera().height());
+  buffers->resize(width, height);
+  std::fill(buffers->depth.begin(), buffers->depth.end(), std::numeric_limits<FloatType>::infinity());
+  std::fill(buffers->normals.begin(), buffers->normals.end(), Vector3::Zero());
+  std::fill(buffers->triangle_indices.begin(), buffers->triangle_indices.end(),
+            SoftwareRenderBuffers::INVALID_TRIANGLE_INDEX);
+
+  std::vector<ScreenTriangle> screen_triangles;
+  setupScreenTriangles(viewpoint, &screen_triangles);
+
+  // Bin the triangles into tiles. The bins are stored consecutively in ascending order of the triangles
+  // so that the rendered images do not depend on the number of threads.
+  const int tile_size = static_cast<int>(options_.software_renderer_tile_size);
+  const int num_tiles_x = (width + tile_size - 1) / tile_size;
+  const int num_tiles_y = (height + tile_size - 1) / tile_size;
+  const std::size_t num_tiles = static_cast<std::size_t>(num_tiles_x) * num_tiles_y;
+  std::vector<std::uint32_t> tile_offsets(num_tiles + 1, 0);
+  for (const ScreenTriangle& screen_triangle : screen_triangles) {
+    for (int tile_y = screen_triangle.min_y / tile_size; tile_y <= screen_triangle.max_y / tile_size; ++tile_y) {
+      for (int tile_x = screen_triangle.min_x / tile_size; tile_x <= screen_triangle.max_x / tile_size; ++tile_x) {
+        ++tile_offsets[tile_y * num_tiles_x + tile_x + 1];
+      }
+    }
+  }
+  for (std::size_t i = 0; i < num_tiles; ++i) {
+    tile_offsets[i + 1] += tile_offsets[i];
+  }
+  std::vector<std::uint32_t> tile_triangles(tile_offsets.back());
+  std::vector<std::uint32_t> tile_fill(tile_offsets.begin(), tile_offsets.end() - 1);
+  for (std::size_t i = 0; i < screen_triangles.size(); ++i) {
+    const ScreenTriangle& screen_triangle = screen_triangles[i];
+    for (int tile_y = screen_triangle.min_y / tile_size; tile_y <= screen_triangle.max_y / tile_size; ++tile_y) {
+      for (int tile_x = screen_triangle.min_x / tile_size; tile_x <= screen_triangle.max_x / tile_size; ++tile_x) {
+        tile_triangles[tile_fill[tile_y * num_tiles_x + tile_x]++] = static_cast<std::uint32_t>(i);
+      }
+    }
+  }
+
+  // Tiles cover disjoint pixels so they can be rasterized independently
+#pragma omp parallel for schedule(dynamic)
+  for (std::ptrdiff_t tile = 0; tile < static_cast<std::ptrdiff_t>(num_tiles); ++tile) {
+    const int tile_min_x = static_cast<int>(tile % num_tiles_x) * tile_size;
+    const int tile_min_y = static_cast<int>(tile / num_tiles_x) * tile_size;
+    const int tile_max_x = std::min(tile_min_x + tile_size, width) - 1;
+    const int tile_max_y = std::min(tile_min_y + tile_size, height) - 1;
+    rasterizeTile(screen_triangles,
+                  tile_triangles.data() + tile_offsets[tile], tile_triangles.data() + tile_offsets[tile + 1],
+                  tile_min_x, tile_min_y, tile_max_x, tile_max_y, buffers);
+  }
+}
+
+void ViewpointSoftwareRenderer::setupScreenTriangles(
+        const Viewpoint& viewpoint, std::vector<ScreenTriangle>* screen_triangles) const {
+  const PinholeCamera& camera = viewpoint.camera();
+  const int width = static_cast<int>(camera.width());
+  const int height = static_cast<int>(camera.height());
+  const FloatType fx = camera.intrinsics()(0, 0);
+  const FloatType fy = camera.intrinsics()(1, 1);
+  const FloatType cx = camera.intrinsics()(0, 2);
+  const FloatType cy = camera.intrinsics()(1, 2);
+  const Matrix3x4 world_to_camera = viewpoint.pose().getTransformationWorldToImage();
+  const Matrix3x3 rotation = world_to_camera.leftCols<3>();
+  const Vector3 translation = world_to_camera.rightCols<1>();
+
+  std::vector<Vector3> camera_vertices(vertices_.size());
+#pragma omp parallel for
+  for (std::ptrdiff_t i = 0; i < static_cast<std::ptrdiff_t>(vertices_.size()); ++i) {
+    camera_vertices[i] = rotation * vertices_[i] + translation;
+  }
+
+  // Each thread sets up a contiguous range of triangles so that concatenating the results keeps the order
+  const std::ptrdiff_t num_triangles = static_cast<std::ptrdiff_t>(getNumTriangles());
+  std::vector<std::vector<ScreenTriangle>> thread_screen_triangles(omp_get_max_threads());
+#pragma omp parallel
+  {
+    std::vector<ScreenTriangle>& local_screen_triangles = thread_screen_triangles[omp_get_thread_num()];
+    // Polygon after clipping a triangle against the near plane (camera coordinates and barycentric coordinates)
+    Vector3 polygon_positions[4];
+    Vector3 polygon_weights[4];
+#pragma omp for schedule(static)
+    for (std::ptrdiff_t i = 0; i < num_triangles; ++i) {
+      const Vector3 positions[3] = {
+              camera_vertices[triangle_vertex_indices_[3 * i + 0]],
+              camera_vertices[triangle_vertex_indices_[3 * i + 1]],
+              camera_vertices[triangle_vertex_indices_[3 * i + 2]]
+      };
+      if (positions[0](2) > far_plane_ && positions[1](2) > far_plane_ && positions[2](2) > far_plane_) {
+        continue;
+      }
+      const Vector3 weights[3] = { Vector3::UnitX(), Vector3::UnitY(), Vector3::UnitZ() };
+      std::size_t polygon_size = 0;
+      for (std::size_t j = 0; j < 3; ++j) {
+        const std::size_t k = (j + 1) % 3;
+        const bool inside_j = positions[j](2) >= near_plane_;
+        const bool inside_k = positions[k](2) >= near_plane_;
+        if (inside_j) {
+          polygon_positions[polygon_size] = positions[j];
+          polygon_weights[polygon_size] = weights[j];
+          ++polygon_size;
+        }
+        if (inside_j != inside_k) {
+          const FloatType t = (near_plane_ - positions[j](2)) / (positions[k](2) - positions[j](2));
+          polygon_positions[polygon_size] = positions[j] + t * (positions[k] - positions[j]);
+          polygon_positions[polygon_size](2) = near_plane_;
+          polygon_weights[polygon_size] = weights[j] + t * (weights[k] - weights[j]);
+          ++polygon_size;
+        }
+      }
+      // Triangulate the clipped polygon as a fan
+      for (std::size_t j = 1; j + 1 < polygon_size; ++j) {
+        const std::size_t fan_indices[3] = { 0, j, j + 1 };
+        ScreenTriangle screen_triangle;
+        for (std::size_t l = 0; l < 3; ++l) {
+          const Vector3& position = polygon_positions[fan_indices[l]];
+          screen_triangle.inv_depth[l] = 1 / position(2);
+          screen_triangle.x[l] = fx * position(0) * screen_triangle.inv_depth[l] + cx;
+          screen_triangle.y[l] = fy * position(1) * screen_triangle.inv_depth[l] + cy;
+          screen_triangle.weights[l] = polygon_weights[fan_indices[l]];
+        }
+        const FloatType area = (screen_triangle.x[1] - screen_triangle.x[0]) * (screen_triangle.y[2] - screen_triangle.y[0])
+                               - (screen_triangle.y[1] - screen_triangle.y[0]) * (screen_triangle.x[2] - screen_triangle.x[0]);
+        if (area == 0 || !std::isfinite(area)) {
+          continue;
+        }
+        // Pixel centers are at half-integer coordinates (same as OpenGL)
+        const FloatType min_x = std::min({ screen_triangle.x[0], screen_triangle.x[1], screen_triangle.x[2] });
+        const FloatType min_y = std::min({ screen_triangle.y[0], screen_triangle.y[1], screen_triangle.y[2] });
+        const FloatType max_x = std::max({ screen_triangle.x[0], screen_triangle.x[1], screen_triangle.x[2] });
+        const FloatType max_y = std::max({ screen_triangle.y[0], screen_triangle.y[1], screen_triangle.y[2] });
+        if (max_x < FloatType(0.5) || max_y < FloatType(0.5)
+            || min_x > width - FloatType(0.5) || min_y > height - FloatType(0.5)) {
+          continue;
+        }
+        screen_triangle.min_x = std::max(static_cast<int>(std::ceil(min_x - FloatType(0.5))), 0);
+        screen_triangle.min_y = std::max(static_cast<int>(std::ceil(min_y - FloatType(0.5))), 0);
+        screen_triangle.max_x = std::min(static_cast<int>(std::floor(max_x - FloatType(0.5))), width - 1);
+        screen_triangle.max_y = std::min(static_cast<int>(std::floor(max_y - FloatType(0.5))), height - 1);
+        if (screen_triangle.min_x > screen_triangle.max_x || screen_triangle.min_y > screen_triangle.max_y) {
+          continue;
+        }
+        // Use a consistent winding so that all edge functions are positive inside of the triangle
+        if (area < 0) {
+          std::swap(screen_triangle.x[1], screen_triangle.x[2]);
+          std::swap(screen_triangle.y[1], screen_triangle.y[2]);
+          std::swap(screen_triangle.inv_depth[1], screen_triangle.inv_depth[2]);
+          std::swap(screen_triangle.weights[1], screen_triangle.weights[2]);
+        }
+        screen_triangle.triangle_index = static_cast<std::uint32_t>(i);
+        local_screen_triangles.push_back(screen_triangle);
+      }
+    }
+  }
+
+  std::size_t total_num_screen_triangles = 0;
+  for (const std::vector<ScreenTriangle>& local_screen_triangles : thread_screen_triangles) {
+    total_num_screen_triangles += local_screen_triangles.size();
+  }
+  screen_triangles->clear();
+  screen_triangles->reserve(total_num_screen_triangles);
+  for (const std::vector<ScreenTriangle>& local_screen_triangles : thread_screen_triangles) {
+    screen_triangles->insert(screen_triangles->end(), local_screen_triangles.begin(), local_screen_triangles.end());
+  }
+}
+
+void ViewpointSoftwareRenderer::rasterizeTile(
+        const std::vector<ScreenTriangle>& screen_triangles,
+        const std::uint32_t* tile_triangles_begin, const std::uint32_t* tile_triangles_end,
+        const int tile_min_x, const int tile_min_y, const int tile_max_x, const int tile_max_y,
+        SoftwareRenderBuffers* buffers) const {
+  const std::size_t width = buffers->width();
+  // Closest screen triangle and its perspective-correct barycentric coordinates for each pixel of the tile.
+  // The normals are only interpolated once the visible triangles are known.
+  const std::size_t tile_width = tile_max_x - tile_min_x + 1;
+  const std::size_t tile_height = tile_max_y - tile_min_y + 1;
+  std::vector<std::uint32_t> pixel_screen_triangles(tile_width * tile_height, SoftwareRenderBuffers::INVALID_TRIANGLE_INDEX);
+  std::vector<Vector3> pixel_weights(tile_width * tile_height);
+
+  for (const std::uint32_t* it = tile_triangles_begin; it != tile_triangles_end; ++it) {
+    const ScreenTriangle& tri = screen_triangles[*it];
+    const int min_x = std::max(tri.min_x, tile_min_x);
+    const int min_y = std::max(tri.min_y, tile_min_y);
+    const int max_x = std::min(tri.max_x, tile_max_x);
+    const int max_y = std::min(tri.max_y, tile_max_y);
+    // Edge functions e_i(x, y) = a_i * x + b_i * y + c_i are opposite of vertex i
+    FloatType a[3];
+    FloatType b[3];
+    FloatType c[3];
+    for (std::size_t i = 0; i < 3; ++i) {
+      const std::size_t j = (i + 1) % 3;
+      const std::size_t k = (i + 2) % 3;
+      a[i] = tri.y[j] - tri.y[k];
+      b[i] = tri.x[k] - tri.x[j];
+      c[i] = tri.x[j] * tri.y[k] - tri.x[k] * tri.y[j];
+    }
+    const FloatType inv_area = 1 / (c[0] + c[1] + c[2]);
+    for (int y = min_y; y <= max_y; ++y) {
+      const FloatType py = y + FloatType(0.5);
+      FloatType px = min_x + FloatType(0.5);
+      FloatType e[3];
+      for (std::size_t i = 0; i < 3; ++i) {
+        e[i] = a[i] * px + b[i] * py + c[i];
+      }
+      for (int x = min_x; x <= max_x; ++x) {
+        if (e[0] >= 0 && e[1] >= 0 && e[2] >= 0) {
+          const FloatType l0 = e[0] * inv_area;
+          const FloatType l1 = e[1] * inv_area;
+          const FloatType l2 = e[2] * inv_area;
+          const FloatType inv_depth = l0 * tri.inv_depth[0] + l1 * tri.inv_depth[1] + l2 * tri.inv_depth[2];
+          const FloatType depth = 1 / inv_depth;
+          const std::size_t index = y * width + x;
+          FloatType& depth_value = buffers->depth[index];
+          std::uint32_t& triangle_index = buffers->triangle_indices[index];
+          if (depth <= far_plane_
+              && (depth < depth_value || (depth == depth_value && tri.triangle_index < triangle_index))) {
+            depth_value = depth;
+            triangle_index = tri.triangle_index;
+            const std::size_t tile_index = (y - tile_min_y) * tile_width + (x - tile_min_x);
+            pixel_screen_triangles[tile_index] = *it;
+            pixel_weights[tile_index] = Vector3(
+                    l0 * tri.inv_depth[0], l1 * tri.inv_depth[1], l2 * tri.inv_depth[2]) * depth;
+          }
+        }
+        e[0] += a[0];
+        e[1] += a[1];
+        e[2] += a[2];
+      }
+    }
+  }
+
+  for (std::size_t tile_y = 0; tile_y < tile_height; ++tile_y) {
+    for (std::size_t tile_x = 0; tile_x < tile_width; ++tile_x) {
+      const std::size_t tile_index = tile_y * tile_width + tile_x;
+      if (pixel_screen_triangles[tile_index] == SoftwareRenderBuffers::INVALID_TRIANGLE_INDEX) {
+        continue;
+      }
+      const ScreenTriangle& tri = screen_triangles[pixel_screen_triangles[tile_index]];
+      const Vector3& w = pixel_weights[tile_index];
+      const Vector3 mesh_weights = w(0) * tri.weights[0] + w(1) * tri.weights[1] + w(2) * tri.weights[2];
+      const Vector3* normals = &corner_normals_[3 * tri.triangle_index];
+      const Vector3 normal = mesh_weights(0) * normals[0] + mesh_weights(1) * normals[1] + mesh_weights(2) * normals[2];
+      const std::size_t index = (tile_min_y + tile_y) * width + (tile_min_x + tile_x);
+      buffers->normals[index] = normal.normalized();
+    }
+  }
+}
+
+std::vector<std::uint32_t> ViewpointSoftwareRenderer::getVisibleTriangles(const SoftwareRenderBuffers& buffers) {
+  std::vector<std::uint32_t> visible_triangles;
+  for (const std::uint32_t triangle_index : buffers.triangle_indices) {
+    if (triangle_index != SoftwareRenderBuffers::INVALID_TRIANGLE_INDEX) {
+      visible_triangles.push_back(triangle_index);
+    }
+  }
+  std::sort(visible_triangles.begin(), visible_triangles.end());
+  visible_triangles.erase(std::unique(visible_triangles.begin(), visible_triangles.end()), visible_triangles.end());
+  return visible_triangles;
+}
+
+}
@@ -0,0 +1,137 @@
+//==================================================
+// viewpoint_software_renderer.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <bh/common.h>
+#include <bh/config_options.h>
+#include <bh/mLib/mLib.h>
+#include "viewpoint_planner_types.h"
+#include "viewpoint.h"
+
+namespace viewpoint_planner {
+
+/// Depth, normal and triangle index buffers of a rendered mesh (stored row by row).
+struct SoftwareRenderBuffers {
+  static constexpr std::uint32_t INVALID_TRIANGLE_INDEX = std::numeric_limits<std::uint32_t>::max();
+
+  void resize(const std::size_t width, const std::size_t height);
+
+  std::size_t width() const {
+    return width_;
+  }
+
+  std::size_t height() const {
+    return height_;
+  }
+
+  /// Whether a triangle is visible at the pixel
+  bool isValid(const std::size_t x, const std::size_t y) const {
+    return getTriangleIndex(x, y) != INVALID_TRIANGLE_INDEX;
+  }
+
+  /// Depth along the optical axis (infinity if no triangle is visible)
+  FloatType getDepth(const std::size_t x, const std::size_t y) const {
+    return depth[y * width_ + x];
+  }
+
+  /// Interpolated unit normal vector in world coordinates (zero if no triangle is visible)
+  const Vector3& getNormal(const std::size_t x, const std::size_t y) const {
+    return normals[y * width_ + x];
+  }
+
+  std::uint32_t getTriangleIndex(const std::size_t x, const std::size_t y) const {
+    return triangle_indices[y * width_ + x];
+  }
+
+  std::vector<FloatType> depth;
+  std::vector<Vector3> normals;
+  std::vector<std::uint32_t> triangle_indices;
+
+private:
+  std::size_t width_ = 0;
+  std::size_t height_ = 0;
+};
+
+/// Multithreaded tile-based rasterizer for depth, normal and triangle index images of a triangle mesh.
+///
+/// Produces the same images as the depth, normals and indices shaders of the OpenGL offscreen renderer
+/// but without an OpenGL context. Triangles are clipped against the near plane, binned into screen tiles and
+/// the tiles are rasterized in parallel with perspective-correct interpolation.
+/// Rendering does not modify the renderer so multiple viewpoints can be rendered concurrently.
+class ViewpointSoftwareRenderer {
+public:
+  using MeshType = ml::MeshData<FloatType>;
+
+  struct Options : bh::ConfigOptions {
+    Options() {
+      addOption<std::size_t>("software_renderer_tile_size", &software_renderer_tile_size);
+    }
+
+    ~Options() override {}
+
+    // Width and height of the screen tiles that are rasterized in parallel
+    std::size_t software_renderer_tile_size = 32;
+  };
+
+  explicit ViewpointSoftwareRenderer(const MeshType* mesh);
+
+  ViewpointSoftwareRenderer(const Options& options, const MeshType* mesh);
+
+  std::size_t getNumTriangles() const;
+
+  FloatType getNearPlane() const;
+
+  FloatType getFarPlane() const;
+
+  void setNearFarPlane(const FloatType near_plane, const FloatType far_plane);
+
+  /// Render the mesh from a viewpoint. The buffers are resized to the size of the viewpoint's camera.
+  void render(const Viewpoint& viewpoint, SoftwareRenderBuffers* buffers) const;
+
+  /// Sorted indices of all triangles that are visible in the rendered buffers
+  static std::vector<std::uint32_t> getVisibleTriangles(const SoftwareRenderBuffers& buffers);
+
+private:
+  /// Triangle in screen coordinates (possibly a part of a mesh triangle after near plane clipping)
+  struct ScreenTriangle {
+    FloatType x[3];
+    FloatType y[3];
+    FloatType inv_depth[3];
+    // Barycentric coordinates of the vertices with respect to the mesh triangle
+    Vector3 weights[3];
+    std::uint32_t triangle_index;
+    // Inclusive pixel bounds
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+  };
+
+  void setupScreenTriangles(const Viewpoint& viewpoint, std::vector<ScreenTriangle>* screen_triangles) const;
+
+  void rasterizeTile(
+          const std::vector<ScreenTriangle>& screen_triangles,
+          const std::uint32_t* tile_triangles_begin, const std::uint32_t* tile_triangles_end,
+          const int tile_min_x, const int tile_min_y, const int tile_max_x, const int tile_max_y,
+          SoftwareRenderBuffers* buffers) const;
+
+  Options options_;
+  FloatType near_plane_;
+  FloatType far_plane_;
+
+  std::vector<Vector3> vertices_;
+  // Vertex indices of the triangles
+  std::vector<std::uint32_t> triangle_vertex_indices_;
+  // Normal vectors of the triangle corners
+  std::vector<Vector3> corner_normals_;
+};
+
+}
@@ -0,0 +1,290 @@
+//==================================================
+// viewpoint_tour_local_search.cpp
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+
+#include "viewpoint_tour_local_search.h"
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <limits>
+#include <tuple>
+#include <bh/common.h>
+
+namespace viewpoint_planner {
+
+ViewpointTourLocalSearch::ViewpointTourLocalSearch(
+        const Options& options, const std::size_t num_nodes, std::vector<FloatType> distances)
+: options_(options), num_nodes_(num_nodes), distances_(std::move(distances)), min_improvement_(0) {
+  BH_ASSERT(distances_.size() == num_nodes_ * num_nodes_);
+  computeNeighbors();
+}
+
+void ViewpointTourLocalSearch::setEdgeCheckFunction(const EdgeCheckFunction& edge_check_function) {
+  edge_check_function_ = edge_check_function;
+  edge_check_cache_.clear();
+}
+
+FloatType ViewpointTourLocalSearch::computeTourLength(const std::vector<std::size_t>& tour) const {
+  if (tour.size() <= 1) {
+    return 0;
+  }
+  FloatType tour_length = 0;
+  for (std::size_t i = 0; i < tour.size(); ++i) {
+    const std::size_t next_i = i + 1 == tour.size() ? 0 : i + 1;
+    tour_length += getDistance(tour[i], tour[next_i]);
+  }
+  return tour_length;
+}
+
+ViewpointTourLocalSearch::Statistics ViewpointTourLocalSearch::improveTour(std::vector<std::size_t>* tour) {
+  BH_ASSERT(tour->size() == num_nodes_);
+  statistics_ = Statistics();
+  if (num_nodes_ < 4) {
+    return statistics_;
+  }
+  tour_ = *tour;
+  positions_.resize(num_nodes_);
+  for (std::size_t i = 0; i < tour_.size(); ++i) {
+    positions_[tour_[i]] = i;
+  }
+
+  // Ignore improvements that are only due to rounding errors (otherwise the search might not terminate)
+  const FloatType average_edge_length = computeTourLength(tour_) / num_nodes_;
+  if (std::isfinite(average_edge_length)) {
+    min_improvement_ = FloatType(1e-5) * average_edge_length;
+  }
+  else {
+    min_improvement_ = std::numeric_limits<FloatType>::epsilon();
+  }
+
+  active_nodes_.clear();
+  active_flags_.assign(num_nodes_, false);
+  for (const std::size_t node : tour_) {
+    activateNode(node);
+  }
+  while (!active_nodes_.empty()) {
+    const std::size_t node = active_nodes_.front();
+    active_nodes_.pop_front();
+    active_flags_[node] = false;
+    if (improveWith2Opt(node) || improveWithOrOpt(node)) {
+      activateNode(node);
+    }
+  }
+
+  *tour = std::move(tour_);
+  tour_.clear();
+  positions_.clear();
+  return statistics_;
+}
+
+bool ViewpointTourLocalSearch::isEdgeAllowed(const std::size_t node1, const std::size_t node2) {
+  if (!edge_check_function_) {
+    return true;
+  }
+  const std::size_t key = std::min(node1, node2) * num_nodes_ + std::max(node1, node2);
+  auto it = edge_check_cache_.find(key);
+  if (it == edge_check_cache_.end()) {
+    std::tie(it, std::ignore) = edge_check_cache_.emplace(key, edge_check_function_(node1, node2));
+  }
+  return it->second;
+}
+
+void ViewpointTourLocalSearch::computeNeighbors() {
+  neighbors_.resize(num_nodes_);
+  for (std::size_t node = 0; node < num_nodes_; ++node) {
+    std::vector<std::size_t>& neighbors = neighbors_[node];
+    neighbors.clear();
+    for (std::size_t other_node = 0; other_node < num_nodes_; ++other_node) {
+      if (other_node != node && std::isfinite(getDistance(node, other_node))) {
+        neighbors.push_back(other_node);
+      }
+    }
+    const std::size_t num_neighbors = std::min(options_.num_neighbors, neighbors.size());
+    const auto distance_compare = [&](const std::size_t node1, const std::size_t node2) {
+      return getDistance(node, node1) < getDistance(node, node2);
+    };
+    std::partial_sort(neighbors.begin(), neighbors.begin() + num_neighbors, neighbors.end(), distance_compare);
+    neighbors.resize(num_neighbors);
+  }
+}
+
+void ViewpointTourLocalSearch::activateNode(const std::size_t node) {
+  if (!active_flags_[node]) {
+    active_flags_[node] = true;
+    active_nodes_.push_back(node);
+  }
+}
+
+bool ViewpointTourLocalSearch::improveWith2Opt(const std::size_t node_a) {
+  // Replace edges (a, b) and (c, d) with (a, c) and (b, d) where b and d are the successors (or predecessors)
+  // of a and c. Only neighbors c closer to a than b can lead to an improvement.
+  for (const bool forward : { true, false }) {
+    const std::size_t node_b = forward ? getSuccessor(node_a) : getPredecessor(node_a);
+    const FloatType distance_ab = getDistance(node_a, node_b);
+    for (const std::size_t node_c : neighbors_[node_a]) {
+      const FloatType distance_ac = getDistance(node_a, node_c);
+      if (distance_ac + min_improvement_ >= distance_ab) {
+        break;
+      }
+      const std::size_t node_d = forward ? getSuccessor(node_c) : getPredecessor(node_c);
+      if (node_c == node_b || node_d == node_a) {
+        continue;
+      }
+      ++statistics_.num_evaluated_moves;
+      const FloatType delta = distance_ac + getDistance(node_b, node_d) - distance_ab - getDistance(node_c, node_d);
+      if (!(delta < -min_improvement_)) {
+        continue;
+      }
+      // Forward: a b ... c d -> a c ... b d, backward: b a ... d c -> b d ... a c
+      const std::size_t reverse_first = forward ? node_b : node_a;
+      const std::size_t reverse_last = forward ? node_c : node_d;
+      if (options_.max_2opt_segment_length > 0) {
+        const std::size_t segment_length = getSegmentLength(reverse_first, reverse_last);
+        if (std::min(segment_length, num_nodes_ - segment_length) > options_.max_2opt_segment_length) {
+          continue;
+        }
+      }
+      if (!isEdgeAllowed(node_a, node_c) || !isEdgeAllowed(node_b, node_d)) {
+        continue;
+      }
+      reverse(reverse_first, reverse_last);
+      activateNode(node_b);
+      activateNode(node_c);
+      activateNode(node_d);
+      ++statistics_.num_2opt_moves;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ViewpointTourLocalSearch::improveWithOrOpt(const std::size_t node) {
+  // Move the segment starting at node (p s1 ... s2 n) between a neighbor c of s1 or s2 and its successor
+  // or predecessor (in either orientation)
+  for (std::size_t segment_length = 1;
+       segment_length <= options_.max_or_opt_segment_length && segment_length + 3 <= num_nodes_;
+       ++segment_length) {
+    const std::size_t node_s1 = node;
+    const std::size_t node_s2 = tour_[(positions_[node_s1] + segment_length - 1) % num_nodes_];
+    const std::size_t node_p = getPredecessor(node_s1);
+    const std::size_t node_n = getSuccessor(node_s2);
+    const FloatType removal_gain = getDistance(node_p, node_s1) + getDistance(node_s2, node_n)
+                                   - getDistance(node_p, node_n);
+    if (!(removal_gain > min_improvement_)) {
+      continue;
+    }
+    const std::size_t num_segment_ends = segment_length == 1 ? 1 : 2;
+    for (std::size_t end = 0; end < num_segment_ends; ++end) {
+      const std::size_t node_e = end == 0 ? node_s1 : node_s2;
+      const std::size_t node_other = node_e == node_s1 ? node_s2 : node_s1;
+      for (const std::size_t node_c : neighbors_[node_e]) {
+        const FloatType distance_ec = getDistance(node_e, node_c);
+        if (distance_ec + min_improvement_ >= removal_gain) {
+          break;
+        }
+        if (getSegmentLength(node_s1, node_c) <= segment_length) {
+          continue;
+        }
+        // Insert between c and its successor f (c e ... other f)
+        const std::size_t node_f = getSuccessor(node_c);
+        if (node_f != node_s1) {
+          ++statistics_.num_evaluated_moves;
+          const FloatType delta = distance_ec + getDistance(node_other, node_f) - getDistance(node_c, node_f)
+                                  - removal_gain;
+          if (delta < -min_improvement_
+              && isEdgeAllowed(node_p, node_n) && isEdgeAllowed(node_e, node_c) && isEdgeAllowed(node_other, node_f)) {
+            moveSegment(node_s1, node_s2, node_c, node_e == node_s2);
+            activateNode(node_p);
+            activateNode(node_n);
+            activateNode(node_c);
+            activateNode(node_f);
+            activateNode(node_other);
+            ++statistics_.num_or_opt_moves;
+            return true;
+          }
+        }
+        // Insert between the predecessor g of c and c (g other ... e c)
+        const std::size_t node_g = getPredecessor(node_c);
+        if (node_g != node_s2) {
+          ++statistics_.num_evaluated_moves;
+          const FloatType delta = distance_ec + getDistance(node_g, node_other) - getDistance(node_g, node_c)
+                                  - removal_gain;
+          if (delta < -min_improvement_
+              && isEdgeAllowed(node_p, node_n) && isEdgeAllowed(node_e, node_c) && isEdgeAllowed(node_g, node_other)) {
+            moveSegment(node_s1, node_s2, node_g, node_other == node_s2);
+            activateNode(node_p);
+            activateNode(node_n);
+            activateNode(node_c);
+            activateNode(node_g);
+            activateNode(node_other);
+            ++statistics_.num_or_opt_moves;
+            return true;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
+
+void ViewpointTourLocalSearch::reverse(const std::size_t node1, const std::size_t node2) {
+  std::size_t first = node1;
+  std::size_t last = node2;
+  std::size_t segment_length = getSegmentLength(first, last);
+  // Reversing the complementary part results in the same cycle
+  if (2 * segment_length > num_nodes_) {
+    first = getSuccessor(node2);
+    last = getPredecessor(node1);
+    segment_length = num_nodes_ - segment_length;
+  }
+  reversePositions(positions_[first], segment_length);
+}
+
+void ViewpointTourLocalSearch::reversePositions(const std::size_t position, const std::size_t length) {
+  if (length < 2) {
+    return;
+  }
+  std::size_t i = position;
+  std::size_t j = (position + length - 1) % num_nodes_;
+  for (std::size_t k = 0; k < length / 2; ++k) {
+    std::swap(tour_[i], tour_[j]);
+    positions_[tour_[i]] = i;
+    positions_[tour_[j]] = j;
+    i = i + 1 == num_nodes_ ? 0 : i + 1;
+    j = j == 0 ? num_nodes_ - 1 : j - 1;
+  }
+}
+
+void ViewpointTourLocalSearch::moveSegment(
+        const std::size_t first, const std::size_t last, const std::size_t node, const bool reversed) {
+  // The segment is rotated in place with the nodes between it and node on the shorter side of the tour.
+  // A rotation of two adjacent ranges A B into B A is done by reversing both ranges and then the whole range.
+  // Skipping the reversal of the segment leaves it reversed.
+  const std::size_t segment_length = getSegmentLength(first, last);
+  const std::size_t first_position = positions_[first];
+  const std::size_t forward_length = getSegmentLength(last, node) - 1;
+  const std::size_t backward_length = num_nodes_ - segment_length - forward_length;
+  if (forward_length <= backward_length) {
+    // Segment followed by the nodes up to node
+    if (!reversed) {
+      reversePositions(first_position, segment_length);
+    }
+    reversePositions((first_position + segment_length) % num_nodes_, forward_length);
+    reversePositions(first_position, segment_length + forward_length);
+  }
+  else {
+    // Nodes after node followed by the segment
+    const std::size_t begin_position = (first_position + num_nodes_ - backward_length) % num_nodes_;
+    if (!reversed) {
+      reversePositions(first_position, segment_length);
+    }
+    reversePositions(begin_position, backward_length);
+    reversePositions(begin_position, backward_length + segment_length);
+  }
+}
+
+}
@@ -0,0 +1,118 @@
+//==================================================
+// viewpoint_tour_local_search.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "viewpoint_planner_types.h"
+
+namespace viewpoint_planner {
+
+/// 2-Opt and Or-Opt local search for a symmetric tour (cycle) over a set of nodes.
+///
+/// Moves are evaluated in constant time from the distance changes of the exchanged edges.
+/// Candidate moves are restricted to the nearest neighbors of each node and nodes without an improving move
+/// are skipped until one of their tour edges changes (don't-look bits).
+/// 2-Opt moves reverse the shorter side of the tour in place.
+class ViewpointTourLocalSearch {
+public:
+  /// Returns whether an edge between two nodes may be part of the tour
+  using EdgeCheckFunction = std::function<bool(const std::size_t, const std::size_t)>;
+
+  struct Options {
+    // Number of nearest neighbors of each node that are considered for new edges
+    std::size_t num_neighbors = 10;
+    // Maximum length of a segment that is moved by Or-Opt (0 disables Or-Opt)
+    std::size_t max_or_opt_segment_length = 3;
+    // Maximum length of a segment that is reversed by 2-Opt (0 means unlimited)
+    std::size_t max_2opt_segment_length = 0;
+  };
+
+  struct Statistics {
+    std::size_t num_2opt_moves = 0;
+    std::size_t num_or_opt_moves = 0;
+    std::size_t num_evaluated_moves = 0;
+  };
+
+  /// Distances between all pairs of nodes in row-major order.
+  /// Nodes without a connection must have an infinite distance and are never connected by a move.
+  ViewpointTourLocalSearch(const Options& options, const std::size_t num_nodes, std::vector<FloatType> distances);
+
+  /// Set a function that every new edge has to pass (i.e. for sparse matchability)
+  void setEdgeCheckFunction(const EdgeCheckFunction& edge_check_function);
+
+  std::size_t getNumNodes() const {
+    return num_nodes_;
+  }
+
+  FloatType getDistance(const std::size_t node1, const std::size_t node2) const {
+    return distances_[node1 * num_nodes_ + node2];
+  }
+
+  FloatType computeTourLength(const std::vector<std::size_t>& tour) const;
+
+  /// Improve a tour (containing every node once) until no improving move is left.
+  Statistics improveTour(std::vector<std::size_t>* tour);
+
+private:
+  std::size_t getSuccessor(const std::size_t node) const {
+    const std::size_t position = positions_[node] + 1;
+    return tour_[position == tour_.size() ? 0 : position];
+  }
+
+  std::size_t getPredecessor(const std::size_t node) const {
+    const std::size_t position = positions_[node];
+    return tour_[position == 0 ? tour_.size() - 1 : position - 1];
+  }
+
+  /// Number of nodes on the tour from node1 to node2 (both inclusive) in forward direction
+  std::size_t getSegmentLength(const std::size_t node1, const std::size_t node2) const {
+    return (positions_[node2] + tour_.size() - positions_[node1]) % tour_.size() + 1;
+  }
+
+  bool isEdgeAllowed(const std::size_t node1, const std::size_t node2);
+
+  void computeNeighbors();
+
+  void activateNode(const std::size_t node);
+
+  bool improveWith2Opt(const std::size_t node);
+
+  bool improveWithOrOpt(const std::size_t node);
+
+  /// Reverse the tour from node1 to node2 in forward direction (or the complementary part if it is shorter)
+  void reverse(const std::size_t node1, const std::size_t node2);
+
+  /// Reverse length nodes of the tour starting at position (wrapping around the end of the tour)
+  void reversePositions(const std::size_t position, const std::size_t length);
+
+  /// Move the segment from first to last (in forward direction) between node and its successor.
+  /// If reversed is true the last node of the segment becomes adjacent to node.
+  void moveSegment(const std::size_t first, const std::size_t last, const std::size_t node, const bool reversed);
+
+  Options options_;
+  std::size_t num_nodes_;
+  std::vector<FloatType> distances_;
+  // Nearest neighbors of each node sorted by distance
+  std::vector<std::vector<std::size_t>> neighbors_;
+  EdgeCheckFunction edge_check_function_;
+  // Cached results of the edge check function
+  std::unordered_map<std::size_t, bool> edge_check_cache_;
+  FloatType min_improvement_;
+
+  std::vector<std::size_t> tour_;
+  std::vector<std::size_t> positions_;
+  std::deque<std::size_t> active_nodes_;
+  std::vector<bool> active_flags_;
+  Statistics statistics_;
+};
+
+}
@@ -0,0 +1,298 @@
+//==================================================
+// voxel_index_set.h
+//
+//  Copyright (c) 2017 Benjamin Hepp.
+//  Author: Benjamin Hepp
+//  Created on: Oct 16, 2017
+//==================================================
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <boost/iterator/iterator_facade.hpp>
+#include <bh/common.h>
+#include "viewpoint_planner_types.h"
+#include "occupied_tree.h"
+
+namespace viewpoint_planner {
+
+/// Dense index of a voxel (see bvh::Node::getIndex())
+using VoxelIndex = std::uint32_t;
+
+/// Voxel index and it's corresponding amount of information
+struct VoxelIndexWithInformation {
+  VoxelIndexWithInformation(const VoxelIndex index, const FloatType information)
+  : index(index), information(information) {}
+
+  VoxelIndex index;
+  FloatType information;
+};
+
+/// Set of voxels with their information stored as arrays of voxel indices and information values.
+///
+/// The voxel indices are sorted so that intersections and differences of sets are linear merges.
+/// Compared to a VoxelWithInformationSet this needs only 8 bytes per voxel.
+class VoxelIndexWithInformationSet {
+public:
+  class ConstIterator : public boost::iterator_facade<
+      ConstIterator,
+      const VoxelIndexWithInformation,
+      boost::random_access_traversal_tag,
+      VoxelIndexWithInformation> {
+  public:
+    ConstIterator()
+    : set_(nullptr), position_(0) {}
+
+    ConstIterator(const VoxelIndexWithInformationSet* set, const std::size_t position)
+    : set_(set), position_(position) {}
+
+  private:
+    friend class boost::iterator_core_access;
+
+    VoxelIndexWithInformation dereference() const {
+      return VoxelIndexWithInformation(set_->indices_[position_], set_->informations_[position_]);
+    }
+
+    bool equal(const ConstIterator& other) const {
+      return position_ == other.position_;
+    }
+
+    void increment() {
+      ++position_;
+    }
+
+    void decrement() {
+      --position_;
+    }
+
+    void advance(const std::ptrdiff_t n) {
+      position_ += n;
+    }
+
+    std::ptrdiff_t distance_to(const ConstIterator& other) const {
+      return static_cast<std::ptrdiff_t>(other.position_) - static_cast<std::ptrdiff_t>(position_);
+    }
+
+    const VoxelIndexWithInformationSet* set_;
+    std::size_t position_;
+  };
+
+  using const_iterator = ConstIterator;
+
+  VoxelIndexWithInformationSet() {}
+
+  /// Create from voxel pointers
+  explicit VoxelIndexWithInformationSet(const VoxelWithInformationSet& voxel_set) {
+    indices_.reserve(voxel_set.size());
+    informations_.reserve(voxel_set.size());
+    std::vector<std::pair<VoxelIndex, FloatType>> entries;
+    entries.reserve(voxel_set.size());
+    for (const VoxelWithInformation& vi : voxel_set) {
+      entries.emplace_back(vi.voxel->getIndex(), vi.information);
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const std::pair<VoxelIndex, FloatType>& a, const std::pair<VoxelIndex, FloatType>& b) {
+      return a.first < b.first;
+    });
+    for (const auto& entry : entries) {
+      indices_.push_back(entry.first);
+      informations_.push_back(entry.second);
+    }
+  }
+
+  /// Create from arrays that are already sorted by voxel index (without duplicates)
+  VoxelIndexWithInformationSet(std::vector<VoxelIndex>&& indices, std::vector<FloatType>&& informations)
+  : indices_(std::move(indices)), informations_(std::move(informations)) {
+    BH_ASSERT(indices_.size() == informations_.size());
+#if !BH_RELEASE
+    BH_ASSERT(std::adjacent_find(indices_.begin(), indices_.end(), std::greater_equal<VoxelIndex>()) == indices_.end());
+#endif
+  }
+
+  std::size_t size() const {
+    return indices_.size();
+  }
+
+  bool empty() const {
+    return indices_.empty();
+  }
+
+  void clear() {
+    indices_.clear();
+    informations_.clear();
+    indices_.shrink_to_fit();
+    informations_.shrink_to_fit();
+  }
+
+  ConstIterator begin() const {
+    return ConstIterator(this, 0);
+  }
+
+  ConstIterator end() const {
+    return ConstIterator(this, size());
+  }
+
+  ConstIterator cbegin() const {
+    return begin();
+  }
+
+  ConstIterator cend() const {
+    return end();
+  }
+
+  VoxelIndex getIndex(const std::size_t position) const {
+    return indices_[position];
+  }
+
+  FloatType getInformation(const std::size_t position) const {
+    return informations_[position];
+  }
+
+  const std::vector<VoxelIndex>& getIndices() const {
+    return indices_;
+  }
+
+  const std::vector<FloatType>& getInformations() const {
+    return informations_;
+  }
+
+  /// Position of a voxel in the set or size() if the voxel is not contained
+  std::size_t findPosition(const VoxelIndex index) const {
+    const auto it = std::lower_bound(indices_.begin(), indices_.end(), index);
+    if (it != indices_.end() && *it == index) {
+      return it - indices_.begin();
+    }
+    return size();
+  }
+
+  bool contains(const VoxelIndex index) const {
+    return findPosition(index) != size();
+  }
+
+  /// Call func(position, other_position) for each voxel contained in both sets (in order of the voxel indices)
+  template <typename Function>
+  void forEachIntersection(const VoxelIndexWithInformationSet& other, Function func) const {
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < indices_.size() && j < other.indices_.size()) {
+      if (indices_[i] < other.indices_[j]) {
+        ++i;
+      }
+      else if (other.indices_[j] < indices_[i]) {
+        ++j;
+      }
+      else {
+        func(i, j);
+        ++i;
+        ++j;
+      }
+    }
+  }
+
+  std::size_t computeIntersectionSize(const VoxelIndexWithInformationSet& other) const {
+    std::size_t intersection_size = 0;
+    forEachIntersection(other, [&](const std::size_t, const std::size_t) {
+      ++intersection_size;
+    });
+    return intersection_size;
+  }
+
+  /// Voxels contained in both sets (the information values are taken from this set)
+  VoxelIndexWithInformationSet computeIntersection(const VoxelIndexWithInformationSet& other) const {
+    std::vector<VoxelIndex> indices;
+    std::vector<FloatType> informations;
+    forEachIntersection(other, [&](const std::size_t i, const std::size_t) {
+      indices.push_back(indices_[i]);
+      informations.push_back(informations_[i]);
+    });
+    return VoxelIndexWithInformationSet(std::move(indices), std::move(informations));
+  }
+
+  FloatType computeTotalInformation() const {
+    FloatType total_information = 0;
+    for (const FloatType information : informations_) {
+      total_information += information;
+    }
+    return total_information;
+  }
+
+private:
+  std::vector<VoxelIndex> indices_;
+  std::vector<FloatType> informations_;
+};
+
+/// Map from voxels to a value stored in a flat array indexed by the voxel index.
+///
+/// Lookups and updates are a single array access. The contained voxel indices are kept in insertion order
+/// so that the map can be iterated and cleared in time proportional to its size.
+class DenseVoxelMap {
+public:
+  DenseVoxelMap() {}
+
+  std::size_t size() const {
+    return indices_.size();
+  }
+
+  bool empty() const {
+    return indices_.empty();
+  }
+
+  void clear() {
+    for (const VoxelIndex index : indices_) {
+      values_[index] = getEmptyValue();
+    }
+    indices_.clear();
+  }
+
+  /// Pointer to the value of a voxel or nullptr if the voxel is not contained
+  const FloatType* find(const VoxelIndex index) const {
+    if (index < values_.size() && values_[index] != getEmptyValue()) {
+      return &values_[index];
+    }
+    return nullptr;
+  }
+
+  FloatType* find(const VoxelIndex index) {
+    if (index < values_.size() && values_[index] != getEmptyValue()) {
+      return &values_[index];
+    }
+    return nullptr;
+  }
+
+  /// Insert a voxel that is not contained yet
+  void emplace(const VoxelIndex index, const FloatType value) {
+    BH_ASSERT(value != getEmptyValue());
+    if (index >= values_.size()) {
+      values_.resize(index + 1, getEmptyValue());
+    }
+    BH_ASSERT(values_[index] == getEmptyValue());
+    values_[index] = value;
+    indices_.push_back(index);
+  }
+
+  /// Value of a contained voxel
+  FloatType at(const VoxelIndex index) const {
+    const FloatType* value = find(index);
+    BH_ASSERT(value != nullptr);
+    return *value;
+  }
+
+  /// Contained voxel indices in insertion order
+  const std::vector<VoxelIndex>& getIndices() const {
+    return indices_;
+  }
+
+private:
+  static constexpr FloatType getEmptyValue() {
+    return std::numeric_limits<FloatType>::lowest();
+  }
+
+  std::vector<FloatType> values_;
+  std::vector<VoxelIndex> indices_;
+};
+
+}
@@ -1389,10 +1389,10 @@ void ViewerWidget::onRaycastFinished() {
   //    const FloatType information = planner_->computeViewpointObservationScore(viewpoint, it->voxel);
       FloatType information = it->information;
       if (raycast_mode_ == RaycastMode::WITH_CURRENT_INFORMATION) {
-        const auto observed_it = viewpoint_path->observed_voxel_map.find(it->voxel);
-        if (observed_it != viewpoint_path->observed_voxel_map.end()) {
-          const FloatType voxel_weight = observed_it->first.voxel->getObject()->weight;
-          information = std::min(information, voxel_weight - observed_it->second);
+        const FloatType* observed_information = viewpoint_path->observed_voxel_map.find(it->voxel->getIndex());
+        if (observed_information != nullptr) {
+          const FloatType voxel_weight = it->voxel->getObject()->weight;
+          information = std::min(information, voxel_weight - *observed_information);
         }
       }
       tmp.push_back(std::make_pair(it->voxel, information));
@@ -1411,9 +1411,9 @@ void ViewerWidget::onRaycastFinished() {
     const FloatType new_information = std::accumulate(raycast_voxels.begin(), raycast_voxels.end(),
     FloatType { 0 }, [&](const FloatType& value, const ViewpointPlanner::VoxelWithInformation& vi) {
       FloatType information = vi.information;
-      auto it = viewpoint_path->observed_voxel_map.find(vi.voxel);
-      if (it != viewpoint_path->observed_voxel_map.end()) {
-        information -= it->second;
+      const FloatType* observed_information = viewpoint_path->observed_voxel_map.find(vi.voxel->getIndex());
+      if (observed_information != nullptr) {
+        information -= *observed_information;
         if (information < 0) {
           information = 0;
         }
@@ -1432,10 +1432,10 @@ void ViewerWidget::onRaycastFinished() {
   //    const FloatType information = planner_->computeViewpointObservationScore(viewpoint, it->voxel);
       FloatType information = it->information;
       if (raycast_mode_ == RaycastMode::WITH_CURRENT_INFORMATION) {
-        const auto observed_it = viewpoint_path->observed_voxel_map.find(it->voxel);
-        if (observed_it != viewpoint_path->observed_voxel_map.end()) {
-          const FloatType voxel_weight = observed_it->first.voxel->getObject()->weight;
-          information = std::min(information, voxel_weight - observed_it->second);
+        const FloatType* observed_information = viewpoint_path->observed_voxel_map.find(it->voxel->getIndex());
+        if (observed_information != nullptr) {
+          const FloatType voxel_weight = it->voxel->getObject()->weight;
+          information = std::min(information, voxel_weight - *observed_information);
         }
       }
       tmp.push_back(std::make_pair(it->voxel, information));
@@ -1694,11 +1694,11 @@ void ViewerWidget::setViewpointGraphSelectionIndex(const std::size_t index) {
     std::size_t new_voxels = 0;
     FloatType new_information = std::accumulate(viewpoint_entry.voxel_set.cbegin(), viewpoint_entry.voxel_set.cend(),
                                                 FloatType {0}, [&](const FloatType &value,
-                                                                   const ViewpointPlanner::VoxelWithInformation &voxel_with_information) {
+                                                                   const ViewpointPlanner::VoxelIndexWithInformation &voxel_with_information) {
               FloatType information = voxel_with_information.information;
-              auto it = viewpoint_path.observed_voxel_map.find(voxel_with_information.voxel);
-              if (it != viewpoint_path.observed_voxel_map.end()) {
-                information -= it->second;
+              const FloatType* observed_information = viewpoint_path.observed_voxel_map.find(voxel_with_information.index);
+              if (observed_information != nullptr) {
+                information -= *observed_information;
                 if (information < 0) {
                   information = 0;
                 }
@@ -1714,7 +1714,7 @@ void ViewerWidget::setViewpointGraphSelectionIndex(const std::size_t index) {
   if (planner_panel_->isUpdateCameraOnSelectionChecked()) {
     setCameraPose(viewpoint_entry.viewpoint.pose());
   }
-  octree_drawer_.updateRaycastVoxels(viewpoint_entry.voxel_set);
+  octree_drawer_.updateRaycastVoxels(planner_->getVoxelWithInformationSet(viewpoint_entry.voxel_set));
   octree_drawer_.setInformationRange(0, 1);
   octree_drawer_.setWeightRange(0, 1);
 
@@ -1757,7 +1757,7 @@ void ViewerWidget::setViewpointPathBranchSelectionIndex(std::size_t index) {
   // Set previous selection for combo box
   planner_panel_->setViewpointPathSelectionByItemIndex(path_selection_index);
   // Show triangulated voxels
-  octree_drawer_.updateRaycastVoxels(viewpoint_path.observed_voxel_map);
+  octree_drawer_.updateRaycastVoxels(planner_->getVoxelMap(viewpoint_path.observed_voxel_map));
   octree_drawer_.setInformationRange(0, 1);
   octree_drawer_.setWeightRange(0, 1);
 }
@@ -1790,7 +1790,8 @@ void ViewerWidget::setViewpointPathSelectionIndex(std::size_t index) {
   // Compute total and incremental voxel set and information of selected viewpoint
   const ViewpointPlanner::ViewpointEntryIndex viewpoint_index = viewpoint_path.entries[index].viewpoint_index;
   const ViewpointPlanner::ViewpointEntry& viewpoint_entry = planner_->getViewpointEntries()[viewpoint_index];
-  const ViewpointPlanner::VoxelWithInformationSet total_voxel_set = viewpoint_entry.voxel_set;
+  const ViewpointPlanner::VoxelWithInformationSet total_voxel_set =
+      planner_->getVoxelWithInformationSet(viewpoint_entry.voxel_set);
   // TODO: Broken. Only for triangulation mode,
   //  const ViewpointPlanner::ViewpointPathComputationData& comp_data = planner_->getViewpointPathsComputationData()[viewpoint_path_branch_index];
 //  ViewpointPlanner::VoxelWithInformationSet total_voxel_set = viewpoint_entry.voxel_set;
@@ -1817,7 +1818,8 @@ void ViewerWidget::setViewpointPathSelectionIndex(std::size_t index) {
     // Compute accumulated and incremental voxel map
     for (std::size_t i = 0; i <= index; ++i) {
       ViewpointPlanner::ViewpointEntryIndex other_viewpoint_index = viewpoint_path.entries[i].viewpoint_index;
-      const ViewpointPlanner::VoxelWithInformationSet& other_voxel_set = planner_->getViewpointEntries()[other_viewpoint_index].voxel_set;
+      const ViewpointPlanner::VoxelWithInformationSet other_voxel_set =
+          planner_->getVoxelWithInformationSet(planner_->getViewpointEntries()[other_viewpoint_index].voxel_set);
       for (const ViewpointPlanner::VoxelWithInformation& vi : other_voxel_set) {
         const FloatType observation_information = planner_->getOptions().viewpoint_information_factor * vi.information;
         const auto it = accumulated_voxel_map.find(vi.voxel);
@@ -2350,10 +2352,10 @@ void ViewerWidget::keyPressEvent(QKeyEvent* event) {
       const FloatType voxel_weight = result.node->getObject()->weight;
       voxel_map.emplace(result.node, voxel_weight);
     }
-    for (const ViewpointPlanner::VoxelMap::value_type& entry : viewpoint_path.observed_voxel_map) {
-      const auto it = voxel_map.find(entry.first);
+    for (const ViewpointPlanner::VoxelIndex voxel_index : viewpoint_path.observed_voxel_map.getIndices()) {
+      const auto it = voxel_map.find(planner_->getVoxel(voxel_index));
       if (it != voxel_map.end()) {
-        it->second -= entry.second;
+        it->second -= viewpoint_path.observed_voxel_map.at(voxel_index);
       }
     }
     octree_drawer_.updateRaycastVoxels(voxel_map);